@@ -29,6 +29,9 @@
 #! a shared library using Qt. Additionally, it generates
 #! plugin meta-data by creating a MANIFEST.MF text file
 #! which is embedded in the share library as a Qt resource.
+#! The resources are also compiled into a <library>.rcc file
+#! next to the library, from which the plug-in framework reads
+#! the meta-data without loading the library.
 #!
 #! The following variables can be set in a file named
 #! manifest_headers.cmake, which will then be read by
@@ -231,6 +234,17 @@ macro(ctkMacroBuildPlugin)
   endif()
   list(APPEND MY_QRC_SRCS ${manifest_qrc_src})
 
+  # The resource collections which are also compiled into the
+  # <library>.rcc sidecar file (see below)
+  set(_plugin_qrc_files "${CMAKE_CURRENT_BINARY_DIR}/${lib_name}_manifest.qrc")
+  foreach(_resource_qrc ${MY_RESOURCES})
+    if(IS_ABSOLUTE "${_resource_qrc}")
+      list(APPEND _plugin_qrc_files ${_resource_qrc})
+    else()
+      list(APPEND _plugin_qrc_files "${CMAKE_CURRENT_SOURCE_DIR}/${_resource_qrc}")
+    endif()
+  endforeach()
+
   # Create translation files (.ts and .qm)
   set(_plugin_qm_files )
   set(_plugin_cached_resources_in_binary_tree )
@@ -273,6 +287,7 @@ macro(ctkMacroBuildPlugin)
       PREFIX ${Plugin-SymbolicName}
       RESOURCES ${_plugin_cached_resources_in_source_tree}
       BINARY_RESOURCES ${_plugin_cached_resources_in_binary_tree})
+    list(APPEND _plugin_qrc_files "${CMAKE_CURRENT_BINARY_DIR}/${_plugin_symbolicname}_cached.qrc")
   endif()
 
   source_group("Resources" FILES
@@ -371,12 +386,49 @@ macro(ctkMacroBuildPlugin)
     PREFIX "lib"
     )
 
+  # Compile the plug-in resources a second time into a binary <library>.rcc
+  # file next to the library. The plug-in framework reads the manifest and
+  # the resources from it when installing the plug-in, instead of loading
+  # the library.
+  if(CTK_QT_VERSION VERSION_GREATER "4")
+    set(_rcc_executable ${Qt5Core_RCC_EXECUTABLE})
+  else()
+    set(_rcc_executable ${QT_RCC_EXECUTABLE})
+  endif()
+  add_custom_command(
+    TARGET ${lib_name}
+    POST_BUILD
+    COMMAND ${_rcc_executable} -binary -o $<TARGET_FILE:${lib_name}>.rcc ${_plugin_qrc_files}
+    WORKING_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR}
+    )
+
   if(NOT MY_TEST_PLUGIN AND NOT MY_NO_INSTALL)
     # Install rules
     install(TARGETS ${lib_name} EXPORT CTKExports
       RUNTIME DESTINATION ${CTK_INSTALL_PLUGIN_DIR} COMPONENT RuntimePlugins
       LIBRARY DESTINATION ${CTK_INSTALL_PLUGIN_DIR} COMPONENT RuntimePlugins
       ARCHIVE DESTINATION ${CTK_INSTALL_PLUGIN_DIR} COMPONENT Development)
+
+    # The install step rewrites the library (RPATH), so touch the installed
+    # sidecar to keep it newer than the library. The sidecar location is
+    # only known for single configuration generators; the plug-ins of the
+    # other generators are loaded when installed.
+    if(CMAKE_CFG_INTDIR STREQUAL ".")
+      if(WIN32)
+        set(_plugin_rcc_dir ${plugin_RUNTIME_output_dir})
+      else()
+        set(_plugin_rcc_dir ${plugin_LIBRARY_output_dir})
+      endif()
+      set(_plugin_rcc_name "lib${lib_name}${CMAKE_SHARED_LIBRARY_SUFFIX}.rcc")
+      install(FILES "${_plugin_rcc_dir}/${_plugin_rcc_name}"
+        DESTINATION ${CTK_INSTALL_PLUGIN_DIR} COMPONENT RuntimePlugins OPTIONAL)
+      install(CODE "
+        set(_plugin_rcc \"\$ENV{DESTDIR}\${CMAKE_INSTALL_PREFIX}/${CTK_INSTALL_PLUGIN_DIR}/${_plugin_rcc_name}\")
+        if(EXISTS \"\${_plugin_rcc}\")
+          execute_process(COMMAND \"${CMAKE_COMMAND}\" -E touch \"\${_plugin_rcc}\")
+        endif()"
+        COMPONENT RuntimePlugins)
+    endif()
   endif()
 
   set(my_libs
@@ -142,6 +142,47 @@ int ctkDICOMDatabaseTest4( int argc, char * argv [] )
     return EXIT_FAILURE;
     }
 
+  // check the bulk lookups
+  QStringList instanceUIDs;
+  instanceUIDs << instanceUID << "1.2.3.unknown";
+  QStringList tags;
+  tags << tag << badTag;
+  QList<QStringList> cachedTags = database.cachedTags(instanceUIDs, tags);
+  if (cachedTags.count() != 2
+      || cachedTags[0] != (QStringList() << knownSeriesDescription << "__TAG_NOT_IN_INSTANCE__")
+      || cachedTags[1] != (QStringList() << "" << ""))
+    {
+    std::cerr << "ctkDICOMDatabase: bulk tag cache lookup returned wrong values" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the tags cached after the precached ones keep the series of the instance
+  QString seriesUID = database.seriesForFile(filePath);
+  QMap<QString, QStringList> seriesTags = database.cachedTagsForSeries(seriesUID, tags);
+  if (seriesTags.count() != 1
+      || seriesTags.value(instanceUID) != (QStringList() << knownSeriesDescription << "__TAG_NOT_IN_INSTANCE__"))
+    {
+    std::cerr << "ctkDICOMDatabase: series tag cache lookup returned wrong values" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // caching a precached tag again must not lose its series
+  if (!database.cacheTag(instanceUID, tag, knownSeriesDescription)
+      || database.cachedTagsForSeries(seriesUID, tags) != seriesTags)
+    {
+    std::cerr << "ctkDICOMDatabase: cacheTag() should keep the series of the instance" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // values must also be found after the in-memory cache is dropped
+  database.closeDatabase();
+  database.openDatabase(databaseFile.absoluteFilePath());
+  if (database.cachedTags(instanceUIDs, tags) != cachedTags)
+    {
+    std::cerr << "ctkDICOMDatabase: tag cache should persist across sessions" << std::endl;
+    return EXIT_FAILURE;
+    }
+
   database.closeDatabase();
 
   std::cerr << "Database is in " << databaseDirectory.path().toStdString() << std::endl;
@@ -0,0 +1,166 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QTime>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// Build a minimal synthetic instance, no pixel data is needed for indexing
+ctkDICOMDatabase::IndexingResult createInstance(int patient, int study, int series, int instance)
+{
+  QString studyUID = QString("1.2.826.0.1.3680043.2.1125.%1.%2").arg(patient).arg(study);
+  QString seriesUID = QString("%1.%2").arg(studyUID).arg(series);
+  QString instanceUID = QString("%1.%2").arg(seriesUID).arg(instance);
+
+  DcmDataset* dataset = new DcmDataset;
+  dataset->putAndInsertString(DCM_PatientName, QString("Patient^%1").arg(patient).toLatin1().data());
+  dataset->putAndInsertString(DCM_PatientID, QString("ID%1").arg(patient).toLatin1().data());
+  dataset->putAndInsertString(DCM_StudyInstanceUID, studyUID.toLatin1().data());
+  dataset->putAndInsertString(DCM_StudyDescription, "Benchmark study");
+  dataset->putAndInsertString(DCM_SeriesInstanceUID, seriesUID.toLatin1().data());
+  dataset->putAndInsertString(DCM_SeriesDescription, "Benchmark series");
+  dataset->putAndInsertString(DCM_Modality, "CT");
+  dataset->putAndInsertString(DCM_SOPInstanceUID, instanceUID.toLatin1().data());
+
+  ctkDICOMDatabase::IndexingResult indexingResult;
+  indexingResult.dataset = QSharedPointer<ctkDICOMItem>(new ctkDICOMItem);
+  indexingResult.dataset->InitializeFromItem(dataset, true);
+  // the file is never read since neither copy nor thumbnail is requested
+  indexingResult.filePath = QString("/benchmark/%1").arg(instanceUID);
+  indexingResult.storeFile = false;
+  indexingResult.generateThumbnail = false;
+  return indexingResult;
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabaseTest6( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  ctkDICOMDatabase database;
+  database.openDatabase(":memory:", "ctkDICOMDatabaseTest6");
+  if (!database.isOpen() || !database.lastError().isEmpty())
+    {
+    std::cerr << "ctkDICOMDatabase::openDatabase() failed: "
+              << qPrintable(database.lastError()) << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const int patients = 4;
+  const int studiesPerPatient = 2;
+  const int seriesPerStudy = 5;
+  const int instancesPerSeries = 50;
+
+  QList<ctkDICOMDatabase::IndexingResult> instances;
+  for (int patient = 0; patient < patients; ++patient)
+    {
+    for (int study = 0; study < studiesPerPatient; ++study)
+      {
+      for (int series = 0; series < seriesPerStudy; ++series)
+        {
+        for (int instance = 0; instance < instancesPerSeries; ++instance)
+          {
+          instances << createInstance(patient, study, series, instance);
+          }
+        }
+      }
+    }
+
+  // one transaction per instance
+  QTime timer;
+  timer.start();
+  const int singleInserts = instances.count() / 2;
+  for (int i = 0; i < singleInserts; ++i)
+    {
+    database.insert(instances.mid(i, 1));
+    }
+  int singleElapsed = qMax(1, timer.elapsed());
+
+  // one transaction for the remaining instances
+  timer.start();
+  database.insert(instances.mid(singleInserts));
+  int batchElapsed = qMax(1, timer.elapsed());
+
+  std::cout << "Single inserts: "
+            << (1000. * singleInserts) / singleElapsed << " inserts/s" << std::endl;
+  std::cout << "Batched inserts: "
+            << (1000. * (instances.count() - singleInserts)) / batchElapsed << " inserts/s" << std::endl;
+
+  // check that the hierarchy is complete and has no duplicates
+  if (database.patients().count() != patients)
+    {
+    std::cerr << "Expected " << patients << " patients, got "
+              << database.patients().count() << std::endl;
+    return EXIT_FAILURE;
+    }
+  int studies = 0;
+  foreach(const QString& patient, database.patients())
+    {
+    foreach(const QString& study, database.studiesForPatient(patient))
+      {
+      ++studies;
+      if (database.seriesForStudy(study).count() != seriesPerStudy)
+        {
+        std::cerr << "Wrong number of series in " << qPrintable(study) << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+  if (studies != patients * studiesPerPatient)
+    {
+    std::cerr << "Expected " << patients * studiesPerPatient << " studies, got "
+              << studies << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (database.allFiles().count() != instances.count())
+    {
+    std::cerr << "Expected " << instances.count() << " images, got "
+              << database.allFiles().count() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // inserting the same instances again must not add anything
+  database.insert(instances);
+  if (database.allFiles().count() != instances.count())
+    {
+    std::cerr << "Inserting twice should not duplicate images" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  database.closeDatabase();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabase::IndexingResult createInstance(int series, int instance)
+{
+  QString seriesUID = QString("1.2.826.0.1.3680043.2.1125.7.%1").arg(series);
+  QString instanceUID = QString("%1.%2").arg(seriesUID).arg(instance);
+
+  DcmDataset* dataset = new DcmDataset;
+  dataset->putAndInsertString(DCM_PatientName, "Concurrent^Reader");
+  dataset->putAndInsertString(DCM_PatientID, "ctkDICOMDatabaseTest7");
+  dataset->putAndInsertString(DCM_StudyInstanceUID, "1.2.826.0.1.3680043.2.1125.7");
+  dataset->putAndInsertString(DCM_SeriesInstanceUID, seriesUID.toLatin1().data());
+  dataset->putAndInsertString(DCM_SOPInstanceUID, instanceUID.toLatin1().data());
+
+  ctkDICOMDatabase::IndexingResult indexingResult;
+  indexingResult.dataset = QSharedPointer<ctkDICOMItem>(new ctkDICOMItem);
+  indexingResult.dataset->InitializeFromItem(dataset, true);
+  indexingResult.filePath = QString("/concurrent/%1").arg(instanceUID);
+  indexingResult.storeFile = false;
+  indexingResult.generateThumbnail = false;
+  return indexingResult;
+}
+
+//------------------------------------------------------------------------------
+class ReaderThread : public QThread
+{
+public:
+  ReaderThread(ctkDICOMDatabase* database)
+    : Database(database), Stop(false), Queries(0), Errors(0), Decreases(0), LastCount(0)
+  {
+  }
+
+  virtual void run()
+  {
+    QSqlDatabase connection = this->Database->readOnlyDatabase();
+    if (connection.connectionName() == this->Database->database().connectionName())
+      {
+      std::cerr << "The reader thread should get a connection of its own" << std::endl;
+      ++this->Errors;
+      return;
+      }
+    while (!this->Stop)
+      {
+      QSqlQuery query(connection);
+      if (!query.exec("SELECT COUNT(*) FROM Images") || !query.next())
+        {
+        std::cerr << "Read failed: " << qPrintable(query.lastError().text()) << std::endl;
+        ++this->Errors;
+        continue;
+        }
+      int count = query.value(0).toInt();
+      if (count < this->LastCount)
+        {
+        ++this->Decreases;
+        }
+      this->LastCount = count;
+      ++this->Queries;
+      }
+  }
+
+  ctkDICOMDatabase* Database;
+  volatile bool Stop;
+  int Queries;
+  int Errors;
+  int Decreases;
+  int LastCount;
+};
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabaseTest7( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QDir databaseDirectory = QDir::temp();
+  databaseDirectory.remove("ctkDICOMDatabaseTest7.sql");
+  databaseDirectory.remove("ctkDICOMDatabaseTest7.sql-wal");
+  databaseDirectory.remove("ctkDICOMDatabaseTest7.sql-shm");
+  QFileInfo databaseFile(databaseDirectory, QString("ctkDICOMDatabaseTest7.sql"));
+
+  ctkDICOMDatabase database;
+  database.setWALModeEnabled(true);
+  database.setCacheSize(-8192);
+  database.setMmapSize(64 * 1024 * 1024);
+  database.openDatabase(databaseFile.absoluteFilePath(), "ctkDICOMDatabaseTest7");
+  if (!database.isOpen())
+    {
+    std::cerr << "ctkDICOMDatabase::openDatabase() failed: "
+              << qPrintable(database.lastError()) << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QSqlQuery journalModeQuery(database.database());
+  if (!journalModeQuery.exec("PRAGMA journal_mode") || !journalModeQuery.next()
+      || journalModeQuery.value(0).toString().toLower() != "wal")
+    {
+    std::cerr << "ctkDICOMDatabase: WAL journal mode is not enabled" << std::endl;
+    return EXIT_FAILURE;
+    }
+  journalModeQuery.finish();
+
+  ReaderThread reader(&database);
+  reader.start();
+
+  const int series = 20;
+  const int instancesPerSeries = 100;
+  for (int s = 0; s < series; ++s)
+    {
+    QList<ctkDICOMDatabase::IndexingResult> batch;
+    for (int i = 0; i < instancesPerSeries; ++i)
+      {
+      batch << createInstance(s, i);
+      }
+    database.insert(batch);
+    }
+
+  reader.Stop = true;
+  reader.wait();
+
+  std::cout << "Reader ran " << reader.Queries << " queries while inserting "
+            << series * instancesPerSeries << " instances" << std::endl;
+
+  if (reader.Errors > 0 || reader.Decreases > 0)
+    {
+    std::cerr << "Concurrent reads failed: " << reader.Errors << " errors, "
+              << reader.Decreases << " inconsistent counts" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (reader.Queries == 0)
+    {
+    std::cerr << "The reader did not run any query" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (database.allFiles().count() != series * instancesPerSeries)
+    {
+    std::cerr << "Expected " << series * instancesPerSeries << " images, got "
+              << database.allFiles().count() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  database.closeDatabase();
+
+  return EXIT_SUCCESS;
+}
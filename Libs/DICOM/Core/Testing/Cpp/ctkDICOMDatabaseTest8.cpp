@@ -0,0 +1,175 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QTime>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+void removeDirectory(const QString& path)
+{
+  QDir directory(path);
+  foreach(const QFileInfo& fileInfo,
+          directory.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+    if (fileInfo.isDir())
+      {
+      removeDirectory(fileInfo.absoluteFilePath());
+      }
+    else
+      {
+      QFile::remove(fileInfo.absoluteFilePath());
+      }
+    }
+  directory.rmdir(path);
+}
+
+//------------------------------------------------------------------------------
+// Insert all the files in a new database located in directoryName,
+// returns false if some files are missing from the database
+bool benchmark(const char* name, const QString& directoryName, const QStringList& files,
+               qint64 totalSize, bool storeFile, bool hardLinks)
+{
+  QDir().mkpath(directoryName);
+  ctkDICOMDatabase database;
+  database.setHardLinksEnabled(hardLinks);
+  database.openDatabase(QDir(directoryName).absoluteFilePath("ctkDICOMDatabase.sql"),
+                        QString("ctkDICOMDatabaseTest8-") + name);
+
+  for (int pass = 0; pass < 2; ++pass)
+    {
+    QTime timer;
+    timer.start();
+    database.beginTransaction();
+    foreach(const QString& file, files)
+      {
+      database.insert(file, storeFile, false);
+      }
+    database.endTransaction();
+    double seconds = qMax(1, timer.elapsed()) / 1000.;
+    std::cout << name << (pass == 0 ? ": " : " (again): ")
+              << files.count() / seconds << " files/s, "
+              << totalSize / seconds / (1024 * 1024) << " MiB/s" << std::endl;
+    }
+
+  QStringList indexedFiles = database.allFiles();
+  if (indexedFiles.count() != files.count())
+    {
+    std::cerr << name << ": expected " << files.count() << " files, got "
+              << indexedFiles.count() << std::endl;
+    return false;
+    }
+  QString storageDirectory = database.databaseDirectory() + "/dicom/";
+  foreach(const QString& file, indexedFiles)
+    {
+    if (storeFile != file.startsWith(storageDirectory))
+      {
+      std::cerr << name << ": unexpected file location " << qPrintable(file) << std::endl;
+      return false;
+      }
+    if (!QFileInfo(file).exists())
+      {
+      std::cerr << name << ": missing file " << qPrintable(file) << std::endl;
+      return false;
+      }
+    }
+  if (storeFile)
+    {
+    // every source file must have a stored file of the same size
+    QSet<qint64> storedSizes;
+    foreach(const QString& file, indexedFiles)
+      {
+      storedSizes.insert(QFileInfo(file).size());
+      }
+    foreach(const QString& file, files)
+      {
+      if (!storedSizes.contains(QFileInfo(file).size()))
+        {
+        std::cerr << name << ": " << qPrintable(file) << " was not stored correctly" << std::endl;
+        return false;
+        }
+      }
+    }
+  database.closeDatabase();
+  return true;
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabaseTest8( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMDatabaseTest8: missing dicom directory argument" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the sources are staged in the temporary directory, links need
+  // the source and the database to be on the same file system
+  QString testDirectory = QDir::temp().absoluteFilePath("ctkDICOMDatabaseTest8");
+  removeDirectory(testDirectory);
+  QString sourceDirectory = testDirectory + "/source";
+  QDir().mkpath(sourceDirectory);
+
+  QDir dataDirectory(argv[1]);
+  QStringList files;
+  qint64 totalSize = 0;
+  foreach(const QFileInfo& fileInfo, dataDirectory.entryInfoList(QDir::Files, QDir::Name))
+    {
+    QString file = sourceDirectory + "/" + fileInfo.fileName();
+    if (QFile::copy(fileInfo.absoluteFilePath(), file))
+      {
+      files << file;
+      totalSize += fileInfo.size();
+      }
+    }
+  if (files.isEmpty())
+    {
+    std::cerr << "ctkDICOMDatabaseTest8: no file found in " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::cout << "Inserting " << files.count() << " files, "
+            << totalSize / 1024 << " KiB" << std::endl;
+
+  bool success = benchmark("In place", testDirectory + "/inplace", files, totalSize, false, false)
+    && benchmark("Copy", testDirectory + "/copy", files, totalSize, true, false)
+    && benchmark("Hard link", testDirectory + "/link", files, totalSize, true, true);
+
+  removeDirectory(testDirectory);
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,209 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QTime>
+#include <QVariant>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+int count(const ctkDICOMDatabase& database, const QString& table, const QString& condition)
+{
+  QSqlQuery query(database.database());
+  if (!query.exec("SELECT COUNT(*) FROM " + table + " WHERE " + condition) || !query.next())
+    {
+    std::cerr << "Query failed: " << qPrintable(condition) << std::endl;
+    return -1;
+    }
+  return query.value(0).toInt();
+}
+
+//------------------------------------------------------------------------------
+// Check that the indexed search finds the same rows as LIKE, and time both
+bool compareSearch(const ctkDICOMDatabase& database, const QString& table,
+                   const QString& field, const QString& text)
+{
+  QTime timer;
+  timer.start();
+  int likeCount = count(database, table, ctkDICOMDatabase::searchCondition(field, text, false));
+  int likeTime = timer.restart();
+  int indexCount = count(database, table, ctkDICOMDatabase::searchCondition(field, text, true));
+  int indexTime = timer.elapsed();
+  std::cout << qPrintable(field) << " contains \"" << qPrintable(text) << "\": "
+            << indexCount << " rows, LIKE " << likeTime << " ms, index "
+            << indexTime << " ms" << std::endl;
+  if (likeCount != indexCount)
+    {
+    std::cerr << "The search index found " << indexCount << " rows instead of "
+              << likeCount << std::endl;
+    return false;
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabaseTest9( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMDatabaseTest9: missing dicom filePath argument" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QString dicomFilePath(argv[1]);
+  // pass 1000000 to measure the filters of a large database
+  int numberOfPatients = argc > 2 ? QString(argv[2]).toInt() : 20000;
+
+  QDir temp = QDir::temp();
+  QString databaseFile = temp.absoluteFilePath("ctkDICOMDatabaseTest9.sql");
+  QFile::remove(databaseFile);
+
+  ctkDICOMDatabase database;
+  database.openDatabase(databaseFile, "ctkDICOMDatabaseTest9");
+  if (!ctkDICOMDatabase::hasSearchIndex(database.database())
+      || ctkDICOMDatabase::searchIndexFields().count() != 27
+      || !ctkDICOMDatabase::searchIndexFields("Studies").contains("AccessionNumber")
+      || !ctkDICOMDatabase::searchIndexFields("Studies").contains("StudyDate")
+      || ctkDICOMDatabase::searchIndexFields("Series").contains("SeriesInstanceUID"))
+    {
+    std::cerr << "A new database should have a search index" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the insert path maintains the index
+  database.insert(dicomFilePath, false, false);
+  QString seriesInstanceUID = database.seriesForFile(dicomFilePath);
+  QSqlQuery patientQuery(database.database());
+  patientQuery.exec("SELECT PatientsName FROM Patients");
+  patientQuery.next();
+  QString patientsName = patientQuery.value(0).toString();
+  patientQuery.finish();
+  if (patientsName.length() < 4)
+    {
+    std::cerr << "Unexpected patient name " << qPrintable(patientsName) << std::endl;
+    return EXIT_FAILURE;
+    }
+  QString nameSearch = patientsName.mid(1, 3).toUpper();
+  if (count(database, "Patients", ctkDICOMDatabase::searchCondition("PatientsName", nameSearch)) != 1
+      || count(database, "Patients", ctkDICOMDatabase::searchCondition("PatientsName", nameSearch.left(2))) != 1
+      || count(database, "Patients", ctkDICOMDatabase::searchCondition("PatientsName", "\\'^zz")) != 0)
+    {
+    std::cerr << "The inserted patient was not found in the search index" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QSqlQuery studyQuery(database.database());
+  studyQuery.exec("SELECT StudyDate FROM Studies");
+  studyQuery.next();
+  QString studyDate = studyQuery.value(0).toString();
+  studyQuery.finish();
+  if (!studyDate.isEmpty()
+      && count(database, "Studies", ctkDICOMDatabase::searchCondition("StudyDate", studyDate.left(4))) != 1)
+    {
+    std::cerr << "The inserted study date " << qPrintable(studyDate)
+              << " was not found in the search index" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // an index of other fields is replaced once the event loop runs
+  QSqlQuery dropFieldsQuery(database.database());
+  dropFieldsQuery.exec("DELETE FROM SearchIndexedFields WHERE Field = 'StudyDate'");
+  database.closeDatabase();
+  database.openDatabase(databaseFile, "ctkDICOMDatabaseTest9");
+  if (ctkDICOMDatabase::hasSearchIndex(database.database()))
+    {
+    std::cerr << "An index of other fields should not be used" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QCoreApplication::processEvents();
+  if (!ctkDICOMDatabase::hasSearchIndex(database.database())
+      || count(database, "Patients", ctkDICOMDatabase::searchCondition("PatientsName", nameSearch)) != 1)
+    {
+    std::cerr << "The search index should be rebuilt after opening the database" << std::endl;
+    return EXIT_FAILURE;
+    }
+  database.removeSeries(seriesInstanceUID);
+  if (count(database, "SearchIndex", "1") != 0)
+    {
+    std::cerr << "The search index should be emptied with the database" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // benchmark on synthetic patients
+  std::cout << "Creating " << numberOfPatients << " patients" << std::endl;
+  const char* familyNames[] = {"Smith", "Johnson", "Garcia", "Martinez", "Nguyen",
+                               "Müller", "O'Brien", "Kowalski", "Tanaka", "Rossi"};
+  const char* givenNames[] = {"Anna", "Ben", "Chloe", "David", "Emma", "Felix", "Grace"};
+  qsrand(1);
+  database.beginTransaction();
+  QSqlQuery insertPatient(database.database());
+  insertPatient.prepare("INSERT INTO Patients (UID, PatientsName, PatientID) VALUES (NULL, ?, ?)");
+  for (int i = 0; i < numberOfPatients; ++i)
+    {
+    insertPatient.bindValue(0, QString("%1%2^%3")
+                            .arg(QString::fromUtf8(familyNames[qrand() % 10]))
+                            .arg(qrand() % 1000)
+                            .arg(givenNames[qrand() % 7]));
+    insertPatient.bindValue(1, QString("ID%1").arg(i, 8, 10, QChar('0')));
+    insertPatient.exec();
+    }
+  database.endTransaction();
+
+  QTime timer;
+  timer.start();
+  if (!database.rebuildSearchIndex())
+    {
+    std::cerr << "ctkDICOMDatabase::rebuildSearchIndex() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::cout << "Search index built in " << timer.elapsed() << " ms" << std::endl;
+
+  // typing a name, a letter at a time
+  QStringList searches;
+  searches << "m" << "mu" << "mar" << "mart" << "martinez4" << "o'b" << "müll"
+           << "ben" << "xyz" << "%ez%";
+  bool success = true;
+  foreach(const QString& text, searches)
+    {
+    success = compareSearch(database, "Patients", "PatientsName", text) && success;
+    }
+  success = compareSearch(database, "Patients", "PatientID", "00123") && success;
+
+  database.closeDatabase();
+  QFile::remove(databaseFile);
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
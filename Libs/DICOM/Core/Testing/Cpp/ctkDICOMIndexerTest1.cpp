@@ -50,8 +50,40 @@ int ctkDICOMIndexerTest1( int argc, char * argv [] )
   // make sure it doesn't crash
   indexer.refreshDatabase(database, QDir::tempPath());
 
+  // Test the pipeline settings
+  indexer.setNumberOfParserThreads(4);
+  if (indexer.numberOfParserThreads() != 4)
+    {
+    std::cerr << "ctkDICOMIndexer::setNumberOfParserThreads() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  indexer.setBatchSize(0);
+  if (indexer.batchSize() != 1)
+    {
+    std::cerr << "ctkDICOMIndexer::setBatchSize() should clamp to 1" << std::endl;
+    return EXIT_FAILURE;
+    }
+  indexer.setBatchSize(10);
+
+  // Test background import: files are only queued by addDirectory
+  indexer.setBackgroundImportEnabled(true);
+  if (!indexer.isBackgroundImportEnabled())
+    {
+    std::cerr << "ctkDICOMIndexer::setBackgroundImportEnabled() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  indexer.addDirectory(database, QDir::tempPath());
+
   // ensure all concurrent inserts are complete
   indexer.waitForImportFinished();
 
+  // cancel an import that is running in the background
+  indexer.addDirectory(database, QDir::tempPath());
+  indexer.cancel();
+  indexer.waitForImportFinished();
+
+  // calling it with nothing queued must return immediately
+  indexer.waitForImportFinished();
+
   return EXIT_SUCCESS;
 }
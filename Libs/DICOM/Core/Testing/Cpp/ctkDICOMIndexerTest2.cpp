@@ -0,0 +1,166 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QThread>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMIndexer.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// QThread::msleep is protected in Qt4
+class Sleeper : public QThread
+{
+public:
+  static void msleep(unsigned long msecs)
+  {
+    QThread::msleep(msecs);
+  }
+};
+
+//------------------------------------------------------------------------------
+bool copyFile(const QString& source, const QString& destination)
+{
+  QFile::remove(destination);
+  return QFile::copy(source, destination);
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMIndexerTest2( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMIndexerTest2: missing dicom directory argument" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QDir sourceDirectory(argv[1]);
+  QStringList sourceFiles = sourceDirectory.entryList(QDir::Files, QDir::Name);
+  if (sourceFiles.count() < 3)
+    {
+    std::cerr << "ctkDICOMIndexerTest2: at least 3 files are needed in "
+              << argv[1] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QDir temp = QDir::temp();
+  temp.mkdir("ctkDICOMIndexerTest2");
+  QDir directory(temp.absoluteFilePath("ctkDICOMIndexerTest2"));
+  foreach(const QString& fileName, directory.entryList(QDir::Files))
+    {
+    directory.remove(fileName);
+    }
+  QString fileA = directory.absoluteFilePath("a.dcm");
+  QString fileB = directory.absoluteFilePath("b.dcm");
+  QString fileC = directory.absoluteFilePath("c.dcm");
+  if (!copyFile(sourceDirectory.absoluteFilePath(sourceFiles[0]), fileA)
+      || !copyFile(sourceDirectory.absoluteFilePath(sourceFiles[1]), fileB))
+    {
+    std::cerr << "Failed to copy the test files to " << qPrintable(directory.path()) << std::endl;
+    return EXIT_FAILURE;
+    }
+  // insert timestamps have a resolution of one second
+  Sleeper::msleep(1100);
+
+  ctkDICOMDatabase database;
+  database.openDatabase(":memory:", "ctkDICOMIndexerTest2");
+  ctkDICOMIndexer indexer;
+  indexer.addDirectory(database, directory.absolutePath());
+  if (database.allFiles().count() != 2)
+    {
+    std::cerr << "Expected 2 indexed files, got " << database.allFiles().count() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // nothing changed, nothing to do
+  indexer.refreshDatabase(database, directory.absolutePath());
+  if (database.allFiles().count() != 2)
+    {
+    std::cerr << "Refreshing an unchanged directory should keep the 2 files" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the same directory through a path which is not canonical:
+  // the files are unchanged and must not be indexed again
+  QString instanceA = database.instanceForFile(fileA);
+  QDateTime insertedA = database.insertDateTimeForInstance(instanceA);
+  Sleeper::msleep(1100);
+  indexer.refreshDatabase(database, temp.absolutePath() + "/../" + temp.dirName() + "/ctkDICOMIndexerTest2");
+  if (database.allFiles().count() != 2
+      || database.insertDateTimeForInstance(instanceA) != insertedA)
+    {
+    std::cerr << "Refreshing through a path which is not canonical should keep the 2 files" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // remove b, add c and modify a
+  Sleeper::msleep(1100);
+  QFile::remove(fileB);
+  copyFile(sourceDirectory.absoluteFilePath(sourceFiles[2]), fileC);
+  copyFile(sourceDirectory.absoluteFilePath(sourceFiles[0]), fileA);
+  Sleeper::msleep(1100);
+
+  indexer.refreshDatabase(database, directory.absolutePath());
+
+  QStringList indexedFiles = database.allFiles();
+  if (indexedFiles.count() != 2
+      || !indexedFiles.contains(fileA) || !indexedFiles.contains(fileC))
+    {
+    std::cerr << "Refresh should index " << qPrintable(fileA) << " and "
+              << qPrintable(fileC) << ", got: " << qPrintable(indexedFiles.join(" ")) << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!(database.insertDateTimeForInstance(instanceA) > insertedA))
+    {
+    std::cerr << "The modified file should have been indexed again" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // an invalid directory must leave the database untouched
+  indexer.refreshDatabase(database, directory.absoluteFilePath("missing"));
+  if (database.allFiles().count() != 2)
+    {
+    std::cerr << "Refreshing a missing directory should not remove files" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  database.closeDatabase();
+  QFile::remove(fileA);
+  QFile::remove(fileC);
+  temp.rmdir("ctkDICOMIndexerTest2");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QThread>
+#include <QTime>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMIndexer.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// QThread::msleep is protected in Qt4
+class Sleeper : public QThread
+{
+public:
+  static void msleep(unsigned long msecs)
+  {
+    QThread::msleep(msecs);
+  }
+};
+
+//------------------------------------------------------------------------------
+// Process events until the database holds count files, returns the time it took
+int waitForFiles(ctkDICOMDatabase& database, int count, int timeout)
+{
+  QTime timer;
+  timer.start();
+  while (database.allFiles().count() < count && timer.elapsed() < timeout)
+    {
+    QCoreApplication::processEvents();
+    Sleeper::msleep(20);
+    }
+  return database.allFiles().count() < count ? -1 : timer.elapsed();
+}
+
+//------------------------------------------------------------------------------
+void removeDirectory(const QString& path)
+{
+  QDir directory(path);
+  foreach(const QFileInfo& fileInfo,
+          directory.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+    if (fileInfo.isDir())
+      {
+      removeDirectory(fileInfo.absoluteFilePath());
+      }
+    else
+      {
+      QFile::remove(fileInfo.absoluteFilePath());
+      }
+    }
+  directory.rmdir(path);
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMIndexerTest3( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMIndexerTest3: missing dicom directory argument" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QDir sourceDirectory(argv[1]);
+  QStringList sourceFiles = sourceDirectory.entryList(QDir::Files, QDir::Name);
+  if (sourceFiles.count() < 4)
+    {
+    std::cerr << "ctkDICOMIndexerTest3: at least 4 files are needed in "
+              << argv[1] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QString spoolPath = QDir::temp().absoluteFilePath("ctkDICOMIndexerTest3");
+  removeDirectory(spoolPath);
+  QDir::temp().mkdir("ctkDICOMIndexerTest3");
+  QDir spool(spoolPath);
+  QFile::copy(sourceDirectory.absoluteFilePath(sourceFiles[0]), spool.absoluteFilePath("0.dcm"));
+
+  ctkDICOMDatabase database;
+  database.openDatabase(":memory:", "ctkDICOMIndexerTest3");
+  ctkDICOMIndexer indexer;
+  indexer.setWatchInterval(100);
+  if (indexer.watchInterval() != 100)
+    {
+    std::cerr << "ctkDICOMIndexer::setWatchInterval() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // files already in the directory are imported right away
+  indexer.watchDirectory(database, spoolPath);
+  if (indexer.watchedDirectories() != QStringList(spool.absolutePath())
+      || database.allFiles().count() != 1)
+    {
+    std::cerr << "ctkDICOMIndexer::watchDirectory() should import existing files" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // a file dropped in the directory
+  QFile::copy(sourceDirectory.absoluteFilePath(sourceFiles[1]), spool.absoluteFilePath("1.dcm"));
+  int elapsed = waitForFiles(database, 2, 10000);
+  if (elapsed < 0)
+    {
+    std::cerr << "A file written to a watched directory was not imported" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::cout << "File imported " << elapsed << " ms after being written" << std::endl;
+
+  // a file dropped in a new subdirectory
+  spool.mkdir("series");
+  QFile::copy(sourceDirectory.absoluteFilePath(sourceFiles[2]), spool.absoluteFilePath("series/2.dcm"));
+  if (waitForFiles(database, 3, 10000) < 0)
+    {
+    std::cerr << "A file written to a new subdirectory was not imported" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // nothing is imported once the directory is not watched anymore
+  indexer.unwatchDirectory(spoolPath);
+  if (!indexer.watchedDirectories().isEmpty())
+    {
+    std::cerr << "ctkDICOMIndexer::unwatchDirectory() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QFile::copy(sourceDirectory.absoluteFilePath(sourceFiles[3]), spool.absoluteFilePath("3.dcm"));
+  if (waitForFiles(database, 4, 1000) >= 0)
+    {
+    std::cerr << "A file written to an unwatched directory was imported" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  database.closeDatabase();
+  removeDirectory(spoolPath);
+
+  return EXIT_SUCCESS;
+}
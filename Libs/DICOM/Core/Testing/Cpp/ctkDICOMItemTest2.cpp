@@ -0,0 +1,153 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QFile>
+#include <QTime>
+
+// ctkDICOMCore includes
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/config/osconfig.h> // PACKAGE_VERSION_NUMBER
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// Number of bytes read by this process so far, -1 if unknown
+qint64 bytesReadByProcess()
+{
+  QFile io("/proc/self/io");
+  if (!io.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+    return -1;
+    }
+  // readAll() does not work on procfs files, read line by line
+  QByteArray line = io.readLine();
+  while (!line.isEmpty())
+    {
+    if (line.startsWith("rchar:"))
+      {
+      return line.mid(6).trimmed().toLongLong();
+      }
+    line = io.readLine();
+    }
+  return -1;
+}
+
+//------------------------------------------------------------------------------
+void benchmark(const QString& filePath, bool headerOnly, int iterations)
+{
+  QTime timer;
+  timer.start();
+  qint64 bytesBefore = bytesReadByProcess();
+  for (int i = 0; i < iterations; ++i)
+    {
+    ctkDICOMItem dataset;
+    if (headerOnly)
+      {
+      dataset.InitializeFromFileHeader(filePath);
+      }
+    else
+      {
+      dataset.InitializeFromFile(filePath);
+      }
+    dataset.GetElementAsString(DCM_SOPInstanceUID);
+    }
+  qint64 bytesAfter = bytesReadByProcess();
+  std::cout << (headerOnly ? "InitializeFromFileHeader: " : "InitializeFromFile:       ")
+            << static_cast<double>(timer.elapsed()) / iterations << " ms";
+  if (bytesBefore >= 0 && bytesAfter >= 0)
+    {
+    std::cout << ", " << (bytesAfter - bytesBefore) / iterations << " bytes read";
+    }
+  std::cout << " per instance" << std::endl;
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMItemTest2( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMItemTest2: missing dicom filePath argument";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QString dicomFilePath(argv[1]);
+
+  ctkDICOMItem fullDataset;
+  fullDataset.InitializeFromFile(dicomFilePath);
+  ctkDICOMItem headerDataset;
+  headerDataset.InitializeFromFileHeader(dicomFilePath);
+
+  if (!fullDataset.IsInitialized() || !headerDataset.IsInitialized())
+    {
+    std::cerr << "ctkDICOMItem failed to read " << qPrintable(dicomFilePath) << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // everything needed for indexing must be available from the header
+  DcmTagKey indexedTags[] = {
+    DCM_PatientName, DCM_PatientID, DCM_PatientBirthDate,
+    DCM_StudyInstanceUID, DCM_StudyDate, DCM_StudyDescription,
+    DCM_SeriesInstanceUID, DCM_SeriesNumber, DCM_SeriesDescription, DCM_Modality,
+    DCM_SOPInstanceUID };
+  const int numberOfIndexedTags = sizeof(indexedTags) / sizeof(indexedTags[0]);
+  for (int i = 0; i < numberOfIndexedTags; ++i)
+    {
+    QString fullValue = fullDataset.GetAllElementValuesAsString(indexedTags[i]);
+    QString headerValue = headerDataset.GetAllElementValuesAsString(indexedTags[i]);
+    if (fullValue != headerValue)
+      {
+      std::cerr << "Header-only read returned " << qPrintable(headerValue)
+                << " instead of " << qPrintable(fullValue)
+                << " for " << qPrintable(ctkDICOMItem::TagKey(indexedTags[i])) << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+#if PACKAGE_VERSION_NUMBER > 360
+  // DCMTK 3.6.0 cannot stop before the pixel data
+  DcmElement* pixelData = 0;
+  if (ctkDICOMItem::CheckCondition(headerDataset.findAndGetElement(DCM_PixelData, pixelData)))
+    {
+    std::cerr << "Header-only read should stop before the pixel data" << std::endl;
+    return EXIT_FAILURE;
+    }
+#endif
+
+  const int iterations = 50;
+  benchmark(dicomFilePath, false, iterations);
+  benchmark(dicomFilePath, true, iterations);
+
+  return EXIT_SUCCESS;
+}
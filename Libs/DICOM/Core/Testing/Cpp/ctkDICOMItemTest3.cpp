@@ -0,0 +1,160 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <QTime>
+
+// ctkDICOMCore includes
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+#include <dcmtk/dcmdata/dcdatset.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+struct EncodedName
+{
+  const char* CharacterSet;
+  const char* Raw;
+  QString Expected;
+};
+
+//------------------------------------------------------------------------------
+QList<EncodedName> encodedNames()
+{
+  QList<EncodedName> names;
+  EncodedName latin1 = {"ISO_IR 100", "M\xFCller^J\xFCrgen", QString::fromLatin1("M\xFCller^J\xFCrgen")};
+  EncodedName utf8 = {"ISO_IR 192", "M\xC3\xBCller^J\xC3\xBCrgen", QString::fromLatin1("M\xFCller^J\xFCrgen")};
+  // ISO 8859-5
+  QString cyrillic;
+  cyrillic.append(QChar(0x0418)).append(QChar(0x0432)).append(QChar(0x0430)).append(QChar(0x043D));
+  EncodedName cyrillicName = {"ISO_IR 144", "\xB8\xD2\xD0\xDD", cyrillic};
+  EncodedName noCharacterSet = {"", "Doe^John", QString("Doe^John")};
+  names << latin1 << utf8 << cyrillicName << noCharacterSet;
+  return names;
+}
+
+//------------------------------------------------------------------------------
+// Each task decodes its own items: DcmItem lookups are not thread-safe,
+// the character set decoding is.
+class DecodeTask : public QRunnable
+{
+public:
+  DecodeTask(const QList<EncodedName>& names, int iterations, QAtomicInt& failures)
+    : Names(names)
+    , Iterations(iterations)
+    , Failures(failures)
+  {
+  }
+
+  virtual void run()
+  {
+    QList<QSharedPointer<ctkDICOMItem> > items;
+    foreach(const EncodedName& name, this->Names)
+      {
+      DcmDataset* dataset = new DcmDataset();
+      if (name.CharacterSet[0] != '\0')
+        {
+        dataset->putAndInsertString(DCM_SpecificCharacterSet, name.CharacterSet);
+        }
+      dataset->putAndInsertString(DCM_PatientName, name.Raw);
+      QSharedPointer<ctkDICOMItem> item(new ctkDICOMItem);
+      item->InitializeFromItem(dataset, true);
+      items << item;
+      }
+    for (int i = 0; i < this->Iterations; ++i)
+      {
+      for (int n = 0; n < items.count(); ++n)
+        {
+        // Decode() directly, GetElementAsString() looks the element up first
+        QString decoded = items[n]->Decode(DcmTag(DCM_PatientName), this->Names[n].Raw);
+        if (decoded != this->Names[n].Expected)
+          {
+          this->Failures.ref();
+          }
+        }
+      }
+    // and once through the dataset
+    for (int n = 0; n < items.count(); ++n)
+      {
+      if (items[n]->GetElementAsString(DCM_PatientName) != this->Names[n].Expected)
+        {
+        std::cerr << "Failed to decode " << this->Names[n].CharacterSet << ": "
+                  << qPrintable(items[n]->GetElementAsString(DCM_PatientName)) << std::endl;
+        this->Failures.ref();
+        }
+      }
+  }
+
+private:
+  QList<EncodedName> Names;
+  int Iterations;
+  QAtomicInt& Failures;
+};
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+// Decodes strings of several character sets from many threads at once.
+// Build with -fsanitize=thread to check for data races.
+int ctkDICOMItemTest3( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  const QList<EncodedName> names = encodedNames();
+  const int threadCount = qMax(8, QThread::idealThreadCount());
+  const int iterations = 20000;
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(threadCount);
+  QAtomicInt failures(0);
+  QTime time;
+  time.start();
+  for (int i = 0; i < threadCount; ++i)
+    {
+    pool.start(new DecodeTask(names, iterations, failures));
+    }
+  pool.waitForDone();
+  const int elapsed = time.elapsed();
+
+  const int failureCount = failures.fetchAndAddOrdered(0);
+  if (failureCount != 0)
+    {
+    std::cerr << "ctkDICOMItem::Decode() failed " << failureCount << " times" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::cout << threadCount * iterations * names.count() << " strings decoded by "
+            << threadCount << " threads in " << elapsed << " ms" << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,211 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QPersistentModelIndex>
+#include <QSet>
+#include <QSqlQuery>
+#include <QVariant>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMModel.h"
+#include "ctkModelTester.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+//------------------------------------------------------------------------------
+int ctkDICOMModelTest2( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMModelTest2: missing dicom filePath argument" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QString dicomFilePath(argv[1]);
+
+  QDir temp = QDir::temp();
+  QString databaseFile = temp.absoluteFilePath("ctkDICOMModelTest2.sql");
+  QFile::remove(databaseFile);
+
+  ctkDICOMDatabase database;
+  database.openDatabase(databaseFile, "ctkDICOMModelTest2");
+
+  ctkModelTester tester;
+  tester.setNestedInserts(true);
+  tester.setThrowOnError(false);
+  ctkDICOMModel model;
+  tester.setModel(&model);
+  model.setDatabase(&database);
+  if (model.rowCount() != 0 || model.canFetchMore(QModelIndex()))
+    {
+    std::cerr << "An empty database should give an empty model" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // inserted files are added to the model without resetting it
+  database.insert(dicomFilePath, false, false);
+  QCoreApplication::processEvents();
+  if (model.rowCount() != 1)
+    {
+    std::cerr << "The inserted patient is not in the model: "
+              << model.rowCount() << " rows" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QPersistentModelIndex patientIndex = model.index(0, 0);
+  QModelIndex studyIndex = model.index(0, 0, patientIndex);
+  if (model.rowCount(patientIndex) != 1 || model.rowCount(studyIndex) != 1)
+    {
+    std::cerr << "The inserted study and series are not in the model" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // inserting the same file again must not duplicate any row
+  database.insert(dicomFilePath, false, false);
+  QCoreApplication::processEvents();
+  if (!patientIndex.isValid() || model.rowCount() != 1
+      || model.rowCount(patientIndex) != 1 || model.rowCount(studyIndex) != 1)
+    {
+    std::cerr << "Inserting a file twice should leave the model untouched" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // rows are read a page at a time
+  const int numberOfPatients = 600;
+  database.beginTransaction();
+  QSqlQuery insertPatient(database.database());
+  insertPatient.prepare("INSERT INTO Patients (UID, PatientsName, PatientID) VALUES (NULL, ?, ?)");
+  for (int i = 0; i < numberOfPatients; ++i)
+    {
+    insertPatient.bindValue(0, QString("Patient%1").arg(i));
+    insertPatient.bindValue(1, QString("ID%1").arg(i));
+    insertPatient.exec();
+    }
+  database.endTransaction();
+  model.setDatabase(&database);
+  int fetchCount = 0;
+  int rowCount = model.rowCount();
+  while (model.canFetchMore(QModelIndex()))
+    {
+    model.fetchMore(QModelIndex());
+    if (model.rowCount() <= rowCount)
+      {
+      std::cerr << "fetchMore() did not add any row" << std::endl;
+      return EXIT_FAILURE;
+      }
+    rowCount = model.rowCount();
+    ++fetchCount;
+    }
+  if (rowCount != numberOfPatients + 1 || fetchCount < 2)
+    {
+    std::cerr << "Expected " << numberOfPatients + 1 << " rows read in several pages, got "
+              << rowCount << " rows in " << fetchCount + 1 << " pages" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // rows added before the last fetched one are inserted at their sorted
+  // position, the others are read with the next page
+  model.sort(0, Qt::AscendingOrder);
+  model.fetchMore(QModelIndex());
+  rowCount = model.rowCount();
+  if (!model.canFetchMore(QModelIndex()))
+    {
+    std::cerr << "The sorted patients should be read in several pages" << std::endl;
+    return EXIT_FAILURE;
+    }
+  insertPatient.bindValue(0, QString("!First"));
+  insertPatient.bindValue(1, QString("IDFirst"));
+  insertPatient.exec();
+  int firstUID = insertPatient.lastInsertId().toInt();
+  insertPatient.bindValue(0, QString("~Last"));
+  insertPatient.bindValue(1, QString("IDLast"));
+  insertPatient.exec();
+  int lastUID = insertPatient.lastInsertId().toInt();
+  QMetaObject::invokeMethod(&model, "onPatientAdded", Q_ARG(int, firstUID));
+  QMetaObject::invokeMethod(&model, "onPatientAdded", Q_ARG(int, lastUID));
+  QCoreApplication::processEvents();
+  if (model.rowCount() != rowCount + 1
+      || model.data(model.index(0, 0), ctkDICOMModel::UIDRole).toInt() != firstUID)
+    {
+    std::cerr << "The added patient is not the first row" << std::endl;
+    return EXIT_FAILURE;
+    }
+  while (model.canFetchMore(QModelIndex()))
+    {
+    model.fetchMore(QModelIndex());
+    }
+  if (model.rowCount() != numberOfPatients + 3
+      || model.data(model.index(model.rowCount() - 1, 0), ctkDICOMModel::UIDRole).toInt() != lastUID)
+    {
+    std::cerr << "Expected " << numberOfPatients + 3 << " sorted rows, got "
+              << model.rowCount() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // all the rows are read in every sort order, including by a header which
+  // is not a field of the patients (Institution) and by a field whose values
+  // are all NULL (Age)
+  QList<int> sortColumns;
+  sortColumns << 6 << 1;
+  foreach(int column, sortColumns)
+    {
+    for (int order = Qt::AscendingOrder; order <= Qt::DescendingOrder; ++order)
+      {
+      model.sort(column, Qt::SortOrder(order));
+      while (model.canFetchMore(QModelIndex()))
+        {
+        rowCount = model.rowCount();
+        model.fetchMore(QModelIndex());
+        if (model.rowCount() <= rowCount)
+          {
+          std::cerr << "fetchMore() did not add any row sorting by column "
+                    << column << std::endl;
+          return EXIT_FAILURE;
+          }
+        }
+      QSet<int> uids;
+      for (int row = 0; row < model.rowCount(); ++row)
+        {
+        uids.insert(model.data(model.index(row, 0), ctkDICOMModel::UIDRole).toInt());
+        }
+      if (model.rowCount() != numberOfPatients + 3 || uids.count() != numberOfPatients + 3)
+        {
+        std::cerr << "Expected " << numberOfPatients + 3 << " rows sorting by column "
+                  << column << (order == Qt::AscendingOrder ? " ascending" : " descending")
+                  << ", got " << model.rowCount() << " rows with "
+                  << uids.count() << " patients" << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  model.setDatabase(static_cast<ctkDICOMDatabase*>(0));
+  database.closeDatabase();
+  QFile::remove(databaseFile);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QTime>
+#include <QVariant>
+
+// ctkCore includes
+#include "ctkCallback.h"
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMQuery.h"
+#include "ctkDICOMTester.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+#include <dcmtk/dcmdata/dcfilefo.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+int StudyQueriedCount = 0;
+
+//------------------------------------------------------------------------------
+void onStudyQueried(void* data)
+{
+  Q_UNUSED(data);
+  ++StudyQueriedCount;
+}
+
+//------------------------------------------------------------------------------
+// Save a copy of \a filePath in a new study for each study of the archive
+QStringList createStudies(const QString& filePath, const QDir& directory, int studyCount)
+{
+  QStringList files;
+  DcmFileFormat fileFormat;
+  if (fileFormat.loadFile(filePath.toLatin1().data()).bad())
+    {
+    return files;
+    }
+  DcmDataset* dataset = fileFormat.getDataset();
+  for (int i = 0; i < studyCount; ++i)
+    {
+    QString studyUID = QString("1.2.826.0.1.3680043.2.1125.13.%1").arg(i);
+    QString instanceUID = studyUID + ".1.1";
+    dataset->putAndInsertString(DCM_StudyInstanceUID, studyUID.toLatin1().data());
+    dataset->putAndInsertString(DCM_SeriesInstanceUID, (studyUID + ".1").toLatin1().data());
+    dataset->putAndInsertString(DCM_SOPInstanceUID, instanceUID.toLatin1().data());
+    fileFormat.getMetaInfo()->putAndInsertString(DCM_MediaStorageSOPInstanceUID,
+                                                instanceUID.toLatin1().data());
+    QString file = directory.absoluteFilePath(QString("study%1.dcm").arg(i));
+    if (fileFormat.saveFile(file.toLatin1().data()).bad())
+      {
+      return QStringList();
+      }
+    files << file;
+    }
+  return files;
+}
+
+//------------------------------------------------------------------------------
+// Query all the studies of the archive with \a associations associations
+bool queryStudies(int port, int associations, int studyCount, const QString& databaseFile)
+{
+  QFile::remove(databaseFile);
+  ctkDICOMDatabase database;
+  database.openDatabase(databaseFile, QString("ctkDICOMQueryTest3_%1").arg(associations));
+
+  ctkDICOMQuery query;
+  query.setCallingAETitle("CTK_AE");
+  query.setCalledAETitle("CTK_AE");
+  query.setHost("localhost");
+  query.setPort(port);
+  query.setMaximumNumberOfAssociations(associations);
+
+  ctkCallback callback(onStudyQueried);
+  QObject::connect(&query, SIGNAL(studyQueried(QString)), &callback, SLOT(invoke()));
+  StudyQueriedCount = 0;
+
+  QTime timer;
+  timer.start();
+  if (!query.query(database))
+    {
+    std::cerr << "ctkDICOMQuery::query() failed with " << associations << " associations" << std::endl;
+    return false;
+    }
+  std::cout << "Queried " << studyCount << " studies on " << associations
+            << " associations in " << timer.elapsed() << " ms" << std::endl;
+
+  QSqlQuery seriesQuery(database.database());
+  seriesQuery.exec("SELECT COUNT(*) FROM Series");
+  seriesQuery.next();
+  int seriesCount = seriesQuery.value(0).toInt();
+  seriesQuery.finish();
+  database.closeDatabase();
+  QFile::remove(databaseFile);
+
+  if (query.studyInstanceUIDQueried().count() != studyCount
+      || StudyQueriedCount != studyCount
+      || seriesCount != studyCount)
+    {
+    std::cerr << "Expected " << studyCount << " studies and series, got "
+              << query.studyInstanceUIDQueried().count() << " studies, "
+              << StudyQueriedCount << " studyQueried() signals and "
+              << seriesCount << " series" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMQueryTest3( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMQueryTest3: missing dicom filePath argument" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QString dicomFilePath(argv[1]);
+  const int studyCount = 20;
+
+  QDir temp = QDir::temp();
+  temp.mkdir("ctkDICOMQueryTest3");
+  QDir directory(temp.absoluteFilePath("ctkDICOMQueryTest3"));
+  QStringList files = createStudies(dicomFilePath, directory, studyCount);
+  if (files.count() != studyCount)
+    {
+    std::cerr << "Failed to create the studies from " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the archive stands in for a PACS
+  ctkDICOMTester tester;
+  tester.startDCMQRSCP();
+  if (!tester.storeData(files))
+    {
+    std::cerr << "Failed to store the studies in the archive" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  bool success = queryStudies(tester.dcmqrscpPort(), 1, studyCount,
+                              directory.absoluteFilePath("serial.sql"));
+  success = queryStudies(tester.dcmqrscpPort(), 4, studyCount,
+                         directory.absoluteFilePath("parallel.sql")) && success;
+
+  foreach(const QString& file, files)
+    {
+    QFile::remove(file);
+    }
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
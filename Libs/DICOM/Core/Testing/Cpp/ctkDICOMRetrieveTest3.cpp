@@ -0,0 +1,163 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QTime>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMRetrieve.h"
+#include "ctkDICOMTester.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+#include <dcmtk/dcmdata/dcfilefo.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+const char* StudyInstanceUID = "1.2.826.0.1.3680043.2.1125.14";
+const char* SeriesInstanceUID = "1.2.826.0.1.3680043.2.1125.14.1";
+
+//------------------------------------------------------------------------------
+// Save copies of \a filePath as the instances of a single series
+QStringList createSeries(const QString& filePath, const QDir& directory, int instanceCount)
+{
+  QStringList files;
+  DcmFileFormat fileFormat;
+  if (fileFormat.loadFile(filePath.toLatin1().data()).bad())
+    {
+    return files;
+    }
+  DcmDataset* dataset = fileFormat.getDataset();
+  dataset->putAndInsertString(DCM_StudyInstanceUID, StudyInstanceUID);
+  dataset->putAndInsertString(DCM_SeriesInstanceUID, SeriesInstanceUID);
+  for (int i = 0; i < instanceCount; ++i)
+    {
+    QString instanceUID = QString("%1.%2").arg(SeriesInstanceUID).arg(i + 1);
+    dataset->putAndInsertString(DCM_SOPInstanceUID, instanceUID.toLatin1().data());
+    dataset->putAndInsertString(DCM_InstanceNumber, QString::number(i + 1).toLatin1().data());
+    fileFormat.getMetaInfo()->putAndInsertString(DCM_MediaStorageSOPInstanceUID,
+                                                instanceUID.toLatin1().data());
+    QString file = directory.absoluteFilePath(QString("instance%1.dcm").arg(i));
+    if (fileFormat.saveFile(file.toLatin1().data()).bad())
+      {
+      return QStringList();
+      }
+    files << file;
+    }
+  return files;
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMRetrieveTest3( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMRetrieveTest3: missing dicom filePath argument" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QString dicomFilePath(argv[1]);
+  // pass 5000 to measure the throughput of a large series
+  int instanceCount = argc > 2 ? QString(argv[2]).toInt() : 300;
+
+  QDir temp = QDir::temp();
+  temp.mkdir("ctkDICOMRetrieveTest3");
+  QDir directory(temp.absoluteFilePath("ctkDICOMRetrieveTest3"));
+  directory.mkdir("instances");
+  directory.mkdir("database");
+  QStringList files = createSeries(dicomFilePath, QDir(directory.absoluteFilePath("instances")),
+                                   instanceCount);
+  if (files.count() != instanceCount)
+    {
+    std::cerr << "Failed to create the series from " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the archive stands in for a PACS
+  ctkDICOMTester tester;
+  tester.startDCMQRSCP();
+  if (!tester.storeData(files))
+    {
+    std::cerr << "Failed to store the series in the archive" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QString databaseFile = QDir(directory.absoluteFilePath("database")).absoluteFilePath("ctkDICOM.sql");
+  QFile::remove(databaseFile);
+  QSharedPointer<ctkDICOMDatabase> database(new ctkDICOMDatabase);
+  database->openDatabase(databaseFile, "ctkDICOMRetrieveTest3");
+
+  ctkDICOMRetrieve retrieve;
+  retrieve.setCallingAETitle("CTK_AE");
+  retrieve.setCalledAETitle("CTK_AE");
+  retrieve.setPort(tester.dcmqrscpPort());
+  retrieve.setHost("localhost");
+  retrieve.setDatabase(database);
+
+  QTime timer;
+  timer.start();
+  if (!retrieve.getSeries(StudyInstanceUID, SeriesInstanceUID))
+    {
+    std::cerr << "ctkDICOMRetrieve::getSeries() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  int elapsed = qMax(1, timer.elapsed());
+  std::cout << "Retrieved " << instanceCount << " instances in " << elapsed << " ms: "
+            << (1000. * instanceCount) / elapsed << " instances per second" << std::endl;
+
+  // every instance is in the database once the retrieve returns
+  QStringList retrievedFiles = database->filesForSeries(SeriesInstanceUID);
+  bool success = true;
+  if (retrievedFiles.count() != instanceCount)
+    {
+    std::cerr << "Expected " << instanceCount << " instances in the database, got "
+              << retrievedFiles.count() << std::endl;
+    success = false;
+    }
+  foreach(const QString& file, retrievedFiles)
+    {
+    if (!QFile::exists(file))
+      {
+      std::cerr << "Retrieved instance not stored: " << qPrintable(file) << std::endl;
+      success = false;
+      break;
+      }
+    }
+
+  database->closeDatabase();
+  foreach(const QString& file, files)
+    {
+    QFile::remove(file);
+    }
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
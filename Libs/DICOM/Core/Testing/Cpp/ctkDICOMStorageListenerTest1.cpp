@@ -0,0 +1,237 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QThread>
+#include <QTime>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMStorageListener.h"
+#include "ctkDcmSCU.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+#include <dcmtk/dcmdata/dcfilefo.h>
+#include <dcmtk/dcmdata/dcuid.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+const int Port = 11120;
+const char* StudyInstanceUID = "1.2.826.0.1.3680043.2.1125.15";
+
+//------------------------------------------------------------------------------
+// Sends copies of a file as the instances of a series, like a modality would
+class StoreClient : public QThread
+{
+public:
+  StoreClient(const QString& filePath, const QString& calledAETitle,
+              const QString& seriesInstanceUID, int instanceCount)
+    : FilePath(filePath)
+    , CalledAETitle(calledAETitle)
+    , SeriesInstanceUID(seriesInstanceUID)
+    , InstanceCount(instanceCount)
+    , StoredCount(0)
+    , Accepted(false)
+  {
+  }
+
+  virtual void run()
+  {
+    DcmFileFormat fileFormat;
+    if (fileFormat.loadFile(this->FilePath.toLatin1().data()).bad())
+      {
+      return;
+      }
+    DcmDataset* dataset = fileFormat.getDataset();
+    OFString sopClassUID;
+    dataset->findAndGetOFString(DCM_SOPClassUID, sopClassUID);
+    dataset->putAndInsertString(DCM_StudyInstanceUID, StudyInstanceUID);
+    dataset->putAndInsertString(DCM_SeriesInstanceUID, this->SeriesInstanceUID.toLatin1().data());
+
+    DcmSCU scu;
+    scu.setAETitle("CTK_MODALITY");
+    scu.setPeerAETitle(this->CalledAETitle.toLatin1().data());
+    scu.setPeerHostName("localhost");
+    scu.setPeerPort(Port);
+    OFList<OFString> transferSyntaxes;
+    transferSyntaxes.push_back(UID_LittleEndianExplicitTransferSyntax);
+    transferSyntaxes.push_back(UID_LittleEndianImplicitTransferSyntax);
+    scu.addPresentationContext(sopClassUID, transferSyntaxes);
+    if (scu.initNetwork().bad() || scu.negotiateAssociation().bad())
+      {
+      return;
+      }
+    this->Accepted = true;
+    T_ASC_PresentationContextID presID = scu.findAnyPresentationContextID(sopClassUID, "");
+    for (int i = 0; i < this->InstanceCount; ++i)
+      {
+      QString instanceUID = QString("%1.%2").arg(this->SeriesInstanceUID).arg(i + 1);
+      dataset->putAndInsertString(DCM_SOPInstanceUID, instanceUID.toLatin1().data());
+      Uint16 status = 0;
+      if (scu.sendSTORERequest(presID, "", dataset, status).bad() || status != STATUS_Success)
+        {
+        break;
+        }
+      ++this->StoredCount;
+      }
+    scu.closeAssociation(DCMSCU_RELEASE_ASSOCIATION);
+  }
+
+  QString FilePath;
+  QString CalledAETitle;
+  QString SeriesInstanceUID;
+  int InstanceCount;
+  int StoredCount;
+  bool Accepted;
+};
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListenerTest1( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMStorageListenerTest1: missing dicom filePath argument" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QString dicomFilePath(argv[1]);
+
+  QDir temp = QDir::temp();
+  temp.mkdir("ctkDICOMStorageListenerTest1");
+  QDir directory(temp.absoluteFilePath("ctkDICOMStorageListenerTest1"));
+  directory.mkdir("databaseA");
+  directory.mkdir("databaseB");
+  QString databaseFileA = QDir(directory.absoluteFilePath("databaseA")).absoluteFilePath("ctkDICOM.sql");
+  QString databaseFileB = QDir(directory.absoluteFilePath("databaseB")).absoluteFilePath("ctkDICOM.sql");
+  QFile::remove(databaseFileA);
+  QFile::remove(databaseFileB);
+
+  ctkDICOMDatabase databaseA;
+  databaseA.openDatabase(databaseFileA, "ctkDICOMStorageListenerTest1A");
+  ctkDICOMDatabase databaseB;
+  databaseB.openDatabase(databaseFileB, "ctkDICOMStorageListenerTest1B");
+
+  ctkDICOMStorageListener listener;
+  listener.setPort(Port);
+  listener.addRoute("CTK_STORE_A", &databaseA);
+  listener.setDatabase(&databaseB);
+  // small enough for the associations to wait for the database
+  listener.setMaximumPendingCount(5);
+  listener.setBatchSize(4);
+  if (listener.routeDatabase("CTK_STORE_A") != &databaseA
+      || listener.routeDatabase("CTK_STORE_B") != &databaseB)
+    {
+    std::cerr << "ctkDICOMStorageListener::routeDatabase() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!listener.start())
+    {
+    std::cerr << "ctkDICOMStorageListener::start() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QString seriesA = QString("%1.1").arg(StudyInstanceUID);
+  QString seriesB = QString("%1.2").arg(StudyInstanceUID);
+  StoreClient clientA(dicomFilePath, "CTK_STORE_A", seriesA, 30);
+  StoreClient clientB(dicomFilePath, "CTK_STORE_B", seriesB, 10);
+  QTime timer;
+  timer.start();
+  clientA.start();
+  clientB.start();
+  // the instances are inserted by the event loop of this thread
+  while ((clientA.isRunning() || clientB.isRunning()) && timer.elapsed() < 60000)
+    {
+    QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+    }
+  listener.flush();
+  int elapsed = timer.elapsed();
+  std::cout << "Received " << listener.receivedCount() << " instances in " << elapsed
+            << " ms, peak pending " << listener.peakPendingCount() << ", throttled "
+            << listener.throttledCount() << " times for " << listener.throttledTime()
+            << " ms" << std::endl;
+
+  bool success = true;
+  if (clientA.StoredCount != 30 || clientB.StoredCount != 10
+      || listener.insertedCount() != 40)
+    {
+    std::cerr << "Expected 40 instances, " << clientA.StoredCount << " and "
+              << clientB.StoredCount << " stored, " << listener.insertedCount()
+              << " inserted" << std::endl;
+    success = false;
+    }
+  if (listener.peakPendingCount() > listener.maximumPendingCount())
+    {
+    std::cerr << "The pending instances went above maximumPendingCount: "
+              << listener.peakPendingCount() << std::endl;
+    success = false;
+    }
+  if (databaseA.filesForSeries(seriesA).count() != 30
+      || databaseA.filesForSeries(seriesB).count() != 0
+      || databaseB.filesForSeries(seriesB).count() != 10)
+    {
+    std::cerr << "The instances were not routed by called AE title" << std::endl;
+    success = false;
+    }
+  foreach(const QString& file, databaseA.filesForSeries(seriesA))
+    {
+    if (!QFile::exists(file)
+        || !file.startsWith(databaseA.databaseDirectory() + "/dicom/"))
+      {
+      std::cerr << "Received instance not stored: " << qPrintable(file) << std::endl;
+      success = false;
+      break;
+      }
+    }
+
+  // without a default database, unknown AE titles are rejected
+  listener.setDatabase(0);
+  StoreClient unknownClient(dicomFilePath, "CTK_UNKNOWN", seriesB, 1);
+  unknownClient.start();
+  unknownClient.wait();
+  if (unknownClient.Accepted || listener.rejectedAssociationCount() != 1)
+    {
+    std::cerr << "The association to an unknown AE title should be rejected" << std::endl;
+    success = false;
+    }
+
+  listener.stop();
+  if (listener.isListening())
+    {
+    std::cerr << "ctkDICOMStorageListener::stop() failed" << std::endl;
+    success = false;
+    }
+
+  databaseA.closeDatabase();
+  databaseB.closeDatabase();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,230 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QThread>
+
+// ctkDICOMCore includes
+#include "ctkDICOMAbstractThumbnailGenerator.h"
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMThumbnailQueue.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// QThread::msleep is protected in Qt4
+class Sleeper : public QThread
+{
+public:
+  static void msleep(unsigned long msecs)
+  {
+    QThread::msleep(msecs);
+  }
+};
+
+//------------------------------------------------------------------------------
+// Writes empty thumbnails and records the order they were requested in
+class TestThumbnailGenerator : public ctkDICOMAbstractThumbnailGenerator
+{
+public:
+  virtual bool generateThumbnail(DicomImage* dcmImage, const QString& path)
+  {
+    Q_UNUSED(dcmImage);
+    QFile thumbnail(path);
+    if (!thumbnail.open(QIODevice::WriteOnly))
+      {
+      return false;
+      }
+    thumbnail.close();
+    QMutexLocker locker(&this->Mutex);
+    this->GeneratedThumbnails << QFileInfo(path).fileName();
+    return true;
+  }
+
+  QMutex Mutex;
+  QStringList GeneratedThumbnails;
+};
+
+//------------------------------------------------------------------------------
+// Blocks the workers until released, so that the queue can be filled
+class BlockingThumbnailGenerator : public TestThumbnailGenerator
+{
+public:
+  BlockingThumbnailGenerator() : Released(false) {}
+  virtual bool generateThumbnail(DicomImage* dcmImage, const QString& path)
+  {
+    while (!this->Released)
+      {
+      Sleeper::msleep(10);
+      }
+    return TestThumbnailGenerator::generateThumbnail(dcmImage, path);
+  }
+
+  volatile bool Released;
+};
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailQueueTest1( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMThumbnailQueueTest1: missing dicom filePath argument" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QString dicomFilePath(argv[1]);
+
+  QDir temp = QDir::temp();
+  temp.mkdir("ctkDICOMThumbnailQueueTest1");
+  QDir thumbnailDirectory(temp.absoluteFilePath("ctkDICOMThumbnailQueueTest1"));
+
+  // requests are processed by priority, series priorities included
+  {
+  ctkDICOMThumbnailQueue queue;
+  if (queue.addRequest(dicomFilePath, thumbnailDirectory.absoluteFilePath("none.png"), "1", ""))
+    {
+    std::cerr << "Requests must fail without a generator" << std::endl;
+    return EXIT_FAILURE;
+    }
+  BlockingThumbnailGenerator generator;
+  queue.setThumbnailGenerator(&generator);
+  queue.setNumberOfThreads(1);
+  queue.setMaximumQueueSize(4);
+
+  // the first request blocks the worker
+  queue.addRequest(dicomFilePath, thumbnailDirectory.absoluteFilePath("0.png"), "series0", "0");
+  while (queue.pendingCount() > 0)
+    {
+    Sleeper::msleep(10);
+    }
+  queue.addRequest(dicomFilePath, thumbnailDirectory.absoluteFilePath("1.png"), "series1", "1", 0);
+  queue.addRequest(dicomFilePath, thumbnailDirectory.absoluteFilePath("2.png"), "series2", "2", 2);
+  queue.addRequest(dicomFilePath, thumbnailDirectory.absoluteFilePath("3.png"), "series3", "3", 1);
+  queue.addRequest(dicomFilePath, thumbnailDirectory.absoluteFilePath("4.png"), "series4", "4", 0);
+  if (queue.addRequest(dicomFilePath, thumbnailDirectory.absoluteFilePath("5.png"), "series5", "5"))
+    {
+    std::cerr << "Requests must fail once the queue is full" << std::endl;
+    return EXIT_FAILURE;
+    }
+  // what is displayed comes first
+  queue.setSeriesPriority("series4", 3);
+  queue.cancelSeries("series1");
+  if (queue.pendingCount() != 3)
+    {
+    std::cerr << "Expected 3 pending requests, got " << queue.pendingCount() << std::endl;
+    return EXIT_FAILURE;
+    }
+  generator.Released = true;
+  queue.waitForDone();
+
+  QStringList expected;
+  expected << "0.png" << "4.png" << "2.png" << "3.png";
+  if (generator.GeneratedThumbnails != expected)
+    {
+    std::cerr << "Thumbnails generated in the wrong order: "
+              << qPrintable(generator.GeneratedThumbnails.join(" ")) << std::endl;
+    return EXIT_FAILURE;
+    }
+  }
+
+  // canceled requests are not processed
+  {
+  ctkDICOMThumbnailQueue queue;
+  BlockingThumbnailGenerator generator;
+  queue.setThumbnailGenerator(&generator);
+  queue.setNumberOfThreads(2);
+  for (int i = 0; i < 20; ++i)
+    {
+    queue.addRequest(dicomFilePath, thumbnailDirectory.absoluteFilePath(QString("c%1.png").arg(i)),
+                     "series", QString::number(i));
+    }
+  queue.cancel();
+  generator.Released = true;
+  queue.waitForDone();
+  if (generator.GeneratedThumbnails.count() > 2 || queue.pendingCount() != 0)
+    {
+    std::cerr << "Canceled requests were processed: "
+              << generator.GeneratedThumbnails.count() << std::endl;
+    return EXIT_FAILURE;
+    }
+  }
+
+  // the database generates a single thumbnail per series by default
+  {
+  TestThumbnailGenerator generator;
+  ctkDICOMDatabase database;
+  QFileInfo databaseFile(thumbnailDirectory, "ctkDICOMThumbnailQueueTest1.sql");
+  QFile::remove(databaseFile.absoluteFilePath());
+  database.openDatabase(databaseFile.absoluteFilePath(), "ctkDICOMThumbnailQueueTest1");
+  database.setThumbnailGenerator(&generator);
+  if (database.thumbnailQueue()->thumbnailGenerator() != &generator)
+    {
+    std::cerr << "The database should share its generator with its queue" << std::endl;
+    return EXIT_FAILURE;
+    }
+  database.insert(dicomFilePath, false, true);
+  database.thumbnailQueue()->waitForDone();
+
+  QString sopInstanceUID = database.instanceForFile(dicomFilePath);
+  QString seriesInstanceUID = database.seriesForFile(dicomFilePath);
+  QString studyInstanceUID = database.studyForSeries(seriesInstanceUID);
+  if (!QFile::exists(database.thumbnailPath(studyInstanceUID, seriesInstanceUID))
+      || QFile::exists(database.thumbnailPath(studyInstanceUID, seriesInstanceUID, sopInstanceUID)))
+    {
+    std::cerr << "Expected a series thumbnail only" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  database.removeSeries(seriesInstanceUID);
+  if (QFile::exists(database.thumbnailPath(studyInstanceUID, seriesInstanceUID)))
+    {
+    std::cerr << "The series thumbnail should be removed with the series" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  database.setPerInstanceThumbnailsEnabled(true);
+  database.insert(dicomFilePath, false, true);
+  database.thumbnailQueue()->waitForDone();
+  if (!QFile::exists(database.thumbnailPath(studyInstanceUID, seriesInstanceUID, sopInstanceUID)))
+    {
+    std::cerr << "Expected an instance thumbnail" << std::endl;
+    return EXIT_FAILURE;
+    }
+  database.closeDatabase();
+  QFile::remove(databaseFile.absoluteFilePath());
+  }
+
+  return EXIT_SUCCESS;
+}
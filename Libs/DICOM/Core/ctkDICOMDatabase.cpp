@@ -21,22 +21,30 @@
 #include <stdexcept>
 
 // Qt includes
+#include <QAtomicInt>
+#include <QCache>
 #include <QDate>
+#include <QDateTime>
 #include <QDebug>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
+#include <QHash>
 #include <QSet>
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QSqlRecord>
 #include <QStringList>
+#include <QThread>
+#include <QThreadStorage>
 #include <QVariant>
 
 // ctkDICOM includes
 #include "ctkDICOMDatabase.h"
 #include "ctkDICOMAbstractThumbnailGenerator.h"
 #include "ctkDICOMItem.h"
+#include "ctkDICOMThumbnailQueue.h"
 
 #include "ctkLogger.h"
 
@@ -56,6 +64,18 @@
 #include <dcmtk/dcmdata/dcrledrg.h>  /* for DcmRLEDecoderRegistration */
 #include <dcmtk/dcmdata/dcrleerg.h>  /* for DcmRLEEncoderRegistration */
 
+// STD includes
+#ifdef Q_OS_WIN
+# include <windows.h>         // For CreateHardLinkW
+#else
+# include <fcntl.h>           // For open
+# include <unistd.h>          // For link and close
+#endif
+#ifdef Q_OS_LINUX
+# include <sys/ioctl.h>
+# include <linux/fs.h>        // For FICLONE
+#endif
+
 //------------------------------------------------------------------------------
 static ctkLogger logger("org.commontk.dicom.DICOMDatabase" );
 //------------------------------------------------------------------------------
@@ -67,6 +87,220 @@ static QString TagNotInInstance("__TAG_NOT_IN_INSTANCE__");
 // really is the empty string
 static QString ValueIsEmptyString("__VALUE_IS_EMPTY_STRING__");
 
+//------------------------------------------------------------------------------
+// Read-only connections opened by a thread, see readOnlyDatabase().
+// The connections belong to the thread: QThreadStorage deletes this object,
+// which removes them, when the thread finishes.
+class ctkDICOMDatabaseThreadConnections
+{
+public:
+  ctkDICOMDatabaseThreadConnections()
+    : Id(NextId.fetchAndAddOrdered(1))
+  {
+  }
+  ~ctkDICOMDatabaseThreadConnections()
+  {
+    foreach(const QString& connectionName, this->Generations.keys())
+      {
+      QSqlDatabase::removeDatabase(connectionName);
+      }
+  }
+
+  /// Unique for the lifetime of the process, unlike the thread address
+  const int Id;
+  /// Generation of the database each connection was opened for
+  QHash<QString, int> Generations;
+
+  static QAtomicInt NextId;
+};
+
+QAtomicInt ctkDICOMDatabaseThreadConnections::NextId(1);
+static QThreadStorage<ctkDICOMDatabaseThreadConnections*> ThreadConnections;
+
+// Incremented when a database is opened or closed, which makes the read-only
+// connections opened before stale
+static QAtomicInt NextReadOnlyGeneration(1);
+
+//------------------------------------------------------------------------------
+// Share the data of source with destination, either as a copy-on-write
+// clone or, if allowed, as a hard link. Both need the files to be on the
+// same file system.
+static bool linkFile(const QString& source, const QString& destination, bool allowHardLink)
+{
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+  int sourceFd = ::open(QFile::encodeName(source).constData(), O_RDONLY);
+  if (sourceFd >= 0)
+    {
+    int destinationFd = ::open(QFile::encodeName(destination).constData(),
+                               O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (destinationFd >= 0)
+      {
+      bool cloned = ::ioctl(destinationFd, FICLONE, sourceFd) == 0;
+      ::close(destinationFd);
+      if (!cloned)
+        {
+        QFile::remove(destination);
+        }
+      ::close(sourceFd);
+      if (cloned)
+        {
+        return true;
+        }
+      }
+    else
+      {
+      ::close(sourceFd);
+      }
+    }
+#endif
+  if (!allowHardLink)
+    {
+    return false;
+    }
+#ifdef Q_OS_WIN
+  return CreateHardLinkW(reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(destination).utf16()),
+                         reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(source).utf16()),
+                         NULL) != 0;
+#else
+  return ::link(QFile::encodeName(source).constData(),
+                QFile::encodeName(destination).constData()) == 0;
+#endif
+}
+
+//------------------------------------------------------------------------------
+static bool copyFile(const QString& source, const QString& destination)
+{
+  QFile sourceFile(source);
+  QFile destinationFile(destination);
+  if (!sourceFile.open(QIODevice::ReadOnly)
+      || !destinationFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+    return false;
+    }
+  // large blocks, the default QFile::copy buffer is only 4 KiB
+  QByteArray buffer;
+  buffer.resize(1024 * 1024);
+  qint64 bytesRead;
+  while ((bytesRead = sourceFile.read(buffer.data(), buffer.size())) > 0)
+    {
+    if (destinationFile.write(buffer.constData(), bytesRead) != bytesRead)
+      {
+      bytesRead = -1;
+      break;
+      }
+    }
+  destinationFile.close();
+  if (bytesRead < 0)
+    {
+    destinationFile.remove();
+    return false;
+    }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Compare the content of two files
+static bool sameFileContent(const QString& first, const QString& second)
+{
+  QFile firstFile(first);
+  QFile secondFile(second);
+  if (firstFile.size() != secondFile.size()
+      || !firstFile.open(QIODevice::ReadOnly) || !secondFile.open(QIODevice::ReadOnly))
+    {
+    return false;
+    }
+  const qint64 blockSize = 1024 * 1024;
+  while (!firstFile.atEnd())
+    {
+    QByteArray firstBlock = firstFile.read(blockSize);
+    if (firstBlock.isEmpty() || firstBlock != secondFile.read(blockSize))
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Fields of the search index with the table and the key column they belong to.
+// These are all the columns the browser tables show, that is all the columns
+// but the UIDs, so that the search box finds what the proxy filter found.
+struct SearchIndexField
+{
+  const char* Field;
+  const char* Table;
+  const char* UIDColumn;
+};
+static const SearchIndexField SearchIndexFields[] = {
+  {"PatientsName", "Patients", "UID"},
+  {"PatientID", "Patients", "UID"},
+  {"PatientsBirthDate", "Patients", "UID"},
+  {"PatientsBirthTime", "Patients", "UID"},
+  {"PatientsSex", "Patients", "UID"},
+  {"PatientsAge", "Patients", "UID"},
+  {"PatientsComments", "Patients", "UID"},
+  {"StudyID", "Studies", "StudyInstanceUID"},
+  {"StudyDate", "Studies", "StudyInstanceUID"},
+  {"StudyTime", "Studies", "StudyInstanceUID"},
+  {"AccessionNumber", "Studies", "StudyInstanceUID"},
+  {"ModalitiesInStudy", "Studies", "StudyInstanceUID"},
+  {"InstitutionName", "Studies", "StudyInstanceUID"},
+  {"ReferringPhysician", "Studies", "StudyInstanceUID"},
+  {"PerformingPhysiciansName", "Studies", "StudyInstanceUID"},
+  {"StudyDescription", "Studies", "StudyInstanceUID"},
+  {"SeriesNumber", "Series", "SeriesInstanceUID"},
+  {"SeriesDate", "Series", "SeriesInstanceUID"},
+  {"SeriesTime", "Series", "SeriesInstanceUID"},
+  {"SeriesDescription", "Series", "SeriesInstanceUID"},
+  {"Modality", "Series", "SeriesInstanceUID"},
+  {"BodyPartExamined", "Series", "SeriesInstanceUID"},
+  {"AcquisitionNumber", "Series", "SeriesInstanceUID"},
+  {"ContrastAgent", "Series", "SeriesInstanceUID"},
+  {"ScanningSequence", "Series", "SeriesInstanceUID"},
+  {"EchoNumber", "Series", "SeriesInstanceUID"},
+  {"TemporalPosition", "Series", "SeriesInstanceUID"}
+};
+static const int NumberOfSearchIndexFields =
+  sizeof(SearchIndexFields) / sizeof(SearchIndexFields[0]);
+
+//------------------------------------------------------------------------------
+static const SearchIndexField* searchIndexField(const QString& field)
+{
+  for (int i = 0; i < NumberOfSearchIndexFields; ++i)
+    {
+    if (field == SearchIndexFields[i].Field)
+      {
+      return &SearchIndexFields[i];
+      }
+    }
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Trigrams indexed for a value. The value is padded with two spaces so
+// that every substring of one or two characters is the prefix of a trigram.
+static QSet<QString> searchTrigrams(const QString& value)
+{
+  QSet<QString> trigrams;
+  if (value.isEmpty())
+    {
+    return trigrams;
+    }
+  QString padded = value.toLower() + "  ";
+  for (int i = 0; i + 3 <= padded.length(); ++i)
+    {
+    trigrams.insert(padded.mid(i, 3));
+    }
+  return trigrams;
+}
+
+//------------------------------------------------------------------------------
+static QString sqlStringLiteral(const QString& value)
+{
+  QString escaped = value;
+  return "'" + escaped.replace("'", "''") + "'";
+}
+
 //------------------------------------------------------------------------------
 class ctkDICOMDatabasePrivate
 {
@@ -88,11 +322,22 @@ public:
   bool loggedExecBatch(QSqlQuery& query);
   bool LoggedExecVerbose;
 
+  ///
+  /// \brief returns a statement prepared once per connection
+  /// The statements of the insert path are executed for every instance,
+  /// they are kept prepared until the database is closed.
+  /// Call finish() on the returned query once the results are read.
+  QSqlQuery& preparedQuery(const QString& queryString);
+  void clearPreparedQueries();
+  QHash<QString, QSqlQuery*> PreparedQueries;
+
   ///
   /// \brief group several inserts into a single transaction
   ///
   void beginTransaction();
   void endTransaction();
+  /// Number of nested beginTransaction calls not yet ended
+  int TransactionDepth;
 
   // dataset must be set always
   // filePath has to be set if this is an import of an actual file
@@ -117,9 +362,28 @@ public:
   QString      DatabaseFileName;
   QString      LastError;
   QSqlDatabase Database;
+
+  /// connection settings, see applyPragmas
+  bool WALModeEnabled;
+  int CacheSize;
+  qint64 MmapSize;
+  void applyPragmas(QSqlDatabase& database, bool readOnly);
+
+  /// Generation of the read-only connections created by readOnlyDatabase().
+  /// Each thread replaces its connection when it is from an older generation.
+  mutable QAtomicInt ReadOnlyGeneration;
+  void invalidateReadOnlyConnections();
+
+  /// databaseChanged is emitted once the current transaction ends
+  bool DatabaseChangedPending;
+  void notifyDatabaseChanged();
   QMap<QString, QString> LoadedHeader;
 
   ctkDICOMAbstractThumbnailGenerator* thumbnailGenerator;
+  ctkDICOMThumbnailQueue ThumbnailQueue;
+  bool PerInstanceThumbnailsEnabled;
+  /// Series whose thumbnail was requested since the database was opened
+  QSet<QString> ThumbnailSeries;
 
   /// these are for optimizing the import of image sequences
   /// since most information are identical for all slices
@@ -141,11 +405,53 @@ public:
   QSqlDatabase TagCacheDatabase;
   QString TagCacheDatabaseFilename;
   QStringList TagsToPrecache;
-  void precacheTags( const QString sopInstanceUID );
+  /// extract the TagsToPrecache values from a dataset being inserted,
+  /// fileName is only read if some tags are missing from the dataset
+  void precacheTags( const ctkDICOMItem& dataset, const QString& sopInstanceUID,
+                     const QString& seriesInstanceUID, const QString& fileName );
+  /// write the rows collected by precacheTags to the tag cache
+  void flushPrecachedTags();
+  /// rows waiting for the end of the current transaction
+  QStringList PrecachedSOPInstanceUIDs;
+  QStringList PrecachedSeriesInstanceUIDs;
+  QStringList PrecachedTags;
+  QStringList PrecachedValues;
+  /// insert rows in the tag cache, seriesInstanceUIDs may be empty
+  /// if the series of the instances is not known
+  bool cacheTags( const QStringList& sopInstanceUIDs, const QStringList& seriesInstanceUIDs,
+                  const QStringList& tags, QStringList values );
+  /// in-memory copy of the most recently used tag cache values,
+  /// keyed by cachedTagKey()
+  QCache<QString, QString> CachedTagValues;
+  static QString cachedTagKey(const QString& sopInstanceUID, const QString& tag);
+  /// convert a value stored in the tag cache to what cachedTag() returns
+  static QString cachedTagValue(const QString& storedValue);
+
+  /// Files stored in the database directory are hard linked to the
+  /// source file when possible instead of being copied
+  bool HardLinksEnabled;
+  /// Storage directories known to exist, they are created once per series
+  QSet<QString> StorageDirectories;
+  /// Copy filePath to the storage file \a storagePath, reusing the data of
+  /// the source when the file system allows it. An existing storage file
+  /// is kept if its content is the same, and only replaced once the copy
+  /// is complete.
+  bool storeFile(const QString& filePath, const QString& storagePath);
 
   int insertPatient(const ctkDICOMItem& ctkDataset);
   void insertStudy(const ctkDICOMItem& ctkDataset, int dbPatientID);
   void insertSeries( const ctkDICOMItem& ctkDataset, QString studyInstanceUID);
+
+  /// the SearchIndex table exists in the database, see hasSearchIndex()
+  bool SearchIndexExists;
+  /// (re)create an empty search index
+  bool createSearchIndex();
+  /// add the trigrams of the \a value of \a field for the row \a uid
+  void indexSearchValue(const QString& field, const QString& uid, const QString& value);
+  /// add the trigrams of all the indexed fields of the row \a uid of \a table
+  void indexSearchRow(const QString& table, const QString& uid);
+  /// remove the index rows of the rows of \a table whose key is in \a uidQuery
+  void removeSearchRows(const QString& table, const QString& uidQuery);
 };
 
 //------------------------------------------------------------------------------
@@ -157,6 +463,16 @@ ctkDICOMDatabasePrivate::ctkDICOMDatabasePrivate(ctkDICOMDatabase& o): q_ptr(&o)
   this->thumbnailGenerator = NULL;
   this->LoggedExecVerbose = false;
   this->TagCacheVerified = false;
+  this->TransactionDepth = 0;
+  this->WALModeEnabled = false;
+  this->CacheSize = 0;
+  this->MmapSize = 0;
+  this->DatabaseChangedPending = false;
+  this->ReadOnlyGeneration.fetchAndStoreOrdered(NextReadOnlyGeneration.fetchAndAddOrdered(1));
+  this->CachedTagValues.setMaxCost(200000);
+  this->HardLinksEnabled = false;
+  this->PerInstanceThumbnailsEnabled = false;
+  this->SearchIndexExists = false;
   this->resetLastInsertedValues();
 }
 
@@ -197,6 +513,31 @@ void ctkDICOMDatabasePrivate::registerCompressionLibraries(){
 //------------------------------------------------------------------------------
 ctkDICOMDatabasePrivate::~ctkDICOMDatabasePrivate()
 {
+  this->clearPreparedQueries();
+}
+
+//------------------------------------------------------------------------------
+QSqlQuery& ctkDICOMDatabasePrivate::preparedQuery(const QString& queryString)
+{
+  QSqlQuery* query = this->PreparedQueries.value(queryString, NULL);
+  if (!query)
+    {
+    query = new QSqlQuery(this->Database);
+    if (!query->prepare(queryString))
+      {
+      logger.error( "SQL failed\n Bad SQL: " + queryString );
+      logger.error( "Error text: " + query->lastError().text() );
+      }
+    this->PreparedQueries.insert(queryString, query);
+    }
+  return *query;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::clearPreparedQueries()
+{
+  qDeleteAll(this->PreparedQueries);
+  this->PreparedQueries.clear();
 }
 
 //------------------------------------------------------------------------------
@@ -257,6 +598,12 @@ bool ctkDICOMDatabasePrivate::loggedExecBatch(QSqlQuery& query)
 //------------------------------------------------------------------------------
 void ctkDICOMDatabasePrivate::beginTransaction()
 {
+  // SQLite does not support nested transactions, only the outermost
+  // begin/end pair is sent to the database
+  if (this->TransactionDepth++ > 0)
+    {
+    return;
+    }
   QSqlQuery transaction( this->Database );
   transaction.prepare( "BEGIN TRANSACTION" );
   transaction.exec();
@@ -265,9 +612,79 @@ void ctkDICOMDatabasePrivate::beginTransaction()
 //------------------------------------------------------------------------------
 void ctkDICOMDatabasePrivate::endTransaction()
 {
+  Q_Q(ctkDICOMDatabase);
+  if (this->TransactionDepth == 0 || --this->TransactionDepth > 0)
+    {
+    return;
+    }
   QSqlQuery transaction( this->Database );
   transaction.prepare( "END TRANSACTION" );
   transaction.exec();
+
+  this->flushPrecachedTags();
+
+  if (this->DatabaseChangedPending)
+    {
+    this->DatabaseChangedPending = false;
+    emit q->databaseChanged();
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::notifyDatabaseChanged()
+{
+  Q_Q(ctkDICOMDatabase);
+  if (this->TransactionDepth > 0)
+    {
+    this->DatabaseChangedPending = true;
+    return;
+    }
+  emit q->databaseChanged();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::applyPragmas(QSqlDatabase& database, bool readOnly)
+{
+  QSqlQuery pragmaQuery(database);
+  if (!readOnly)
+    {
+    //Disable synchronous writing to make modifications faster
+    loggedExec(pragmaQuery, "PRAGMA synchronous = OFF");
+    if (this->WALModeEnabled && this->DatabaseFileName != ":memory:")
+      {
+      loggedExec(pragmaQuery, "PRAGMA journal_mode = WAL");
+      }
+    }
+  if (this->CacheSize != 0)
+    {
+    loggedExec(pragmaQuery, QString("PRAGMA cache_size = %1").arg(this->CacheSize));
+    }
+  if (this->MmapSize > 0)
+    {
+    loggedExec(pragmaQuery, QString("PRAGMA mmap_size = %1").arg(this->MmapSize));
+    }
+  pragmaQuery.finish();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::invalidateReadOnlyConnections()
+{
+  // The connections of the other threads may still be in use, they can only
+  // be removed by their thread: the next readOnlyDatabase() call replaces them.
+  this->ReadOnlyGeneration.fetchAndStoreOrdered(NextReadOnlyGeneration.fetchAndAddOrdered(1));
+
+  // the connection of the calling thread is closed right away
+  if (!ThreadConnections.hasLocalData())
+    {
+    return;
+    }
+  ctkDICOMDatabaseThreadConnections* connections = ThreadConnections.localData();
+  QString connectionName = QString("%1-ReadOnly-%2").arg(this->Database.connectionName())
+    .arg(connections->Id);
+  if (connections->Generations.remove(connectionName))
+    {
+    QSqlDatabase::removeDatabase(connectionName);
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -285,12 +702,101 @@ void ctkDICOMDatabasePrivate::removeBackupFileList()
   loggedExec(query, "DROP TABLE main.Filenames_backup; " );
 }
 
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::createSearchIndex()
+{
+  // the statements of the insert path reference the table
+  this->clearPreparedQueries();
+  QSqlQuery query(this->Database);
+  this->SearchIndexExists =
+    loggedExec(query, "DROP TABLE IF EXISTS SearchIndex")
+    && loggedExec(query, "DROP TABLE IF EXISTS SearchIndexedFields")
+    && loggedExec(query, "CREATE TABLE SearchIndex ("
+                  "Field VARCHAR(64) NOT NULL, Trigram VARCHAR(3) NOT NULL, UID VARCHAR(64) NOT NULL, "
+                  "PRIMARY KEY (Field, Trigram, UID) )")
+    && loggedExec(query, "CREATE INDEX SearchIndexUIDIndex ON SearchIndex (UID)")
+    // the fields the index was built for, see hasSearchIndex()
+    && loggedExec(query, "CREATE TABLE SearchIndexedFields ( Field VARCHAR(64) NOT NULL, PRIMARY KEY (Field) )");
+  for (int i = 0; this->SearchIndexExists && i < NumberOfSearchIndexFields; ++i)
+    {
+    this->SearchIndexExists = loggedExec(query,
+      QString("INSERT INTO SearchIndexedFields (Field) VALUES ('%1')").arg(SearchIndexFields[i].Field));
+    }
+  return this->SearchIndexExists;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::indexSearchValue(const QString& field, const QString& uid, const QString& value)
+{
+  if (!this->SearchIndexExists)
+    {
+    return;
+    }
+  QSqlQuery& insertTrigram = preparedQuery(
+    "INSERT OR IGNORE INTO SearchIndex (Field, Trigram, UID) VALUES (?, ?, ?)" );
+  foreach(const QString& trigram, searchTrigrams(value))
+    {
+    insertTrigram.bindValue(0, field);
+    insertTrigram.bindValue(1, trigram);
+    insertTrigram.bindValue(2, uid);
+    loggedExec(insertTrigram);
+    }
+  insertTrigram.finish();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::indexSearchRow(const QString& table, const QString& uid)
+{
+  if (!this->SearchIndexExists)
+    {
+    return;
+    }
+  // the values are read back from the table so that they are indexed
+  // as rebuildSearchIndex() and the views see them
+  QStringList fields = ctkDICOMDatabase::searchIndexFields(table);
+  QSqlQuery& rowQuery = preparedQuery(QString("SELECT %1 FROM %2 WHERE %3 = ?")
+    .arg(fields.join(", ")).arg(table).arg(searchIndexField(fields.first())->UIDColumn));
+  rowQuery.bindValue(0, uid);
+  QStringList values;
+  if (loggedExec(rowQuery) && rowQuery.next())
+    {
+    for (int i = 0; i < fields.count(); ++i)
+      {
+      values << rowQuery.value(i).toString();
+      }
+    }
+  rowQuery.finish();
+  for (int i = 0; i < values.count(); ++i)
+    {
+    this->indexSearchValue(fields[i], uid, values[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::removeSearchRows(const QString& table, const QString& uidQuery)
+{
+  if (!this->SearchIndexExists)
+    {
+    return;
+    }
+  QStringList fields;
+  foreach(const QString& field, ctkDICOMDatabase::searchIndexFields(table))
+    {
+    fields << sqlStringLiteral(field);
+    }
+  QSqlQuery removeQuery(this->Database);
+  loggedExec(removeQuery, QString("DELETE FROM SearchIndex WHERE Field IN (%1) AND UID IN ( %2 )")
+             .arg(fields.join(", ")).arg(uidQuery));
+}
+
 
 
 //------------------------------------------------------------------------------
 void ctkDICOMDatabase::openDatabase(const QString databaseFile, const QString& connectionName )
 {
   Q_D(ctkDICOMDatabase);
+  d->clearPreparedQueries();
+  d->invalidateReadOnlyConnections();
   d->DatabaseFileName = databaseFile;
   d->Database = QSqlDatabase::addDatabase("QSQLITE", connectionName);
   d->Database.setDatabaseName(databaseFile);
@@ -309,23 +815,28 @@ void ctkDICOMDatabase::openDatabase(const QString databaseFile, const QString& c
     }
   d->resetLastInsertedValues();
 
+  // databases created before the search index existed, or indexed for
+  // other fields, are indexed once the event loop runs again so that
+  // opening them is not delayed. They are searched without the index until then.
+  d->SearchIndexExists = hasSearchIndex(d->Database);
+  if (!d->SearchIndexExists)
+    {
+    QMetaObject::invokeMethod(this, "updateSearchIndex", Qt::QueuedConnection);
+    }
+
   if (!isInMemory())
     {
       QFileSystemWatcher* watcher = new QFileSystemWatcher(QStringList(databaseFile),this);
       connect(watcher, SIGNAL(fileChanged(QString)),this, SIGNAL (databaseChanged()) );
     }
 
-  //Disable synchronous writing to make modifications faster
-  {
-  QSqlQuery pragmaSyncQuery(d->Database);
-  pragmaSyncQuery.exec("PRAGMA synchronous = OFF");
-  pragmaSyncQuery.finish();
-  }
+  d->applyPragmas(d->Database, false);
 
   // set up the tag cache for use later
   QFileInfo fileInfo(d->DatabaseFileName);
   d->TagCacheDatabaseFilename = QString( fileInfo.dir().path() + "/ctkDICOMTagCache.sql" );
   d->TagCacheVerified = false;
+  d->CachedTagValues.clear();
   if ( !this->tagCacheExists() )
     {
     this->initializeTagCache();
@@ -389,10 +900,133 @@ const QSqlDatabase& ctkDICOMDatabase::database() const {
   return d->Database;
 }
 
+//------------------------------------------------------------------------------
+QSqlDatabase ctkDICOMDatabase::readOnlyDatabase() const
+{
+  Q_D(const ctkDICOMDatabase);
+  if (!d->Database.isOpen() || this->isInMemory()
+      || (!d->WALModeEnabled && QThread::currentThread() == this->thread()))
+    {
+    return d->Database;
+    }
+
+  if (!ThreadConnections.hasLocalData())
+    {
+    ThreadConnections.setLocalData(new ctkDICOMDatabaseThreadConnections);
+    }
+  ctkDICOMDatabaseThreadConnections* connections = ThreadConnections.localData();
+  QString connectionName = QString("%1-ReadOnly-%2").arg(d->Database.connectionName())
+    .arg(connections->Id);
+  const int generation = d->ReadOnlyGeneration.fetchAndAddOrdered(0);
+  QHash<QString, int>::iterator it = connections->Generations.find(connectionName);
+  if (it != connections->Generations.end())
+    {
+    if (it.value() == generation)
+      {
+      return QSqlDatabase::database(connectionName);
+      }
+    // the database was closed or reopened since
+    connections->Generations.erase(it);
+    QSqlDatabase::removeDatabase(connectionName);
+    }
+
+  {
+  QSqlDatabase connection = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+  connection.setDatabaseName(d->DatabaseFileName);
+  connection.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000");
+  if (connection.open())
+    {
+    const_cast<ctkDICOMDatabasePrivate*>(d)->applyPragmas(connection, true);
+    connections->Generations.insert(connectionName, generation);
+    return connection;
+    }
+  logger.error("Could not open read-only connection: " + connection.lastError().text());
+  }
+  // not kept, the next call tries again
+  QSqlDatabase::removeDatabase(connectionName);
+  return QSqlDatabase();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::setWALModeEnabled(bool enabled)
+{
+  Q_D(ctkDICOMDatabase);
+  if (d->WALModeEnabled == enabled)
+    {
+    return;
+    }
+  d->WALModeEnabled = enabled;
+  if (d->Database.isOpen() && !this->isInMemory())
+    {
+    QSqlQuery pragmaQuery(d->Database);
+    d->loggedExec(pragmaQuery, enabled ? "PRAGMA journal_mode = WAL" : "PRAGMA journal_mode = DELETE");
+    }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::isWALModeEnabled() const
+{
+  Q_D(const ctkDICOMDatabase);
+  return d->WALModeEnabled;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::setCacheSize(int cacheSize)
+{
+  Q_D(ctkDICOMDatabase);
+  d->CacheSize = cacheSize;
+  if (d->Database.isOpen() && cacheSize != 0)
+    {
+    QSqlQuery pragmaQuery(d->Database);
+    d->loggedExec(pragmaQuery, QString("PRAGMA cache_size = %1").arg(cacheSize));
+    }
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabase::cacheSize() const
+{
+  Q_D(const ctkDICOMDatabase);
+  return d->CacheSize;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::setMmapSize(qint64 mmapSize)
+{
+  Q_D(ctkDICOMDatabase);
+  d->MmapSize = qMax(Q_INT64_C(0), mmapSize);
+  if (d->Database.isOpen())
+    {
+    QSqlQuery pragmaQuery(d->Database);
+    d->loggedExec(pragmaQuery, QString("PRAGMA mmap_size = %1").arg(d->MmapSize));
+    }
+}
+
+//------------------------------------------------------------------------------
+qint64 ctkDICOMDatabase::mmapSize() const
+{
+  Q_D(const ctkDICOMDatabase);
+  return d->MmapSize;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::setHardLinksEnabled(bool enabled)
+{
+  Q_D(ctkDICOMDatabase);
+  d->HardLinksEnabled = enabled;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::areHardLinksEnabled() const
+{
+  Q_D(const ctkDICOMDatabase);
+  return d->HardLinksEnabled;
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMDatabase::setThumbnailGenerator(ctkDICOMAbstractThumbnailGenerator *generator){
   Q_D(ctkDICOMDatabase);
   d->thumbnailGenerator = generator;
+  d->ThumbnailQueue.setThumbnailGenerator(generator);
 }
 
 //------------------------------------------------------------------------------
@@ -401,6 +1035,40 @@ ctkDICOMAbstractThumbnailGenerator* ctkDICOMDatabase::thumbnailGenerator(){
   return d->thumbnailGenerator;
 }
 
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailQueue* ctkDICOMDatabase::thumbnailQueue() const
+{
+  Q_D(const ctkDICOMDatabase);
+  return const_cast<ctkDICOMThumbnailQueue*>(&d->ThumbnailQueue);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::setPerInstanceThumbnailsEnabled(bool enabled)
+{
+  Q_D(ctkDICOMDatabase);
+  d->PerInstanceThumbnailsEnabled = enabled;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::arePerInstanceThumbnailsEnabled() const
+{
+  Q_D(const ctkDICOMDatabase);
+  return d->PerInstanceThumbnailsEnabled;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabase::thumbnailPath(const QString& studyInstanceUID,
+                                        const QString& seriesInstanceUID,
+                                        const QString& sopInstanceUID) const
+{
+  QString path = this->databaseDirectory() + "/thumbs/" + studyInstanceUID + "/" + seriesInstanceUID;
+  if (!sopInstanceUID.isEmpty())
+    {
+    path += "/" + sopInstanceUID;
+    }
+  return path + ".png";
+}
+
 //------------------------------------------------------------------------------
 bool ctkDICOMDatabasePrivate::executeScript(const QString script) {
   QFile scriptFile(script);
@@ -458,12 +1126,18 @@ bool ctkDICOMDatabase::initializeDatabase(const char* sqlFileName)
   Q_D(ctkDICOMDatabase);
 
   d->resetLastInsertedValues();
+  // the tables are about to be dropped
+  d->clearPreparedQueries();
 
   // remove any existing schema info - this handles the case where an
   // old schema should be loaded for testing.
   QSqlQuery dropSchemaInfo(d->Database);
   d->loggedExec( dropSchemaInfo, QString("DROP TABLE IF EXISTS 'SchemaInfo';") );
-  return d->executeScript(sqlFileName);
+  if (!d->executeScript(sqlFileName))
+    {
+    return false;
+    }
+  return d->createSearchIndex();
 }
 
 //------------------------------------------------------------------------------
@@ -552,8 +1226,13 @@ bool ctkDICOMDatabase::updateSchema(const char* schemaFile)
 void ctkDICOMDatabase::closeDatabase()
 {
   Q_D(ctkDICOMDatabase);
+  d->clearPreparedQueries();
+  d->invalidateReadOnlyConnections();
   d->Database.close();
   d->TagCacheDatabase.close();
+  d->CachedTagValues.clear();
+  d->StorageDirectories.clear();
+  d->ThumbnailSeries.clear();
 }
 
 //
@@ -918,7 +1597,14 @@ QString ctkDICOMDatabase::fileValue(const QString fileName, const unsigned short
     }
 
   ctkDICOMItem dataset;
-  dataset.InitializeFromFile(fileName);
+  if (group < DCM_PixelData.getGroup())
+    {
+    dataset.InitializeFromFileHeader(fileName);
+    }
+  else
+    {
+    dataset.InitializeFromFile(fileName);
+    }
 
   DcmTagKey tagKey(group, element);
 
@@ -988,10 +1674,10 @@ void ctkDICOMDatabase::insert ( const QString& filePath, bool storeFile, bool ge
 
   std::string filename = filePath.toStdString();
 
-  DcmFileFormat fileformat;
   ctkDICOMItem ctkDataset;
 
-  ctkDataset.InitializeFromFile(filePath);
+  // the pixel data is not needed for indexing
+  ctkDataset.InitializeFromFileHeader(filePath);
   if ( ctkDataset.IsInitialized() )
     {
       d->insert( ctkDataset, filePath, storeFile, generateThumbnail );
@@ -1002,6 +1688,75 @@ void ctkDICOMDatabase::insert ( const QString& filePath, bool storeFile, bool ge
     }
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::insert( const QList<IndexingResult>& indexingResults )
+{
+  Q_D(ctkDICOMDatabase);
+  d->beginTransaction();
+  foreach(const IndexingResult& indexingResult, indexingResults)
+    {
+    if (indexingResult.dataset.isNull() || !indexingResult.dataset->IsInitialized())
+      {
+      logger.warn(QString("Could not read DICOM file:") + indexingResult.filePath);
+      continue;
+      }
+    d->insert( *indexingResult.dataset, indexingResult.filePath,
+               indexingResult.storeFile, indexingResult.generateThumbnail );
+    }
+  d->endTransaction();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::beginTransaction()
+{
+  Q_D(ctkDICOMDatabase);
+  d->beginTransaction();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::endTransaction()
+{
+  Q_D(ctkDICOMDatabase);
+  d->endTransaction();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::storeFile(const QString& filePath, const QString& storagePath)
+{
+  QFileInfo storageInfo(storagePath);
+  if (storageInfo.exists())
+    {
+    // files are stored by SOP instance UID, the same instance
+    // imported again, e.g. from other media, is not copied again
+    if (sameFileContent(filePath, storagePath))
+      {
+      return true;
+      }
+    }
+  else if (!storageInfo.dir().exists())
+    {
+    // removed behind our back
+    QDir().mkpath(storageInfo.absolutePath());
+    this->StorageDirectories.insert(storageInfo.absolutePath());
+    }
+
+  // the stored file is only replaced once the new one is complete
+  QString partialPath = storagePath + ".part";
+  QFile::remove(partialPath);
+  if (!linkFile(filePath, partialPath, this->HardLinksEnabled)
+      && !copyFile(filePath, partialPath))
+    {
+    return false;
+    }
+  QFile::remove(storagePath);
+  if (!QFile::rename(partialPath, storagePath))
+    {
+    QFile::remove(partialPath);
+    return false;
+    }
+  return true;
+}
+
 //------------------------------------------------------------------------------
 int ctkDICOMDatabasePrivate::insertPatient(const ctkDICOMItem& ctkDataset)
 {
@@ -1013,8 +1768,11 @@ int ctkDICOMDatabasePrivate::insertPatient(const ctkDICOMItem& ctkDataset)
   QString patientsName(ctkDataset.GetElementAsString(DCM_PatientName) );
   QString patientsBirthDate(ctkDataset.GetElementAsString(DCM_PatientBirthDate) );
 
-  QSqlQuery checkPatientExistsQuery(Database);
-  checkPatientExistsQuery.prepare ( "SELECT * FROM Patients WHERE PatientID = ? AND PatientsName = ?" );
+  // Patients are only identified by an autoincrement UID, there is no
+  // unique key an INSERT OR IGNORE could rely on. This runs only when the
+  // patient differs from the previous insert.
+  QSqlQuery& checkPatientExistsQuery =
+    preparedQuery( "SELECT UID FROM Patients WHERE PatientID = ? AND PatientsName = ?" );
   checkPatientExistsQuery.bindValue ( 0, patientID );
   checkPatientExistsQuery.bindValue ( 1, patientsName );
   loggedExec(checkPatientExistsQuery);
@@ -1022,20 +1780,22 @@ int ctkDICOMDatabasePrivate::insertPatient(const ctkDICOMItem& ctkDataset)
   if (checkPatientExistsQuery.next())
     {
       // we found him
-      dbPatientID = checkPatientExistsQuery.value(checkPatientExistsQuery.record().indexOf("UID")).toInt();
-      qDebug() << "Found patient in the database as UId: " << dbPatientID;
+      dbPatientID = checkPatientExistsQuery.value(0).toInt();
+      checkPatientExistsQuery.finish();
+      logger.debug ( "Found patient in the database as UId: " + QString().setNum ( dbPatientID ) );
     }
   else
     {
-      // Insert it
+      checkPatientExistsQuery.finish();
 
+      // Insert it
       QString patientsBirthTime(ctkDataset.GetElementAsString(DCM_PatientBirthTime) );
       QString patientsSex(ctkDataset.GetElementAsString(DCM_PatientSex) );
       QString patientsAge(ctkDataset.GetElementAsString(DCM_PatientAge) );
       QString patientComments(ctkDataset.GetElementAsString(DCM_PatientComments) );
 
-      QSqlQuery insertPatientStatement ( Database );
-      insertPatientStatement.prepare ( "INSERT INTO Patients ('UID', 'PatientsName', 'PatientID', 'PatientsBirthDate', 'PatientsBirthTime', 'PatientsSex', 'PatientsAge', 'PatientsComments' ) values ( NULL, ?, ?, ?, ?, ?, ?, ? )" );
+      QSqlQuery& insertPatientStatement = preparedQuery (
+        "INSERT INTO Patients ('UID', 'PatientsName', 'PatientID', 'PatientsBirthDate', 'PatientsBirthTime', 'PatientsSex', 'PatientsAge', 'PatientsComments' ) values ( NULL, ?, ?, ?, ?, ?, ?, ? )" );
       insertPatientStatement.bindValue ( 0, patientsName );
       insertPatientStatement.bindValue ( 1, patientID );
       insertPatientStatement.bindValue ( 2, QDate::fromString ( patientsBirthDate, "yyyyMMdd" ) );
@@ -1044,11 +1804,13 @@ int ctkDICOMDatabasePrivate::insertPatient(const ctkDICOMItem& ctkDataset)
       // TODO: shift patient's age to study,
       // since this is not a patient level attribute in images
       // insertPatientStatement.bindValue ( 5, patientsAge );
+      insertPatientStatement.bindValue ( 5, QVariant() );
       insertPatientStatement.bindValue ( 6, patientComments );
       loggedExec(insertPatientStatement);
       dbPatientID = insertPatientStatement.lastInsertId().toInt();
+      insertPatientStatement.finish();
       logger.debug ( "New patient inserted: " + QString().setNum ( dbPatientID ) );
-      qDebug() << "New patient inserted as : " << dbPatientID;
+      this->indexSearchRow("Patients", QString::number(dbPatientID));
     }
     return dbPatientID;
 }
@@ -1057,110 +1819,101 @@ int ctkDICOMDatabasePrivate::insertPatient(const ctkDICOMItem& ctkDataset)
 void ctkDICOMDatabasePrivate::insertStudy(const ctkDICOMItem& ctkDataset, int dbPatientID)
 {
   QString studyInstanceUID(ctkDataset.GetElementAsString(DCM_StudyInstanceUID) );
-  QSqlQuery checkStudyExistsQuery (Database);
-  checkStudyExistsQuery.prepare ( "SELECT * FROM Studies WHERE StudyInstanceUID = ?" );
-  checkStudyExistsQuery.bindValue ( 0, studyInstanceUID );
-  checkStudyExistsQuery.exec();
-  if(!checkStudyExistsQuery.next())
-    {
-      qDebug() << "Need to insert new study: " << studyInstanceUID;
-
-      QString studyID(ctkDataset.GetElementAsString(DCM_StudyID) );
-      QString studyDate(ctkDataset.GetElementAsString(DCM_StudyDate) );
-      QString studyTime(ctkDataset.GetElementAsString(DCM_StudyTime) );
-      QString accessionNumber(ctkDataset.GetElementAsString(DCM_AccessionNumber) );
-      QString modalitiesInStudy(ctkDataset.GetElementAsString(DCM_ModalitiesInStudy) );
-      QString institutionName(ctkDataset.GetElementAsString(DCM_InstitutionName) );
-      QString performingPhysiciansName(ctkDataset.GetElementAsString(DCM_PerformingPhysicianName) );
-      QString referringPhysician(ctkDataset.GetElementAsString(DCM_ReferringPhysicianName) );
-      QString studyDescription(ctkDataset.GetElementAsString(DCM_StudyDescription) );
-
-      QSqlQuery insertStudyStatement ( Database );
-      insertStudyStatement.prepare ( "INSERT INTO Studies ( 'StudyInstanceUID', 'PatientsUID', 'StudyID', 'StudyDate', 'StudyTime', 'AccessionNumber', 'ModalitiesInStudy', 'InstitutionName', 'ReferringPhysician', 'PerformingPhysiciansName', 'StudyDescription' ) VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? )" );
-      insertStudyStatement.bindValue ( 0, studyInstanceUID );
-      insertStudyStatement.bindValue ( 1, dbPatientID );
-      insertStudyStatement.bindValue ( 2, studyID );
-      insertStudyStatement.bindValue ( 3, QDate::fromString ( studyDate, "yyyyMMdd" ) );
-      insertStudyStatement.bindValue ( 4, studyTime );
-      insertStudyStatement.bindValue ( 5, accessionNumber );
-      insertStudyStatement.bindValue ( 6, modalitiesInStudy );
-      insertStudyStatement.bindValue ( 7, institutionName );
-      insertStudyStatement.bindValue ( 8, referringPhysician );
-      insertStudyStatement.bindValue ( 9, performingPhysiciansName );
-      insertStudyStatement.bindValue ( 10, studyDescription );
-      if ( !insertStudyStatement.exec() )
-        {
-          logger.error ( "Error executing statament: " + insertStudyStatement.lastQuery() + " Error: " + insertStudyStatement.lastError().text() );
-        }
-      else
-        {
-          LastStudyInstanceUID = studyInstanceUID;
-        }
+  QString studyID(ctkDataset.GetElementAsString(DCM_StudyID) );
+  QString studyDate(ctkDataset.GetElementAsString(DCM_StudyDate) );
+  QString studyTime(ctkDataset.GetElementAsString(DCM_StudyTime) );
+  QString accessionNumber(ctkDataset.GetElementAsString(DCM_AccessionNumber) );
+  QString modalitiesInStudy(ctkDataset.GetElementAsString(DCM_ModalitiesInStudy) );
+  QString institutionName(ctkDataset.GetElementAsString(DCM_InstitutionName) );
+  QString performingPhysiciansName(ctkDataset.GetElementAsString(DCM_PerformingPhysicianName) );
+  QString referringPhysician(ctkDataset.GetElementAsString(DCM_ReferringPhysicianName) );
+  QString studyDescription(ctkDataset.GetElementAsString(DCM_StudyDescription) );
+
+  // existing studies are left untouched by the conflict clause
+  QSqlQuery& insertStudyStatement = preparedQuery (
+    "INSERT OR IGNORE INTO Studies ( 'StudyInstanceUID', 'PatientsUID', 'StudyID', 'StudyDate', 'StudyTime', 'AccessionNumber', 'ModalitiesInStudy', 'InstitutionName', 'ReferringPhysician', 'PerformingPhysiciansName', 'StudyDescription' ) VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? )" );
+  insertStudyStatement.bindValue ( 0, studyInstanceUID );
+  insertStudyStatement.bindValue ( 1, dbPatientID );
+  insertStudyStatement.bindValue ( 2, studyID );
+  insertStudyStatement.bindValue ( 3, QDate::fromString ( studyDate, "yyyyMMdd" ) );
+  insertStudyStatement.bindValue ( 4, studyTime );
+  insertStudyStatement.bindValue ( 5, accessionNumber );
+  insertStudyStatement.bindValue ( 6, modalitiesInStudy );
+  insertStudyStatement.bindValue ( 7, institutionName );
+  insertStudyStatement.bindValue ( 8, referringPhysician );
+  insertStudyStatement.bindValue ( 9, performingPhysiciansName );
+  insertStudyStatement.bindValue ( 10, studyDescription );
+  if ( !insertStudyStatement.exec() )
+    {
+      logger.error ( "Error executing statament: " + insertStudyStatement.lastQuery() + " Error: " + insertStudyStatement.lastError().text() );
     }
   else
     {
-    qDebug() << "Used existing study: " << studyInstanceUID;
+      bool inserted = insertStudyStatement.numRowsAffected() > 0;
+      insertStudyStatement.finish();
+      if (inserted)
+        {
+        logger.debug ( "New study inserted: " + studyInstanceUID );
+        this->indexSearchRow("Studies", studyInstanceUID);
+        }
+      LastStudyInstanceUID = studyInstanceUID;
     }
+  insertStudyStatement.finish();
 }
 
 //------------------------------------------------------------------------------
 void ctkDICOMDatabasePrivate::insertSeries(const ctkDICOMItem& ctkDataset, QString studyInstanceUID)
 {
   QString seriesInstanceUID(ctkDataset.GetElementAsString(DCM_SeriesInstanceUID) );
-  QSqlQuery checkSeriesExistsQuery (Database);
-  checkSeriesExistsQuery.prepare ( "SELECT * FROM Series WHERE SeriesInstanceUID = ?" );
-  checkSeriesExistsQuery.bindValue ( 0, seriesInstanceUID );
-  logger.warn ( "Statement: " + checkSeriesExistsQuery.lastQuery() );
-  checkSeriesExistsQuery.exec();
-  if(!checkSeriesExistsQuery.next())
-    {
-      qDebug() << "Need to insert new series: " << seriesInstanceUID;
-
-      QString seriesDate(ctkDataset.GetElementAsString(DCM_SeriesDate) );
-      QString seriesTime(ctkDataset.GetElementAsString(DCM_SeriesTime) );
-      QString seriesDescription(ctkDataset.GetElementAsString(DCM_SeriesDescription) );
-      QString modality(ctkDataset.GetElementAsString(DCM_Modality) );
-      QString bodyPartExamined(ctkDataset.GetElementAsString(DCM_BodyPartExamined) );
-      QString frameOfReferenceUID(ctkDataset.GetElementAsString(DCM_FrameOfReferenceUID) );
-      QString contrastAgent(ctkDataset.GetElementAsString(DCM_ContrastBolusAgent) );
-      QString scanningSequence(ctkDataset.GetElementAsString(DCM_ScanningSequence) );
-      long seriesNumber(ctkDataset.GetElementAsInteger(DCM_SeriesNumber) );
-      long acquisitionNumber(ctkDataset.GetElementAsInteger(DCM_AcquisitionNumber) );
-      long echoNumber(ctkDataset.GetElementAsInteger(DCM_EchoNumbers) );
-      long temporalPosition(ctkDataset.GetElementAsInteger(DCM_TemporalPositionIdentifier) );
-
-      QSqlQuery insertSeriesStatement ( Database );
-      insertSeriesStatement.prepare ( "INSERT INTO Series ( 'SeriesInstanceUID', 'StudyInstanceUID', 'SeriesNumber', 'SeriesDate', 'SeriesTime', 'SeriesDescription', 'Modality', 'BodyPartExamined', 'FrameOfReferenceUID', 'AcquisitionNumber', 'ContrastAgent', 'ScanningSequence', 'EchoNumber', 'TemporalPosition' ) VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? )" );
-      insertSeriesStatement.bindValue ( 0, seriesInstanceUID );
-      insertSeriesStatement.bindValue ( 1, studyInstanceUID );
-      insertSeriesStatement.bindValue ( 2, static_cast<int>(seriesNumber) );
-      insertSeriesStatement.bindValue ( 3, QDate::fromString ( seriesDate, "yyyyMMdd" ) );
-      insertSeriesStatement.bindValue ( 4, seriesTime );
-      insertSeriesStatement.bindValue ( 5, seriesDescription );
-      insertSeriesStatement.bindValue ( 6, modality );
-      insertSeriesStatement.bindValue ( 7, bodyPartExamined );
-      insertSeriesStatement.bindValue ( 8, frameOfReferenceUID );
-      insertSeriesStatement.bindValue ( 9, static_cast<int>(acquisitionNumber) );
-      insertSeriesStatement.bindValue ( 10, contrastAgent );
-      insertSeriesStatement.bindValue ( 11, scanningSequence );
-      insertSeriesStatement.bindValue ( 12, static_cast<int>(echoNumber) );
-      insertSeriesStatement.bindValue ( 13, static_cast<int>(temporalPosition) );
-      if ( !insertSeriesStatement.exec() )
-        {
-          logger.error ( "Error executing statament: "
-                         + insertSeriesStatement.lastQuery()
-                         + " Error: " + insertSeriesStatement.lastError().text() );
-          LastSeriesInstanceUID = "";
-        }
-      else
-        {
-          LastSeriesInstanceUID = seriesInstanceUID;
-        }
+  QString seriesDate(ctkDataset.GetElementAsString(DCM_SeriesDate) );
+  QString seriesTime(ctkDataset.GetElementAsString(DCM_SeriesTime) );
+  QString seriesDescription(ctkDataset.GetElementAsString(DCM_SeriesDescription) );
+  QString modality(ctkDataset.GetElementAsString(DCM_Modality) );
+  QString bodyPartExamined(ctkDataset.GetElementAsString(DCM_BodyPartExamined) );
+  QString frameOfReferenceUID(ctkDataset.GetElementAsString(DCM_FrameOfReferenceUID) );
+  QString contrastAgent(ctkDataset.GetElementAsString(DCM_ContrastBolusAgent) );
+  QString scanningSequence(ctkDataset.GetElementAsString(DCM_ScanningSequence) );
+  long seriesNumber(ctkDataset.GetElementAsInteger(DCM_SeriesNumber) );
+  long acquisitionNumber(ctkDataset.GetElementAsInteger(DCM_AcquisitionNumber) );
+  long echoNumber(ctkDataset.GetElementAsInteger(DCM_EchoNumbers) );
+  long temporalPosition(ctkDataset.GetElementAsInteger(DCM_TemporalPositionIdentifier) );
+
+  // existing series are left untouched by the conflict clause
+  QSqlQuery& insertSeriesStatement = preparedQuery (
+    "INSERT OR IGNORE INTO Series ( 'SeriesInstanceUID', 'StudyInstanceUID', 'SeriesNumber', 'SeriesDate', 'SeriesTime', 'SeriesDescription', 'Modality', 'BodyPartExamined', 'FrameOfReferenceUID', 'AcquisitionNumber', 'ContrastAgent', 'ScanningSequence', 'EchoNumber', 'TemporalPosition' ) VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? )" );
+  insertSeriesStatement.bindValue ( 0, seriesInstanceUID );
+  insertSeriesStatement.bindValue ( 1, studyInstanceUID );
+  insertSeriesStatement.bindValue ( 2, static_cast<int>(seriesNumber) );
+  insertSeriesStatement.bindValue ( 3, QDate::fromString ( seriesDate, "yyyyMMdd" ) );
+  insertSeriesStatement.bindValue ( 4, seriesTime );
+  insertSeriesStatement.bindValue ( 5, seriesDescription );
+  insertSeriesStatement.bindValue ( 6, modality );
+  insertSeriesStatement.bindValue ( 7, bodyPartExamined );
+  insertSeriesStatement.bindValue ( 8, frameOfReferenceUID );
+  insertSeriesStatement.bindValue ( 9, static_cast<int>(acquisitionNumber) );
+  insertSeriesStatement.bindValue ( 10, contrastAgent );
+  insertSeriesStatement.bindValue ( 11, scanningSequence );
+  insertSeriesStatement.bindValue ( 12, static_cast<int>(echoNumber) );
+  insertSeriesStatement.bindValue ( 13, static_cast<int>(temporalPosition) );
+  if ( !insertSeriesStatement.exec() )
+    {
+      logger.error ( "Error executing statament: "
+                     + insertSeriesStatement.lastQuery()
+                     + " Error: " + insertSeriesStatement.lastError().text() );
+      LastSeriesInstanceUID = "";
     }
   else
     {
-    qDebug() << "Used existing series: " << seriesInstanceUID;
+      bool inserted = insertSeriesStatement.numRowsAffected() > 0;
+      insertSeriesStatement.finish();
+      if (inserted)
+        {
+        logger.debug ( "New series inserted: " + seriesInstanceUID );
+        this->indexSearchRow("Series", seriesInstanceUID);
+        }
+      LastSeriesInstanceUID = seriesInstanceUID;
     }
+  insertSeriesStatement.finish();
 }
 
 //------------------------------------------------------------------------------
@@ -1178,30 +1931,69 @@ const QStringList ctkDICOMDatabase::tagsToPrecache()
 }
 
 //------------------------------------------------------------------------------
-void ctkDICOMDatabasePrivate::precacheTags( const QString sopInstanceUID )
+void ctkDICOMDatabasePrivate::precacheTags( const ctkDICOMItem& dataset,
+                                            const QString& sopInstanceUID,
+                                            const QString& seriesInstanceUID,
+                                            const QString& fileName )
 {
   Q_Q(ctkDICOMDatabase);
 
-  ctkDICOMItem dataset;
-  QString fileName = q->fileForInstance(sopInstanceUID);
-  dataset.InitializeFromFile(fileName);
-
-
-  QStringList sopInstanceUIDs, tags, values;
+  // datasets read for indexing stop at the pixel data, the file
+  // is only read again for the tags located after it
+  QScopedPointer<ctkDICOMItem> fullDataset;
   foreach (const QString &tag, this->TagsToPrecache)
     {
     unsigned short group, element;
     q->tagToGroupElement(tag, group, element);
     DcmTagKey tagKey(group, element);
-    QString value = dataset.GetAllElementValuesAsString(tagKey);
-    sopInstanceUIDs << sopInstanceUID;
-    tags << tag;
-    values << value;
+    const ctkDICOMItem* source = &dataset;
+    DcmElement* dcmElement = NULL;
+    if ( group >= DCM_PixelData.getGroup() && !fileName.isEmpty()
+         && !dataset.findAndGetElement(tagKey, dcmElement).good() )
+      {
+      if (fullDataset.isNull())
+        {
+        fullDataset.reset(new ctkDICOMItem);
+        fullDataset->InitializeFromFile(fileName);
+        }
+      if (fullDataset->IsInitialized())
+        {
+        source = fullDataset.data();
+        }
+      }
+    this->PrecachedSOPInstanceUIDs << sopInstanceUID;
+    this->PrecachedSeriesInstanceUIDs << seriesInstanceUID;
+    this->PrecachedTags << tag;
+    this->PrecachedValues << source->GetAllElementValuesAsString(tagKey);
     }
 
-  this->beginTransaction();
-  q->cacheTags(sopInstanceUIDs, tags, values);
-  this->endTransaction();
+  if (this->TransactionDepth == 0)
+    {
+    this->flushPrecachedTags();
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::flushPrecachedTags()
+{
+  Q_Q(ctkDICOMDatabase);
+  if (this->PrecachedSOPInstanceUIDs.isEmpty())
+    {
+    return;
+    }
+  // the tag cache lives in its own database file, write all the
+  // rows collected during the last transaction in a single one
+  bool transaction = q->tagCacheExists() && this->TagCacheDatabase.transaction();
+  this->cacheTags(this->PrecachedSOPInstanceUIDs, this->PrecachedSeriesInstanceUIDs,
+                  this->PrecachedTags, this->PrecachedValues);
+  if (transaction)
+    {
+    this->TagCacheDatabase.commit();
+    }
+  this->PrecachedSOPInstanceUIDs.clear();
+  this->PrecachedSeriesInstanceUIDs.clear();
+  this->PrecachedTags.clear();
+  this->PrecachedValues.clear();
 }
 
 //------------------------------------------------------------------------------
@@ -1221,8 +2013,7 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMItem& ctkDataset, const QStr
 
   QString sopInstanceUID ( ctkDataset.GetElementAsString(DCM_SOPInstanceUID) );
 
-  QSqlQuery fileExistsQuery ( Database );
-  fileExistsQuery.prepare("SELECT InsertTimestamp,Filename FROM Images WHERE SOPInstanceUID == :sopInstanceUID");
+  QSqlQuery& fileExistsQuery = preparedQuery("SELECT InsertTimestamp,Filename FROM Images WHERE SOPInstanceUID == :sopInstanceUID");
   fileExistsQuery.bindValue(":sopInstanceUID",sopInstanceUID);
   {
   bool success = fileExistsQuery.exec();
@@ -1234,8 +2025,9 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMItem& ctkDataset, const QStr
   fileExistsQuery.next();
 
   QString databaseFilename(fileExistsQuery.value(1).toString());
-  QDateTime fileLastModified(QFileInfo(databaseFilename).lastModified());
   QDateTime databaseInsertTimestamp(QDateTime::fromString(fileExistsQuery.value(0).toString(),Qt::ISODate));
+  fileExistsQuery.finish();
+  QDateTime fileLastModified(QFileInfo(databaseFilename).lastModified());
 
   qDebug() << "inserting filePath: " << filePath;
   if (databaseFilename == "")
@@ -1251,8 +2043,7 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMItem& ctkDataset, const QStr
         }
       else
         {
-        QSqlQuery deleteFile ( Database );
-        deleteFile.prepare("DELETE FROM Images WHERE SOPInstanceUID == :sopInstanceUID");
+        QSqlQuery& deleteFile = preparedQuery("DELETE FROM Images WHERE SOPInstanceUID == :sopInstanceUID");
         deleteFile.bindValue(":sopInstanceUID",sopInstanceUID);
         bool success = deleteFile.exec();
         if (!success)
@@ -1293,16 +2084,16 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMItem& ctkDataset, const QStr
   QString filename = filePath;
   if ( storeFile && !q->isInMemory() && !seriesInstanceUID.isEmpty() )
     {
-      // QString studySeriesDirectory = studyInstanceUID + "/" + seriesInstanceUID;
-      QString destinationDirectoryName = q->databaseDirectory() + "/dicom/";
-      QDir destinationDir(destinationDirectoryName);
-      filename = destinationDirectoryName +
+      QString studySeriesDirectory = q->databaseDirectory() + "/dicom/" +
           studyInstanceUID + "/" +
-          seriesInstanceUID + "/" +
-          sopInstanceUID;
+          seriesInstanceUID;
+      filename = studySeriesDirectory + "/" + sopInstanceUID;
 
-      destinationDir.mkpath(studyInstanceUID + "/" +
-                            seriesInstanceUID);
+      if (!this->StorageDirectories.contains(studySeriesDirectory))
+        {
+          QDir().mkpath(studySeriesDirectory);
+          this->StorageDirectories.insert(studySeriesDirectory);
+        }
 
       if(filePath.isEmpty())
         {
@@ -1317,11 +2108,14 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMItem& ctkDataset, const QStr
       else
         {
           // we're inserting an existing file
-
-          QFile currentFile( filePath );
-          currentFile.copy(filename);
           logger.debug( "Copy file from: " + filePath );
           logger.debug( "Copy file to  : " + filename );
+          if ( !this->storeFile( filePath, filename ) )
+            {
+              // not indexed, the row would point to a missing file
+              logger.error ( "Error storing file: " + filename );
+              return;
+            }
         }
     }
 
@@ -1382,23 +2176,21 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMItem& ctkDataset, const QStr
       //
       if ( !filename.isEmpty() && !seriesInstanceUID.isEmpty() )
         {
-          QSqlQuery checkImageExistsQuery (Database);
-          checkImageExistsQuery.prepare ( "SELECT * FROM Images WHERE Filename = ?" );
-          checkImageExistsQuery.bindValue ( 0, filename );
-          checkImageExistsQuery.exec();
-          qDebug() << "Maybe add Instance";
-          if(!checkImageExistsQuery.next())
+          // rows already using this file name are left untouched,
+          // rows for the same instance were removed above
+          QSqlQuery& insertImageStatement = preparedQuery (
+            "INSERT OR IGNORE INTO Images ( 'SOPInstanceUID', 'Filename', 'SeriesInstanceUID', 'InsertTimestamp' ) VALUES ( ?, ?, ?, ? )" );
+          insertImageStatement.bindValue ( 0, sopInstanceUID );
+          insertImageStatement.bindValue ( 1, filename );
+          insertImageStatement.bindValue ( 2, seriesInstanceUID );
+          insertImageStatement.bindValue ( 3, QDateTime::currentDateTime() );
+          bool imageInserted = loggedExec(insertImageStatement)
+            && insertImageStatement.numRowsAffected() > 0;
+          insertImageStatement.finish();
+          if (imageInserted)
             {
-              QSqlQuery insertImageStatement ( Database );
-              insertImageStatement.prepare ( "INSERT INTO Images ( 'SOPInstanceUID', 'Filename', 'SeriesInstanceUID', 'InsertTimestamp' ) VALUES ( ?, ?, ?, ? )" );
-              insertImageStatement.bindValue ( 0, sopInstanceUID );
-              insertImageStatement.bindValue ( 1, filename );
-              insertImageStatement.bindValue ( 2, seriesInstanceUID );
-              insertImageStatement.bindValue ( 3, QDateTime::currentDateTime() );
-              insertImageStatement.exec();
-
               // insert was needed, so cache any application-requested tags
-              this->precacheTags(sopInstanceUID);
+              this->precacheTags(ctkDataset, sopInstanceUID, seriesInstanceUID, filename);
 
               // let users of this class track when things happen
               emit q->instanceAdded(sopInstanceUID);
@@ -1406,26 +2198,31 @@ void ctkDICOMDatabasePrivate::insert( const ctkDICOMItem& ctkDataset, const QStr
             }
         }
 
-      if( generateThumbnail && thumbnailGenerator && !seriesInstanceUID.isEmpty() )
+      if( generateThumbnail && thumbnailGenerator && !seriesInstanceUID.isEmpty()
+          && (this->PerInstanceThumbnailsEnabled || !this->ThumbnailSeries.contains(seriesInstanceUID)) )
         {
-          QString studySeriesDirectory = studyInstanceUID + "/" + seriesInstanceUID;
-          //Create thumbnail here
-          QString thumbnailPath = q->databaseDirectory() +
-              "/thumbs/" + studyInstanceUID + "/" + seriesInstanceUID
-              + "/" + sopInstanceUID + ".png";
+          // thumbnails are generated in the background, by default only
+          // for the first instance of each series
+          QString thumbnailInstanceUID =
+            this->PerInstanceThumbnailsEnabled ? sopInstanceUID : QString();
+          QString thumbnailPath =
+            q->thumbnailPath(studyInstanceUID, seriesInstanceUID, thumbnailInstanceUID);
           QFileInfo thumbnailInfo(thumbnailPath);
-          if( !(thumbnailInfo.exists()
-                && (thumbnailInfo.lastModified() > QFileInfo(filename).lastModified())))
+          // the series is requested again by the next instance if the queue is full
+          if( (thumbnailInfo.exists()
+               && (thumbnailInfo.lastModified() > QFileInfo(filename).lastModified()))
+              || this->ThumbnailQueue.addRequest(filename, thumbnailPath,
+                                                 seriesInstanceUID, thumbnailInstanceUID) )
             {
-              QDir(q->databaseDirectory() + "/thumbs/").mkpath(studySeriesDirectory);
-              DicomImage dcmImage(QDir::toNativeSeparators(filename).toLatin1());
-              thumbnailGenerator->generateThumbnail(&dcmImage, thumbnailPath);
+              this->ThumbnailSeries.insert(seriesInstanceUID);
             }
         }
 
-      if (q->isInMemory())
+      // file changes are reported by the file system watcher, except for
+      // the write-ahead log that is only merged at checkpoints
+      if (q->isInMemory() || this->WALModeEnabled)
         {
-          emit q->databaseChanged();
+          this->notifyDatabaseChanged();
         }
     }
   else
@@ -1440,8 +2237,8 @@ bool ctkDICOMDatabase::fileExistsAndUpToDate(const QString& filePath)
   Q_D(ctkDICOMDatabase);
   bool result(false);
 
-  QSqlQuery check_filename_query(database());
-  check_filename_query.prepare("SELECT InsertTimestamp FROM Images WHERE Filename == ?");
+  QSqlQuery& check_filename_query =
+    d->preparedQuery("SELECT InsertTimestamp FROM Images WHERE Filename == ?");
   check_filename_query.bindValue(0,filePath);
   d->loggedExec(check_filename_query);
   if (
@@ -1455,6 +2252,110 @@ bool ctkDICOMDatabase::fileExistsAndUpToDate(const QString& filePath)
   return result;
 }
 
+//------------------------------------------------------------------------------
+QHash<QString, QDateTime> ctkDICOMDatabase::insertDateTimesForDirectory(const QString& directoryName)
+{
+  Q_D(ctkDICOMDatabase);
+  QHash<QString, QDateTime> result;
+
+  // range on the file name index, '0' is the character following '/'
+  QDir directory(directoryName);
+  QStringList prefixes;
+  prefixes << directory.absolutePath();
+  if (!directory.canonicalPath().isEmpty() && !prefixes.contains(directory.canonicalPath()))
+    {
+    prefixes << directory.canonicalPath();
+    }
+  QStringList statements;
+  for (int i = 0; i < prefixes.count(); ++i)
+    {
+    statements << "SELECT Filename, InsertTimestamp FROM Images WHERE Filename >= ? AND Filename < ?";
+    }
+  // the relative file names can't be resolved here
+  statements << "SELECT Filename, InsertTimestamp FROM Images "
+                "WHERE Filename NOT LIKE '/%' AND Filename NOT LIKE '\\%' AND Filename NOT LIKE '_:%'";
+
+  QSqlQuery query(d->Database);
+  query.prepare(statements.join(" UNION "));
+  foreach(const QString& prefix, prefixes)
+    {
+    query.addBindValue(prefix + "/");
+    query.addBindValue(prefix + "0");
+    }
+  if (!d->loggedExec(query))
+    {
+    return result;
+    }
+  while (query.next())
+    {
+    result.insert(query.value(0).toString(),
+                  QDateTime::fromString(query.value(1).toString(), Qt::ISODate));
+    }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::removeFiles(const QStringList& fileNames)
+{
+  Q_D(ctkDICOMDatabase);
+  if (fileNames.isEmpty())
+    {
+    return true;
+    }
+
+  bool success = true;
+  QStringList thumbnailsToRemove;
+  this->beginTransaction();
+  foreach (const QString& fileName, fileNames)
+    {
+    QSqlQuery& selectImage = d->preparedQuery(
+      "SELECT Images.SOPInstanceUID, Images.SeriesInstanceUID, Series.StudyInstanceUID FROM Images "
+      "LEFT JOIN Series ON Series.SeriesInstanceUID = Images.SeriesInstanceUID WHERE Filename = ?");
+    selectImage.bindValue(0, fileName);
+    if (d->loggedExec(selectImage) && selectImage.next())
+      {
+      thumbnailsToRemove << this->thumbnailPath(selectImage.value(2).toString(),
+                                                selectImage.value(1).toString(),
+                                                selectImage.value(0).toString());
+      // the series thumbnail may show the removed file, it is
+      // generated again from the next instance inserted
+      QString seriesThumbnail = this->thumbnailPath(selectImage.value(2).toString(),
+                                                    selectImage.value(1).toString());
+      if (!thumbnailsToRemove.contains(seriesThumbnail))
+        {
+        thumbnailsToRemove << seriesThumbnail;
+        }
+      d->ThumbnailSeries.remove(selectImage.value(1).toString());
+      }
+    selectImage.finish();
+
+    QSqlQuery& deleteImage = d->preparedQuery("DELETE FROM Images WHERE Filename = ?");
+    deleteImage.bindValue(0, fileName);
+    if (!d->loggedExec(deleteImage))
+      {
+      success = false;
+      }
+    deleteImage.finish();
+    }
+  this->cleanup();
+  this->endTransaction();
+
+  foreach (const QString& thumbnail, thumbnailsToRemove)
+    {
+    if (QFile::exists(thumbnail) && !QFile::remove(thumbnail))
+      {
+      logger.warn("Failed to remove thumbnail " + thumbnail);
+      }
+    }
+
+  d->resetLastInsertedValues();
+  if (this->isInMemory() || d->WALModeEnabled)
+    {
+    d->notifyDatabaseChanged();
+    }
+  return success;
+}
+
 
 //------------------------------------------------------------------------------
 bool ctkDICOMDatabase::isOpen() const
@@ -1487,6 +2388,7 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID)
     }
 
   QList< QPair<QString,QString> > removeList;
+  QString seriesThumbnail;
   while ( fileExistsQuery.next() )
     {
       QString dbFilePath = fileExistsQuery.value(fileExistsQuery.record().indexOf("Filename")).toString();
@@ -1494,6 +2396,7 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID)
       QString studyInstanceUID = fileExistsQuery.value(fileExistsQuery.record().indexOf("StudyInstanceUID")).toString();
       QString internalFilePath = studyInstanceUID + "/" + seriesInstanceUID + "/" + sopInstanceUID;
       removeList << qMakePair(dbFilePath,internalFilePath);
+      seriesThumbnail = this->thumbnailPath(studyInstanceUID, seriesInstanceUID);
     }
 
   QSqlQuery fileRemove ( d->Database );
@@ -1540,6 +2443,12 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID)
         }
     }
 
+  if (!seriesThumbnail.isEmpty() && QFile::exists(seriesThumbnail))
+    {
+      QFile::remove(seriesThumbnail);
+    }
+  d->ThumbnailSeries.remove(seriesInstanceUID);
+
   this->cleanup();
 
   d->resetLastInsertedValues();
@@ -1552,8 +2461,16 @@ bool ctkDICOMDatabase::cleanup()
 {
   Q_D(ctkDICOMDatabase);
   QSqlQuery seriesCleanup ( d->Database );
+  // the search index rows are removed first, they are found through
+  // the rows about to be removed
+  d->removeSearchRows("Series",
+    "SELECT SeriesInstanceUID FROM Series WHERE ( SELECT COUNT(*) FROM Images WHERE Images.SeriesInstanceUID = Series.SeriesInstanceUID ) = 0");
   seriesCleanup.exec("DELETE FROM Series WHERE ( SELECT COUNT(*) FROM Images WHERE Images.SeriesInstanceUID = Series.SeriesInstanceUID ) = 0;");
+  d->removeSearchRows("Studies",
+    "SELECT StudyInstanceUID FROM Studies WHERE ( SELECT COUNT(*) FROM Series WHERE Series.StudyInstanceUID = Studies.StudyInstanceUID ) = 0");
   seriesCleanup.exec("DELETE FROM Studies WHERE ( SELECT COUNT(*) FROM Series WHERE Series.StudyInstanceUID = Studies.StudyInstanceUID ) = 0;");
+  d->removeSearchRows("Patients",
+    "SELECT UID FROM Patients WHERE ( SELECT COUNT(*) FROM Studies WHERE Studies.PatientsUID = Patients.UID ) = 0");
   seriesCleanup.exec("DELETE FROM Patients WHERE ( SELECT COUNT(*) FROM Studies WHERE Studies.PatientsUID = Patients.UID ) = 0;");
   return true;
 }
@@ -1645,9 +2562,10 @@ bool ctkDICOMDatabase::tagCacheExists()
 
     }
 
-  // check that the table exists
+  // check that the table exists and has the series column, caches
+  // created by older versions are rebuilt by initializeTagCache()
   QSqlQuery cacheExists( d->TagCacheDatabase );
-  cacheExists.prepare("SELECT * FROM TagCache LIMIT 1");
+  cacheExists.prepare("SELECT SeriesInstanceUID FROM TagCache LIMIT 1");
   bool success = d->loggedExec(cacheExists);
   if (success)
     {
@@ -1663,33 +2581,64 @@ bool ctkDICOMDatabase::initializeTagCache()
 {
   Q_D(ctkDICOMDatabase);
 
-  // First, drop any existing table
-  if ( this->tagCacheExists() )
+  // First, drop any existing table. tagCacheExists() opens the
+  // database, the table may still exist with an outdated schema.
+  this->tagCacheExists();
+  if ( !d->TagCacheDatabase.isOpen() )
     {
-    qDebug() << "TagCacheDatabase drop existing table\n";
-    QSqlQuery dropCacheTable( d->TagCacheDatabase );
-    dropCacheTable.prepare( "DROP TABLE TagCache" );
-    d->loggedExec(dropCacheTable);
+    return false;
     }
+  qDebug() << "TagCacheDatabase drop existing table\n";
+  QSqlQuery dropCacheTable( d->TagCacheDatabase );
+  dropCacheTable.prepare( "DROP TABLE IF EXISTS TagCache" );
+  d->loggedExec(dropCacheTable);
+  d->TagCacheVerified = false;
+  d->CachedTagValues.clear();
 
   // now create a table
   qDebug() << "TagCacheDatabase adding table\n";
   QSqlQuery createCacheTable( d->TagCacheDatabase );
   createCacheTable.prepare(
-    "CREATE TABLE TagCache (SOPInstanceUID, Tag, Value, PRIMARY KEY (SOPInstanceUID, Tag))" );
+    "CREATE TABLE TagCache (SOPInstanceUID, SeriesInstanceUID, Tag, Value, PRIMARY KEY (SOPInstanceUID, Tag))" );
   bool success = d->loggedExec(createCacheTable);
   if (success)
     {
+    QSqlQuery createSeriesIndex( d->TagCacheDatabase );
+    createSeriesIndex.prepare(
+      "CREATE INDEX TagCacheSeriesIndex ON TagCache (SeriesInstanceUID, Tag)" );
+    d->loggedExec(createSeriesIndex);
     d->TagCacheVerified = true;
     return true;
     }
   return false;
 }
 
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabasePrivate::cachedTagKey(const QString& sopInstanceUID, const QString& tag)
+{
+  return sopInstanceUID + "|" + tag;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabasePrivate::cachedTagValue(const QString& storedValue)
+{
+  if (storedValue == QString(""))
+    {
+    return ValueIsEmptyString;
+    }
+  return storedValue;
+}
+
 //------------------------------------------------------------------------------
 QString ctkDICOMDatabase::cachedTag(const QString sopInstanceUID, const QString tag)
 {
   Q_D(ctkDICOMDatabase);
+  QString key = d->cachedTagKey(sopInstanceUID, tag);
+  QString* cachedValue = d->CachedTagValues.object(key);
+  if (cachedValue)
+    {
+    return *cachedValue;
+    }
   if ( !this->tagCacheExists() )
     {
     if ( !this->initializeTagCache() )
@@ -1705,13 +2654,156 @@ QString ctkDICOMDatabase::cachedTag(const QString sopInstanceUID, const QString
   QString result("");
   if (selectValue.next())
     {
-    result = selectValue.value(0).toString();
-    if (result == QString(""))
+    result = d->cachedTagValue(selectValue.value(0).toString());
+    d->CachedTagValues.insert(key, new QString(result));
+    }
+  return( result );
+}
+
+//------------------------------------------------------------------------------
+QList<QStringList> ctkDICOMDatabase::cachedTags(const QStringList& sopInstanceUIDs, const QStringList& tags)
+{
+  Q_D(ctkDICOMDatabase);
+
+  QList<QStringList> result;
+  QHash<QString, int> rowIndices;
+  QSet<QString> missingUIDs;
+  QHash<QString, int> tagIndices;
+  for (int column = 0; column < tags.count(); ++column)
+    {
+    tagIndices[tags[column]] = column;
+    }
+  for (int row = 0; row < sopInstanceUIDs.count(); ++row)
+    {
+    const QString& sopInstanceUID = sopInstanceUIDs[row];
+    QStringList values;
+    foreach (const QString& tag, tags)
       {
-      result = ValueIsEmptyString;
+      QString* cachedValue = d->CachedTagValues.object(d->cachedTagKey(sopInstanceUID, tag));
+      if (cachedValue)
+        {
+        values << *cachedValue;
+        }
+      else
+        {
+        values << QString("");
+        missingUIDs.insert(sopInstanceUID);
+        }
       }
+    result << values;
+    rowIndices.insertMulti(sopInstanceUID, row);
     }
-  return( result );
+
+  if (missingUIDs.isEmpty() || tags.isEmpty())
+    {
+    return result;
+    }
+  if ( !this->tagCacheExists() )
+    {
+    if ( !this->initializeTagCache() )
+      {
+      return result;
+      }
+    }
+
+  // values are inlined because the number of bound parameters is
+  // limited, quotes are escaped the same way as in the table views
+  QStringList quotedTags;
+  foreach (const QString& tag, tags)
+    {
+    quotedTags << "'" + QString(tag).replace("'", "''") + "'";
+    }
+  const int uidsPerQuery = 500;
+  QStringList uids = missingUIDs.toList();
+  for (int first = 0; first < uids.count(); first += uidsPerQuery)
+    {
+    QStringList quotedUIDs;
+    foreach (const QString& sopInstanceUID, uids.mid(first, uidsPerQuery))
+      {
+      quotedUIDs << "'" + QString(sopInstanceUID).replace("'", "''") + "'";
+      }
+    QSqlQuery selectValues( d->TagCacheDatabase );
+    selectValues.prepare( QString(
+      "SELECT SOPInstanceUID, Tag, Value FROM TagCache WHERE SOPInstanceUID IN (%1) AND Tag IN (%2)")
+      .arg(quotedUIDs.join(",")).arg(quotedTags.join(",")) );
+    if (!d->loggedExec(selectValues))
+      {
+      continue;
+      }
+    while (selectValues.next())
+      {
+      QString sopInstanceUID = selectValues.value(0).toString();
+      QString tag = selectValues.value(1).toString();
+      QString value = d->cachedTagValue(selectValues.value(2).toString());
+      d->CachedTagValues.insert(d->cachedTagKey(sopInstanceUID, tag), new QString(value));
+      int column = tagIndices.value(tag, -1);
+      if (column < 0)
+        {
+        continue;
+        }
+      foreach (int row, rowIndices.values(sopInstanceUID))
+        {
+        result[row][column] = value;
+        }
+      }
+    }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+QMap<QString, QStringList> ctkDICOMDatabase::cachedTagsForSeries(const QString& seriesInstanceUID, const QStringList& tags)
+{
+  Q_D(ctkDICOMDatabase);
+
+  QMap<QString, QStringList> result;
+  if (tags.isEmpty())
+    {
+    return result;
+    }
+  if ( !this->tagCacheExists() )
+    {
+    if ( !this->initializeTagCache() )
+      {
+      return result;
+      }
+    }
+
+  QHash<QString, int> tagIndices;
+  QStringList quotedTags;
+  for (int column = 0; column < tags.count(); ++column)
+    {
+    tagIndices[tags[column]] = column;
+    quotedTags << "'" + QString(tags[column]).replace("'", "''") + "'";
+    }
+  QStringList emptyValues;
+  for (int column = 0; column < tags.count(); ++column)
+    {
+    emptyValues << QString("");
+    }
+
+  QSqlQuery selectValues( d->TagCacheDatabase );
+  selectValues.prepare( QString(
+    "SELECT SOPInstanceUID, Tag, Value FROM TagCache WHERE SeriesInstanceUID = ? AND Tag IN (%1)")
+    .arg(quotedTags.join(",")) );
+  selectValues.addBindValue(seriesInstanceUID);
+  if (!d->loggedExec(selectValues))
+    {
+    return result;
+    }
+  while (selectValues.next())
+    {
+    QString sopInstanceUID = selectValues.value(0).toString();
+    QString tag = selectValues.value(1).toString();
+    QString value = d->cachedTagValue(selectValues.value(2).toString());
+    d->CachedTagValues.insert(d->cachedTagKey(sopInstanceUID, tag), new QString(value));
+    QMap<QString, QStringList>::iterator it = result.find(sopInstanceUID);
+    if (it == result.end())
+      {
+      it = result.insert(sopInstanceUID, emptyValues);
+      }
+    (*it)[tagIndices.value(tag)] = value;
+    }
+  return result;
 }
 
 //------------------------------------------------------------------------------
@@ -1728,9 +2820,18 @@ bool ctkDICOMDatabase::cacheTag(const QString sopInstanceUID, const QString tag,
 bool ctkDICOMDatabase::cacheTags(const QStringList sopInstanceUIDs, const QStringList tags, QStringList values)
 {
   Q_D(ctkDICOMDatabase);
-  if ( !this->tagCacheExists() )
+  return d->cacheTags(sopInstanceUIDs, QStringList(), tags, values);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::cacheTags( const QStringList& sopInstanceUIDs,
+                                         const QStringList& seriesInstanceUIDs,
+                                         const QStringList& tags, QStringList values )
+{
+  Q_Q(ctkDICOMDatabase);
+  if ( !q->tagCacheExists() )
     {
-    if ( !this->initializeTagCache() )
+    if ( !q->initializeTagCache() )
       {
       return false;
       }
@@ -1746,10 +2847,168 @@ bool ctkDICOMDatabase::cacheTags(const QStringList sopInstanceUIDs, const QStrin
       }
     }
 
-  QSqlQuery insertTags( d->TagCacheDatabase );
-  insertTags.prepare( "INSERT OR REPLACE INTO TagCache VALUES(?,?,?)" );
+  // a null series is stored as NULL, such rows are only
+  // found by instance. A null series keeps the series already
+  // cached for the instance, if any.
+  QVariantList series;
+  for (int index = 0; index < sopInstanceUIDs.count(); ++index)
+    {
+    series << (index < seriesInstanceUIDs.count() ?
+               QVariant(seriesInstanceUIDs[index]) : QVariant(QVariant::String));
+    }
+
+  QSqlQuery insertTags( this->TagCacheDatabase );
+  // not ON CONFLICT DO UPDATE, it needs SQLite 3.24
+  insertTags.prepare( "INSERT OR REPLACE INTO TagCache (SOPInstanceUID, SeriesInstanceUID, Tag, Value) "
+                      "VALUES(?, COALESCE(?, (SELECT SeriesInstanceUID FROM TagCache "
+                      "WHERE SOPInstanceUID = ? AND SeriesInstanceUID IS NOT NULL LIMIT 1)), ?, ?)" );
+  insertTags.addBindValue(sopInstanceUIDs);
+  insertTags.addBindValue(series);
   insertTags.addBindValue(sopInstanceUIDs);
   insertTags.addBindValue(tags);
   insertTags.addBindValue(values);
-  return d->loggedExecBatch(insertTags);
+  bool success = this->loggedExecBatch(insertTags);
+  if (success)
+    {
+    for (int index = 0; index < sopInstanceUIDs.count() && index < tags.count(); ++index)
+      {
+      this->CachedTagValues.insert(this->cachedTagKey(sopInstanceUIDs[index], tags[index]),
+                                   new QString(this->cachedTagValue(values[index])));
+      }
+    }
+  return success;
+}
+
+///
+/// Code related to the search index
+///
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabase::searchIndexFields(const QString& table)
+{
+  QStringList fields;
+  for (int i = 0; i < NumberOfSearchIndexFields; ++i)
+    {
+    if (table.isEmpty() || table == SearchIndexFields[i].Table)
+      {
+      fields << SearchIndexFields[i].Field;
+      }
+    }
+  return fields;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::hasSearchIndex(const QSqlDatabase& database)
+{
+  QStringList tables = database.tables();
+  if (!tables.contains("SearchIndex") || !tables.contains("SearchIndexedFields"))
+    {
+    return false;
+    }
+  QSqlQuery fieldsQuery(database);
+  if (!fieldsQuery.exec("SELECT Field FROM SearchIndexedFields"))
+    {
+    return false;
+    }
+  QSet<QString> indexedFields;
+  while (fieldsQuery.next())
+    {
+    indexedFields.insert(fieldsQuery.value(0).toString());
+    }
+  return indexedFields == searchIndexFields().toSet();
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabase::searchCondition(const QString& field, const QString& text,
+                                          bool useSearchIndex)
+{
+  const SearchIndexField* indexField = searchIndexField(field);
+  if (!indexField)
+    {
+    logger.warn("No search condition for unknown field " + field);
+    return QString();
+    }
+  QString condition = QString("%1.%2 LIKE %3")
+    .arg(indexField->Table).arg(field).arg(sqlStringLiteral("%" + text + "%"));
+  // wildcards cannot be looked up in the index
+  if (!useSearchIndex || text.isEmpty() || text.contains('%') || text.contains('_'))
+    {
+    return condition;
+    }
+
+  // the index gives candidates, LIKE still decides: all the trigrams
+  // of the text may be found in a value that does not contain it
+  QString lowerText = text.toLower();
+  QString candidates;
+  if (lowerText.length() < 3)
+    {
+    // short texts are the prefix of an indexed trigram
+    QString upperBound = lowerText;
+    upperBound[upperBound.length() - 1] = QChar(upperBound.at(upperBound.length() - 1).unicode() + 1);
+    candidates = QString("SELECT UID FROM SearchIndex WHERE Field = '%1' AND Trigram >= %2 AND Trigram < %3")
+      .arg(field).arg(sqlStringLiteral(lowerText)).arg(sqlStringLiteral(upperBound));
+    }
+  else
+    {
+    QStringList trigrams;
+    for (int i = 0; i + 3 <= lowerText.length(); ++i)
+      {
+      trigrams << sqlStringLiteral(lowerText.mid(i, 3));
+      }
+    trigrams.removeDuplicates();
+    candidates = QString("SELECT UID FROM SearchIndex WHERE Field = '%1' AND Trigram IN (%2) "
+                         "GROUP BY UID HAVING COUNT(*) = %3")
+      .arg(field).arg(trigrams.join(", ")).arg(trigrams.count());
+    }
+  return QString("( %1.%2 IN ( %3 ) AND %4 )")
+    .arg(indexField->Table).arg(indexField->UIDColumn).arg(candidates).arg(condition);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::rebuildSearchIndex()
+{
+  Q_D(ctkDICOMDatabase);
+  if (!d->Database.isOpen())
+    {
+    return false;
+    }
+
+  // the index is created in the transaction that fills it, the read-only
+  // connections do not see it before it is complete
+  d->beginTransaction();
+  if (!d->createSearchIndex())
+    {
+    d->endTransaction();
+    return false;
+    }
+  bool success = true;
+  for (int i = 0; i < NumberOfSearchIndexFields; ++i)
+    {
+    const SearchIndexField& indexField = SearchIndexFields[i];
+    QSqlQuery valuesQuery(d->Database);
+    if (!d->loggedExec(valuesQuery, QString("SELECT %1, %2 FROM %3")
+                       .arg(indexField.UIDColumn).arg(indexField.Field).arg(indexField.Table)))
+      {
+      success = false;
+      continue;
+      }
+    while (valuesQuery.next())
+      {
+      d->indexSearchValue(indexField.Field, valuesQuery.value(0).toString(),
+                          valuesQuery.value(1).toString());
+      }
+    }
+  d->endTransaction();
+  return success;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::updateSearchIndex()
+{
+  Q_D(ctkDICOMDatabase);
+  if (d->SearchIndexExists)
+    {
+    return true;
+    }
+  return this->rebuildSearchIndex();
 }
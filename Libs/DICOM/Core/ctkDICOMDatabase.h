@@ -22,7 +22,9 @@
 #define __ctkDICOMDatabase_h
 
 // Qt includes
+#include <QMap>
 #include <QObject>
+#include <QSharedPointer>
 #include <QStringList>
 #include <QSqlDatabase>
 
@@ -33,6 +35,7 @@ class QDateTime;
 class ctkDICOMDatabasePrivate;
 class DcmDataset;
 class ctkDICOMAbstractThumbnailGenerator;
+class ctkDICOMThumbnailQueue;
 
 /// \ingroup DICOM_Core
 ///
@@ -57,13 +60,77 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMDatabase : public QObject
   Q_PROPERTY(QString lastError READ lastError)
   Q_PROPERTY(QString databaseFilename READ databaseFilename)
   Q_PROPERTY(QStringList tagsToPrecache READ tagsToPrecache WRITE setTagsToPrecache)
+  Q_PROPERTY(bool walModeEnabled READ isWALModeEnabled WRITE setWALModeEnabled)
+  Q_PROPERTY(int cacheSize READ cacheSize WRITE setCacheSize)
+  Q_PROPERTY(qint64 mmapSize READ mmapSize WRITE setMmapSize)
+  Q_PROPERTY(bool hardLinksEnabled READ areHardLinksEnabled WRITE setHardLinksEnabled)
+  Q_PROPERTY(bool perInstanceThumbnailsEnabled READ arePerInstanceThumbnailsEnabled WRITE setPerInstanceThumbnailsEnabled)
 
 public:
+  /// \brief A dataset that has been parsed from a file but not yet inserted.
+  ///
+  /// Used by ctkDICOMIndexer to hand over datasets parsed on worker threads
+  /// to the thread that owns the database connection.
+  struct IndexingResult
+  {
+    QString filePath;
+    QSharedPointer<ctkDICOMItem> dataset;
+    bool storeFile;
+    bool generateThumbnail;
+  };
+
   explicit ctkDICOMDatabase(QObject *parent = 0);
   explicit ctkDICOMDatabase(QString databaseFile);
   virtual ~ctkDICOMDatabase();
 
   const QSqlDatabase& database() const;
+
+  ///
+  /// Returns a read-only connection to the database for the calling thread.
+  /// Connections are created on first use and removed when their thread
+  /// finishes. After closeDatabase() or openDatabase(), each thread gets a
+  /// new connection on its next call; the connection of the calling thread
+  /// is removed right away.
+  /// Returns an invalid connection if it can't be opened, the next call
+  /// tries again.
+  /// When WAL journaling is enabled, queries run on these connections are
+  /// not blocked by inserts running on the main connection.
+  /// Falls back to the main connection for in-memory databases, and on the
+  /// thread of this object when WAL journaling is disabled.
+  QSqlDatabase readOnlyDatabase() const;
+
+  ///
+  /// Enable the write-ahead log journal (PRAGMA journal_mode = WAL), so
+  /// that readers and the writer do not block each other.
+  /// The journal mode is persistent in the database file, so leaving this
+  /// disabled (the default) keeps the mode the file already has. Ignored for
+  /// in-memory databases.
+  void setWALModeEnabled(bool enabled);
+  bool isWALModeEnabled() const;
+
+  ///
+  /// SQLite page cache size of each connection, as PRAGMA cache_size:
+  /// positive values are a number of pages, negative values a size in KiB.
+  /// 0 (default) keeps the SQLite default.
+  void setCacheSize(int cacheSize);
+  int cacheSize() const;
+
+  ///
+  /// Maximum number of bytes of the database file accessed through
+  /// memory-mapped I/O by each connection (PRAGMA mmap_size).
+  /// 0 (default) keeps memory-mapped I/O disabled.
+  void setMmapSize(qint64 mmapSize);
+  qint64 mmapSize() const;
+
+  ///
+  /// Files inserted with storeFile set are copied into the database
+  /// directory. Where the file system supports it, the copy is a
+  /// copy-on-write clone of the source that does not duplicate the data.
+  /// If enabled, a hard link to the source is created otherwise, when both
+  /// are on the same file system. Later modifications of the source file are
+  /// then visible in the database directory. Disabled by default.
+  void setHardLinksEnabled(bool enabled);
+  bool areHardLinksEnabled() const;
   const QString lastError() const;
   const QString databaseFilename() const;
 
@@ -92,6 +159,24 @@ public:
   /// get thumbnail genrator object
   ctkDICOMAbstractThumbnailGenerator* thumbnailGenerator();
 
+  ///
+  /// Thumbnails of inserted instances are generated in the background by
+  /// this queue, with the thumbnail generator. thumbnailReady() is emitted
+  /// by the queue as they are written.
+  ctkDICOMThumbnailQueue* thumbnailQueue() const;
+
+  ///
+  /// By default a single thumbnail is generated per series, from its first
+  /// inserted instance. If enabled, a thumbnail is generated for each instance.
+  void setPerInstanceThumbnailsEnabled(bool enabled);
+  bool arePerInstanceThumbnailsEnabled() const;
+
+  ///
+  /// Path of the thumbnail of an instance, or of the series thumbnail if
+  /// \a sopInstanceUID is empty
+  QString thumbnailPath(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+                        const QString& sopInstanceUID = QString()) const;
+
   ///
   /// open the SQLite database in @param databaseFile . If the file does not
   /// exist, a new database is created and initialized with the
@@ -189,10 +274,31 @@ public:
                             bool storeFile = true, bool generateThumbnail = true,
                             bool createHierarchy = true,
                             const QString& destinationDirectoryName = QString() );
+  /// Insert a list of already parsed files. All the rows are written within
+  /// a single transaction. Datasets that could not be parsed are skipped.
+  /// Must be called from the thread that opened the database.
+  void insert ( const QList<IndexingResult>& indexingResults );
+
+  ///
+  /// \brief group several inserts into a single transaction
+  /// Calls can be nested, only the outermost pair is sent to the database.
+  void beginTransaction();
+  void endTransaction();
 
   /// Check if file is already in database and up-to-date
   bool fileExistsAndUpToDate(const QString& filePath);
 
+  /// Return the insert time of the files indexed below \a directoryName,
+  /// keyed by the file name as stored. The files stored with a relative
+  /// name are all returned, the caller has to resolve them.
+  QHash<QString, QDateTime> insertDateTimesForDirectory(const QString& directoryName);
+
+  /// remove the images referencing \a fileNames from the database, as well
+  /// as their thumbnails and the thumbnails of their series, which are
+  /// generated again. The files themselves are left untouched, series,
+  /// studies and patients left without images are removed.
+  Q_INVOKABLE bool removeFiles(const QStringList& fileNames);
+
   /// remove the series from the database, including images and
   /// thumbnails
   Q_INVOKABLE bool removeSeries(const QString& seriesInstanceUID);
@@ -232,11 +338,44 @@ public:
   Q_INVOKABLE bool initializeTagCache ();
   /// Return the value of a cached tag
   Q_INVOKABLE QString cachedTag (const QString sopInstanceUID, const QString tag);
+  /// Return the cached values of several tags for several instances in a single query.
+  /// Row i of the result holds the values of \a tags for sopInstanceUIDs[i], in the
+  /// same order as \a tags, following the conventions of cachedTag().
+  Q_INVOKABLE QList<QStringList> cachedTags (const QStringList& sopInstanceUIDs, const QStringList& tags);
+  /// Return the cached values of \a tags for all the instances of a series, keyed by
+  /// SOPInstanceUID. Only the values of instances which had tags precached while
+  /// inserting them in the database know their series; values cached afterwards
+  /// through cacheTag() or cacheTags() keep that series.
+  Q_INVOKABLE QMap<QString, QStringList> cachedTagsForSeries (const QString& seriesInstanceUID, const QStringList& tags);
   /// Insert an instance tag's value into to the cache
   Q_INVOKABLE bool cacheTag (const QString sopInstanceUID, const QString tag, const QString value);
   /// Insert lists of tags into the cache as a batch query operation
   Q_INVOKABLE bool cacheTags (const QStringList sopInstanceUIDs, const QStringList tags, const QStringList values);
 
+  ///
+  /// \brief trigram index of the fields the browsers search on
+  /// All the columns of the Patients, Studies and Series tables but the
+  /// UIDs are indexed by the insert path so that substring searches do not
+  /// scan the tables. Databases without an up to date index are indexed by
+  /// updateSearchIndex() once the event loop runs after openDatabase().
+  ///
+  /// Return the fields of the search index, only those of \a table if not empty
+  static QStringList searchIndexFields(const QString& table = QString());
+  /// Return true if \a database has a search index of all the searchIndexFields()
+  static bool hasSearchIndex(const QSqlDatabase& database);
+  /// Return an SQL condition selecting the rows whose \a field contains
+  /// \a text, with the semantics of LIKE '%text%'. The column names are
+  /// qualified by their table name so that the condition can be used in
+  /// joins. The search index is only used if \a useSearchIndex is true.
+  static QString searchCondition(const QString& field, const QString& text,
+                                 bool useSearchIndex = true);
+  /// Fill the search index from the Patients, Studies and Series tables,
+  /// it is only needed for databases created before the index existed.
+  Q_INVOKABLE bool rebuildSearchIndex();
+  /// Rebuild the search index if the database has none or one of other
+  /// fields. Return true if the index is up to date.
+  Q_INVOKABLE bool updateSearchIndex();
+
 
 Q_SIGNALS:
   /// Things inserted to database.
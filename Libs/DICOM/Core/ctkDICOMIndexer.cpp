@@ -24,12 +24,16 @@
 #include <QSqlError>
 #include <QVariant>
 #include <QDate>
+#include <QDateTime>
 #include <QStringList>
 #include <QSet>
+#include <QHash>
 #include <QFile>
+#include <QDir>
 #include <QDirIterator>
 #include <QFileInfo>
 #include <QDebug>
+#include <QMutexLocker>
 #include <QPixmap>
 
 // ctkDICOM includes
@@ -55,6 +59,42 @@
 static ctkLogger logger("org.commontk.dicom.DICOMIndexer" );
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// Canonical path of filePath, resolved against baseDirectory if relative.
+// Files that no longer exist have no canonical path, their path is cleaned up.
+static QString normalizedFilePath(const QDir& baseDirectory, const QString& filePath)
+{
+  QFileInfo fileInfo(baseDirectory, filePath);
+  QString canonicalFilePath = fileInfo.canonicalFilePath();
+  return canonicalFilePath.isEmpty() ? QDir::cleanPath(fileInfo.absoluteFilePath()) : canonicalFilePath;
+}
+
+
+//------------------------------------------------------------------------------
+// ctkDICOMIndexerParseTask methods
+
+//------------------------------------------------------------------------------
+ctkDICOMIndexerParseTask::ctkDICOMIndexerParseTask(ctkDICOMIndexerPrivate* indexer,
+                                                   const QString& filePath,
+                                                   bool storeFile)
+  : Indexer(indexer), FilePath(filePath), StoreFile(storeFile)
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerParseTask::run()
+{
+  ctkDICOMDatabase::IndexingResult indexingResult;
+  indexingResult.filePath = this->FilePath;
+  indexingResult.storeFile = this->StoreFile;
+  indexingResult.generateThumbnail = true;
+  if (!this->Indexer->isCanceled())
+    {
+    indexingResult.dataset = QSharedPointer<ctkDICOMItem>(new ctkDICOMItem);
+    indexingResult.dataset->InitializeFromFileHeader(this->FilePath);
+    }
+  this->Indexer->pushParsedFile(indexingResult);
+}
 
 //------------------------------------------------------------------------------
 // ctkDICOMIndexerPrivate methods
@@ -62,14 +102,389 @@ static ctkLogger logger("org.commontk.dicom.DICOMIndexer" );
 //------------------------------------------------------------------------------
 ctkDICOMIndexerPrivate::ctkDICOMIndexerPrivate(ctkDICOMIndexer& o) : q_ptr(&o), Canceled(false)
 {
+  this->BatchSize = 500;
+  this->BackgroundImportEnabled = false;
+  this->ImportInProgress = false;
+  this->FilesToIndex = 0;
+  this->FilesIndexed = 0;
+  this->PendingParseTasks = 0;
+  this->WriteScheduled = false;
+
+  this->DirectoryWatcher = new QFileSystemWatcher(this);
+  connect(this->DirectoryWatcher, SIGNAL(directoryChanged(QString)),
+          this, SLOT(onWatchedDirectoryChanged(QString)));
+  this->WatchTimer.setSingleShot(true);
+  this->WatchTimer.setInterval(1000);
+  connect(&this->WatchTimer, SIGNAL(timeout()), this, SLOT(onWatchTimeout()));
 }
 
 //------------------------------------------------------------------------------
 ctkDICOMIndexerPrivate::~ctkDICOMIndexerPrivate()
 {
+  // the parse tasks reference this object, make sure they are all done
+  {
+  QMutexLocker locker(&this->QueueMutex);
+  this->Canceled = true;
+  this->QueueNotFull.wakeAll();
+  }
+  this->ParserPool.waitForDone();
 }
 
 //------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::startParsing(ctkDICOMDatabase& database,
+                                          const QStringList& listOfFiles,
+                                          bool storeFile,
+                                          bool skipUpToDateFiles)
+{
+  if (this->Database && this->Database != &database)
+    {
+    // flush what is left for the previous database first
+    this->writeParsedFiles(true);
+    }
+  this->Database = &database;
+
+  if (!this->ImportInProgress)
+    {
+    this->ImportInProgress = true;
+    this->FilesToIndex = 0;
+    this->FilesIndexed = 0;
+    }
+
+  // the up-to-date check needs the database connection,
+  // so it is done here rather than in the parse tasks
+  QStringList filesToParse;
+  foreach(const QString& filePath, listOfFiles)
+    {
+    if (skipUpToDateFiles && database.fileExistsAndUpToDate(filePath))
+      {
+      logger.debug( "File " + filePath + " already added.");
+      continue;
+      }
+    filesToParse << filePath;
+    }
+  this->FilesToIndex += listOfFiles.count();
+  this->FilesIndexed += listOfFiles.count() - filesToParse.count();
+
+  {
+  QMutexLocker locker(&this->QueueMutex);
+  this->PendingParseTasks += filesToParse.count();
+  }
+  foreach(const QString& filePath, filesToParse)
+    {
+    this->ParserPool.start(new ctkDICOMIndexerParseTask(this, filePath, storeFile));
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::pushParsedFile(const ctkDICOMDatabase::IndexingResult& indexingResult)
+{
+  QMutexLocker locker(&this->QueueMutex);
+  // bound the memory used by parsed datasets waiting for the writer
+  while (!this->Canceled && this->ParsedFiles.count() >= 2 * this->BatchSize)
+    {
+    this->QueueNotFull.wait(&this->QueueMutex);
+    }
+  if (!this->Canceled)
+    {
+    this->ParsedFiles.append(indexingResult);
+    }
+  --this->PendingParseTasks;
+  this->QueueChanged.wakeAll();
+
+  if (this->BackgroundImportEnabled && !this->WriteScheduled)
+    {
+    this->WriteScheduled = true;
+    QMetaObject::invokeMethod(this, "onParsedFilesAvailable", Qt::QueuedConnection);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMIndexerPrivate::isCanceled()
+{
+  QMutexLocker locker(&this->QueueMutex);
+  return this->Canceled;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::onParsedFilesAvailable()
+{
+  {
+  QMutexLocker locker(&this->QueueMutex);
+  this->WriteScheduled = false;
+  }
+  this->writeParsedFiles(false);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::writeParsedFiles(bool waitForCompletion)
+{
+  Q_Q(ctkDICOMIndexer);
+
+  if (!this->ImportInProgress)
+    {
+    return;
+    }
+
+  bool finished = false;
+  while (!finished)
+    {
+    QList<ctkDICOMDatabase::IndexingResult> batch;
+    bool canceled;
+    {
+    QMutexLocker locker(&this->QueueMutex);
+    while (waitForCompletion && !this->Canceled && this->PendingParseTasks > 0
+           && this->ParsedFiles.count() < this->BatchSize)
+      {
+      this->QueueChanged.wait(&this->QueueMutex);
+      }
+    canceled = this->Canceled;
+    if (canceled)
+      {
+      this->ParsedFiles.clear();
+      }
+    else if (this->PendingParseTasks == 0 || this->ParsedFiles.count() >= this->BatchSize)
+      {
+      batch = this->ParsedFiles.mid(0, this->BatchSize);
+      this->ParsedFiles.erase(this->ParsedFiles.begin(),
+                              this->ParsedFiles.begin() + batch.count());
+      this->QueueNotFull.wakeAll();
+      }
+    finished = (this->PendingParseTasks == 0 && this->ParsedFiles.isEmpty());
+    }
+
+    if (canceled)
+      {
+      // remaining tasks return without parsing once they see the flag
+      this->ParserPool.waitForDone();
+      QMutexLocker locker(&this->QueueMutex);
+      this->ParsedFiles.clear();
+      finished = true;
+      }
+    else if (!batch.isEmpty())
+      {
+      emit q->indexingFilePath(batch.last().filePath);
+      if (this->Database)
+        {
+        this->Database->insert(batch);
+        }
+      this->FilesIndexed += batch.count();
+      emit q->indexingFileNumber(this->FilesIndexed);
+      emit q->progress( ( 100 * this->FilesIndexed ) / this->FilesToIndex );
+      }
+    else if (!finished && !waitForCompletion)
+      {
+      // not enough parsed files for a full batch yet
+      return;
+      }
+    }
+
+  this->ImportInProgress = false;
+  emit q->indexingComplete();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::importFiles(ctkDICOMDatabase& database,
+                                         const QStringList& listOfFiles,
+                                         bool storeFile,
+                                         bool skipUpToDateFiles)
+{
+  Q_Q(ctkDICOMIndexer);
+
+  bool backgroundImport;
+  {
+  QMutexLocker locker(&this->QueueMutex);
+  this->Canceled = false;
+  backgroundImport = this->BackgroundImportEnabled;
+  }
+  emit q->progress(0);
+  this->startParsing(database, listOfFiles, storeFile, skipUpToDateFiles);
+
+  if (backgroundImport)
+    {
+    // make sure indexingComplete is emitted even if there is nothing to parse
+    QMutexLocker locker(&this->QueueMutex);
+    if (!this->WriteScheduled)
+      {
+      this->WriteScheduled = true;
+      QMetaObject::invokeMethod(this, "onParsedFilesAvailable", Qt::QueuedConnection);
+      }
+    }
+  else
+    {
+    this->writeParsedFiles(true);
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::addWatchedDirectory(const QString& directoryName,
+                                                 const QString& rootDirectory,
+                                                 QStringList& existingFiles)
+{
+  if (this->WatchedDirectoryRoots.contains(directoryName))
+    {
+    return;
+    }
+  this->WatchedDirectoryRoots[directoryName] = rootDirectory;
+  // watch before listing so that no file can be missed
+  this->DirectoryWatcher->addPath(directoryName);
+
+  QHash<QString, QDateTime>& files = this->WatchedFiles[directoryName];
+  QDir directory(directoryName);
+  foreach(const QFileInfo& fileInfo,
+          directory.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+    if (fileInfo.isDir())
+      {
+      this->addWatchedDirectory(fileInfo.absoluteFilePath(), rootDirectory, existingFiles);
+      }
+    else
+      {
+      files[fileInfo.fileName()] = fileInfo.lastModified();
+      existingFiles << fileInfo.absoluteFilePath();
+      }
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::removeWatchedDirectory(const QString& directoryName)
+{
+  QStringList directories;
+  QHash<QString, QString>::iterator it = this->WatchedDirectoryRoots.begin();
+  while (it != this->WatchedDirectoryRoots.end())
+    {
+    if (it.key() == directoryName || it.key().startsWith(directoryName + "/"))
+      {
+      directories << it.key();
+      this->WatchedFiles.remove(it.key());
+      this->ChangedDirectories.remove(it.key());
+      it = this->WatchedDirectoryRoots.erase(it);
+      }
+    else
+      {
+      ++it;
+      }
+    }
+  if (!directories.isEmpty())
+    {
+    this->DirectoryWatcher->removePaths(directories);
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::onWatchedDirectoryChanged(const QString& directoryName)
+{
+  this->ChangedDirectories.insert(directoryName);
+  // the timer is not restarted, a steady flow of files must not
+  // delay the scan indefinitely
+  if (!this->WatchTimer.isActive())
+    {
+    this->WatchTimer.start();
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::onWatchTimeout()
+{
+  QSet<QString> directoriesToScan = this->ChangedDirectories;
+  this->ChangedDirectories.clear();
+
+  // files to import, per watched root
+  QHash<QString, QStringList> completeFiles;
+  foreach(const QString& directoryName, directoriesToScan)
+    {
+    if (!this->WatchedDirectoryRoots.contains(directoryName))
+      {
+      continue;
+      }
+    QString rootDirectory = this->WatchedDirectoryRoots[directoryName];
+    QDir directory(directoryName);
+    if (!directory.exists())
+      {
+      this->removeWatchedDirectory(directoryName);
+      continue;
+      }
+
+    QHash<QString, QDateTime>& knownFiles = this->WatchedFiles[directoryName];
+    QHash<QString, QDateTime> currentFiles;
+    foreach(const QFileInfo& fileInfo,
+            directory.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot))
+      {
+      QString filePath = fileInfo.absoluteFilePath();
+      if (fileInfo.isDir())
+        {
+        // files written before the watch was added are imported
+        // the same way as the ones written afterwards
+        QStringList newFiles;
+        this->addWatchedDirectory(filePath, rootDirectory, newFiles);
+        foreach(const QString& newFile, newFiles)
+          {
+          QFileInfo newFileInfo(newFile);
+          this->WatchedFiles[newFileInfo.absolutePath()].remove(newFileInfo.fileName());
+          this->ChangedDirectories.insert(newFileInfo.absolutePath());
+          }
+        continue;
+        }
+
+      QDateTime lastModified = fileInfo.lastModified();
+      QHash<QString, QDateTime>::const_iterator known = knownFiles.find(fileInfo.fileName());
+      if (known != knownFiles.end() && known.value() == lastModified)
+        {
+        currentFiles[fileInfo.fileName()] = lastModified;
+        continue;
+        }
+
+      QPair<qint64, QDateTime> state(fileInfo.size(), lastModified);
+      QHash<QString, QPair<qint64, QDateTime> >::iterator incomplete =
+        this->IncompleteFiles.find(filePath);
+      if (incomplete != this->IncompleteFiles.end() && incomplete.value() == state)
+        {
+        // not written to since the last scan
+        this->IncompleteFiles.erase(incomplete);
+        currentFiles[fileInfo.fileName()] = lastModified;
+        completeFiles[rootDirectory] << filePath;
+        }
+      else
+        {
+        this->IncompleteFiles[filePath] = state;
+        this->ChangedDirectories.insert(directoryName);
+        }
+      }
+    // forget the files that were removed
+    knownFiles = currentFiles;
+    }
+
+  // drop the state of incomplete files that disappeared
+  QHash<QString, QPair<qint64, QDateTime> >::iterator incomplete = this->IncompleteFiles.begin();
+  while (incomplete != this->IncompleteFiles.end())
+    {
+    if (directoriesToScan.contains(QFileInfo(incomplete.key()).absolutePath())
+        && !QFileInfo(incomplete.key()).exists())
+      {
+      incomplete = this->IncompleteFiles.erase(incomplete);
+      }
+    else
+      {
+      ++incomplete;
+      }
+    }
+
+  QHash<QString, QStringList>::const_iterator root;
+  for (root = completeFiles.constBegin(); root != completeFiles.constEnd(); ++root)
+    {
+    WatchedRoot watchedRoot = this->WatchedRoots.value(root.key());
+    if (watchedRoot.Database)
+      {
+      logger.debug(QString("Importing %1 files written to %2")
+                   .arg(root.value().count()).arg(root.key()));
+      this->importFiles(*watchedRoot.Database, root.value(), watchedRoot.StoreFile);
+      }
+    }
+
+  if (!this->ChangedDirectories.isEmpty() && !this->WatchTimer.isActive())
+    {
+    this->WatchTimer.start();
+    }
+}
 
 //------------------------------------------------------------------------------
 // ctkDICOMIndexer methods
@@ -85,6 +500,65 @@ ctkDICOMIndexer::~ctkDICOMIndexer()
 {
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::setNumberOfParserThreads(int count)
+{
+  Q_D(ctkDICOMIndexer);
+  d->ParserPool.setMaxThreadCount(qMax(1, count));
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMIndexer::numberOfParserThreads() const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->ParserPool.maxThreadCount();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::setBatchSize(int size)
+{
+  Q_D(ctkDICOMIndexer);
+  QMutexLocker locker(&d->QueueMutex);
+  d->BatchSize = qMax(1, size);
+  d->QueueNotFull.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMIndexer::batchSize() const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->BatchSize;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::setBackgroundImportEnabled(bool enabled)
+{
+  Q_D(ctkDICOMIndexer);
+  QMutexLocker locker(&d->QueueMutex);
+  d->BackgroundImportEnabled = enabled;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMIndexer::isBackgroundImportEnabled() const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->BackgroundImportEnabled;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::setWatchInterval(int msecs)
+{
+  Q_D(ctkDICOMIndexer);
+  d->WatchTimer.setInterval(qMax(0, msecs));
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMIndexer::watchInterval() const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->WatchTimer.interval();
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMIndexer::addFile(ctkDICOMDatabase& database,
                                    const QString filePath,
@@ -131,21 +605,12 @@ void ctkDICOMIndexer::addListOfFiles(ctkDICOMDatabase& ctkDICOMDatabase,
                                      const QString& destinationDirectoryName)
 {
   Q_D(ctkDICOMIndexer);
-  d->Canceled = false;
-  int CurrentFileIndex = 0;
-  foreach(QString filePath, listOfFiles)
+  if (!destinationDirectoryName.isEmpty())
   {
-    int percent = ( 100 * CurrentFileIndex ) / listOfFiles.size();
-    emit this->progress(percent);
-    this->addFile(ctkDICOMDatabase, filePath, destinationDirectoryName);
-    CurrentFileIndex++;
-
-    if( d->Canceled )
-      {
-      break;
-      }
+    logger.warn("Ignoring destinationDirectoryName parameter, just taking it as indication we should copy!");
   }
-  emit this->indexingComplete();
+
+  d->importFiles(ctkDICOMDatabase, listOfFiles, !destinationDirectoryName.isEmpty());
 }
 
 //------------------------------------------------------------------------------
@@ -218,53 +683,144 @@ void ctkDICOMIndexer::addDicomdir(ctkDICOMDatabase& ctkDICOMDatabase,
 //------------------------------------------------------------------------------
 void ctkDICOMIndexer::refreshDatabase(ctkDICOMDatabase& dicomDatabase, const QString& directoryName)
 {
-  Q_UNUSED(dicomDatabase);
-  Q_UNUSED(directoryName);
-  /*
-   * Probably this should go to the database class as well
-   * Or we have to extend the interface to make possible what we do here
-   * without using SQL directly
+  Q_D(ctkDICOMIndexer);
+
+  QDir directory(directoryName);
+  if (directoryName.isEmpty() || !directory.exists())
+    {
+    logger.warn("Cannot refresh the database from missing directory " + directoryName);
+    return;
+    }
 
-  /// get all filenames from the database
-  QSqlQuery allFilesQuery(dicomDatabase.database());
-  QStringList databaseFileNames;
-  QStringList filesToRemove;
-  this->loggedExec(allFilesQuery, "SELECT Filename from Images;");
+  // insert time of each file indexed below the directory, the entries
+  // left once the directory has been walked are the stale ones. The stored
+  // file names may be relative to the database directory or not canonical,
+  // both sides are compared by canonical path.
+  QHash<QString, QDateTime> indexedFiles = dicomDatabase.insertDateTimesForDirectory(directoryName);
+  QDir databaseDirectory(dicomDatabase.databaseDirectory());
+  QString rootPrefix = normalizedFilePath(databaseDirectory, directory.absolutePath()) + "/";
+  QHash<QString, QString> storedFileNames;
+  foreach(const QString& storedFileName, indexedFiles.keys())
+    {
+    QString filePath = normalizedFilePath(databaseDirectory, storedFileName);
+    if (filePath.startsWith(rootPrefix))
+      {
+      storedFileNames.insert(filePath, storedFileName);
+      }
+    else
+      {
+      // a relative file name outside of the directory
+      indexedFiles.remove(storedFileName);
+      }
+    }
 
-  while (allFilesQuery.next())
+  QStringList newFiles;
+  QStringList modifiedFiles;
+  QStringList modifiedStoredFiles;
+  int unchangedFiles = 0;
+  QDirIterator it(directory.absolutePath(), QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext())
     {
-    QString fileName = allFilesQuery.value(0).toString();
-    databaseFileNames.append(fileName);
-    if (! QFile::exists(fileName) )
+    QString filePath = it.next();
+    QHash<QString, QString>::iterator storedFileName =
+      storedFileNames.find(normalizedFilePath(databaseDirectory, filePath));
+    if (storedFileName == storedFileNames.end())
       {
-      filesToRemove.append(fileName);
+      newFiles << filePath;
+      continue;
       }
+    // same rule as ctkDICOMDatabase::fileExistsAndUpToDate()
+    if (it.fileInfo().lastModified() < indexedFiles.value(storedFileName.value()))
+      {
+      ++unchangedFiles;
+      }
+    else
+      {
+      modifiedFiles << filePath;
+      modifiedStoredFiles << storedFileName.value();
+      }
+    indexedFiles.remove(storedFileName.value());
+    storedFileNames.erase(storedFileName);
+    }
+  QStringList removedFiles = indexedFiles.keys();
+
+  logger.info(QString("Refreshing %1: %2 new, %3 modified, %4 removed, %5 unchanged files")
+              .arg(directoryName).arg(newFiles.count()).arg(modifiedFiles.count())
+              .arg(removedFiles.count()).arg(unchangedFiles));
+
+  // modified files are indexed again from scratch, they may
+  // not hold the same instance anymore
+  dicomDatabase.removeFiles(removedFiles + modifiedStoredFiles);
+
+  emit databaseRefreshed(newFiles.count(), modifiedFiles.count(),
+                         removedFiles.count(), unchangedFiles);
+
+  QStringList filesToIndex = newFiles + modifiedFiles;
+  emit foundFilesToIndex(filesToIndex.count());
+  d->importFiles(dicomDatabase, filesToIndex, false, false);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::watchDirectory(ctkDICOMDatabase& database,
+                                     const QString& directoryName,
+                                     const QString& destinationDirectoryName)
+{
+  Q_D(ctkDICOMIndexer);
+  QDir directory(directoryName);
+  if (directoryName.isEmpty() || !directory.exists())
+    {
+    logger.warn("Cannot watch missing directory " + directoryName);
+    return;
+    }
+  if (!destinationDirectoryName.isEmpty())
+    {
+    logger.warn("Ignoring destinationDirectoryName parameter, just taking it as indication we should copy!");
     }
 
-  QSet<QString> filesytemFiles;
-  QDirIterator dirIt(directoryName);
-  while (dirIt.hasNext())
+  QString rootDirectory = directory.absolutePath();
+  this->unwatchDirectory(rootDirectory);
+  ctkDICOMIndexerPrivate::WatchedRoot watchedRoot;
+  watchedRoot.Database = &database;
+  watchedRoot.StoreFile = !destinationDirectoryName.isEmpty();
+  d->WatchedRoots[rootDirectory] = watchedRoot;
+
+  QStringList existingFiles;
+  d->addWatchedDirectory(rootDirectory, rootDirectory, existingFiles);
+  emit foundFilesToIndex(existingFiles.count());
+  d->importFiles(database, existingFiles, watchedRoot.StoreFile);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::unwatchDirectory(const QString& directoryName)
+{
+  Q_D(ctkDICOMIndexer);
+  QString rootDirectory = QDir(directoryName).absolutePath();
+  if (d->WatchedRoots.remove(rootDirectory))
     {
-    filesytemFiles.insert(dirIt.next());
+    d->removeWatchedDirectory(rootDirectory);
     }
+}
 
-  // TODO: it looks like this function was never finished...
-  //
-  // I guess the next step is to remove all filesToRemove from the database
-  // and also to add filesystemFiles into the database tables
-  */
-  }
+//------------------------------------------------------------------------------
+QStringList ctkDICOMIndexer::watchedDirectories() const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->WatchedRoots.keys();
+}
 
 //------------------------------------------------------------------------------
 void ctkDICOMIndexer::waitForImportFinished()
 {
-  // No-op - this had been used when the indexing was multi-threaded,
-  // and has only been retained for API compatibility.
+  Q_D(ctkDICOMIndexer);
+  d->writeParsedFiles(true);
 }
 
 //----------------------------------------------------------------------------
 void ctkDICOMIndexer::cancel()
 {
   Q_D(ctkDICOMIndexer);
+  QMutexLocker locker(&d->QueueMutex);
   d->Canceled = true;
+  d->QueueNotFull.wakeAll();
+  d->QueueChanged.wakeAll();
 }
@@ -34,13 +34,52 @@ class ctkDICOMIndexerPrivate;
 ///
 /// \brief Indexes DICOM images located in local directory into an Sql database
 ///
+/// Files passed to addListOfFiles, addDirectory and addDicomdir are parsed
+/// in parallel by a pool of worker threads. The parsed datasets are then
+/// inserted by a single writer, the thread owning the database connection,
+/// which commits them in batches of batchSize instances per transaction.
+///
 class CTK_DICOM_CORE_EXPORT ctkDICOMIndexer : public QObject
 {
   Q_OBJECT
+  Q_PROPERTY(int numberOfParserThreads READ numberOfParserThreads WRITE setNumberOfParserThreads)
+  Q_PROPERTY(int batchSize READ batchSize WRITE setBatchSize)
+  Q_PROPERTY(bool backgroundImportEnabled READ isBackgroundImportEnabled WRITE setBackgroundImportEnabled)
+  Q_PROPERTY(int watchInterval READ watchInterval WRITE setWatchInterval)
 public:
   explicit ctkDICOMIndexer(QObject *parent = 0);
   virtual ~ctkDICOMIndexer();
 
+  ///
+  /// \brief Number of worker threads used to parse DICOM files.
+  /// Defaults to QThread::idealThreadCount().
+  void setNumberOfParserThreads(int count);
+  int numberOfParserThreads() const;
+
+  ///
+  /// \brief Number of instances inserted per database transaction.
+  /// Defaults to 500.
+  void setBatchSize(int size);
+  int batchSize() const;
+
+  ///
+  /// \brief If enabled, addListOfFiles and addDirectory return as soon as
+  /// the files are queued for parsing.
+  /// The parsed files are then inserted each time control returns to the
+  /// event loop of the thread owning the database, or when
+  /// waitForImportFinished() is called. Disabled by default.
+  void setBackgroundImportEnabled(bool enabled);
+  bool isBackgroundImportEnabled() const;
+
+  ///
+  /// \brief Delay in milliseconds between a change in a watched directory
+  /// and the scan of that directory.
+  /// All the changes happening during that delay are handled by a single
+  /// scan. A file is only imported once its size and modification time are
+  /// the same in two consecutive scans. Defaults to 1000.
+  void setWatchInterval(int msecs);
+  int watchInterval() const;
+
   ///
   /// \brief Adds directory to database and optionally copies files to
   /// destinationDirectory.
@@ -80,13 +119,43 @@ public:
   Q_INVOKABLE void addFile(ctkDICOMDatabase& database, const QString filePath,
                     const QString& destinationDirectoryName = "");
 
+  ///
+  /// \brief Bring the database up to date with the files below directoryName.
+  ///
+  /// The files indexed below directoryName are compared with a walk of the
+  /// directory: rows of files that no longer exist are removed, new files and
+  /// files modified since they were inserted are indexed the same way as
+  /// addListOfFiles does, unchanged files are not read at all.
+  /// databaseRefreshed() reports the number of files in each category.
+  ///
   Q_INVOKABLE void refreshDatabase(ctkDICOMDatabase& database, const QString& directoryName);
 
   ///
-  /// \brief Deprecated - no op.
-  /// \deprecated
-  /// Previously ensured that the QFuture threads have all finished indexing
-  /// before returning control.
+  /// \brief Import the files written below directoryName as they appear.
+  ///
+  /// The files already in the directory are imported first. The directory
+  /// and its subdirectories are then watched for changes: new or modified
+  /// files are imported once they are complete, without walking the
+  /// whole tree again. Requires an event loop in the thread owning the
+  /// database.
+  ///
+  Q_INVOKABLE void watchDirectory(ctkDICOMDatabase& database, const QString& directoryName,
+                    const QString& destinationDirectoryName = "");
+
+  ///
+  /// \brief Stop importing the files written below directoryName.
+  Q_INVOKABLE void unwatchDirectory(const QString& directoryName);
+
+  /// Directories passed to watchDirectory
+  Q_INVOKABLE QStringList watchedDirectories() const;
+
+  ///
+  /// \brief Wait until all the queued files are parsed and inserted
+  /// into the database.
+  ///
+  /// Only needed when background import is enabled, otherwise the add
+  /// methods already return once the import is finished.
+  /// Must be called from the thread owning the database.
   ///
   Q_INVOKABLE void waitForImportFinished();
 
@@ -96,6 +165,9 @@ Q_SIGNALS:
   void indexingFilePath(QString);
   void progress(int);
   void indexingComplete();
+  /// Emitted by refreshDatabase() once the directory has been compared with
+  /// the database, before the new and modified files are indexed
+  void databaseRefreshed(int newFiles, int modifiedFiles, int removedFiles, int unchangedFiles);
 
 public Q_SLOTS:
   void cancel();
@@ -21,10 +21,41 @@
 #ifndef CTKDICOMINDEXERPRIVATE_H
 #define CTKDICOMINDEXERPRIVATE_H
 
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QList>
+#include <QMutex>
 #include <QObject>
+#include <QPair>
+#include <QPointer>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWaitCondition>
 
 #include "ctkDICOMIndexer.h"
 
+class ctkDICOMIndexerPrivate;
+
+//------------------------------------------------------------------------------
+/// \internal
+/// Parses the header of a single file on a worker thread and hands the
+/// result over to the writer through ctkDICOMIndexerPrivate::pushParsedFile.
+class ctkDICOMIndexerParseTask : public QRunnable
+{
+public:
+  ctkDICOMIndexerParseTask(ctkDICOMIndexerPrivate* indexer, const QString& filePath,
+                           bool storeFile);
+  virtual void run();
+
+private:
+  ctkDICOMIndexerPrivate* Indexer;
+  QString FilePath;
+  bool StoreFile;
+};
+
 //------------------------------------------------------------------------------
 class ctkDICOMIndexerPrivate : public QObject
 {
@@ -39,9 +70,91 @@ public:
   ctkDICOMIndexerPrivate(ctkDICOMIndexer&);
   ~ctkDICOMIndexerPrivate();
 
+  /// Queue the files for parsing on the worker pool. Files already in the
+  /// database and up-to-date are skipped if \a skipUpToDateFiles is true.
+  void startParsing(ctkDICOMDatabase& database, const QStringList& listOfFiles,
+                    bool storeFile, bool skipUpToDateFiles = true);
+
+  /// Parse and insert the files, in the background if enabled
+  void importFiles(ctkDICOMDatabase& database, const QStringList& listOfFiles,
+                   bool storeFile, bool skipUpToDateFiles = true);
+
+  /// Called from the worker threads, blocks while the queue is full
+  void pushParsedFile(const ctkDICOMDatabase::IndexingResult& indexingResult);
+
+  /// Returns true if the parse tasks should stop early
+  bool isCanceled();
+
+  /// Insert parsed files into the database, one transaction per batch.
+  /// If \a waitForCompletion is true, the method returns once all queued
+  /// files have been parsed and inserted, otherwise only the batches that
+  /// are ready are written.
+  void writeParsedFiles(bool waitForCompletion);
+
+  /// Start watching \a directoryName and its subdirectories, files already
+  /// present are returned in \a existingFiles
+  void addWatchedDirectory(const QString& directoryName, const QString& rootDirectory,
+                           QStringList& existingFiles);
+
+  /// Stop watching \a directoryName and its subdirectories
+  void removeWatchedDirectory(const QString& directoryName);
+
+public Q_SLOTS:
+  /// Invoked through the event loop when running in background mode
+  void onParsedFilesAvailable();
+
+  /// Called by the file system watcher, schedules a scan of the directory
+  void onWatchedDirectoryChanged(const QString& directoryName);
+
+  /// Scan the changed directories and import the files that are complete
+  void onWatchTimeout();
+
 public:
   ctkDICOMAbstractThumbnailGenerator* thumbnailGenerator;
   bool                    Canceled;
+
+  /// Number of files committed per database transaction
+  int BatchSize;
+  bool BackgroundImportEnabled;
+  QThreadPool ParserPool;
+
+  /// Database that the currently queued files are inserted into
+  QPointer<ctkDICOMDatabase> Database;
+
+  /// Only accessed from the thread owning the database
+  bool ImportInProgress;
+  int FilesToIndex;
+  int FilesIndexed;
+
+  /// Protects all members below as well as Canceled and BatchSize
+  QMutex QueueMutex;
+  QWaitCondition QueueNotFull;
+  QWaitCondition QueueChanged;
+  QList<ctkDICOMDatabase::IndexingResult> ParsedFiles;
+  /// Number of files submitted to the parser pool and not yet queued
+  int PendingParseTasks;
+  /// Set when a queued call to onParsedFilesAvailable is already scheduled
+  bool WriteScheduled;
+
+  /// Directories passed to watchDirectory
+  struct WatchedRoot
+  {
+    WatchedRoot() : StoreFile(false) {}
+    QPointer<ctkDICOMDatabase> Database;
+    bool StoreFile;
+  };
+  QHash<QString, WatchedRoot> WatchedRoots;
+  /// Root of each watched directory and subdirectory
+  QHash<QString, QString> WatchedDirectoryRoots;
+  QFileSystemWatcher* DirectoryWatcher;
+  /// Changes are collected for WatchTimer's interval before scanning
+  QTimer WatchTimer;
+  QSet<QString> ChangedDirectories;
+  /// Files already imported, with their modification time, per directory
+  QHash<QString, QHash<QString, QDateTime> > WatchedFiles;
+  /// Size and modification time of files seen once that may still be
+  /// written to. They are imported once they did not change between two scans.
+  QHash<QString, QPair<qint64, QDateTime> > IncompleteFiles;
 };
 
 
@@ -27,6 +27,76 @@
 
 #include <stdexcept>
 
+#include <QHash>
+#include <QTextCodec>
+
+/// Codecs of the DICOM character sets. The map is filled once when first
+/// used and only read afterwards, it can be used from any thread.
+class ctkDICOMItemCharacterSets
+{
+  public:
+
+    ctkDICOMItemCharacterSets();
+
+    /// Returns 0 if the character set is unknown
+    QTextCodec* codec( const QString& specificCharacterSet ) const
+    {
+      return m_Codecs.value( specificCharacterSet, 0 );
+    }
+
+  private:
+
+    void insert( const QString& dicomName, const QByteArray& qtName );
+
+    QHash<QString, QTextCodec*> m_Codecs;
+};
+
+ctkDICOMItemCharacterSets::ctkDICOMItemCharacterSets()
+{
+  // fills up a map of encoding names that might be named in DICOM files.
+  // for each encoding we store the codec that Qt uses for the same encoding.
+  // This is because there is not yet a standard naming scheme but lots of aliases
+  // out in the real world: e.g. http://www.openi18n.org/subgroups/sa/locnameguide/final/CodesetAliasTable.html
+
+  // use all names that Qt knows by itself
+  foreach( QByteArray c, QTextCodec::availableCodecs() )
+  {
+    insert( c.constData(), c );
+  }
+                  //    DICOM        Qt
+  insert("ISO_IR 6", "UTF-8"); // actually ASCII, but ok
+  insert("ISO_IR 100", "ISO-8859-1");
+  insert("ISO_IR 101", "ISO-8859-2");
+  insert("ISO_IR 109", "ISO-8859-3");
+  insert("ISO_IR 110", "ISO-8859-4");
+  insert("ISO_IR 144", "ISO-8859-5");
+  insert("ISO_IR 127", "ISO-8859-6");
+  insert("ISO_IR 126", "ISO-8859-7");
+  insert("ISO_IR 138", "ISO-8859-8");
+  insert("ISO_IR 148", "ISO-8859-9");
+  insert("ISO_IR 179", "ISO-8859-13");
+  insert("ISO_IR 192", "UTF-8");
+  // japanese
+  insert("ISO 2022 IR 13", "ISO 2022-JP"); // Single byte charset, JIS X 0201: Katakana, Romaji
+  insert("ISO 2022 IR 87", "ISO 2022-JP"); // Multi byte charset, JIS X 0208: Kanji, Kanji set
+  insert("ISO 2022 IR 159", "ISO 2022-JP");
+  // korean
+  insert("ISO 2022 IR 149", "EUC-KR"); // Multi byte charset, KS X 1001: Hangul, Hanja
+}
+
+void ctkDICOMItemCharacterSets::insert( const QString& dicomName, const QByteArray& qtName )
+{
+  QTextCodec* codec = QTextCodec::codecForName( qtName );
+  if (!codec)
+  {
+    std::cerr << "Could not create QTextCodec object for '" << qtName.constData() << "'. Using default encoding instead." << std::endl;
+    codec = QTextCodec::codecForName("UTF-8"); // uses Latin1
+  }
+  m_Codecs.insert( dicomName, codec );
+}
+
+Q_GLOBAL_STATIC(ctkDICOMItemCharacterSets, ctkDICOMItemCharacterSetsInstance)
+
 
 class ctkDICOMItemPrivate
 {
@@ -128,6 +198,33 @@ void ctkDICOMItem::InitializeFromFile(const QString& filename,
   InitializeFromItem(dataset, true);
 }
 
+void ctkDICOMItem::InitializeFromFileHeader(const QString& filename,
+                                            const Uint32 maxReadLength)
+{
+  DcmDataset *dataset;
+
+  DcmFileFormat fileformat;
+#if PACKAGE_VERSION_NUMBER > 360
+  OFCondition status = fileformat.loadFileUntilTag(filename.toLatin1().data(),
+    EXS_Unknown, EGL_noChange, maxReadLength, ERM_autoDetect, DCM_PixelData);
+#else
+  // DCMTK 3.6.0 cannot stop at a given tag, rely on lazy loading of the
+  // long elements instead
+  OFCondition status = fileformat.loadFile(filename.toLatin1().data(),
+    EXS_Unknown, EGL_noChange, maxReadLength, ERM_autoDetect);
+#endif
+  dataset = fileformat.getAndRemoveDataset();
+
+  if (!status.good())
+  {
+    qDebug() << "Could not load " << filename << "\nDCMTK says: " << status.text();
+    delete dataset;
+    return;
+  }
+
+  InitializeFromItem(dataset, true);
+}
+
 void ctkDICOMItem::Serialize()
 {
   Q_D(ctkDICOMItem);
@@ -337,88 +434,42 @@ QString ctkDICOMItem::Decode( const DcmTag& tag, const OFString& raw ) const
 {
   Q_D(const ctkDICOMItem);
   // decode for types LO, LT, PN, SH, ST, UT
-  QString vr = TagVR(tag);
-  if ( !d->m_SpecificCharacterSet.isEmpty()
-    && (vr == "LO" ||
-        vr == "LT" ||
-        vr == "PN" ||
-        vr == "SH" ||
-        vr == "ST" ||
-        vr == "UT" ) )
-  {
-    //std::cout << "Decode from encoding " << d->m_SpecificCharacterSet.toStdString() << std::endl;
-    static QMap<QString, QTextDecoder*> decoders;
-    static QMap<QString, QString> qtEncodingNamesForDICOMEncodingNames;
-
-    if (qtEncodingNamesForDICOMEncodingNames.isEmpty())
-    {
-      // runs only once and fills up a map of encoding names that might be named in DICOM files.
-      // for each encoding we store the name that Qt uses for the same encoding.
-      // This is because there is not yet a standard naming scheme but lots of aliases
-      // out in the real world: e.g. http://www.openi18n.org/subgroups/sa/locnameguide/final/CodesetAliasTable.html
-
-                                              //    DICOM        Qt
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 6", "UTF-8"); // actually ASCII, but ok
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 100", "ISO-8859-1");
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 101", "ISO-8859-2");
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 109", "ISO-8859-3");
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 110", "ISO-8859-4");
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 144", "ISO-8859-5");
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 127", "ISO-8859-6");
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 126", "ISO-8859-7");
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 138", "ISO-8859-8");
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 148", "ISO-8859-9");
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 179", "ISO-8859-13");
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO_IR 192", "UTF-8");
-      // japanese
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO 2022 IR 13", "ISO 2022-JP"); // Single byte charset, JIS X 0201: Katakana, Romaji
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO 2022 IR 87", "ISO 2022-JP"); // Multi byte charset, JIS X 0208: Kanji, Kanji set
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO 2022 IR 159", "ISO 2022-JP");
-      // korean
-      qtEncodingNamesForDICOMEncodingNames.insert("ISO 2022 IR 149", "EUC-KR"); // Multi byte charset, KS X 1001: Hangul, Hanja
-
-      // use all names that Qt knows by itself
-      foreach( QByteArray c, QTextCodec::availableCodecs() )
-      {
-        qtEncodingNamesForDICOMEncodingNames.insert( c.constData(), c.constData() );
-      }
-
-    }
+  if ( d->m_SpecificCharacterSet.isEmpty() )
+  {
+    return QString::fromLatin1(raw.c_str());
+  }
+  switch ( tag.getEVR() )
+  {
+    case EVR_LO:
+    case EVR_LT:
+    case EVR_PN:
+    case EVR_SH:
+    case EVR_ST:
+    case EVR_UT:
+      break;
+    default:
+      return QString::fromLatin1(raw.c_str());
+  }
 
-    if ( qtEncodingNamesForDICOMEncodingNames.contains(d->m_SpecificCharacterSet) )
-    {
-      QString encodingName( qtEncodingNamesForDICOMEncodingNames[d->m_SpecificCharacterSet] );
-      if ( !decoders.contains( encodingName ) )
-      {
-        QTextCodec* codec = QTextCodec::codecForName( encodingName.toLatin1() );
-        if (!codec)
-        {
-          std::cerr << "Could not create QTextCodec object for '" << encodingName.toStdString() << "'. Using default encoding instead." << std::endl;
-          decoders.insert( encodingName, QTextCodec::codecForName("UTF-8")->makeDecoder() ); // uses Latin1
-        }
-        else
-        {
-          // initialize a QTextDecoder for given encoding
-          decoders.insert( encodingName, codec->makeDecoder() );
-          // We are responsible for deleting the QTextDecoder objects
-          // created by makeDecoder(). BUT as these objects are stored
-          // in a static map that lives until application end AND
-          // nothing application relevant happens during their
-          // destruction, we just let them be destructed by C++ on
-          // application exit.
-          // Any potential leaks that are found by this behavior can
-          // be suppressed.
-        }
-      }
+  // the most common character sets don't need a codec
+  if ( d->m_SpecificCharacterSet == QLatin1String("ISO_IR 100") )
+  {
+    return QString::fromLatin1(raw.c_str());
+  }
+  if ( d->m_SpecificCharacterSet == QLatin1String("ISO_IR 192")
+    || d->m_SpecificCharacterSet == QLatin1String("ISO_IR 6") )
+  {
+    return QString::fromUtf8(raw.c_str());
+  }
 
-      //std::cout << "Decode '" <<  raw.c_str() << "' to '" << decoders[encodingName]->toUnicode( raw.c_str() ).toLocal8Bit().constData() << "'" << std::endl;
-      return decoders[encodingName]->toUnicode( raw.c_str() );
-    }
-    else
-    {
-      std::cerr << "DICOM dataset contains some encoding that we never thought we would see(" << d->m_SpecificCharacterSet.toStdString() << "). Using default encoding." << std::endl;
-    }
+  // The codecs are looked up once and never change afterwards, decoding
+  // without a converter state is thread-safe.
+  QTextCodec* codec = ctkDICOMItemCharacterSetsInstance()->codec(d->m_SpecificCharacterSet);
+  if ( codec )
+  {
+    return codec->toUnicode( raw.c_str() );
   }
+  std::cerr << "DICOM dataset contains some encoding that we never thought we would see(" << d->m_SpecificCharacterSet.toStdString() << "). Using default encoding." << std::endl;
 
   return QString::fromLatin1(raw.c_str()); // Latin1 is ISO 8859, which is the default character set of DICOM (PS 3.5-2008, Page 18)
 
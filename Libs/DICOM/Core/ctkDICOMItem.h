@@ -93,6 +93,16 @@ public:
                     const Uint32 maxReadLength = DCM_MaxReadLength,
                     const E_FileReadMode readMode = ERM_autoDetect);
 
+    ///
+    /// \brief Initialize from the header of a file, for indexing.
+    ///
+    /// Parsing stops at the pixel data element (7FE0,0010) so that the pixel
+    /// data of large multi-frame files is neither read nor kept in memory.
+    /// Elements longer than \a maxReadLength bytes are only loaded from the
+    /// file when they are accessed.
+    /// \warning Attributes stored after the pixel data are not available.
+    virtual void InitializeFromFileHeader(const QString& filename,
+                    const Uint32 maxReadLength = 256);
 
 
     /// \brief Save dataset to file
@@ -147,6 +157,9 @@ public:
     /// If so, all attributes of types Long String (LO), Long Text (LT), Person Name (PN), Short String (SH),
     /// Short Text (ST), Unlimited Text (UT) should be interpreted as encoded with a special set.
     ///
+    /// ISO_IR 100 and ISO_IR 192 are decoded without a QTextCodec. This method is
+    /// thread-safe as long as the item is not modified concurrently.
+    ///
     /// See implementation for details.
     QString Decode(const DcmTag& tag, const OFString& raw) const;
 
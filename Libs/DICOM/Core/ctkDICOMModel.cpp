@@ -19,12 +19,15 @@
 =========================================================================*/
 
 // Qt includes
+#include <QPointer>
+#include <QSet>
 #include <QStringList>
 #include <QSqlDriver>
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QSqlRecord>
 #include <QSqlResult>
+#include <QTimer>
 
 #include <QTime>
 #include <QDebug>
@@ -33,6 +36,7 @@
 #include "dcvrpn.h"
 
 // ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
 #include "ctkDICOMModel.h"
 #include "ctkLogger.h"
 
@@ -57,6 +61,9 @@ public:
   void fetch(const QModelIndex& indexValue, int limit);
   Node* createNode(int row, const QModelIndex& parentValue)const;
   Node* nodeFromIndex(const QModelIndex& indexValue)const;
+  QModelIndex indexFromNode(Node* node)const;
+  /// Return the created child of \a parentNode with the given UID, if any
+  Node* childNode(Node* parentNode, const QString& uid)const;
   //QModelIndexList indexListFromNode(const Node* node)const;
   //QModelIndexList modelIndexList(Node* node = 0)const;
   //int childrenCount(Node* node = 0)const;
@@ -66,11 +73,34 @@ public:
   QString  generateQuery(const QString& fields, const QString& table, const QString& conditions = QString())const;
   void updateQueries(Node* node)const;
 
+  /// Number of rows read from the database at once
+  static const int PageSize = 256;
+
+  /// Return true if the child row \a left of \a parentNode is before
+  /// \a right in the sort order of the fetch queries, see fetch()
+  bool isBefore(Node* parentNode, const QSqlRecord& left, const QSqlRecord& right)const;
+  /// Insert the row \a uid at its sorted position in the children of
+  /// \a parentNode if it is before the last fetched child, the row is
+  /// fetched with the next page otherwise
+  void insertChild(Node* parentNode, const QString& uid);
+  /// Insert the rows added to the database since the last call
+  void insertPendingRows();
+  QPointer<ctkDICOMDatabase> DICOMDatabase;
+  QStringList  PendingPatients;
+  QStringList  PendingStudies;
+  QStringList  PendingSeries;
+  QTimer       PendingRowsTimer;
+
   Node*        RootNode;
   QSqlDatabase DataBase;
   QList<QMap<int, QVariant> > Headers;
-  QString      Sort;
+  /// header of the column the rows are sorted by, empty if they are sorted by UID.
+  /// The levels without that field are sorted by UID, see Node::SortColumn
+  QString      SortColumn;
+  Qt::SortOrder SortOrder;
   QMap<QString, QVariant> SearchParameters;
+  /// the database has a search index for the searched fields
+  bool         UseSearchIndex;
 
   ctkDICOMModel::IndexType StartLevel;
   ctkDICOMModel::IndexType EndLevel;
@@ -93,20 +123,86 @@ struct Node
   Node*                           Parent;
   QVector<Node*>                  Children;
   int                             Row;
-  QSqlQuery                       Query;
+  /// SELECT statement of the children, without ORDER BY nor LIMIT clause
+  QString                         Query;
+  /// field of Query the children are sorted by, then by UID. Empty if
+  /// they are only sorted by UID: the sorted header is not a field of Query
+  QString                         SortColumn;
+  /// fetched rows of the children in the sort order, the first field is
+  /// their UID. The next page starts after the last one.
+  QVector<QSqlRecord>             Records;
+  QSet<QString>                   RecordUIDs;
   QString                         UID;
-  int                             RowCount;
   bool                            AtEnd;
+  bool                            HasRows;
   bool                            Fetching;
   QMap<int, QVariant>             Data;
 };
 
+//------------------------------------------------------------------------------
+// Storage class of a value in the SQLite sort order: NULL, number, then text
+static int sqlValueRank(const QVariant& value)
+{
+  if (value.isNull())
+    {
+    return 0;
+    }
+  switch (value.type())
+    {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+      return 1;
+    default:
+      return 2;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Compare two values the way SQLite orders them
+static int compareSqlValues(const QVariant& left, const QVariant& right)
+{
+  int leftRank = sqlValueRank(left);
+  int rightRank = sqlValueRank(right);
+  if (leftRank != rightRank || leftRank == 0)
+    {
+    return leftRank - rightRank;
+    }
+  if (leftRank == 1)
+    {
+    double leftNumber = left.toDouble();
+    double rightNumber = right.toDouble();
+    return leftNumber < rightNumber ? -1 : (leftNumber > rightNumber ? 1 : 0);
+    }
+  return QString::compare(left.toString(), right.toString());
+}
+
+//------------------------------------------------------------------------------
+// Names of the fields selected by "Column as Name, ..."
+static QStringList fieldAliases(const QString& fields)
+{
+  QStringList aliases;
+  foreach(QString field, fields.split(',', QString::SkipEmptyParts))
+    {
+    QString alias = field.section(" as ", -1).trimmed();
+    alias.remove('"');
+    aliases << alias;
+    }
+  return aliases;
+}
+
 //------------------------------------------------------------------------------
 ctkDICOMModelPrivate::ctkDICOMModelPrivate(ctkDICOMModel& o):q_ptr(&o)
 {
   this->RootNode     = 0;
+  this->UseSearchIndex = false;
+  this->SortOrder = Qt::AscendingOrder;
   this->StartLevel = ctkDICOMModel::RootType;
   this->EndLevel = ctkDICOMModel::ImageType;
+  this->PendingRowsTimer.setSingleShot(true);
+  this->PendingRowsTimer.setInterval(0);
 }
 
 //------------------------------------------------------------------------------
@@ -119,6 +215,11 @@ ctkDICOMModelPrivate::~ctkDICOMModelPrivate()
 //------------------------------------------------------------------------------
 void ctkDICOMModelPrivate::init()
 {
+  Q_Q(ctkDICOMModel);
+  // rows are inserted once the insert batch is committed
+  QObject::connect(&this->PendingRowsTimer, SIGNAL(timeout()),
+                   q, SLOT(insertPendingRows()));
+
   QMap<int, QVariant> data;
   data[Qt::DisplayRole] = QString("Name");
   this->Headers << data;
@@ -146,6 +247,34 @@ Node* ctkDICOMModelPrivate::nodeFromIndex(const QModelIndex& indexValue)const
   return indexValue.isValid() ? reinterpret_cast<Node*>(indexValue.internalPointer()) : this->RootNode;
 }
 
+//------------------------------------------------------------------------------
+QModelIndex ctkDICOMModelPrivate::indexFromNode(Node* node)const
+{
+  Q_Q(const ctkDICOMModel);
+  if (node == 0 || node == this->RootNode)
+    {
+    return QModelIndex();
+    }
+  return q->createIndex(node->Row, 0, node);
+}
+
+//------------------------------------------------------------------------------
+Node* ctkDICOMModelPrivate::childNode(Node* parentNode, const QString& uid)const
+{
+  if (parentNode == 0)
+    {
+    return 0;
+    }
+  foreach(Node* node, parentNode->Children)
+    {
+    if (node->UID == uid)
+      {
+      return node;
+      }
+    }
+  return 0;
+}
+
 /*
 //------------------------------------------------------------------------------
 QModelIndexList ctkDICOMModelPrivate::indexListFromNode(const Node* node)const
@@ -159,17 +288,15 @@ QModelIndexList ctkDICOMModelPrivate::indexListFromNode(const Node* node)const
     {
     return indexList;
     }
-  int field = parentNode->Query.record().indexOf("UID");
   int row = -1;
-  for (row = 0; row < parentNode->RowCount; ++row)
+  for (row = 0; row < parentNode->Records.count(); ++row)
     {
-    QString uid = this->value(parentNode, row, field).toString();
-    if (uid == node->UID)
+    if (parentNode->Records[row].value("UID").toString() == node->UID)
       {
       break;
       }
     }
-  if (row >= parentNode->RowCount)
+  if (row >= parentNode->Records.count())
     {
     return indexList;
     }
@@ -248,8 +375,8 @@ Node* ctkDICOMModelPrivate::createNode(int row, const QModelIndex& parentValue)c
 #endif
     }
 
-  node->RowCount = 0;
   node->AtEnd = false;
+  node->HasRows = false;
   node->Fetching = false;
 
   this->updateQueries(node);
@@ -261,9 +388,9 @@ Node* ctkDICOMModelPrivate::createNode(int row, const QModelIndex& parentValue)c
 QVariant ctkDICOMModelPrivate::value(const QModelIndex& parentValue, int row, int column) const
 {
   Node* node = this->nodeFromIndex(parentValue);
-  if (row >= node->RowCount)
+  if (row >= node->Records.count())
     {
-    const_cast<ctkDICOMModelPrivate *>(this)->fetch(parentValue, row + 256);
+    const_cast<ctkDICOMModelPrivate *>(this)->fetch(parentValue, row + PageSize);
     }
   return this->value(node, row, column);
 }
@@ -271,20 +398,11 @@ QVariant ctkDICOMModelPrivate::value(const QModelIndex& parentValue, int row, in
 //------------------------------------------------------------------------------
 QVariant ctkDICOMModelPrivate::value(Node* parentNode, int row, int column) const
 {
-  if (row < 0 || column < 0 || !parentNode || row >= parentNode->RowCount)
+  if (row < 0 || column < 0 || !parentNode || row >= parentNode->Records.count())
     {
     return QVariant();
     }
-
-  if (!parentNode->Query.seek(row))
-    {
-    qDebug() << parentNode->Query.lastError();
-    Q_ASSERT(parentNode->Query.seek(row));
-    return QVariant();
-    }
-  QVariant res = parentNode->Query.value(column);
-  Q_ASSERT(res.isValid());
-  return res;
+  return parentNode->Records[row].value(column);
 }
 
 //------------------------------------------------------------------------------
@@ -295,10 +413,6 @@ QString ctkDICOMModelPrivate::generateQuery(const QString& fields, const QString
     {
     res += QString(" WHERE ") + conditions;
     }
-  if (!this->Sort.isEmpty())
-    {
-    res += QString(" ORDER BY ") + this->Sort;
-    }
   logger.debug ( "ctkDICOMModelPrivate::generateQuery: query is: " + res );
   return res;
 }
@@ -307,6 +421,7 @@ QString ctkDICOMModelPrivate::generateQuery(const QString& fields, const QString
 void ctkDICOMModelPrivate::updateQueries(Node* node)const
 {
   // are you kidding me, it should be virtualized here :-)
+  QString fields;
   QString query;
   QString condition;
   switch(node->Type)
@@ -317,16 +432,19 @@ void ctkDICOMModelPrivate::updateQueries(Node* node)const
     case ctkDICOMModel::RootType:
       //query = QString("SELECT  FROM ");
       if(this->SearchParameters["Name"].toString() != ""){
-        condition.append("PatientsName LIKE \"%" + this->SearchParameters["Name"].toString() + "%\"");
+        condition.append(ctkDICOMDatabase::searchCondition(
+          "PatientsName", this->SearchParameters["Name"].toString(), this->UseSearchIndex));
       }
-      query = this->generateQuery("UID as UID, PatientsName as Name, PatientsAge as Age, PatientsBirthDate as Date, PatientID as \"Subject ID\"","Patients", condition);
+      fields = "UID as UID, PatientsName as Name, PatientsAge as Age, PatientsBirthDate as Date, PatientID as \"Subject ID\"";
+      query = this->generateQuery(fields, "Patients", condition);
       logger.debug ( "ctkDICOMModelPrivate::updateQueries for Root: query is: " + query );
       break;
     case ctkDICOMModel::PatientType:
       //query = QString("SELECT  FROM Studies WHERE PatientsUID='%1'").arg(node->UID);
       if(this->SearchParameters["Study"].toString() != "")
         {
-        condition.append("StudyDescription LIKE \"%" + this->SearchParameters["Study"].toString() + "%\"" + " AND ");
+        condition.append(ctkDICOMDatabase::searchCondition(
+          "StudyDescription", this->SearchParameters["Study"].toString(), this->UseSearchIndex) + " AND ");
         }
       if(this->SearchParameters["Modalities"].value<QStringList>().count() > 0)
         {
@@ -338,16 +456,19 @@ void ctkDICOMModelPrivate::updateQueries(Node* node)const
           condition.append(" ( StudyDate BETWEEN \'" + QDate::fromString(this->SearchParameters["StartDate"].toString(), "yyyyMMdd").toString("yyyy-MM-dd")
                            + "\' AND \'" + QDate::fromString(this->SearchParameters["EndDate"].toString(), "yyyyMMdd").toString("yyyy-MM-dd") + "\' ) AND ");
         }
-      query = this->generateQuery("StudyInstanceUID as UID, StudyDescription as Name, ModalitiesInStudy as Scan, StudyDate as Date, AccessionNumber as Number, InstitutionName as Institution, ReferringPhysician as Referrer, PerformingPhysiciansName as Performer", "Studies", condition + QString("PatientsUID='%1'").arg(node->UID));
+      fields = "StudyInstanceUID as UID, StudyDescription as Name, ModalitiesInStudy as Scan, StudyDate as Date, AccessionNumber as Number, InstitutionName as Institution, ReferringPhysician as Referrer, PerformingPhysiciansName as Performer";
+      query = this->generateQuery(fields, "Studies", condition + QString("PatientsUID='%1'").arg(node->UID));
       logger.debug ( "ctkDICOMModelPrivate::updateQueries for Patient: query is: " + query );
       break;
     case ctkDICOMModel::StudyType:
       //query = QString("SELECT SeriesInstanceUID as UID, SeriesDescription as Name, BodyPartExamined as Scan, SeriesDate as Date, AcquisitionNumber as Number FROM Series WHERE StudyInstanceUID='%1'").arg(node->UID);
       if(this->SearchParameters["Series"].toString() != "")
         {
-        condition.append("SeriesDescription LIKE \"%" + this->SearchParameters["Series"].toString() + "%\"" + " AND ");
+        condition.append(ctkDICOMDatabase::searchCondition(
+          "SeriesDescription", this->SearchParameters["Series"].toString(), this->UseSearchIndex) + " AND ");
         }
-      query = this->generateQuery("SeriesInstanceUID as UID, SeriesDescription as Name, Modality as Age, SeriesNumber as Scan, BodyPartExamined as \"Subject ID\", SeriesDate as Date, AcquisitionNumber as Number","Series",condition + QString("StudyInstanceUID='%1'").arg(node->UID));
+      fields = "SeriesInstanceUID as UID, SeriesDescription as Name, Modality as Age, SeriesNumber as Scan, BodyPartExamined as \"Subject ID\", SeriesDate as Date, AcquisitionNumber as Number";
+      query = this->generateQuery(fields, "Series", condition + QString("StudyInstanceUID='%1'").arg(node->UID));
       logger.debug ( "ctkDICOMModelPrivate::updateQueries for Study: query is: " + query );
       break;
     case ctkDICOMModel::SeriesType:
@@ -356,13 +477,16 @@ void ctkDICOMModelPrivate::updateQueries(Node* node)const
         condition.append("SOPInstanceUID LIKE \"%" + this->SearchParameters["ID"].toString() + "%\"" + " AND ");
         }
       //query = QString("SELECT Filename as UID, Filename as Name, SeriesInstanceUID as Date FROM Images WHERE SeriesInstanceUID='%1'").arg(node->UID);
-      query = this->generateQuery("SOPInstanceUID as UID, Filename as Name, SeriesInstanceUID as Date", "Images", condition + QString("SeriesInstanceUID='%1'").arg(node->UID));
+      fields = "SOPInstanceUID as UID, Filename as Name, SeriesInstanceUID as Date";
+      query = this->generateQuery(fields, "Images", condition + QString("SeriesInstanceUID='%1'").arg(node->UID));
       logger.debug ( "ctkDICOMModelPrivate::updateQueries for Series: query is: " + query );
       break;
     case ctkDICOMModel::ImageType:
       break;
     }
-  node->Query = QSqlQuery(query, this->DataBase);
+  node->Query = query;
+  // the levels do not all have a field for each header
+  node->SortColumn = fieldAliases(fields).contains(this->SortColumn) ? this->SortColumn : QString();
   foreach(Node* child, node->Children)
     {
     this->updateQueries(child);
@@ -374,52 +498,232 @@ void ctkDICOMModelPrivate::fetch(const QModelIndex& indexValue, int limit)
 {
   Q_Q(ctkDICOMModel);
   Node* node = this->nodeFromIndex(indexValue);
-  if (node->AtEnd || limit <= node->RowCount || node->Fetching/*|| bottom.column() == -1*/)
+  if (node->AtEnd || limit <= node->Records.count() || node->Fetching)
     {
     return;
     }
-  node->Fetching = true;
-
-  int newRowCount;
-  const int oldRowCount = node->RowCount;
-
-  // try to seek directly
-  if (node->Query.seek(limit - 1))
+  if (node->Query.isEmpty())
     {
-    newRowCount = limit;
+    node->AtEnd = true;
+    return;
     }
-  else
+  node->Fetching = true;
+
+  // read the page after the last fetched row (keyset paging): the rows are
+  // ordered by the sort column then by UID, the page starts after the
+  // position of the last row. Rows added before it since it was read are
+  // inserted by insertChild().
+  int pageSize = qMax(int(PageSize), limit - node->Records.count());
+  QString sortColumn = QString("\"%1\"").arg(node->SortColumn);
+  QString pageQuery = QString("SELECT * FROM ( ") + node->Query + QString(" )");
+  QVariantList boundValues;
+  if (!node->Records.isEmpty())
     {
-    newRowCount = qMax(oldRowCount, 1);
-    if (node->Query.seek(newRowCount - 1))
+    const QSqlRecord& lastRecord = node->Records.last();
+    QVariant lastUID = lastRecord.value(0);
+    if (node->SortColumn.isEmpty())
+      {
+      pageQuery += QString(" WHERE UID > ?");
+      boundValues << lastUID;
+      }
+    else
       {
-      while (node->Query.next())
+      // NULL values are sorted first in ascending order, last in descending order
+      QVariant lastValue = lastRecord.value(node->SortColumn);
+      bool ascending = this->SortOrder == Qt::AscendingOrder;
+      if (lastValue.isNull())
+        {
+        pageQuery += ascending ?
+          QString(" WHERE ( %1 IS NOT NULL OR UID > ? )").arg(sortColumn) :
+          QString(" WHERE ( %1 IS NULL AND UID > ? )").arg(sortColumn);
+        boundValues << lastUID;
+        }
+      else
         {
-        ++newRowCount;
+        pageQuery += ascending ?
+          QString(" WHERE ( %1 > ? OR ( %1 = ? AND UID > ? ) )").arg(sortColumn) :
+          QString(" WHERE ( %1 < ? OR %1 IS NULL OR ( %1 = ? AND UID > ? ) )").arg(sortColumn);
+        boundValues << lastValue << lastValue << lastUID;
         }
       }
-    else
+    }
+  pageQuery += QString(" ORDER BY ");
+  if (!node->SortColumn.isEmpty())
+    {
+    pageQuery += sortColumn
+      + (this->SortOrder == Qt::AscendingOrder ? QString(" ASC, ") : QString(" DESC, "));
+    }
+  pageQuery += QString("UID LIMIT %1").arg(pageSize);
+
+  QSqlQuery query(this->DataBase);
+  query.setForwardOnly(true);
+  query.prepare(pageQuery);
+  for (int i = 0; i < boundValues.count(); ++i)
+    {
+    query.bindValue(i, boundValues[i]);
+    }
+  QVector<QSqlRecord> newRecords;
+  int rowsRead = 0;
+  if (!query.exec())
+    {
+    logger.error("ctkDICOMModelPrivate::fetch: " + query.lastError().text());
+    }
+  while (query.next())
+    {
+    ++rowsRead;
+    QSqlRecord record = query.record();
+    QString uid = record.value(0).toString();
+    if (!node->RecordUIDs.contains(uid))
       {
-      // empty or invalid query
-      newRowCount = 0;
+      node->RecordUIDs.insert(uid);
+      newRecords << record;
       }
-    node->AtEnd = true; // this is the end.
     }
-  if (newRowCount > 0 && newRowCount > node->RowCount)
+  node->AtEnd = rowsRead < pageSize;
+
+  if (!newRecords.isEmpty())
     {
-    q->beginInsertRows(indexValue, node->RowCount, newRowCount - 1);
-    node->RowCount = newRowCount;
+    node->HasRows = true;
+    const int oldRowCount = node->Records.count();
+    q->beginInsertRows(indexValue, oldRowCount, oldRowCount + newRecords.count() - 1);
+    node->Records += newRecords;
     node->Fetching = false;
     q->endInsertRows();
     }
   else
     {
-    node->RowCount = newRowCount;
     node->Fetching = false;
     }
 }
 
+//------------------------------------------------------------------------------
+bool ctkDICOMModelPrivate::isBefore(Node* parentNode, const QSqlRecord& left, const QSqlRecord& right)const
+{
+  if (!parentNode->SortColumn.isEmpty())
+    {
+    int comparison = compareSqlValues(left.value(parentNode->SortColumn), right.value(parentNode->SortColumn));
+    if (comparison != 0)
+      {
+      return this->SortOrder == Qt::AscendingOrder ? comparison < 0 : comparison > 0;
+      }
+    }
+  return compareSqlValues(left.value(0), right.value(0)) < 0;
+}
 
+//------------------------------------------------------------------------------
+void ctkDICOMModelPrivate::insertChild(Node* parentNode, const QString& uid)
+{
+  Q_Q(ctkDICOMModel);
+  if (parentNode->Query.isEmpty() || parentNode->RecordUIDs.contains(uid))
+    {
+    return;
+    }
+  QSqlQuery query(this->DataBase);
+  query.prepare(QString("SELECT * FROM ( ") + parentNode->Query + QString(" ) WHERE UID = ?"));
+  // patients are identified by an integer
+  query.bindValue(0, parentNode->Type == ctkDICOMModel::RootType ? QVariant(uid.toInt()) : QVariant(uid));
+  if (!query.exec())
+    {
+    logger.error("ctkDICOMModelPrivate::insertChild: " + query.lastError().text());
+    return;
+    }
+  if (!query.next())
+    {
+    // filtered out by the search parameters
+    return;
+    }
+  QSqlRecord record = query.record();
+  query.finish();
+
+  // position of the first fetched row after the new one
+  int row = 0;
+  int end = parentNode->Records.count();
+  while (row < end)
+    {
+    int middle = (row + end) / 2;
+    if (this->isBefore(parentNode, parentNode->Records[middle], record))
+      {
+      row = middle + 1;
+      }
+    else
+      {
+      end = middle;
+      }
+    }
+  if (row == parentNode->Records.count() && !parentNode->AtEnd)
+    {
+    // after the last fetched row, it is read with the next page
+    return;
+    }
+
+  q->beginInsertRows(this->indexFromNode(parentNode), row, row);
+  parentNode->Records.insert(row, record);
+  parentNode->RecordUIDs.insert(uid);
+  parentNode->HasRows = true;
+  // the nodes of the rows below move down
+  foreach(Node* child, parentNode->Children)
+    {
+    if (child->Row >= row)
+      {
+      ++child->Row;
+      }
+    }
+  q->endInsertRows();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModelPrivate::insertPendingRows()
+{
+  QStringList patients = this->PendingPatients;
+  QStringList studies = this->PendingStudies;
+  QStringList series = this->PendingSeries;
+  this->PendingPatients.clear();
+  this->PendingStudies.clear();
+  this->PendingSeries.clear();
+  if (this->RootNode == 0)
+    {
+    return;
+    }
+
+  foreach(const QString& patientUID, patients)
+    {
+    this->insertChild(this->RootNode, patientUID);
+    }
+
+  // only the children of the nodes created by the views can be displayed
+  QSqlQuery parentQuery(this->DataBase);
+  parentQuery.prepare("SELECT PatientsUID FROM Studies WHERE StudyInstanceUID = ?");
+  foreach(const QString& studyUID, studies)
+    {
+    parentQuery.bindValue(0, studyUID);
+    if (parentQuery.exec() && parentQuery.next())
+      {
+      Node* patientNode = this->childNode(this->RootNode, parentQuery.value(0).toString());
+      if (patientNode)
+        {
+        this->insertChild(patientNode, studyUID);
+        }
+      }
+    parentQuery.finish();
+    }
+
+  parentQuery.prepare("SELECT Series.StudyInstanceUID, PatientsUID FROM Series, Studies "
+                      "WHERE Series.StudyInstanceUID = Studies.StudyInstanceUID AND SeriesInstanceUID = ?");
+  foreach(const QString& seriesUID, series)
+    {
+    parentQuery.bindValue(0, seriesUID);
+    if (parentQuery.exec() && parentQuery.next())
+      {
+      Node* patientNode = this->childNode(this->RootNode, parentQuery.value(1).toString());
+      Node* studyNode = this->childNode(patientNode, parentQuery.value(0).toString());
+      if (studyNode)
+        {
+        this->insertChild(studyNode, seriesUID);
+        }
+      }
+    parentQuery.finish();
+    }
+}
 
 //------------------------------------------------------------------------------
 ctkDICOMModel::ctkDICOMModel(QObject* parentObject)
@@ -487,12 +791,16 @@ QVariant ctkDICOMModel::data ( const QModelIndex & dataIndex, int role ) const
     }
   QModelIndex parentIndex = this->parent(dataIndex);
   Node* parentNode = d->nodeFromIndex(parentIndex);
-  if (dataIndex.row() >= parentNode->RowCount)
+  if (dataIndex.row() >= parentNode->Records.count())
     {
-    const_cast<ctkDICOMModelPrivate *>(d)->fetch(dataIndex, dataIndex.row());
+    const_cast<ctkDICOMModelPrivate *>(d)->fetch(parentIndex, dataIndex.row() + 1);
+    }
+  if (dataIndex.row() >= parentNode->Records.count())
+    {
+    return QVariant();
     }
   QString columnName = d->Headers[dataIndex.column()][Qt::DisplayRole].toString();
-  int field = parentNode->Query.record().indexOf(columnName);
+  int field = parentNode->Records[dataIndex.row()].indexOf(columnName);
   if (field < 0)
     {
     // Not all the columns are in the record, it's ok to have no field here.
@@ -564,7 +872,7 @@ void ctkDICOMModel::fetchMore ( const QModelIndex & parentValue )
 {
   Q_D(ctkDICOMModel);
   Node* node = d->nodeFromIndex(parentValue);
-  d->fetch(parentValue, qMax(node->RowCount, 0) + 256);
+  d->fetch(parentValue, node->Records.count() + ctkDICOMModelPrivate::PageSize);
 }
 
 //------------------------------------------------------------------------------
@@ -608,20 +916,21 @@ bool ctkDICOMModel::hasChildren ( const QModelIndex & parentIndex ) const
 
   // It's not because we don't have row that we don't have children, maybe it
   // just means that the children haven't been fetched yet
-  if (node->RowCount == 0 && !node->AtEnd)
+  if (!node->HasRows && !node->AtEnd)
     {
     // We don't want to fetch the data because we don't want to add children
     // to the index yet (it would be a mess to add rows inside a hasChildren)
-    //const_cast<qCTKDCMTKModelPrivate*>(d)->fetch(parentIndex, 1);
-    bool res = node->Query.seek(0);
-    if (!res)
+    QSqlQuery query(d->DataBase);
+    query.setForwardOnly(true);
+    node->HasRows = !node->Query.isEmpty()
+      && query.exec(node->Query + QString(" LIMIT 1")) && query.next();
+    if (!node->HasRows)
       {
       // now we know there is no children to the node, don't try next time.
       node->AtEnd = true;
       }
-    return res;
     }
-  return node->RowCount > 0;
+  return node->HasRows;
 }
 
 //------------------------------------------------------------------------------
@@ -689,25 +998,6 @@ QModelIndex ctkDICOMModel::parent ( const QModelIndex & indexValue ) const
     return QModelIndex();
     }
   return parentNode == d->RootNode ? QModelIndex() : this->createIndex(parentNode->Row, 0, parentNode);
-  /* need to recalculate the parent row
-  Node* greatParentNode = parentNode->Parent;
-  if (greatParentNode == 0)
-    {
-    return QModelIndex();
-    }
-  int field = greatParentNode->Query.record().indexOf("UID");
-  int row = -1;
-  for (row = 0; row < greatParentNode->RowCount; ++row)
-    {
-    QString uid = d->value(greatParentNode, row, field).toString();
-    if (uid == parentNode->UID)
-      {
-      break;
-      }
-    }
-  Q_ASSERT(row < greatParentNode->RowCount);
-  return this->createIndex(row, 0, parentNode);
-  */
 }
 
 //------------------------------------------------------------------------------
@@ -721,7 +1011,7 @@ int ctkDICOMModel::rowCount ( const QModelIndex & parentValue ) const
   Node* node = d->nodeFromIndex(parentValue);
   Q_ASSERT(node);
   // Returns the amount of rows currently cached on the client.
-  return node ? node->RowCount : 0;
+  return node ? node->Records.count() : 0;
 }
 
 //------------------------------------------------------------------------------
@@ -848,9 +1138,13 @@ void ctkDICOMModel::setDatabase(const QSqlDatabase &db)
 
   this->beginResetModel();
   d->DataBase = db;
+  d->UseSearchIndex = ctkDICOMDatabase::hasSearchIndex(db);
 
   delete d->RootNode;
   d->RootNode = 0;
+  d->PendingPatients.clear();
+  d->PendingStudies.clear();
+  d->PendingSeries.clear();
 
   if (d->DataBase.tables().empty())
     {
@@ -863,17 +1157,8 @@ void ctkDICOMModel::setDatabase(const QSqlDatabase &db)
 
   this->endResetModel();
 
-  // TODO, use hasQuerySize everywhere, not only in setDataBase()
-  bool hasQuerySize = d->RootNode->Query.driver()->hasFeature(QSqlDriver::QuerySize);
-  if (hasQuerySize && d->RootNode->Query.size() > 0)
-    {
-    int newRowCount= d->RootNode->Query.size();
-    beginInsertRows(QModelIndex(), 0, qMax(0, newRowCount - 1));
-    d->RootNode->RowCount = newRowCount;
-    d->RootNode->AtEnd = true;
-    endInsertRows();
-    }
-  d->fetch(QModelIndex(), 256);
+  // only the first page is read, the views fetch the others when needed
+  d->fetch(QModelIndex(), ctkDICOMModelPrivate::PageSize);
 }
 
 //------------------------------------------------------------------------------
@@ -883,10 +1168,14 @@ void ctkDICOMModel::setDatabase(const QSqlDatabase &db,const QMap<QString, QVari
 
   this->beginResetModel();
   d->DataBase = db;
+  d->UseSearchIndex = ctkDICOMDatabase::hasSearchIndex(db);
   d->SearchParameters = parameters;
 
   delete d->RootNode;
   d->RootNode = 0;
+  d->PendingPatients.clear();
+  d->PendingStudies.clear();
+  d->PendingSeries.clear();
 
   if (d->DataBase.tables().empty())
     {
@@ -899,17 +1188,70 @@ void ctkDICOMModel::setDatabase(const QSqlDatabase &db,const QMap<QString, QVari
 
   this->endResetModel();
 
-  // TODO, use hasQuerySize everywhere, not only in setDataBase()
-  bool hasQuerySize = d->RootNode->Query.driver()->hasFeature(QSqlDriver::QuerySize);
-  if (hasQuerySize && d->RootNode->Query.size() > 0)
+  // only the first page is read, the views fetch the others when needed
+  d->fetch(QModelIndex(), ctkDICOMModelPrivate::PageSize);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModel::setDatabase(ctkDICOMDatabase* dicomDatabase)
+{
+  Q_D(ctkDICOMModel);
+  if (d->DICOMDatabase)
+    {
+    QObject::disconnect(d->DICOMDatabase, 0, this, 0);
+    }
+  d->DICOMDatabase = dicomDatabase;
+  if (dicomDatabase)
+    {
+    QObject::connect(dicomDatabase, SIGNAL(patientAdded(int,QString,QString,QString)),
+                     this, SLOT(onPatientAdded(int)));
+    QObject::connect(dicomDatabase, SIGNAL(studyAdded(QString)),
+                     this, SLOT(onStudyAdded(QString)));
+    QObject::connect(dicomDatabase, SIGNAL(seriesAdded(QString)),
+                     this, SLOT(onSeriesAdded(QString)));
+    }
+  this->setDatabase(dicomDatabase ? dicomDatabase->readOnlyDatabase() : QSqlDatabase());
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModel::onPatientAdded(int databaseID)
+{
+  Q_D(ctkDICOMModel);
+  QString uid = QString::number(databaseID);
+  if (!d->PendingPatients.contains(uid))
+    {
+    d->PendingPatients << uid;
+    }
+  d->PendingRowsTimer.start();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModel::onStudyAdded(const QString& studyInstanceUID)
+{
+  Q_D(ctkDICOMModel);
+  if (!d->PendingStudies.contains(studyInstanceUID))
     {
-    int newRowCount= d->RootNode->Query.size();
-    beginInsertRows(QModelIndex(), 0, qMax(0, newRowCount - 1));
-    d->RootNode->RowCount = newRowCount;
-    d->RootNode->AtEnd = true;
-    endInsertRows();
+    d->PendingStudies << studyInstanceUID;
     }
-  d->fetch(QModelIndex(), 256);
+  d->PendingRowsTimer.start();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModel::onSeriesAdded(const QString& seriesInstanceUID)
+{
+  Q_D(ctkDICOMModel);
+  if (!d->PendingSeries.contains(seriesInstanceUID))
+    {
+    d->PendingSeries << seriesInstanceUID;
+    }
+  d->PendingRowsTimer.start();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModel::insertPendingRows()
+{
+  Q_D(ctkDICOMModel);
+  d->insertPendingRows();
 }
 
 //------------------------------------------------------------------------------
@@ -956,9 +1298,8 @@ void ctkDICOMModel::sort(int column, Qt::SortOrder order)
   this->beginResetModel();
   delete d->RootNode;
   d->RootNode = 0;
-  d->Sort = QString("\"%1\" %2")
-    .arg(d->Headers[column][Qt::DisplayRole].toString())
-    .arg(order == Qt::AscendingOrder ? "ASC" : "DESC");
+  d->SortColumn = d->Headers[column][Qt::DisplayRole].toString();
+  d->SortOrder = order;
   d->RootNode = d->createNode(-1, QModelIndex());
 
   this->endResetModel();
@@ -29,9 +29,16 @@
 
 #include "ctkDICOMCoreExport.h"
 
+class ctkDICOMDatabase;
 class ctkDICOMModelPrivate;
 
 /// \ingroup DICOM_Core
+///
+/// Rows are read from the database a page at a time, as the views need them.
+/// When the model is given a ctkDICOMDatabase, the patients, studies and
+/// series added to it are inserted in the model without resetting it.
+/// Removed rows are not signaled by the database, reset() the model after
+/// removing data.
 class CTK_DICOM_CORE_EXPORT ctkDICOMModel
 //  : public QStandardItemModel
   : public QAbstractItemModel
@@ -61,6 +68,11 @@ public:
 
   void setDatabase(const QSqlDatabase& dataBase);
   void setDatabase(const QSqlDatabase& dataBase, const QMap<QString,QVariant>& parameters);
+  /// Show the content of \a dicomDatabase, using its read-only connection,
+  /// and keep the model up to date as patients, studies and series are added.
+  /// Setting a QSqlDatabase later on suspends the updates until the database
+  /// connection has tables again.
+  void setDatabase(ctkDICOMDatabase* dicomDatabase);
 
   /// Set it before populating the model
   ctkDICOMModel::IndexType endLevel()const;
@@ -84,6 +96,11 @@ public:
   virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
 public Q_SLOTS:
   virtual void reset();
+protected Q_SLOTS:
+  void onPatientAdded(int databaseID);
+  void onStudyAdded(const QString& studyInstanceUID);
+  void onSeriesAdded(const QString& seriesInstanceUID);
+  void insertPendingRows();
 protected:
   QScopedPointer<ctkDICOMModelPrivate> d_ptr;
 
@@ -28,6 +28,11 @@
 #include <QFile>
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
 #include <QDebug>
 
 // ctkDICOMCore includes
@@ -71,13 +76,26 @@ public:
       if (this->query)
         {
         logger.debug ( "FIND RESPONSE" );
-        emit this->query->debug("Got a find response!");
+        // the association can be used by a series worker thread
+        if (QThread::currentThread() == this->query->thread())
+          {
+          emit this->query->debug("Got a find response!");
+          }
         return this->DcmSCU::handleFINDResponse(presID, response, waitForNextResponse);
         }
       return DIMSE_NULLKEY;
     };
 };
 
+//------------------------------------------------------------------------------
+// Series level C-FIND responses of a study, owned by the result
+struct ctkDICOMQuerySeriesResult
+{
+  QString            StudyInstanceUID;
+  QList<DcmDataset*> Datasets;
+  bool               Success;
+};
+
 //------------------------------------------------------------------------------
 class ctkDICOMQueryPrivate
 {
@@ -88,6 +106,9 @@ public:
   /// Add a StudyInstanceUID to be queried
   void addStudyInstanceUIDAndDataset(const QString& StudyInstanceUID, DcmDataset* dataset );
 
+  /// Set the connectivity parameters and the presentation context of \a scu
+  bool initializeSCU(DcmSCU& scu)const;
+
   QString                 CallingAETitle;
   QString                 CalledAETitle;
   QString                 Host;
@@ -99,8 +120,131 @@ public:
   QStringList             StudyInstanceUIDList;
   QList<DcmDataset*>      StudyDatasetList;
   bool                    Canceled;
+  int                     MaximumNumberOfAssociations;
+
+  // Patient of each study of StudyInstanceUIDList, the series level
+  // responses don't contain it.
+  QVector<OFString>       StudyPatientNames;
+  QVector<OFString>       StudyPatientIDs;
+
+  // Shared with the series workers
+  QMutex                  Mutex;
+  QWaitCondition          SeriesResultsAvailable;
+  /// Indexes in StudyInstanceUIDList of the studies left to query
+  QList<int>              PendingStudies;
+  QList<ctkDICOMQuerySeriesResult> SeriesResults;
+  int                     RunningWorkers;
+};
+
+//------------------------------------------------------------------------------
+// Queries the series of the pending studies on its own association, which
+// is kept open until no study is left. The responses are inserted in the
+// database by the thread running ctkDICOMQuery::query().
+class ctkDICOMQuerySeriesWorker : public QThread
+{
+public:
+  ctkDICOMQuerySeriesWorker(ctkDICOMQueryPrivate* queryPrivate,
+                            const DcmDataset& seriesQuery, DcmSCU* scu);
+  virtual void run();
+
+protected:
+  ctkDICOMQuerySeriesResult querySeries(DcmSCU& scu, Uint16 presentationContext, int studyIndex);
+
+  ctkDICOMQueryPrivate* QueryPrivate;
+  DcmDataset            Query;
+  /// Already negotiated association, a new one is negotiated if 0
+  DcmSCU*               SCU;
 };
 
+//------------------------------------------------------------------------------
+// ctkDICOMQuerySeriesWorker methods
+
+//------------------------------------------------------------------------------
+ctkDICOMQuerySeriesWorker::ctkDICOMQuerySeriesWorker(ctkDICOMQueryPrivate* queryPrivate,
+                                                     const DcmDataset& seriesQuery, DcmSCU* scu)
+  : QueryPrivate(queryPrivate)
+  , Query(seriesQuery)
+  , SCU(scu)
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMQuerySeriesWorker::run()
+{
+  ctkDICOMQueryPrivate* d = this->QueryPrivate;
+  DcmSCU ownSCU;
+  DcmSCU* scu = this->SCU;
+  if (scu == 0)
+    {
+    OFCondition result = d->initializeSCU(ownSCU) ? ownSCU.negotiateAssociation() : EC_IllegalCall;
+    if (result.good())
+      {
+      scu = &ownSCU;
+      }
+    else
+      {
+      // the peer may limit the number of associations, the other workers
+      // query the studies left
+      logger.warn( "Error negotiating an additional association: " + QString(result.text()) );
+      }
+    }
+  Uint16 presentationContext = scu ?
+    scu->findPresentationContextID ( UID_FINDStudyRootQueryRetrieveInformationModel, "") : 0;
+
+  while (presentationContext != 0)
+    {
+    int studyIndex = -1;
+    {
+    QMutexLocker locker(&d->Mutex);
+    if (d->Canceled || d->PendingStudies.isEmpty())
+      {
+      break;
+      }
+    studyIndex = d->PendingStudies.takeFirst();
+    }
+    ctkDICOMQuerySeriesResult result = this->querySeries(*scu, presentationContext, studyIndex);
+    QMutexLocker locker(&d->Mutex);
+    d->SeriesResults << result;
+    d->SeriesResultsAvailable.wakeAll();
+    }
+
+  if (scu == &ownSCU)
+    {
+    ownSCU.closeAssociation ( DCMSCU_RELEASE_ASSOCIATION );
+    }
+  QMutexLocker locker(&d->Mutex);
+  --d->RunningWorkers;
+  d->SeriesResultsAvailable.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMQuerySeriesResult ctkDICOMQuerySeriesWorker
+::querySeries(DcmSCU& scu, Uint16 presentationContext, int studyIndex)
+{
+  ctkDICOMQueryPrivate* d = this->QueryPrivate;
+  ctkDICOMQuerySeriesResult result;
+  result.StudyInstanceUID = d->StudyInstanceUIDList.at(studyIndex);
+
+  this->Query.putAndInsertString ( DCM_StudyInstanceUID, result.StudyInstanceUID.toStdString().c_str() );
+  OFList<QRResponse *> responses;
+  OFCondition status = scu.sendFINDRequest ( presentationContext, &this->Query, &responses );
+  result.Success = status.good();
+  for ( OFIterator<QRResponse*> it = responses.begin(); it != responses.end(); it++ )
+    {
+    DcmDataset *dataset = (*it)->m_dataset;
+    if ( result.Success && dataset != NULL ) // the last response is always empty
+      {
+      DcmDataset *seriesDataset = new DcmDataset(*dataset);
+      // add the patient elements not provided for the series level query
+      seriesDataset->putAndInsertOFStringArray( DCM_PatientName, d->StudyPatientNames.at(studyIndex) );
+      seriesDataset->putAndInsertOFStringArray( DCM_PatientID, d->StudyPatientIDs.at(studyIndex) );
+      result.Datasets << seriesDataset;
+      }
+    delete *it;
+    }
+  return result;
+}
+
 //------------------------------------------------------------------------------
 // ctkDICOMQueryPrivate methods
 
@@ -111,6 +255,8 @@ ctkDICOMQueryPrivate::ctkDICOMQueryPrivate()
   this->Port = 0;
   this->Canceled = false;
   this->PreferCGET = false;
+  this->MaximumNumberOfAssociations = 4;
+  this->RunningWorkers = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -124,6 +270,29 @@ void ctkDICOMQueryPrivate::addStudyInstanceUIDAndDataset( const QString& s, DcmD
 {
   this->StudyInstanceUIDList.append ( s );
   this->StudyDatasetList.append ( dataset );
+  OFString patientName, patientID;
+  dataset->findAndGetOFStringArray ( DCM_PatientName, patientName );
+  dataset->findAndGetOFStringArray ( DCM_PatientID, patientID );
+  this->StudyPatientNames.append ( patientName );
+  this->StudyPatientIDs.append ( patientID );
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMQueryPrivate::initializeSCU(DcmSCU& scu)const
+{
+  scu.setAETitle ( OFString(this->CallingAETitle.toStdString().c_str()) );
+  scu.setPeerAETitle ( OFString(this->CalledAETitle.toStdString().c_str()) );
+  scu.setPeerHostName ( OFString(this->Host.toStdString().c_str()) );
+  scu.setPeerPort ( this->Port );
+
+  OFList<OFString> transferSyntaxes;
+  transferSyntaxes.push_back ( UID_LittleEndianExplicitTransferSyntax );
+  transferSyntaxes.push_back ( UID_BigEndianExplicitTransferSyntax );
+  transferSyntaxes.push_back ( UID_LittleEndianImplicitTransferSyntax );
+
+  scu.addPresentationContext ( UID_FINDStudyRootQueryRetrieveInformationModel, transferSyntaxes );
+  // scu.addPresentationContext ( UID_VerificationSOPClass, transferSyntaxes );
+  return scu.initNetwork().good();
 }
 
 //------------------------------------------------------------------------------
@@ -214,6 +383,20 @@ bool ctkDICOMQuery::preferCGET()const
   return d->PreferCGET;
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMQuery::setMaximumNumberOfAssociations(int maximumNumberOfAssociations)
+{
+  Q_D(ctkDICOMQuery);
+  d->MaximumNumberOfAssociations = qMax(1, maximumNumberOfAssociations);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMQuery::maximumNumberOfAssociations()const
+{
+  Q_D(const ctkDICOMQuery);
+  return d->MaximumNumberOfAssociations;
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMQuery::setFilters( const QMap<QString,QVariant>& filters )
 {
@@ -260,24 +443,16 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
   if (d->Canceled) {return false;}
 
   d->StudyInstanceUIDList.clear();
-  d->SCU.setAETitle ( OFString(this->callingAETitle().toStdString().c_str()) );
-  d->SCU.setPeerAETitle ( OFString(this->calledAETitle().toStdString().c_str()) );
-  d->SCU.setPeerHostName ( OFString(this->host().toStdString().c_str()) );
-  d->SCU.setPeerPort ( this->port() );
+  d->StudyDatasetList.clear();
+  d->StudyPatientNames.clear();
+  d->StudyPatientIDs.clear();
 
   logger.error ( "Setting Transfer Syntaxes" );
   emit progress("Setting Transfer Syntaxes");
   emit progress(10);
   if (d->Canceled) {return false;}
 
-  OFList<OFString> transferSyntaxes;
-  transferSyntaxes.push_back ( UID_LittleEndianExplicitTransferSyntax );
-  transferSyntaxes.push_back ( UID_BigEndianExplicitTransferSyntax );
-  transferSyntaxes.push_back ( UID_LittleEndianImplicitTransferSyntax );
-
-  d->SCU.addPresentationContext ( UID_FINDStudyRootQueryRetrieveInformationModel, transferSyntaxes );
-  // d->SCU.addPresentationContext ( UID_VerificationSOPClass, transferSyntaxes );
-  if ( !d->SCU.initNetwork().good() )
+  if ( !d->initializeSCU(d->SCU) )
     {
     logger.error( "Error initializing the network" );
     emit progress("Error initializing the network");
@@ -412,7 +587,9 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
   emit progress(50);
   if (d->Canceled) {return false;}
 
-  for ( OFIterator<QRResponse*> it = responses.begin(); it != responses.end(); it++ )
+  // the responses are inserted in a single transaction
+  database.beginTransaction();
+  for ( OFIterator<QRResponse*> it = responses.begin(); it != responses.end() && !d->Canceled; it++ )
     {
     DcmDataset *dataset = (*it)->m_dataset;
     if ( dataset != NULL ) // the last response is always empty
@@ -423,9 +600,10 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
       d->addStudyInstanceUIDAndDataset ( StudyInstanceUID.c_str(), dataset );
       emit progress(QString("Processing: ") + QString(StudyInstanceUID.c_str()));
       emit progress(50);
-      if (d->Canceled) {return false;}
       }
     }
+  database.endTransaction();
+  if (d->Canceled) {return false;}
 
   /* Only ask for series attributes now. This requires kicking out the rest of former query. */
   d->Query->clear();
@@ -440,55 +618,93 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
   /* Add user-defined filters */
   d->Query->putAndInsertOFStringArray(DCM_SeriesDescription, seriesDescription.toLatin1().data());
 
-  // Now search each within each Study that was identified
+  // Now search each within each Study that was identified. The studies are
+  // shared among several associations and the responses are inserted by
+  // batches as they come, the workers don't wait for the database.
   d->Query->putAndInsertString ( DCM_QueryRetrieveLevel, "SERIES" );
-  float progressRatio = 25. / d->StudyInstanceUIDList.count();
-  int i = 0; 
+  const int studyCount = d->StudyInstanceUIDList.count();
+  const int workerCount = qMin(d->MaximumNumberOfAssociations, studyCount);
+  logger.debug ( QString("Starting Series C-FIND on %1 association(s)").arg(workerCount) );
+  emit progress(QString("Starting Series C-FIND for %1 studies").arg(studyCount));
 
-  QListIterator<DcmDataset*> datasetIterator(d->StudyDatasetList);
-  foreach ( QString StudyInstanceUID, d->StudyInstanceUIDList )
+  d->PendingStudies.clear();
+  for (int studyIndex = 0; studyIndex < studyCount; ++studyIndex)
     {
-    DcmDataset *studyDataset = datasetIterator.next();
-    DcmElement *patientName, *patientID;
-    studyDataset->findAndGetElement(DCM_PatientName, patientName);
-    studyDataset->findAndGetElement(DCM_PatientID, patientID);
-
-    logger.debug ( "Starting Series C-FIND for Study: " + StudyInstanceUID );
-    emit progress(QString("Starting Series C-FIND for Study: ") + StudyInstanceUID);
-    emit progress(50 + (progressRatio * i++));
-    if (d->Canceled) {return false;}
-
-    d->Query->putAndInsertString ( DCM_StudyInstanceUID, StudyInstanceUID.toStdString().c_str() );
-    OFList<QRResponse *> responses;
-    status = d->SCU.sendFINDRequest ( presentationContext, d->Query, &responses );
-    if ( status.good() )
+    d->PendingStudies << studyIndex;
+    }
+  d->SeriesResults.clear();
+  d->RunningWorkers = workerCount;
+  QList<ctkDICOMQuerySeriesWorker*> workers;
+  for (int i = 0; i < workerCount; ++i)
+    {
+    // the study level association is reused by the first worker
+    ctkDICOMQuerySeriesWorker* worker =
+      new ctkDICOMQuerySeriesWorker(d, *d->Query, i == 0 ? &d->SCU : 0);
+    workers << worker;
+    worker->start();
+    }
+
+  int queriedStudyCount = 0;
+  while (true)
+    {
+    QList<ctkDICOMQuerySeriesResult> results;
+    {
+    QMutexLocker locker(&d->Mutex);
+    while (d->SeriesResults.isEmpty() && d->RunningWorkers > 0)
       {
-      for ( OFIterator<QRResponse*> it = responses.begin(); it != responses.end(); it++ )
+      d->SeriesResultsAvailable.wait(&d->Mutex);
+      }
+    results = d->SeriesResults;
+    d->SeriesResults.clear();
+    }
+    if (results.isEmpty())
+      {
+      // all the workers are done
+      break;
+      }
+
+    database.beginTransaction();
+    foreach (const ctkDICOMQuerySeriesResult& result, results)
+      {
+      foreach (DcmDataset* dataset, result.Datasets)
         {
-        DcmDataset *dataset = (*it)->m_dataset;
-        if ( dataset != NULL )
-          {
-          // add the patient elements not provided for the series level query
-          dataset->insert( patientName, true );
-          dataset->insert( patientID, true );
-          // insert series dataset 
-          database.insert ( dataset, false /* do not store */, false /* no thumbnail */ );
-          }
+        database.insert ( dataset, false /* do not store */, false /* no thumbnail */ );
+        delete dataset;
         }
-      logger.debug ( "Find succeded on Series level for Study: " + StudyInstanceUID );
-      emit progress(QString("Find succeded on Series level for Study: ") + StudyInstanceUID);
-      emit progress(50 + (progressRatio * i++));
-      if (d->Canceled) {return false;}
       }
-    else
+    database.endTransaction();
+
+    foreach (const ctkDICOMQuerySeriesResult& result, results)
       {
-      logger.error ( "Find on Series level failed for Study: " + StudyInstanceUID );
-      emit progress(QString("Find on Series level failed for Study: ") + StudyInstanceUID);
+      ++queriedStudyCount;
+      if (result.Success)
+        {
+        logger.debug ( "Find succeded on Series level for Study: " + result.StudyInstanceUID );
+        emit progress(QString("Find succeded on Series level for Study: ") + result.StudyInstanceUID);
+        emit studyQueried(result.StudyInstanceUID);
+        }
+      else
+        {
+        logger.error ( "Find on Series level failed for Study: " + result.StudyInstanceUID );
+        emit progress(QString("Find on Series level failed for Study: ") + result.StudyInstanceUID);
+        }
       }
-    emit progress(50 + (progressRatio * i++));
-    if (d->Canceled) {return false;}
+    emit progress(50 + (50 * queriedStudyCount) / studyCount);
+    }
+
+  foreach (ctkDICOMQuerySeriesWorker* worker, workers)
+    {
+    worker->wait();
+    delete worker;
+    }
+  if (!d->Canceled && !d->PendingStudies.isEmpty())
+    {
+    logger.error ( QString("Find on Series level failed for %1 studies, no association is left")
+                   .arg(d->PendingStudies.count()) );
+    emit progress(QString("Find on Series level failed for %1 studies").arg(d->PendingStudies.count()));
     }
   d->SCU.closeAssociation ( DCMSCU_RELEASE_ASSOCIATION );
+  if (d->Canceled) {return false;}
   emit progress(100);
   return true;
 }
@@ -44,6 +44,7 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMQuery : public QObject
   Q_PROPERTY(QString host READ host WRITE setHost);
   Q_PROPERTY(int port READ port WRITE setPort);
   Q_PROPERTY(bool preferCGET READ preferCGET WRITE setPreferCGET);
+  Q_PROPERTY(int maximumNumberOfAssociations READ maximumNumberOfAssociations WRITE setMaximumNumberOfAssociations);
 
 public:
   explicit ctkDICOMQuery(QObject* parent = 0);
@@ -68,6 +69,12 @@ public:
   /// false by default
   void setPreferCGET ( bool preferCGET );
   bool preferCGET()const;
+  /// Number of associations opened in parallel to query the series of the
+  /// studies found. Each association is reused for several studies.
+  /// 1 queries the series one study after the other.
+  /// 4 by default.
+  void setMaximumNumberOfAssociations(int maximumNumberOfAssociations);
+  int maximumNumberOfAssociations()const;
 
   /// Query a remote DICOM Image Store SCP
   /// You must at least set the host and port before calling query()
@@ -108,6 +115,10 @@ Q_SIGNALS:
   void debug(const QString& message);
   /// Signal is emitted inside the query() function. It send any error messages
   void error(const QString& message);
+  /// Signal is emitted inside the query() function each time the series of
+  /// a study have been inserted in the database, while the other studies
+  /// are still being queried.
+  void studyQueried(const QString& studyInstanceUID);
   /// Signal is emitted inside the query() function when finished with value 
   /// true for success or false for error
   void done(const bool& error);
@@ -21,6 +21,10 @@
 #include <stdexcept>
 
 // Qt includes
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
 
 // ctkDICOMCore includes
 #include "ctkDICOMRetrieve.h"
@@ -84,30 +88,7 @@ public:
   virtual OFCondition handleSTORERequest(const T_ASC_PresentationContextID presID,
                                          DcmDataset *incomingObject,
                                          OFBool& continueCGETSession,
-                                         Uint16& cStoreReturnStatus)
-    {
-      if (this->retrieve)
-        {
-        OFString instanceUID;
-        incomingObject->findAndGetOFString(DCM_SOPInstanceUID, instanceUID);
-        QString qInstanceUID(instanceUID.c_str());
-        emit this->retrieve->progress("Got STORE request for " + qInstanceUID);
-        emit this->retrieve->progress(0);
-        continueCGETSession = !this->retrieve->wasCanceled();
-        if (this->retrieve && this->retrieve->database())
-          {
-          this->retrieve->database()->insert(incomingObject);
-          return EC_Normal;
-          }
-        else
-          {
-          return this->DcmSCU::handleSTORERequest(
-                          presID, incomingObject, continueCGETSession, cStoreReturnStatus);
-          }
-        }
-      //return false;
-      return EC_IllegalCall;
-    };
+                                         Uint16& cStoreReturnStatus);
 
   // called when status information from remote server
   // comes in from CGET
@@ -160,8 +141,93 @@ public:
   bool get ( const QString& studyInstanceUID,
                   const QString& seriesInstanceUID,
                   const RetrieveType retrieveType );
+
+  /// Queue a dataset received by C-GET for the database writer.
+  /// Called on the network thread, blocks while the queue is full.
+  void pushReceivedDataset(DcmDataset* dataset);
+  /// Insert the received datasets by batches until the C-GET session is over.
+  /// Returns the number of datasets inserted.
+  int writeReceivedDatasets();
+
+  // Hand-off between the C-GET session, run on a worker thread, and the
+  // database writer, run on the calling thread which owns the connection
+  QMutex         QueueMutex;
+  QWaitCondition QueueChanged;
+  QWaitCondition QueueNotFull;
+  QList<ctkDICOMDatabase::IndexingResult> ReceivedDatasets;
+  bool           ReceiveInProgress;
+  /// Number of datasets inserted within a single transaction
+  int            BatchSize;
+  /// Number of received datasets kept in memory before the network thread
+  /// waits for the writer
+  int            MaximumQueueSize;
+};
+
+//------------------------------------------------------------------------------
+// Runs the C-GET session, so that receiving is not slowed down by the inserts
+class ctkDICOMRetrieveGetThread : public QThread
+{
+public:
+  ctkDICOMRetrieveGetThread(ctkDICOMRetrievePrivate* retrievePrivate,
+                            T_ASC_PresentationContextID presID,
+                            DcmDataset* retrieveParameters,
+                            OFList<RetrieveResponse*>* responses)
+    : RetrievePrivate(retrievePrivate)
+    , PresID(presID)
+    , RetrieveParameters(retrieveParameters)
+    , Responses(responses)
+  {
+  }
+
+  virtual void run()
+  {
+    this->Status = this->RetrievePrivate->SCU.sendCGETRequest (
+      this->PresID, this->RetrieveParameters, this->Responses );
+    QMutexLocker locker(&this->RetrievePrivate->QueueMutex);
+    this->RetrievePrivate->ReceiveInProgress = false;
+    this->RetrievePrivate->QueueChanged.wakeAll();
+  }
+
+  OFCondition Status;
+
+protected:
+  ctkDICOMRetrievePrivate*    RetrievePrivate;
+  T_ASC_PresentationContextID PresID;
+  DcmDataset*                 RetrieveParameters;
+  OFList<RetrieveResponse*>*  Responses;
 };
 
+//------------------------------------------------------------------------------
+// ctkDICOMRetrieveSCUPrivate methods
+
+//------------------------------------------------------------------------------
+// called when a data set is coming in from a server in
+// response to a CGET
+OFCondition ctkDICOMRetrieveSCUPrivate::handleSTORERequest(const T_ASC_PresentationContextID presID,
+                                                           DcmDataset *incomingObject,
+                                                           OFBool& continueCGETSession,
+                                                           Uint16& cStoreReturnStatus)
+{
+  if (this->retrieve)
+    {
+    continueCGETSession = !this->retrieve->wasCanceled();
+    if (this->retrieve->database())
+      {
+      // the database is written by the thread that called getStudy()
+      // or getSeries(), the response is sent without waiting for it
+      this->retrieve->d_func()->pushReceivedDataset(incomingObject);
+      return EC_Normal;
+      }
+    else
+      {
+      return this->DcmSCU::handleSTORERequest(
+                      presID, incomingObject, continueCGETSession, cStoreReturnStatus);
+      }
+    }
+  //return false;
+  return EC_IllegalCall;
+}
+
 //------------------------------------------------------------------------------
 // ctkDICOMRetrievePrivate methods
 
@@ -174,6 +240,9 @@ ctkDICOMRetrievePrivate::ctkDICOMRetrievePrivate(ctkDICOMRetrieve& obj)
   this->KeepAssociationOpen = true;
   this->ConnectionParamsChanged = false;
   this->LastRetrieveType = RetrieveNone;
+  this->ReceiveInProgress = false;
+  this->BatchSize = 100;
+  this->MaximumQueueSize = 400;
 
   // Register the JPEG libraries in case we need them
   // (registration only happens once, so it's okay to call repeatedly)
@@ -213,6 +282,63 @@ ctkDICOMRetrievePrivate::~ctkDICOMRetrievePrivate()
     }
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMRetrievePrivate::pushReceivedDataset(DcmDataset* dataset)
+{
+  // the SCU deletes the dataset once the C-STORE response is sent
+  ctkDICOMDatabase::IndexingResult indexingResult;
+  indexingResult.dataset = QSharedPointer<ctkDICOMItem>(new ctkDICOMItem);
+  indexingResult.dataset->InitializeFromItem(new DcmDataset(*dataset), true /* take ownership */);
+  indexingResult.storeFile = true;
+  indexingResult.generateThumbnail = true;
+
+  QMutexLocker locker(&this->QueueMutex);
+  while (this->ReceivedDatasets.count() >= this->MaximumQueueSize && !this->WasCanceled)
+    {
+    this->QueueNotFull.wait(&this->QueueMutex);
+    }
+  this->ReceivedDatasets.append(indexingResult);
+  this->QueueChanged.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMRetrievePrivate::writeReceivedDatasets()
+{
+  Q_Q(ctkDICOMRetrieve);
+  int insertedCount = 0;
+  while (true)
+    {
+    QList<ctkDICOMDatabase::IndexingResult> batch;
+    {
+    QMutexLocker locker(&this->QueueMutex);
+    while (this->ReceiveInProgress && this->ReceivedDatasets.count() < this->BatchSize)
+      {
+      if (!this->QueueChanged.wait(&this->QueueMutex, 200)
+          && !this->ReceivedDatasets.isEmpty())
+        {
+        // the network is slower than the database, don't wait for a full batch
+        break;
+        }
+      }
+    if (this->ReceivedDatasets.isEmpty())
+      {
+      // the session is over
+      break;
+      }
+    batch = this->ReceivedDatasets;
+    this->ReceivedDatasets.clear();
+    this->QueueNotFull.wakeAll();
+    }
+
+    this->Database->insert(batch);
+    insertedCount += batch.count();
+    QString instanceUID = batch.last().dataset->GetElementAsString(DCM_SOPInstanceUID);
+    emit q->progress("Got STORE request for " + instanceUID);
+    emit q->progress(0);
+    }
+  return insertedCount;
+}
+
 //------------------------------------------------------------------------------
 bool ctkDICOMRetrievePrivate::initializeSCU( const QString& studyInstanceUID,
                                          const QString& seriesInstanceUID,
@@ -411,9 +537,23 @@ bool ctkDICOMRetrievePrivate::get ( const QString& studyInstanceUID,
   emit q->progress("Found Presentation Context");
   emit q->progress(1);
 
-  // do the actual move request
-  OFCondition status = this->SCU.sendCGETRequest ( 
-                          presID, retrieveParameters, &responses );
+  // do the actual get request, the received datasets are inserted while
+  // the next ones are coming
+  OFCondition status;
+  if (this->Database)
+    {
+    this->ReceiveInProgress = true;
+    ctkDICOMRetrieveGetThread getThread(this, presID, retrieveParameters, &responses);
+    getThread.start();
+    int insertedCount = this->writeReceivedDatasets();
+    getThread.wait();
+    status = getThread.Status;
+    logger.debug ( QString("%1 datasets inserted").arg(insertedCount) );
+    }
+  else
+    {
+    status = this->SCU.sendCGETRequest ( presID, retrieveParameters, &responses );
+    }
 
   emit q->progress("Sent Get Request");
   emit q->progress(2);
@@ -80,6 +80,8 @@ public:
   Q_INVOKABLE bool wasCanceled();
   /// where to insert new data sets obtained via get (must be set for
   /// get to succee
+  /// The data sets are inserted by batches from the thread calling
+  /// getSeries() or getStudy(), while the next ones are being received.
   Q_INVOKABLE void setDatabase(ctkDICOMDatabase& dicomDatabase);
   void setDatabase(QSharedPointer<ctkDICOMDatabase> dicomDatabase);
   Q_INVOKABLE QSharedPointer<ctkDICOMDatabase> database()const;
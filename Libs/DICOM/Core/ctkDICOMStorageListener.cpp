@@ -0,0 +1,836 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QDir>
+#include <QFile>
+#include <QMap>
+#include <QMutexLocker>
+#include <QTime>
+
+// ctkDICOMCore includes
+#include "ctkDICOMStorageListener.h"
+#include "ctkDICOMStorageListener_p.h"
+#include "ctkLogger.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+#include <dcmtk/dcmdata/dcfilefo.h>
+#include <dcmtk/dcmdata/dcuid.h>
+#include <dcmtk/dcmnet/diutil.h>
+
+static ctkLogger logger("org.commontk.dicom.DICOMStorageListener");
+
+namespace
+{
+
+// Transfer syntaxes accepted for the storage SOP classes, the instances are
+// stored as they are received.
+const char* AcceptedTransferSyntaxes[] = {
+  UID_LittleEndianExplicitTransferSyntax,
+  UID_BigEndianExplicitTransferSyntax,
+  UID_LittleEndianImplicitTransferSyntax,
+  UID_JPEGProcess14SV1TransferSyntax,
+  UID_JPEGProcess1TransferSyntax,
+  UID_JPEGProcess2_4TransferSyntax,
+  UID_JPEGLSLosslessTransferSyntax,
+  UID_JPEGLSLossyTransferSyntax,
+  UID_JPEG2000LosslessOnlyTransferSyntax,
+  UID_JPEG2000TransferSyntax,
+  UID_RLELosslessTransferSyntax
+};
+const int AcceptedTransferSyntaxCount =
+  sizeof(AcceptedTransferSyntaxes) / sizeof(AcceptedTransferSyntaxes[0]);
+
+const char* VerificationSOPClasses[] = { UID_VerificationSOPClass };
+
+//------------------------------------------------------------------------------
+void storeCallback(void* callbackData, T_DIMSE_StoreProgress* progress,
+                   T_DIMSE_C_StoreRQ* request, char* imageFileName,
+                   DcmDataset** imageDataSet, T_DIMSE_C_StoreRSP* response,
+                   DcmDataset** statusDetail)
+{
+  Q_UNUSED(imageFileName);
+  if (progress->state != DIMSE_StoreEnd)
+    {
+    return;
+    }
+  *statusDetail = NULL;
+  if (response->DimseStatus != STATUS_Success
+      || imageDataSet == NULL || *imageDataSet == NULL)
+    {
+    return;
+    }
+  ctkDICOMStorageAssociationTask* task =
+    reinterpret_cast<ctkDICOMStorageAssociationTask*>(callbackData);
+  response->DimseStatus = task->storeInstance(*request);
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+// ctkDICOMStorageListenerAcceptor methods
+
+//------------------------------------------------------------------------------
+ctkDICOMStorageListenerAcceptor::ctkDICOMStorageListenerAcceptor(ctkDICOMStorageListenerPrivate* listener)
+  : Listener(listener)
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListenerAcceptor::run()
+{
+  while (!this->Listener->isStopping())
+    {
+    T_ASC_Association* association = 0;
+    // wake up every second to see if the listener is stopped
+    OFCondition cond = ASC_receiveAssociation(this->Listener->Network, &association,
+                                              ASC_DEFAULTMAXPDU, NULL, NULL, OFFalse,
+                                              DUL_NOBLOCK, 1);
+    if (cond.good())
+      {
+      this->processAssociationRequest(association);
+      continue;
+      }
+    if (cond != DUL_NOASSOCIATIONREQUEST)
+      {
+      logger.error(QString("Error receiving an association: ") + cond.text());
+      }
+    ASC_dropSCPAssociation(association);
+    ASC_destroyAssociation(&association);
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListenerAcceptor::processAssociationRequest(T_ASC_Association* association)
+{
+  QString callingAETitle = QString(association->params->DULparams.callingAPTitle).trimmed();
+  QString calledAETitle = QString(association->params->DULparams.calledAPTitle).trimmed();
+
+  OFCondition cond = ASC_acceptContextsWithPreferredTransferSyntaxes(
+    association->params, VerificationSOPClasses, 1,
+    AcceptedTransferSyntaxes, AcceptedTransferSyntaxCount);
+  if (cond.good())
+    {
+    cond = ASC_acceptContextsWithPreferredTransferSyntaxes(
+      association->params, dcmAllStorageSOPClassUIDs, numberOfAllDcmStorageSOPClassUIDs,
+      AcceptedTransferSyntaxes, AcceptedTransferSyntaxCount);
+    }
+  if (cond.bad())
+    {
+    logger.error(QString("Error accepting the presentation contexts: ") + cond.text());
+    ASC_dropSCPAssociation(association);
+    ASC_destroyAssociation(&association);
+    return;
+    }
+
+  QString storageDirectory;
+  if (!this->Listener->reserveAssociation(callingAETitle, calledAETitle, storageDirectory))
+    {
+    T_ASC_RejectParameters rejection =
+      {
+      ASC_RESULT_REJECTEDTRANSIENT,
+      ASC_SOURCE_SERVICEUSER,
+      ASC_REASON_SU_CALLEDAETITLENOTRECOGNIZED
+      };
+    ASC_rejectAssociation(association, &rejection);
+    ASC_dropSCPAssociation(association);
+    ASC_destroyAssociation(&association);
+    return;
+    }
+
+  cond = ASC_acknowledgeAssociation(association);
+  if (cond.bad())
+    {
+    logger.error(QString("Error acknowledging the association: ") + cond.text());
+    ASC_dropSCPAssociation(association);
+    ASC_destroyAssociation(&association);
+    this->Listener->associationEnded();
+    return;
+    }
+  logger.debug("Association accepted from " + callingAETitle + " to " + calledAETitle);
+  this->Listener->AssociationPool.start(
+    new ctkDICOMStorageAssociationTask(this->Listener, association, calledAETitle, storageDirectory));
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMStorageAssociationTask methods
+
+//------------------------------------------------------------------------------
+ctkDICOMStorageAssociationTask::ctkDICOMStorageAssociationTask(ctkDICOMStorageListenerPrivate* listener,
+                                                               T_ASC_Association* association,
+                                                               const QString& calledAETitle,
+                                                               const QString& storageDirectory)
+  : Listener(listener)
+  , Association(association)
+  , CalledAETitle(calledAETitle)
+  , StorageDirectory(storageDirectory)
+  , FileFormat(0)
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageAssociationTask::run()
+{
+  while (true)
+    {
+    T_ASC_PresentationContextID presID = 0;
+    T_DIMSE_Message message;
+    // wake up every second to see if the listener is stopped
+    OFCondition cond = DIMSE_receiveCommand(this->Association, DIMSE_NONBLOCKING, 1,
+                                            &presID, &message, NULL);
+    if (cond == DIMSE_NODATAAVAILABLE)
+      {
+      if (this->Listener->isStopping())
+        {
+        ASC_abortAssociation(this->Association);
+        break;
+        }
+      continue;
+      }
+    if (cond == DUL_PEERREQUESTEDRELEASE)
+      {
+      ASC_acknowledgeRelease(this->Association);
+      break;
+      }
+    if (cond == DUL_PEERABORTEDASSOCIATION)
+      {
+      break;
+      }
+    if (cond.good())
+      {
+      switch (message.CommandField)
+        {
+        case DIMSE_C_ECHO_RQ:
+          cond = DIMSE_sendEchoResponse(this->Association, presID,
+                                        &message.msg.CEchoRQ, STATUS_Success, NULL);
+          break;
+        case DIMSE_C_STORE_RQ:
+          cond = this->store(presID, message.msg.CStoreRQ);
+          break;
+        default:
+          cond = DIMSE_BADCOMMANDTYPE;
+          break;
+        }
+      }
+    if (cond.bad())
+      {
+      if (!this->Listener->isStopping())
+        {
+        logger.error(QString("Error on the association to ") + this->CalledAETitle
+                     + ": " + cond.text());
+        }
+      ASC_abortAssociation(this->Association);
+      break;
+      }
+    }
+  ASC_dropSCPAssociation(this->Association);
+  ASC_destroyAssociation(&this->Association);
+  this->Listener->associationEnded();
+}
+
+//------------------------------------------------------------------------------
+OFCondition ctkDICOMStorageAssociationTask::store(T_ASC_PresentationContextID presID,
+                                                  T_DIMSE_C_StoreRQ& request)
+{
+  // the dataset is received in the file format it is written with
+  DcmFileFormat fileFormat;
+  DcmDataset* dataset = fileFormat.getDataset();
+  this->FileFormat = &fileFormat;
+  // a stalled peer must not block stop(): the dataset can't be resumed
+  // after a timeout, the association is aborted by run()
+  int timeout = this->Listener->dimseTimeout();
+  OFCondition cond = DIMSE_storeProvider(this->Association, presID, &request,
+                                         NULL, OFTrue, &dataset,
+                                         storeCallback, this, DIMSE_NONBLOCKING, timeout);
+  this->FileFormat = 0;
+  if (cond == DIMSE_NODATAAVAILABLE)
+    {
+    logger.warn(QString("No data received for %1 s from the association to %2")
+                .arg(timeout).arg(this->CalledAETitle));
+    }
+  return cond;
+}
+
+//------------------------------------------------------------------------------
+Uint16 ctkDICOMStorageAssociationTask::storeInstance(const T_DIMSE_C_StoreRQ& request)
+{
+  DcmDataset* dataset = this->FileFormat->getDataset();
+  OFString studyInstanceUID, seriesInstanceUID, sopInstanceUID;
+  dataset->findAndGetOFString(DCM_StudyInstanceUID, studyInstanceUID);
+  dataset->findAndGetOFString(DCM_SeriesInstanceUID, seriesInstanceUID);
+  dataset->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID);
+  if (sopInstanceUID != request.AffectedSOPInstanceUID
+      || studyInstanceUID.empty() || seriesInstanceUID.empty())
+    {
+    logger.error(QString("Received dataset does not match its C-STORE request: ")
+                 + request.AffectedSOPInstanceUID);
+    return STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+    }
+
+  QString filePath;
+  if (!this->StorageDirectory.isNull())
+    {
+    // same layout as ctkDICOMDatabase::insert() with storeFile
+    QString directory = this->StorageDirectory + "/" + studyInstanceUID.c_str()
+      + "/" + seriesInstanceUID.c_str();
+    if (!this->CreatedDirectories.contains(directory))
+      {
+      QDir().mkpath(directory);
+      this->CreatedDirectories.insert(directory);
+      }
+    filePath = directory + "/" + sopInstanceUID.c_str();
+    OFCondition cond = this->FileFormat->saveFile(QFile::encodeName(filePath).constData(),
+                                                  dataset->getOriginalXfer());
+    if (cond.bad())
+      {
+      logger.error("Error saving file " + filePath + ": " + cond.text());
+      return STATUS_STORE_Refused_OutOfResources;
+      }
+    }
+
+  // the parsed dataset is inserted, the file is not read again
+  ctkDICOMStorageListenerPrivate::ReceivedInstance instance;
+  instance.CalledAETitle = this->CalledAETitle;
+  instance.IndexingResult.filePath = filePath;
+  instance.IndexingResult.dataset = QSharedPointer<ctkDICOMItem>(new ctkDICOMItem);
+  instance.IndexingResult.dataset->InitializeFromItem(this->FileFormat->getAndRemoveDataset(),
+                                                      true /* take ownership */);
+  instance.IndexingResult.storeFile = false;
+  instance.IndexingResult.generateThumbnail = true;
+  this->Listener->pushReceivedInstance(instance);
+  return STATUS_Success;
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMStorageListenerPrivate methods
+
+//------------------------------------------------------------------------------
+ctkDICOMStorageListenerPrivate::ctkDICOMStorageListenerPrivate(ctkDICOMStorageListener& o)
+  : q_ptr(&o)
+{
+  this->Port = 11112;
+  this->BatchSize = 100;
+  this->Network = 0;
+  this->Acceptor = 0;
+  this->MaximumNumberOfAssociations = 8;
+  this->MaximumPendingCount = 500;
+  this->DIMSETimeout = 30;
+  this->Stopping = false;
+  this->HasDefaultRoute = false;
+  this->WriteScheduled = false;
+  this->ReceivedCount = 0;
+  this->InsertedCount = 0;
+  this->PeakPendingCount = 0;
+  this->ThrottledCount = 0;
+  this->ThrottledTime = 0;
+  this->AssociationCount = 0;
+  this->RejectedAssociationCount = 0;
+  this->AssociationPool.setMaxThreadCount(this->MaximumNumberOfAssociations);
+
+#ifdef HAVE_WINSOCK_H
+  WSAData winSockData;
+  /* we need at least version 1.1 */
+  WORD winSockVersionNeeded = MAKEWORD( 1, 1 );
+  WSAStartup(winSockVersionNeeded, &winSockData);
+#endif
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMStorageListenerPrivate::~ctkDICOMStorageListenerPrivate()
+{
+#ifdef HAVE_WINSOCK_H
+  WSACleanup();
+#endif
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMStorageListenerPrivate::storageDirectory(ctkDICOMDatabase* database)
+{
+  if (!database || database->isInMemory())
+    {
+    return QString();
+    }
+  return database->databaseDirectory() + "/dicom";
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListenerPrivate::updateRoutes()
+{
+  QHash<QString, QString> routeStorageDirectories;
+  QHash<QString, QPointer<ctkDICOMDatabase> >::const_iterator it;
+  for (it = this->Routes.constBegin(); it != this->Routes.constEnd(); ++it)
+    {
+    if (it.value())
+      {
+      routeStorageDirectories[it.key()] = ctkDICOMStorageListenerPrivate::storageDirectory(it.value());
+      }
+    }
+  QString defaultStorageDirectory = ctkDICOMStorageListenerPrivate::storageDirectory(this->Database);
+
+  QMutexLocker locker(&this->Mutex);
+  this->RouteStorageDirectories = routeStorageDirectories;
+  this->HasDefaultRoute = !this->Database.isNull();
+  this->DefaultStorageDirectory = defaultStorageDirectory;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMStorageListenerPrivate::reserveAssociation(const QString& callingAETitle,
+                                                        const QString& calledAETitle,
+                                                        QString& storageDirectory)
+{
+  Q_Q(ctkDICOMStorageListener);
+  bool accepted = false;
+  {
+  QMutexLocker locker(&this->Mutex);
+  if (this->AssociationCount >= this->MaximumNumberOfAssociations)
+    {
+    logger.warn("Too many associations, rejecting " + callingAETitle);
+    }
+  else if (this->RouteStorageDirectories.contains(calledAETitle))
+    {
+    storageDirectory = this->RouteStorageDirectories[calledAETitle];
+    accepted = true;
+    }
+  else if (this->HasDefaultRoute)
+    {
+    storageDirectory = this->DefaultStorageDirectory;
+    accepted = true;
+    }
+  else
+    {
+    logger.warn("No database for the called AE title " + calledAETitle);
+    }
+  if (accepted)
+    {
+    ++this->AssociationCount;
+    }
+  else
+    {
+    ++this->RejectedAssociationCount;
+    }
+  }
+  if (!accepted)
+    {
+    emit q->associationRejected(callingAETitle, calledAETitle);
+    }
+  return accepted;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListenerPrivate::associationEnded()
+{
+  QMutexLocker locker(&this->Mutex);
+  --this->AssociationCount;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListenerPrivate::pushReceivedInstance(const ReceivedInstance& instance)
+{
+  QMutexLocker locker(&this->Mutex);
+  ++this->ReceivedCount;
+  if (this->ReceivedInstances.count() >= this->MaximumPendingCount && !this->Stopping)
+    {
+    // delay the C-STORE response until the database catches up
+    ++this->ThrottledCount;
+    QTime timer;
+    timer.start();
+    while (this->ReceivedInstances.count() >= this->MaximumPendingCount && !this->Stopping)
+      {
+      this->QueueNotFull.wait(&this->Mutex);
+      }
+    this->ThrottledTime += timer.elapsed();
+    }
+  this->ReceivedInstances.append(instance);
+  this->PeakPendingCount = qMax(this->PeakPendingCount, this->ReceivedInstances.count());
+
+  if (!this->WriteScheduled)
+    {
+    // run by the event loop of the listener thread, flush() empties the
+    // queue if there is none
+    this->WriteScheduled = true;
+    QMetaObject::invokeMethod(this, "onReceivedInstancesAvailable", Qt::QueuedConnection);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMStorageListenerPrivate::isStopping()
+{
+  QMutexLocker locker(&this->Mutex);
+  return this->Stopping;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListenerPrivate::dimseTimeout()
+{
+  QMutexLocker locker(&this->Mutex);
+  return this->DIMSETimeout;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListenerPrivate::onReceivedInstancesAvailable()
+{
+  {
+  QMutexLocker locker(&this->Mutex);
+  this->WriteScheduled = false;
+  }
+  this->writeReceivedInstances(false);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListenerPrivate::writeReceivedInstances(bool all)
+{
+  Q_Q(ctkDICOMStorageListener);
+  while (true)
+    {
+    QList<ReceivedInstance> batch;
+    bool remaining = false;
+    {
+    QMutexLocker locker(&this->Mutex);
+    batch = this->ReceivedInstances.mid(0, this->BatchSize);
+    this->ReceivedInstances.erase(this->ReceivedInstances.begin(),
+                                  this->ReceivedInstances.begin() + batch.count());
+    this->QueueNotFull.wakeAll();
+    remaining = !this->ReceivedInstances.isEmpty();
+    if (remaining && !all && !this->WriteScheduled)
+      {
+      // one batch at a time, to keep the event loop responsive
+      this->WriteScheduled = true;
+      QMetaObject::invokeMethod(this, "onReceivedInstancesAvailable", Qt::QueuedConnection);
+      }
+    }
+    if (batch.isEmpty())
+      {
+      return;
+      }
+
+    // one transaction per database
+    QMap<QString, QList<ctkDICOMDatabase::IndexingResult> > routedResults;
+    foreach(const ReceivedInstance& instance, batch)
+      {
+      routedResults[instance.CalledAETitle] << instance.IndexingResult;
+      }
+    QMap<QString, QList<ctkDICOMDatabase::IndexingResult> >::const_iterator it;
+    for (it = routedResults.constBegin(); it != routedResults.constEnd(); ++it)
+      {
+      ctkDICOMDatabase* database = q->routeDatabase(it.key());
+      if (!database)
+        {
+        logger.error(QString("The database of %1 was deleted, %2 instances are not inserted")
+                     .arg(it.key()).arg(it.value().count()));
+        continue;
+        }
+      database->insert(it.value());
+      QStringList sopInstanceUIDs;
+      foreach(const ctkDICOMDatabase::IndexingResult& indexingResult, it.value())
+        {
+        sopInstanceUIDs << indexingResult.dataset->GetElementAsString(DCM_SOPInstanceUID);
+        }
+      emit q->instancesInserted(it.key(), sopInstanceUIDs);
+      }
+    {
+    QMutexLocker locker(&this->Mutex);
+    this->InsertedCount += batch.count();
+    }
+    if (!all)
+      {
+      return;
+      }
+    }
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMStorageListener methods
+
+//------------------------------------------------------------------------------
+ctkDICOMStorageListener::ctkDICOMStorageListener(QObject* parentObject)
+  : QObject(parentObject)
+  , d_ptr(new ctkDICOMStorageListenerPrivate(*this))
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMStorageListener::~ctkDICOMStorageListener()
+{
+  this->stop();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::setPort(int port)
+{
+  Q_D(ctkDICOMStorageListener);
+  d->Port = port;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::port()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  return d->Port;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::setMaximumNumberOfAssociations(int maximumNumberOfAssociations)
+{
+  Q_D(ctkDICOMStorageListener);
+  QMutexLocker locker(&d->Mutex);
+  d->MaximumNumberOfAssociations = qMax(1, maximumNumberOfAssociations);
+  d->AssociationPool.setMaxThreadCount(d->MaximumNumberOfAssociations);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::maximumNumberOfAssociations()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->MaximumNumberOfAssociations;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::setMaximumPendingCount(int maximumPendingCount)
+{
+  Q_D(ctkDICOMStorageListener);
+  QMutexLocker locker(&d->Mutex);
+  d->MaximumPendingCount = qMax(1, maximumPendingCount);
+  d->QueueNotFull.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::maximumPendingCount()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->MaximumPendingCount;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::setBatchSize(int batchSize)
+{
+  Q_D(ctkDICOMStorageListener);
+  QMutexLocker locker(&d->Mutex);
+  d->BatchSize = qMax(1, batchSize);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::batchSize()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->BatchSize;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::setDIMSETimeout(int dimseTimeout)
+{
+  Q_D(ctkDICOMStorageListener);
+  QMutexLocker locker(&d->Mutex);
+  d->DIMSETimeout = qMax(1, dimseTimeout);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::dimseTimeout()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->DIMSETimeout;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::setDatabase(ctkDICOMDatabase* database)
+{
+  Q_D(ctkDICOMStorageListener);
+  d->Database = database;
+  d->updateRoutes();
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabase* ctkDICOMStorageListener::database()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  return d->Database;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::addRoute(const QString& calledAETitle, ctkDICOMDatabase* database)
+{
+  Q_D(ctkDICOMStorageListener);
+  d->Routes[calledAETitle.trimmed()] = database;
+  d->updateRoutes();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::removeRoute(const QString& calledAETitle)
+{
+  Q_D(ctkDICOMStorageListener);
+  d->Routes.remove(calledAETitle.trimmed());
+  d->updateRoutes();
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMStorageListener::routes()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  return d->Routes.keys();
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabase* ctkDICOMStorageListener::routeDatabase(const QString& calledAETitle)const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QString aeTitle = calledAETitle.trimmed();
+  if (d->Routes.contains(aeTitle))
+    {
+    return d->Routes[aeTitle];
+    }
+  return d->Database;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMStorageListener::start()
+{
+  Q_D(ctkDICOMStorageListener);
+  if (d->Acceptor)
+    {
+    return true;
+    }
+  OFCondition cond = ASC_initializeNetwork(NET_ACCEPTOR, d->Port, 30, &d->Network);
+  if (cond.bad())
+    {
+    logger.error(QString("Error listening on port %1: %2").arg(d->Port).arg(cond.text()));
+    d->Network = 0;
+    return false;
+    }
+  // the databases may have been opened since the routes were set
+  d->updateRoutes();
+  {
+  QMutexLocker locker(&d->Mutex);
+  d->Stopping = false;
+  d->ReceivedCount = 0;
+  d->InsertedCount = 0;
+  d->PeakPendingCount = 0;
+  d->ThrottledCount = 0;
+  d->ThrottledTime = 0;
+  d->RejectedAssociationCount = 0;
+  }
+  d->Acceptor = new ctkDICOMStorageListenerAcceptor(d);
+  d->Acceptor->start();
+  logger.info(QString("Listening on port %1").arg(d->Port));
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::stop()
+{
+  Q_D(ctkDICOMStorageListener);
+  if (!d->Acceptor)
+    {
+    return;
+    }
+  {
+  QMutexLocker locker(&d->Mutex);
+  d->Stopping = true;
+  d->QueueNotFull.wakeAll();
+  }
+  d->Acceptor->wait();
+  delete d->Acceptor;
+  d->Acceptor = 0;
+  d->AssociationPool.waitForDone();
+  ASC_dropNetwork(&d->Network);
+  d->Network = 0;
+  this->flush();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMStorageListener::isListening()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  return d->Acceptor != 0;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::flush()
+{
+  Q_D(ctkDICOMStorageListener);
+  d->writeReceivedInstances(true);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::receivedCount()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->ReceivedCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::insertedCount()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->InsertedCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::pendingCount()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->ReceivedInstances.count();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::peakPendingCount()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->PeakPendingCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::throttledCount()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->ThrottledCount;
+}
+
+//------------------------------------------------------------------------------
+qint64 ctkDICOMStorageListener::throttledTime()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->ThrottledTime;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::associationCount()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->AssociationCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::rejectedAssociationCount()const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&const_cast<ctkDICOMStorageListenerPrivate*>(d)->Mutex);
+  return d->RejectedAssociationCount;
+}
@@ -0,0 +1,160 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMStorageListener_h
+#define __ctkDICOMStorageListener_h
+
+// Qt includes
+#include <QObject>
+#include <QStringList>
+
+#include "ctkDICOMCoreExport.h"
+
+class ctkDICOMDatabase;
+class ctkDICOMStorageListenerPrivate;
+
+/// \ingroup DICOM_Core
+///
+/// Storage SCP that inserts the instances it receives into ctkDICOMDatabase.
+///
+/// Each association is served on its own thread. A received instance is
+/// written once into the storage directory of its database and the parsed
+/// dataset is inserted without reading the file again. The inserts are done
+/// by batches on the thread of the listener, which must be the thread of the
+/// databases. The batches are scheduled through the event loop of that
+/// thread: without a running event loop, flush() must be called regularly,
+/// otherwise the associations wait as soon as maximumPendingCount instances
+/// are pending.
+///
+/// The database an instance is inserted in is chosen from the called AE
+/// title of the association (see addRoute()). Associations with a called AE
+/// title that has no route go to database(), and are rejected if it is not
+/// set.
+///
+/// When the databases don't keep up with the network, the associations wait
+/// before acknowledging a C-STORE until the number of instances waiting to be
+/// inserted goes below maximumPendingCount. throttledCount() and
+/// throttledTime() report how often and how long it happened.
+class CTK_DICOM_CORE_EXPORT ctkDICOMStorageListener : public QObject
+{
+  Q_OBJECT
+  Q_PROPERTY(int port READ port WRITE setPort)
+  Q_PROPERTY(int maximumNumberOfAssociations READ maximumNumberOfAssociations WRITE setMaximumNumberOfAssociations)
+  Q_PROPERTY(int maximumPendingCount READ maximumPendingCount WRITE setMaximumPendingCount)
+  Q_PROPERTY(int batchSize READ batchSize WRITE setBatchSize)
+  Q_PROPERTY(int dimseTimeout READ dimseTimeout WRITE setDIMSETimeout)
+public:
+  explicit ctkDICOMStorageListener(QObject* parent = 0);
+  virtual ~ctkDICOMStorageListener();
+
+  /// Port to listen on. It is used by the next call to start().
+  /// 11112 by default.
+  void setPort(int port);
+  int port()const;
+
+  /// Associations served at the same time, additional ones are rejected.
+  /// 8 by default.
+  void setMaximumNumberOfAssociations(int maximumNumberOfAssociations);
+  int maximumNumberOfAssociations()const;
+
+  /// Number of received instances waiting to be inserted above which the
+  /// associations wait for the database.
+  /// 500 by default.
+  void setMaximumPendingCount(int maximumPendingCount);
+  int maximumPendingCount()const;
+
+  /// Number of instances inserted within a single transaction.
+  /// 100 by default.
+  void setBatchSize(int batchSize);
+  int batchSize()const;
+
+  /// Time in seconds to wait for the next data of a dataset being received
+  /// before aborting the association. It also bounds the time stop() waits
+  /// for the associations receiving a dataset.
+  /// 30 by default.
+  void setDIMSETimeout(int dimseTimeout);
+  int dimseTimeout()const;
+
+  /// Database of the associations without a route.
+  /// No database by default.
+  void setDatabase(ctkDICOMDatabase* database);
+  ctkDICOMDatabase* database()const;
+
+  /// Insert the instances sent to \a calledAETitle into \a database.
+  /// The instances are stored in the directory of the database at the time
+  /// the association is accepted.
+  void addRoute(const QString& calledAETitle, ctkDICOMDatabase* database);
+  void removeRoute(const QString& calledAETitle);
+  /// Called AE titles that have a route
+  QStringList routes()const;
+  /// Database the instances sent to \a calledAETitle are inserted in,
+  /// database() if there is no route for it.
+  ctkDICOMDatabase* routeDatabase(const QString& calledAETitle)const;
+
+  /// Open the port and accept associations.
+  /// Returns false if the port can't be opened.
+  bool start();
+  /// Close the port, abort the open associations and insert the instances
+  /// already received. The associations receiving a dataset are aborted
+  /// once it is received, or after dimseTimeout() if the peer stalls.
+  void stop();
+  bool isListening()const;
+
+  /// Number of instances received since the start.
+  int receivedCount()const;
+  /// Number of instances inserted in the databases since the start.
+  int insertedCount()const;
+  /// Number of received instances not inserted yet.
+  int pendingCount()const;
+  /// Highest pendingCount() since the start.
+  int peakPendingCount()const;
+  /// Number of C-STORE that waited for the database because
+  /// maximumPendingCount was reached.
+  int throttledCount()const;
+  /// Total time in ms the C-STORE waited for the database.
+  qint64 throttledTime()const;
+  /// Number of associations currently served.
+  int associationCount()const;
+  /// Number of associations rejected, because the called AE title has no
+  /// route or maximumNumberOfAssociations was reached.
+  int rejectedAssociationCount()const;
+
+public Q_SLOTS:
+  /// Insert the instances received so far without waiting for the next
+  /// batch. It must be called regularly if the thread of the listener does
+  /// not run an event loop.
+  void flush();
+
+Q_SIGNALS:
+  /// Emitted after each batch is inserted, with the SOP Instance UIDs
+  /// inserted for the called AE title.
+  void instancesInserted(const QString& calledAETitle, const QStringList& sopInstanceUIDs);
+  /// Emitted when an association is rejected.
+  void associationRejected(const QString& callingAETitle, const QString& calledAETitle);
+
+protected:
+  QScopedPointer<ctkDICOMStorageListenerPrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDICOMStorageListener);
+  Q_DISABLE_COPY(ctkDICOMStorageListener);
+};
+
+#endif
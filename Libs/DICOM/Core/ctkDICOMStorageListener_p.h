@@ -0,0 +1,178 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef CTKDICOMSTORAGELISTENERPRIVATE_H
+#define CTKDICOMSTORAGELISTENERPRIVATE_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMStorageListener.h"
+
+// DCMTK includes
+#include <dcmtk/config/osconfig.h>
+#include <dcmtk/dcmnet/assoc.h>
+#include <dcmtk/dcmnet/dimse.h>
+
+class DcmFileFormat;
+class ctkDICOMStorageListenerPrivate;
+
+//------------------------------------------------------------------------------
+/// \internal
+/// Accepts the associations and hands them over to the association pool.
+class ctkDICOMStorageListenerAcceptor : public QThread
+{
+public:
+  ctkDICOMStorageListenerAcceptor(ctkDICOMStorageListenerPrivate* listener);
+  virtual void run();
+
+protected:
+  void processAssociationRequest(T_ASC_Association* association);
+
+  ctkDICOMStorageListenerPrivate* Listener;
+};
+
+//------------------------------------------------------------------------------
+/// \internal
+/// Serves the C-ECHO and C-STORE requests of a single association. Received
+/// instances are written to the storage directory of the association and
+/// queued for the database through ctkDICOMStorageListenerPrivate::pushReceivedInstance.
+class ctkDICOMStorageAssociationTask : public QRunnable
+{
+public:
+  ctkDICOMStorageAssociationTask(ctkDICOMStorageListenerPrivate* listener,
+                                 T_ASC_Association* association,
+                                 const QString& calledAETitle,
+                                 const QString& storageDirectory);
+  virtual void run();
+
+  /// Called by DIMSE_storeProvider once the dataset is received,
+  /// returns the status of the C-STORE response
+  Uint16 storeInstance(const T_DIMSE_C_StoreRQ& request);
+
+protected:
+  OFCondition store(T_ASC_PresentationContextID presID, T_DIMSE_C_StoreRQ& request);
+
+  ctkDICOMStorageListenerPrivate* Listener;
+  T_ASC_Association* Association;
+  QString CalledAETitle;
+  /// Null for in-memory databases, nothing is written then
+  QString StorageDirectory;
+  /// Directories already created by this association
+  QSet<QString> CreatedDirectories;
+  /// File format the instance being received is read into
+  DcmFileFormat* FileFormat;
+};
+
+//------------------------------------------------------------------------------
+class ctkDICOMStorageListenerPrivate : public QObject
+{
+  Q_OBJECT
+
+  Q_DECLARE_PUBLIC(ctkDICOMStorageListener);
+
+protected:
+  ctkDICOMStorageListener* const q_ptr;
+
+public:
+  ctkDICOMStorageListenerPrivate(ctkDICOMStorageListener&);
+  ~ctkDICOMStorageListenerPrivate();
+
+  struct ReceivedInstance
+  {
+    QString CalledAETitle;
+    ctkDICOMDatabase::IndexingResult IndexingResult;
+  };
+
+  /// Directory the instances of \a database are written to,
+  /// a null string for in-memory databases
+  static QString storageDirectory(ctkDICOMDatabase* database);
+
+  /// Copy the routes for the acceptor thread
+  void updateRoutes();
+
+  /// Called from the acceptor thread. Returns false if the association must
+  /// be rejected, otherwise the association is counted until associationEnded()
+  /// is called.
+  bool reserveAssociation(const QString& callingAETitle, const QString& calledAETitle,
+                          QString& storageDirectory);
+  void associationEnded();
+
+  /// Called from the association threads, blocks while the queue is full.
+  /// The queue is emptied by the event loop of the listener thread, or by flush().
+  void pushReceivedInstance(const ReceivedInstance& instance);
+
+  bool isStopping();
+  int dimseTimeout();
+
+  /// Insert a batch of received instances. All the pending instances are
+  /// inserted if \a all is true.
+  void writeReceivedInstances(bool all);
+
+public Q_SLOTS:
+  /// Invoked through the event loop when instances are queued
+  void onReceivedInstancesAvailable();
+
+public:
+  int Port;
+  int BatchSize;
+
+  /// Only accessed from the thread of the listener
+  QPointer<ctkDICOMDatabase> Database;
+  QHash<QString, QPointer<ctkDICOMDatabase> > Routes;
+
+  T_ASC_Network* Network;
+  ctkDICOMStorageListenerAcceptor* Acceptor;
+  QThreadPool AssociationPool;
+
+  /// Protects all members below
+  QMutex Mutex;
+  QWaitCondition QueueNotFull;
+  int MaximumNumberOfAssociations;
+  int MaximumPendingCount;
+  int DIMSETimeout;
+  bool Stopping;
+  /// Storage directory of each route, for the acceptor thread
+  QHash<QString, QString> RouteStorageDirectories;
+  bool HasDefaultRoute;
+  QString DefaultStorageDirectory;
+  QList<ReceivedInstance> ReceivedInstances;
+  /// Set when a queued call to onReceivedInstancesAvailable is already scheduled
+  bool WriteScheduled;
+
+  int ReceivedCount;
+  int InsertedCount;
+  int PeakPendingCount;
+  int ThrottledCount;
+  qint64 ThrottledTime;
+  int AssociationCount;
+  int RejectedAssociationCount;
+};
+
+#endif // CTKDICOMSTORAGELISTENERPRIVATE_H
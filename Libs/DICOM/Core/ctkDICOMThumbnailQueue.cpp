@@ -0,0 +1,347 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QReadWriteLock>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QWriteLocker>
+
+// ctkDICOMCore includes
+#include "ctkDICOMAbstractThumbnailGenerator.h"
+#include "ctkDICOMThumbnailQueue.h"
+#include "ctkLogger.h"
+
+// DCMTK includes
+#include <dcmtk/dcmimgle/dcmimage.h>
+
+static ctkLogger logger ( "org.commontk.dicom.DICOMThumbnailQueue" );
+
+//------------------------------------------------------------------------------
+class ctkDICOMThumbnailQueuePrivate
+{
+  Q_DECLARE_PUBLIC(ctkDICOMThumbnailQueue);
+protected:
+  ctkDICOMThumbnailQueue* const q_ptr;
+
+public:
+  ctkDICOMThumbnailQueuePrivate(ctkDICOMThumbnailQueue&);
+  virtual ~ctkDICOMThumbnailQueuePrivate();
+
+  struct Request
+  {
+    QString FilePath;
+    QString ThumbnailPath;
+    QString SeriesInstanceUID;
+    QString SOPInstanceUID;
+    int Priority;
+  };
+
+  /// Remove the highest priority request from the queue,
+  /// returns false if there is none
+  bool takeRequest(Request& request);
+
+  /// Start a worker if the pool is not fully used yet
+  void startWorker();
+
+  /// Process requests until the queue is empty
+  void work();
+
+  /// Read locked by the workers while they generate a thumbnail,
+  /// write locked to replace the generator
+  mutable QReadWriteLock GeneratorLock;
+  ctkDICOMAbstractThumbnailGenerator* ThumbnailGenerator;
+  QThreadPool WorkerPool;
+  int MaximumQueueSize;
+
+  /// Protects the members below
+  mutable QMutex Mutex;
+  QList<Request> PendingRequests;
+  QHash<QString, int> SeriesPriorities;
+  int RunningWorkers;
+};
+
+//------------------------------------------------------------------------------
+class ctkDICOMThumbnailQueueWorker : public QRunnable
+{
+public:
+  ctkDICOMThumbnailQueueWorker(ctkDICOMThumbnailQueuePrivate* queue)
+    : Queue(queue)
+  {
+  }
+  virtual void run()
+  {
+    this->Queue->work();
+  }
+private:
+  ctkDICOMThumbnailQueuePrivate* Queue;
+};
+
+//------------------------------------------------------------------------------
+// ctkDICOMThumbnailQueuePrivate methods
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailQueuePrivate::ctkDICOMThumbnailQueuePrivate(ctkDICOMThumbnailQueue& o)
+  : q_ptr(&o)
+{
+  this->ThumbnailGenerator = 0;
+  this->MaximumQueueSize = 10000;
+  this->RunningWorkers = 0;
+  this->WorkerPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailQueuePrivate::~ctkDICOMThumbnailQueuePrivate()
+{
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailQueuePrivate::takeRequest(Request& request)
+{
+  QMutexLocker locker(&this->Mutex);
+  int bestIndex = -1;
+  int bestPriority = 0;
+  for (int i = 0; i < this->PendingRequests.count(); ++i)
+    {
+    const Request& candidate = this->PendingRequests[i];
+    int priority = qMax(candidate.Priority,
+                        this->SeriesPriorities.value(candidate.SeriesInstanceUID, candidate.Priority));
+    // first queued wins among equal priorities
+    if (bestIndex < 0 || priority > bestPriority)
+      {
+      bestIndex = i;
+      bestPriority = priority;
+      }
+    }
+  if (bestIndex < 0)
+    {
+    --this->RunningWorkers;
+    return false;
+    }
+  request = this->PendingRequests.takeAt(bestIndex);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueuePrivate::startWorker()
+{
+  // called with the mutex locked
+  if (this->RunningWorkers < this->WorkerPool.maxThreadCount())
+    {
+    ++this->RunningWorkers;
+    this->WorkerPool.start(new ctkDICOMThumbnailQueueWorker(this));
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueuePrivate::work()
+{
+  Q_Q(ctkDICOMThumbnailQueue);
+  Request request;
+  while (this->takeRequest(request))
+    {
+    bool generated = false;
+    {
+    QReadLocker generatorLocker(&this->GeneratorLock);
+    if (!this->ThumbnailGenerator)
+      {
+      continue;
+      }
+    QDir().mkpath(QFileInfo(request.ThumbnailPath).absolutePath());
+    DicomImage dcmImage(QFile::encodeName(QDir::toNativeSeparators(request.FilePath)).constData());
+    generated = this->ThumbnailGenerator->generateThumbnail(&dcmImage, request.ThumbnailPath);
+    }
+    if (generated)
+      {
+      emit q->thumbnailReady(request.SeriesInstanceUID, request.SOPInstanceUID,
+                             request.ThumbnailPath);
+      }
+    else
+      {
+      logger.warn("Could not generate thumbnail for " + request.FilePath);
+      }
+    }
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMThumbnailQueue methods
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailQueue::ctkDICOMThumbnailQueue(QObject* parentValue)
+  : QObject(parentValue)
+  , d_ptr(new ctkDICOMThumbnailQueuePrivate(*this))
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailQueue::~ctkDICOMThumbnailQueue()
+{
+  // the workers reference the private object
+  this->cancel();
+  this->waitForDone();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::setThumbnailGenerator(ctkDICOMAbstractThumbnailGenerator* generator)
+{
+  Q_D(ctkDICOMThumbnailQueue);
+  // waits for the thumbnails being generated, the pending
+  // requests are processed with the new generator
+  QWriteLocker locker(&d->GeneratorLock);
+  d->ThumbnailGenerator = generator;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMAbstractThumbnailGenerator* ctkDICOMThumbnailQueue::thumbnailGenerator() const
+{
+  Q_D(const ctkDICOMThumbnailQueue);
+  QReadLocker locker(&d->GeneratorLock);
+  return d->ThumbnailGenerator;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::setNumberOfThreads(int count)
+{
+  Q_D(ctkDICOMThumbnailQueue);
+  QMutexLocker locker(&d->Mutex);
+  d->WorkerPool.setMaxThreadCount(qMax(1, count));
+  while (d->RunningWorkers < d->PendingRequests.count()
+         && d->RunningWorkers < d->WorkerPool.maxThreadCount())
+    {
+    d->startWorker();
+    }
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailQueue::numberOfThreads() const
+{
+  Q_D(const ctkDICOMThumbnailQueue);
+  return d->WorkerPool.maxThreadCount();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::setMaximumQueueSize(int size)
+{
+  Q_D(ctkDICOMThumbnailQueue);
+  QMutexLocker locker(&d->Mutex);
+  d->MaximumQueueSize = qMax(1, size);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailQueue::maximumQueueSize() const
+{
+  Q_D(const ctkDICOMThumbnailQueue);
+  QMutexLocker locker(&d->Mutex);
+  return d->MaximumQueueSize;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailQueue::addRequest(const QString& filePath, const QString& thumbnailPath,
+                                        const QString& seriesInstanceUID,
+                                        const QString& sopInstanceUID, int priority)
+{
+  Q_D(ctkDICOMThumbnailQueue);
+  if (!this->thumbnailGenerator())
+    {
+    return false;
+    }
+  QMutexLocker locker(&d->Mutex);
+  if (d->PendingRequests.count() >= d->MaximumQueueSize)
+    {
+    logger.warn("Thumbnail queue is full, skipping " + thumbnailPath);
+    return false;
+    }
+  ctkDICOMThumbnailQueuePrivate::Request request;
+  request.FilePath = filePath;
+  request.ThumbnailPath = thumbnailPath;
+  request.SeriesInstanceUID = seriesInstanceUID;
+  request.SOPInstanceUID = sopInstanceUID;
+  request.Priority = priority;
+  d->PendingRequests.append(request);
+  d->startWorker();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::setSeriesPriority(const QString& seriesInstanceUID, int priority)
+{
+  Q_D(ctkDICOMThumbnailQueue);
+  QMutexLocker locker(&d->Mutex);
+  d->SeriesPriorities[seriesInstanceUID] = priority;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::clearSeriesPriorities()
+{
+  Q_D(ctkDICOMThumbnailQueue);
+  QMutexLocker locker(&d->Mutex);
+  d->SeriesPriorities.clear();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailQueue::pendingCount() const
+{
+  Q_D(const ctkDICOMThumbnailQueue);
+  QMutexLocker locker(&d->Mutex);
+  return d->PendingRequests.count();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::waitForDone()
+{
+  Q_D(ctkDICOMThumbnailQueue);
+  d->WorkerPool.waitForDone();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::cancel()
+{
+  Q_D(ctkDICOMThumbnailQueue);
+  QMutexLocker locker(&d->Mutex);
+  d->PendingRequests.clear();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailQueue::cancelSeries(const QString& seriesInstanceUID)
+{
+  Q_D(ctkDICOMThumbnailQueue);
+  QMutexLocker locker(&d->Mutex);
+  QList<ctkDICOMThumbnailQueuePrivate::Request>::iterator it = d->PendingRequests.begin();
+  while (it != d->PendingRequests.end())
+    {
+    if (it->SeriesInstanceUID == seriesInstanceUID)
+      {
+      it = d->PendingRequests.erase(it);
+      }
+    else
+      {
+      ++it;
+      }
+    }
+}
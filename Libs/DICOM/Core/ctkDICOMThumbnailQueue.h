@@ -0,0 +1,111 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMThumbnailQueue_h
+#define __ctkDICOMThumbnailQueue_h
+
+// Qt includes
+#include <QObject>
+
+#include "ctkDICOMCoreExport.h"
+
+class ctkDICOMAbstractThumbnailGenerator;
+class ctkDICOMThumbnailQueuePrivate;
+
+/// \ingroup DICOM_Core
+///
+/// \brief Generates thumbnails on a dedicated pool of worker threads
+///
+/// Requests are queued with a priority and processed highest priority
+/// first. The priority of all the requests of a series can be raised at
+/// any time, for example for the series currently displayed, and pending
+/// requests can be canceled. thumbnailReady() is emitted from the worker
+/// thread each time a thumbnail has been written.
+///
+class CTK_DICOM_CORE_EXPORT ctkDICOMThumbnailQueue : public QObject
+{
+  Q_OBJECT
+  Q_PROPERTY(int numberOfThreads READ numberOfThreads WRITE setNumberOfThreads)
+  Q_PROPERTY(int maximumQueueSize READ maximumQueueSize WRITE setMaximumQueueSize)
+public:
+  explicit ctkDICOMThumbnailQueue(QObject* parent = 0);
+  virtual ~ctkDICOMThumbnailQueue();
+
+  ///
+  /// Generator used by the worker threads, it must be thread-safe.
+  /// Waits for the thumbnails being generated with the previous generator,
+  /// which is not used anymore once this returns. The pending requests are
+  /// processed with the new generator, they are dropped if it is null.
+  void setThumbnailGenerator(ctkDICOMAbstractThumbnailGenerator* generator);
+  ctkDICOMAbstractThumbnailGenerator* thumbnailGenerator() const;
+
+  ///
+  /// Number of worker threads. Defaults to half of QThread::idealThreadCount(),
+  /// so that thumbnails do not compete with parsing for all the cores.
+  void setNumberOfThreads(int count);
+  int numberOfThreads() const;
+
+  ///
+  /// Maximum number of pending requests, addRequest() fails once it is
+  /// reached. Defaults to 10000.
+  void setMaximumQueueSize(int size);
+  int maximumQueueSize() const;
+
+  ///
+  /// Queue the generation of the thumbnail of \a filePath into \a thumbnailPath.
+  /// \a sopInstanceUID is empty for series thumbnails. Requests with a
+  /// higher priority are processed first.
+  /// Returns false if the queue is full or if there is no generator.
+  Q_INVOKABLE bool addRequest(const QString& filePath, const QString& thumbnailPath,
+                              const QString& seriesInstanceUID, const QString& sopInstanceUID,
+                              int priority = 0);
+
+  ///
+  /// Raise the priority of all the requests of a series, including the
+  /// requests not queued yet. The request priority is used if higher.
+  Q_INVOKABLE void setSeriesPriority(const QString& seriesInstanceUID, int priority);
+  Q_INVOKABLE void clearSeriesPriorities();
+
+  /// Number of requests not processed yet
+  int pendingCount() const;
+
+  /// Block until all the queued requests are processed or canceled
+  Q_INVOKABLE void waitForDone();
+
+public Q_SLOTS:
+  /// Drop all the pending requests, thumbnails being generated are completed
+  void cancel();
+  /// Drop the pending requests of a series
+  void cancelSeries(const QString& seriesInstanceUID);
+
+Q_SIGNALS:
+  /// Emitted from a worker thread when a thumbnail has been written
+  void thumbnailReady(const QString& seriesInstanceUID, const QString& sopInstanceUID,
+                      const QString& thumbnailPath);
+
+protected:
+  QScopedPointer<ctkDICOMThumbnailQueuePrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDICOMThumbnailQueue);
+  Q_DISABLE_COPY(ctkDICOMThumbnailQueue);
+};
+
+#endif
@@ -0,0 +1,171 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTime>
+
+// ctkDICOMWidgets includes
+#include "ctkDICOMFrameCache.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+//------------------------------------------------------------------------------
+int ctkDICOMFrameCacheTest1( int argc, char * argv [] )
+{
+  QApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMFrameCacheTest1: missing dicom directory argument" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QDir directory(argv[1]);
+  QList<ctkDICOMFrameCache::FrameId> sequence;
+  foreach(const QString& fileName, directory.entryList(QDir::Files, QDir::Name))
+    {
+    sequence << ctkDICOMFrameCache::FrameId(directory.filePath(fileName), 0);
+    }
+  if (sequence.count() < 4)
+    {
+    std::cerr << "ctkDICOMFrameCacheTest1: not enough files in " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ctkDICOMFrameCache cache;
+  cache.setPrefetchCount(2);
+
+  // miss then hit
+  ctkDICOMFrameCache::Frame frame = cache.frame(sequence[0].first);
+  if (frame.isNull() || frame.Width <= 0 || frame.Height <= 0
+      || cache.missCount() != 1 || cache.hitCount() != 0)
+    {
+    std::cerr << "ctkDICOMFrameCache::frame() failed to decode "
+              << qPrintable(sequence[0].first) << std::endl;
+    return EXIT_FAILURE;
+    }
+  ctkDICOMFrameCache::Frame cachedFrame = cache.frame(sequence[0].first);
+  if (cache.missCount() != 1 || cache.hitCount() != 1
+      || cachedFrame.Values != frame.Values || cachedFrame.Image != frame.Image)
+    {
+    std::cerr << "ctkDICOMFrameCache::frame() failed to cache the frame" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the frames that follow are prefetched
+  cache.scrollTo(sequence, 0);
+  cache.waitForPrefetch();
+  if (cache.prefetchedCount() != 2
+      || !cache.contains(sequence[1].first) || !cache.contains(sequence[2].first)
+      || cache.contains(sequence[3].first))
+    {
+    std::cerr << "ctkDICOMFrameCache::scrollTo() failed to prefetch: "
+              << cache.prefetchedCount() << std::endl;
+    return EXIT_FAILURE;
+    }
+  cache.frame(sequence[1].first);
+  cache.frame(sequence[2].first);
+  if (cache.missCount() != 1 || cache.hitCount() != 3)
+    {
+    std::cerr << "ctkDICOMFrameCache failed to use the prefetched frames" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // a file written again is decoded again
+  QString copyPath = QDir::temp().filePath("ctkDICOMFrameCacheTest1.dcm");
+  QFile::remove(copyPath);
+  QFile::copy(sequence[0].first, copyPath);
+  cache.frame(copyPath);
+  int otherFile = 1;
+  while (otherFile < sequence.count()
+         && QFileInfo(sequence[otherFile].first).size() == QFileInfo(copyPath).size())
+    {
+    ++otherFile;
+    }
+  if (otherFile < sequence.count())
+    {
+    QFile::remove(copyPath);
+    QFile::copy(sequence[otherFile].first, copyPath);
+    int missCount = cache.missCount();
+    cache.frame(copyPath);
+    if (cache.missCount() != missCount + 1)
+      {
+      std::cerr << "ctkDICOMFrameCache used the frame of a replaced file" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  QFile::remove(copyPath);
+
+  // scrolling backward prefetches the previous frames
+  cache.clear();
+  cache.resetStatistics();
+  const int last = sequence.count() - 1;
+  cache.scrollTo(sequence, last);
+  cache.scrollTo(sequence, last - 1);
+  cache.waitForPrefetch();
+  if (!cache.contains(sequence[last - 2].first) || !cache.contains(sequence[last - 3].first))
+    {
+    std::cerr << "ctkDICOMFrameCache::scrollTo() failed to prefetch backward" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the memory budget is respected
+  cache.clear();
+  cache.setMaximumByteCount(3 * frame.byteCount());
+  cache.setPrefetchCount(0);
+  for (int i = 0; i < sequence.count(); ++i)
+    {
+    cache.frame(sequence[i].first);
+    }
+  if (cache.frameCount() > 3 || cache.byteCount() > cache.maximumByteCount()
+      || !cache.contains(sequence[last].first))
+    {
+    std::cerr << "ctkDICOMFrameCache failed to respect the memory budget: "
+              << cache.frameCount() << " frames, " << cache.byteCount() << " bytes" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // time a scroll through the series, with and without prefetching
+  cache.setMaximumByteCount(512 * 1024 * 1024);
+  for (int prefetchCount = 0; prefetchCount <= 8; prefetchCount += 8)
+    {
+    cache.clear();
+    cache.resetStatistics();
+    cache.setPrefetchCount(prefetchCount);
+    QTime time;
+    time.start();
+    for (int i = 0; i < sequence.count(); ++i)
+      {
+      cache.frame(sequence[i].first);
+      cache.scrollTo(sequence, i);
+      }
+    std::cout << "prefetch " << prefetchCount << ": " << time.elapsed() << " ms, "
+              << cache.hitCount() << " hits, " << cache.missCount() << " misses, "
+              << cache.prefetchedCount() << " prefetched" << std::endl;
+    }
+  cache.waitForPrefetch();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QApplication>
+#include <QByteArray>
+#include <QTime>
+
+// ctkDICOMWidgets includes
+#include "ctkDICOMImage.h"
+
+// DCMTK includes
+#include <dcmimage.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// Conversion through an encoded PGM buffer, as it was done before
+// ctkDICOMImage::toQImage()
+QImage pgmFrame(DicomImage& dicomImage, int frame)
+{
+  QImage image;
+  const unsigned long width = dicomImage.getWidth();
+  const unsigned long height = dicomImage.getHeight();
+  QString header = QString("P5 %1 %2 255\n").arg(width).arg(height);
+  const unsigned long offset = header.length();
+  const unsigned long length = width * height + offset;
+  QByteArray buffer;
+  buffer.append(header);
+  buffer.resize(length);
+  if (dicomImage.getOutputData(static_cast<void *>(buffer.data() + offset), length - offset, 8, frame))
+    {
+    image.loadFromData(buffer);
+    }
+  return image;
+}
+
+//------------------------------------------------------------------------------
+double framesPerSecond(int frameCount, int elapsed)
+{
+  return (1000. * frameCount) / qMax(1, elapsed);
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkDICOMImageTest2( int argc, char * argv [] )
+{
+  QApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMImageTest2: missing dicom filePath argument" << std::endl;
+    return EXIT_FAILURE;
+    }
+  // pass 1000 to time the scrolling of a large series
+  int frameCount = argc > 2 ? QString(argv[2]).toInt() : 200;
+
+  DicomImage dcmtkImage(argv[1]);
+  ctkDICOMImage ctkImage(&dcmtkImage);
+  if (!dcmtkImage.isMonochrome())
+    {
+    std::cerr << "ctkDICOMImageTest2: a monochrome image is expected" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // both conversions give the same pixels
+  QImage expected = pgmFrame(dcmtkImage, 0);
+  QImage image = ctkImage.frame(0);
+  if (image.isNull() || image.size() != expected.size()
+      || image.size() != QSize(dcmtkImage.getWidth(), dcmtkImage.getHeight()))
+    {
+    std::cerr << "ctkDICOMImage::frame() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  for (int y = 0; y < image.height(); ++y)
+    {
+    for (int x = 0; x < image.width(); ++x)
+      {
+      if (qGray(image.pixel(x, y)) != qGray(expected.pixel(x, y)))
+        {
+        std::cerr << "Pixel (" << x << ", " << y << ") differs: " << qGray(image.pixel(x, y))
+                  << " instead of " << qGray(expected.pixel(x, y)) << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  // the window changes every frame, like when scrolling through a series
+  // with the interactive window/level
+  double center = 0.;
+  double width = 0.;
+  dcmtkImage.getWindow(center, width);
+  QTime timer;
+  timer.start();
+  for (int i = 0; i < frameCount; ++i)
+    {
+    dcmtkImage.setWindow(center + (i % 2), width);
+    pgmFrame(dcmtkImage, 0);
+    }
+  int pgmTime = timer.restart();
+  for (int i = 0; i < frameCount; ++i)
+    {
+    dcmtkImage.setWindow(center + (i % 2), width);
+    ctkImage.frame(0);
+    }
+  int directTime = timer.elapsed();
+  std::cout << frameCount << " frames of " << image.width() << "x" << image.height()
+            << ": PGM " << framesPerSecond(frameCount, pgmTime) << " fps, direct "
+            << framesPerSecond(frameCount, directTime) << " fps" << std::endl;
+
+  return EXIT_SUCCESS;
+}
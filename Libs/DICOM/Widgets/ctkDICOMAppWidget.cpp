@@ -209,7 +209,8 @@ void ctkDICOMAppWidgetPrivate::showIndexerDialog()
     // close the dialog
     q->connect(DICOMIndexer.data(), SIGNAL(indexingComplete()),
             IndexerProgress, SLOT(close()));
-    // reset the database to show new data
+    // the model inserts the new data as it is indexed but the database
+    // does not signal removed rows: reset the model to drop them
     q->connect(DICOMIndexer.data(), SIGNAL(indexingComplete()),
             &DICOMModel, SLOT(reset()));
     // stop indexing and reset the database if canceled
@@ -414,7 +415,7 @@ void ctkDICOMAppWidget::setDatabaseDirectory(const QString& directory)
   // update the database schema if needed and provide progress
   this->updateDatabaseSchemaIfNeeded();
 
-  d->DICOMModel.setDatabase(d->DICOMDatabase->database());
+  d->DICOMModel.setDatabase(d->DICOMDatabase.data());
   d->DICOMModel.setEndLevel(ctkDICOMModel::SeriesType);
   d->TreeView->resizeColumnToContents(0);
 
@@ -425,6 +426,7 @@ void ctkDICOMAppWidget::setDatabaseDirectory(const QString& directory)
   // update the button and let any connected slots know about the change
   d->DirectoryButton->setDirectory(directory);
   d->ThumbnailsWidget->setDatabaseDirectory(directory);
+  d->ThumbnailsWidget->setDatabase(d->DICOMDatabase.data());
   d->ImagePreview->setDatabaseDirectory(directory);
   emit databaseDirectoryChanged(directory);
 }
@@ -579,7 +581,7 @@ void ctkDICOMAppWidget::resumeModel()
 {
   Q_D(ctkDICOMAppWidget);
 
-  d->DICOMModel.setDatabase(d->DICOMDatabase->database());
+  d->DICOMModel.setDatabase(d->DICOMDatabase.data());
 }
 
 //----------------------------------------------------------------------------
@@ -989,7 +991,7 @@ void ctkDICOMAppWidget::onThumbnailWidthSliderValueChanged(int val){
 //----------------------------------------------------------------------------
 void ctkDICOMAppWidget::onSearchParameterChanged(){
   Q_D(ctkDICOMAppWidget);
-  d->DICOMModel.setDatabase(d->DICOMDatabase->database(), d->SearchOption->parameters());
+  d->DICOMModel.setDatabase(d->DICOMDatabase->readOnlyDatabase(), d->SearchOption->parameters());
 
   this->onModelSelected(d->DICOMModel.index(0,0));
   d->ThumbnailsWidget->clearThumbnails();
@@ -0,0 +1,531 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCache>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+// ctkDICOMWidgets includes
+#include "ctkDICOMFrameCache.h"
+#include "ctkDICOMImage.h"
+#include "ctkLogger.h"
+
+// DCMTK includes
+#include <dcmtk/dcmimgle/dcmimage.h>
+#include <dcmtk/dcmimgle/dipixel.h>
+#include <dcmtk/dcmimage/diregist.h> /* Include color image support */
+
+// STD includes
+#include <cstring>
+
+static ctkLogger logger ( "org.commontk.dicom.DICOMFrameCache" );
+
+Q_GLOBAL_STATIC(ctkDICOMFrameCache, ctkDICOMFrameCacheGlobalInstance)
+
+//------------------------------------------------------------------------------
+class ctkDICOMFrameCachePrivate
+{
+  Q_DECLARE_PUBLIC(ctkDICOMFrameCache);
+protected:
+  ctkDICOMFrameCache* const q_ptr;
+
+public:
+  typedef ctkDICOMFrameCache::Frame Frame;
+  typedef ctkDICOMFrameCache::FrameId FrameId;
+  /// The frame id with the modification time and the size of the file,
+  /// a file written again is decoded again
+  typedef QPair<FrameId, QPair<qint64, qint64> > FrameKey;
+
+  ctkDICOMFrameCachePrivate(ctkDICOMFrameCache&);
+  virtual ~ctkDICOMFrameCachePrivate();
+
+  /// Reads the file system, call it without the mutex locked
+  static FrameKey frameKey(const FrameId& frameId);
+  static Frame decodeFrame(const FrameId& frameId);
+
+  /// Called with the mutex locked
+  void insertFrame(const FrameKey& key, const Frame& frame);
+  /// Called with the mutex locked
+  void queuePrefetch(const FrameId& frameId);
+
+  /// Decode the pending prefetches until there is none left,
+  /// runs on the prefetch thread
+  void prefetch();
+
+  QThreadPool PrefetchPool;
+
+  /// Protects the members below
+  mutable QMutex Mutex;
+  /// Signaled when a frame is decoded by the prefetcher or when it stops
+  QWaitCondition PrefetchProgress;
+  /// The cost of the frames is in KB, QCache counts with an int
+  QCache<FrameKey, Frame> Frames;
+  int PrefetchCount;
+  QList<FrameId> PendingPrefetches;
+  /// Frame being decoded by the prefetcher
+  QSet<FrameId> Decoding;
+  bool PrefetchRunning;
+  QList<FrameId> LastSequence;
+  int LastIndex;
+
+  int HitCount;
+  int MissCount;
+  int PrefetchedCount;
+};
+
+//------------------------------------------------------------------------------
+class ctkDICOMFrameCachePrefetcher : public QRunnable
+{
+public:
+  ctkDICOMFrameCachePrefetcher(ctkDICOMFrameCachePrivate* cache)
+    : Cache(cache)
+  {
+  }
+  virtual void run()
+  {
+    this->Cache->prefetch();
+  }
+private:
+  ctkDICOMFrameCachePrivate* Cache;
+};
+
+//------------------------------------------------------------------------------
+// ctkDICOMFrameCache::Frame methods
+
+//------------------------------------------------------------------------------
+ctkDICOMFrameCache::Frame::Frame()
+  : Width(0)
+  , Height(0)
+  , IsSigned(false)
+  , Window(0.)
+  , Level(0.)
+{
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMFrameCache::Frame::isNull() const
+{
+  return this->Values.isEmpty() && this->Image.isNull();
+}
+
+//------------------------------------------------------------------------------
+qint64 ctkDICOMFrameCache::Frame::byteCount() const
+{
+  return static_cast<qint64>(this->Values.count()) * sizeof(quint16)
+    + this->Image.byteCount();
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMFrameCachePrivate methods
+
+//------------------------------------------------------------------------------
+ctkDICOMFrameCachePrivate::ctkDICOMFrameCachePrivate(ctkDICOMFrameCache& o)
+  : q_ptr(&o)
+{
+  this->PrefetchPool.setMaxThreadCount(1);
+  this->Frames.setMaxCost(512 * 1024);
+  this->PrefetchCount = 8;
+  this->PrefetchRunning = false;
+  this->LastIndex = -1;
+  this->HitCount = 0;
+  this->MissCount = 0;
+  this->PrefetchedCount = 0;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMFrameCachePrivate::~ctkDICOMFrameCachePrivate()
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMFrameCachePrivate::FrameKey ctkDICOMFrameCachePrivate::frameKey(const FrameId& frameId)
+{
+  QFileInfo fileInfo(frameId.first);
+  return FrameKey(frameId, QPair<qint64, qint64>(
+    fileInfo.lastModified().toMSecsSinceEpoch(), fileInfo.size()));
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMFrameCache::Frame ctkDICOMFrameCachePrivate::decodeFrame(const FrameId& frameId)
+{
+  // only the requested frame of a multi-frame instance is decoded
+  DicomImage dcmImage(QFile::encodeName(QDir::toNativeSeparators(frameId.first)).constData(),
+                      CIF_UsePartialAccessToPixelData, frameId.second, 1);
+  Frame frame = ctkDICOMFrameCache::createFrame(dcmImage);
+  if (frame.isNull())
+    {
+    logger.warn(QString("Could not decode frame %1 of %2").arg(frameId.second).arg(frameId.first));
+    }
+  return frame;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMFrameCachePrivate::insertFrame(const FrameKey& key, const Frame& frame)
+{
+  int cost = static_cast<int>((frame.byteCount() + 1023) / 1024);
+  // QCache drops the least recently used frames to make room, as well as
+  // the frames of files written again since they were decoded
+  this->Frames.insert(key, new Frame(frame), qMax(1, cost));
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMFrameCachePrivate::queuePrefetch(const FrameId& frameId)
+{
+  // cached frames are skipped by prefetch(), the file is not read here
+  if (!this->Decoding.contains(frameId) && !this->PendingPrefetches.contains(frameId))
+    {
+    this->PendingPrefetches << frameId;
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMFrameCachePrivate::prefetch()
+{
+  while (true)
+    {
+    FrameId frameId;
+    {
+    QMutexLocker locker(&this->Mutex);
+    if (this->PendingPrefetches.isEmpty())
+      {
+      this->PrefetchRunning = false;
+      this->PrefetchProgress.wakeAll();
+      return;
+      }
+    frameId = this->PendingPrefetches.takeFirst();
+    this->Decoding.insert(frameId);
+    }
+    FrameKey key = ctkDICOMFrameCachePrivate::frameKey(frameId);
+    bool cached = false;
+    {
+    QMutexLocker locker(&this->Mutex);
+    cached = this->Frames.contains(key);
+    if (cached)
+      {
+      this->Decoding.remove(frameId);
+      this->PrefetchProgress.wakeAll();
+      }
+    }
+    if (cached)
+      {
+      continue;
+      }
+    Frame frame = ctkDICOMFrameCachePrivate::decodeFrame(frameId);
+    {
+    QMutexLocker locker(&this->Mutex);
+    this->Decoding.remove(frameId);
+    if (!frame.isNull())
+      {
+      this->insertFrame(key, frame);
+      ++this->PrefetchedCount;
+      }
+    this->PrefetchProgress.wakeAll();
+    }
+    }
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMFrameCache methods
+
+//------------------------------------------------------------------------------
+ctkDICOMFrameCache::ctkDICOMFrameCache(QObject* parentValue)
+  : QObject(parentValue)
+  , d_ptr(new ctkDICOMFrameCachePrivate(*this))
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMFrameCache::~ctkDICOMFrameCache()
+{
+  Q_D(ctkDICOMFrameCache);
+  // the prefetcher references the private object
+  this->clear();
+  d->PrefetchPool.waitForDone();
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMFrameCache* ctkDICOMFrameCache::globalInstance()
+{
+  return ctkDICOMFrameCacheGlobalInstance();
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMFrameCache::Frame ctkDICOMFrameCache::createFrame(DicomImage& dicomImage)
+{
+  Frame frame;
+  if (dicomImage.getStatus() != EIS_Normal)
+    {
+    return frame;
+    }
+  frame.Width = static_cast<int>(dicomImage.getWidth());
+  frame.Height = static_cast<int>(dicomImage.getHeight());
+  if (!dicomImage.isMonochrome())
+    {
+    frame.Image = ctkDICOMImage::toQImage(&dicomImage);
+    return frame;
+    }
+
+  const DiPixel* pixels = dicomImage.getInterData();
+  const int count = frame.Width * frame.Height;
+  if (!pixels || !pixels->getData() || pixels->getCount() < static_cast<unsigned long>(count))
+    {
+    return frame;
+    }
+  QVector<quint16> values(count);
+  switch (pixels->getRepresentation())
+    {
+    case EPR_Uint8:
+      {
+      const Uint8* data = static_cast<const Uint8*>(pixels->getData());
+      for (int i = 0; i < count; ++i)
+        {
+        values[i] = data[i];
+        }
+      break;
+      }
+    case EPR_Sint8:
+      {
+      const Sint8* data = static_cast<const Sint8*>(pixels->getData());
+      for (int i = 0; i < count; ++i)
+        {
+        values[i] = static_cast<quint16>(static_cast<qint16>(data[i]));
+        }
+      frame.IsSigned = true;
+      break;
+      }
+    case EPR_Uint16:
+    case EPR_Sint16:
+      memcpy(values.data(), pixels->getData(), count * sizeof(quint16));
+      frame.IsSigned = (pixels->getRepresentation() == EPR_Sint16);
+      break;
+    default:
+      // 32-bit modality values are rendered by DicomImage
+      frame.Image = ctkDICOMImage::toQImage(&dicomImage);
+      return frame;
+    }
+  frame.Values = values;
+
+  // keep the window selected by the caller
+  if (!dicomImage.getWindow(frame.Level, frame.Window))
+    {
+    if (dicomImage.getWindowCount() > 0)
+      {
+      dicomImage.setWindow(0);
+      }
+    else
+      {
+      dicomImage.setMinMaxWindow(OFTrue /* ignore extreme values */);
+      }
+    dicomImage.getWindow(frame.Level, frame.Window);
+    }
+  return frame;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMFrameCache::setMaximumByteCount(qint64 byteCount)
+{
+  Q_D(ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  d->Frames.setMaxCost(static_cast<int>(qMin(qMax(byteCount / 1024, qint64(1)),
+                                             qint64(INT_MAX))));
+}
+
+//------------------------------------------------------------------------------
+qint64 ctkDICOMFrameCache::maximumByteCount() const
+{
+  Q_D(const ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  return static_cast<qint64>(d->Frames.maxCost()) * 1024;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMFrameCache::setPrefetchCount(int count)
+{
+  Q_D(ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  d->PrefetchCount = qMax(0, count);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMFrameCache::prefetchCount() const
+{
+  Q_D(const ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  return d->PrefetchCount;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMFrameCache::Frame ctkDICOMFrameCache::frame(const QString& filePath, int frameNumber)
+{
+  Q_D(ctkDICOMFrameCache);
+  FrameId frameId(filePath, frameNumber);
+  ctkDICOMFrameCachePrivate::FrameKey key = ctkDICOMFrameCachePrivate::frameKey(frameId);
+  {
+  QMutexLocker locker(&d->Mutex);
+  while (d->Decoding.contains(frameId))
+    {
+    d->PrefetchProgress.wait(&d->Mutex);
+    }
+  // object() makes it the most recently used frame
+  Frame* cachedFrame = d->Frames.object(key);
+  if (cachedFrame)
+    {
+    ++d->HitCount;
+    return *cachedFrame;
+    }
+  ++d->MissCount;
+  d->PendingPrefetches.removeAll(frameId);
+  }
+  Frame decodedFrame = ctkDICOMFrameCachePrivate::decodeFrame(frameId);
+  if (!decodedFrame.isNull())
+    {
+    QMutexLocker locker(&d->Mutex);
+    d->insertFrame(key, decodedFrame);
+    }
+  return decodedFrame;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMFrameCache::contains(const QString& filePath, int frameNumber) const
+{
+  Q_D(const ctkDICOMFrameCache);
+  ctkDICOMFrameCachePrivate::FrameKey key =
+    ctkDICOMFrameCachePrivate::frameKey(FrameId(filePath, frameNumber));
+  QMutexLocker locker(&d->Mutex);
+  return d->Frames.contains(key);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMFrameCache::scrollTo(const QList<FrameId>& sequence, int index)
+{
+  Q_D(ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  int direction = 1;
+  if (d->LastIndex >= 0 && index < d->LastIndex && sequence == d->LastSequence)
+    {
+    direction = -1;
+    }
+  d->LastSequence = sequence;
+  d->LastIndex = index;
+
+  d->PendingPrefetches.clear();
+  for (int i = 1; i <= d->PrefetchCount; ++i)
+    {
+    int next = index + direction * i;
+    if (next < 0 || next >= sequence.count())
+      {
+      break;
+      }
+    d->queuePrefetch(sequence[next]);
+    }
+  // the previous frame too, in case the scroll turns back
+  int previous = index - direction;
+  if (d->PrefetchCount > 0 && previous >= 0 && previous < sequence.count())
+    {
+    d->queuePrefetch(sequence[previous]);
+    }
+
+  if (!d->PendingPrefetches.isEmpty() && !d->PrefetchRunning)
+    {
+    d->PrefetchRunning = true;
+    d->PrefetchPool.start(new ctkDICOMFrameCachePrefetcher(d));
+    }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMFrameCache::waitForPrefetch()
+{
+  Q_D(ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  while (d->PrefetchRunning)
+    {
+    d->PrefetchProgress.wait(&d->Mutex);
+    }
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMFrameCache::hitCount() const
+{
+  Q_D(const ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  return d->HitCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMFrameCache::missCount() const
+{
+  Q_D(const ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  return d->MissCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMFrameCache::prefetchedCount() const
+{
+  Q_D(const ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  return d->PrefetchedCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMFrameCache::frameCount() const
+{
+  Q_D(const ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  return d->Frames.count();
+}
+
+//------------------------------------------------------------------------------
+qint64 ctkDICOMFrameCache::byteCount() const
+{
+  Q_D(const ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  return static_cast<qint64>(d->Frames.totalCost()) * 1024;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMFrameCache::resetStatistics()
+{
+  Q_D(ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  d->HitCount = 0;
+  d->MissCount = 0;
+  d->PrefetchedCount = 0;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMFrameCache::clear()
+{
+  Q_D(ctkDICOMFrameCache);
+  QMutexLocker locker(&d->Mutex);
+  d->PendingPrefetches.clear();
+  d->Frames.clear();
+  d->LastSequence.clear();
+  d->LastIndex = -1;
+}
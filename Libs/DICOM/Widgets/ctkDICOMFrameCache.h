@@ -0,0 +1,141 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMFrameCache_h
+#define __ctkDICOMFrameCache_h
+
+// Qt includes
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QVector>
+
+#include "ctkDICOMWidgetsExport.h"
+
+class ctkDICOMFrameCachePrivate;
+class DicomImage;
+
+/// \ingroup DICOM_Widgets
+///
+/// \brief Memory bounded cache of decoded DICOM frames
+///
+/// Frames are identified by the file path and the frame number, which
+/// covers the frames of an enhanced multi-frame instance as well as the
+/// instances of a series. The cached frames of a file are only used while
+/// its modification time and size are unchanged. The least recently used
+/// frames are dropped when the decoded frames take more than maximumByteCount.
+///
+/// scrollTo() tells the cache which frame of a sequence is displayed. The
+/// following frames in the direction of the scroll are decoded on a
+/// background thread, so that they are in the cache when displayed.
+///
+/// All the methods are thread-safe. globalInstance() is shared by the
+/// viewers.
+class CTK_DICOM_WIDGETS_EXPORT ctkDICOMFrameCache : public QObject
+{
+  Q_OBJECT
+  Q_PROPERTY(qint64 maximumByteCount READ maximumByteCount WRITE setMaximumByteCount)
+  Q_PROPERTY(int prefetchCount READ prefetchCount WRITE setPrefetchCount)
+public:
+  /// File path and frame number
+  typedef QPair<QString, int> FrameId;
+
+  /// A decoded frame. Monochrome frames of 8 or 16 bit keep the modality
+  /// values (see ctkQImageView::addImage()), the other frames are rendered
+  /// into Image.
+  struct CTK_DICOM_WIDGETS_EXPORT Frame
+  {
+    Frame();
+    bool isNull() const;
+    /// Memory used by the frame
+    qint64 byteCount() const;
+
+    int Width;
+    int Height;
+    QVector<quint16> Values;
+    bool IsSigned;
+    /// Default window/level of the modality values: the first window of
+    /// the dataset, or the range of the values if there is none.
+    double Window;
+    double Level;
+    QImage Image;
+  };
+
+  explicit ctkDICOMFrameCache(QObject* parent = 0);
+  virtual ~ctkDICOMFrameCache();
+
+  /// Cache shared by the DICOM viewers
+  static ctkDICOMFrameCache* globalInstance();
+
+  /// Decode the first frame of \a dicomImage. The window selected in
+  /// \a dicomImage is kept as the default window of the frame; if none is
+  /// selected, the default window is selected in \a dicomImage.
+  /// Returns a null frame if the image can't be rendered.
+  static Frame createFrame(DicomImage& dicomImage);
+
+  /// Memory the cached frames may use. 512 MB by default.
+  void setMaximumByteCount(qint64 byteCount);
+  qint64 maximumByteCount() const;
+
+  /// Number of frames decoded ahead of the displayed frame by scrollTo().
+  /// 0 disables prefetching. 8 by default.
+  void setPrefetchCount(int count);
+  int prefetchCount() const;
+
+  /// Returns the frame, decoding it on the calling thread if it is not
+  /// cached yet. A frame being prefetched is waited for.
+  Frame frame(const QString& filePath, int frameNumber = 0);
+  bool contains(const QString& filePath, int frameNumber = 0) const;
+
+  /// Prefetch the frames around \a index in \a sequence. The frames that
+  /// follow in the direction of the last scroll within the same sequence
+  /// are decoded first; the pending prefetches of the previous call are
+  /// dropped.
+  void scrollTo(const QList<FrameId>& sequence, int index);
+
+  /// Wait until the pending prefetches are done
+  void waitForPrefetch();
+
+  /// Number of frame() calls served from the cache
+  int hitCount() const;
+  /// Number of frame() calls that decoded the frame
+  int missCount() const;
+  /// Number of frames decoded in the background
+  int prefetchedCount() const;
+  /// Number of cached frames
+  int frameCount() const;
+  /// Memory used by the cached frames
+  qint64 byteCount() const;
+  void resetStatistics();
+
+public Q_SLOTS:
+  /// Drop all the frames and the pending prefetches
+  void clear();
+
+protected:
+  QScopedPointer<ctkDICOMFrameCachePrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDICOMFrameCache);
+  Q_DISABLE_COPY(ctkDICOMFrameCache);
+};
+
+#endif
@@ -22,6 +22,7 @@
 // Qt includes
 #include <QDebug>
 #include <QString>
+#include <QVector>
 
 // ctkDICOMCore includes
 #include "ctkDICOMImage.h"
@@ -31,6 +32,9 @@
 #include <dcmimage.h>
 #include <ofbmanip.h>
 
+// STD includes
+#include <cstring>
+
 static ctkLogger logger ( "org.commontk.dicom.DICOMImage" );
 struct Node;
 
@@ -105,33 +109,62 @@ DicomImage* ctkDICOMImage::dicomImage() const
 QImage ctkDICOMImage::frame(int frame) const
 {
   Q_D(const ctkDICOMImage);
+  return ctkDICOMImage::toQImage(d->DicomImage, frame);
+}
 
-  // this way of converting the dicom image to a qpixmap was adopted from some code from
-  // the DCMTK forum, posted by Joerg Riesmayer, see http://forum.dcmtk.org/viewtopic.php?t=120
-  QImage image;
-  if ((d->DicomImage != NULL) && (d->DicomImage->getStatus() == EIS_Normal))
+//------------------------------------------------------------------------------
+QImage ctkDICOMImage::toQImage(DicomImage* dicomImage, int frame)
+{
+  if ((dicomImage == NULL) || (dicomImage->getStatus() != EIS_Normal))
+    {
+    return QImage();
+    }
+  const int width = static_cast<int>(dicomImage->getWidth());
+  const int height = static_cast<int>(dicomImage->getHeight());
+  const bool monochrome = dicomImage->isMonochrome();
+  const int bytesPerPixel = monochrome ? 1 : 3;
+#if QT_VERSION >= 0x050500
+  QImage image(width, height, monochrome ? QImage::Format_Grayscale8 : QImage::Format_RGB888);
+#else
+  QImage image(width, height, monochrome ? QImage::Format_Indexed8 : QImage::Format_RGB888);
+  if (monochrome)
     {
-    /* get image extension */
-    const unsigned long width = d->DicomImage->getWidth();
-    const unsigned long height = d->DicomImage->getHeight();
-    QString header = QString("P5 %1 %2 255\n").arg(width).arg(height);
-    const unsigned long offset = header.length();
-    const unsigned long length = width * height + offset;
-    /* create output buffer for DicomImage class */
-    QByteArray buffer;
-    buffer.append(header);
-    buffer.resize(length);
-
-    /* copy PGM header to buffer */
-
-    if (d->DicomImage->getOutputData(static_cast<void *>(buffer.data() + offset), length - offset, 8, frame))
+    QVector<QRgb> grayTable(256);
+    for (int i = 0; i < 256; ++i)
       {
-
-      if (!image.loadFromData( buffer ))
-        {
-        logger.error("QImage couldn't created");
-        }
+      grayTable[i] = qRgb(i, i, i);
       }
+    image.setColorTable(grayTable);
+    }
+#endif
+  if (image.isNull())
+    {
+    logger.error("QImage couldn't be allocated");
+    return QImage();
+    }
+  const int lineLength = width * bytesPerPixel;
+  const unsigned long length = static_cast<unsigned long>(lineLength) * height;
+  if (image.bytesPerLine() == lineLength)
+    {
+    // the scanlines are contiguous, render straight into the image
+    if (!dicomImage->getOutputData(static_cast<void *>(image.bits()), length, 8, frame))
+      {
+      logger.error("DicomImage couldn't render the frame");
+      return QImage();
+      }
+    return image;
+    }
+  // the scanlines of the image are padded to 32 bits, copy line by line
+  QByteArray buffer;
+  buffer.resize(length);
+  if (!dicomImage->getOutputData(static_cast<void *>(buffer.data()), length, 8, frame))
+    {
+    logger.error("DicomImage couldn't render the frame");
+    return QImage();
+    }
+  for (int y = 0; y < height; ++y)
+    {
+    memcpy(image.scanLine(y), buffer.constData() + y * lineLength, lineLength);
     }
   return image;
 }
@@ -63,6 +63,17 @@ public:
   ///
   QImage frame(int frame = 0) const;
 
+  ///
+  /// \brief Render a frame of \a dicomImage with its current window into
+  /// an 8 bit grayscale or RGB888 image.
+  ///
+  /// The pixels are written directly into the QImage, without going through
+  /// an encoded PGM/PPM buffer. Returns a null image if the frame can't be
+  /// rendered. Grayscale images are Format_Indexed8 with a gray color table
+  /// with Qt older than 5.5.
+  ///
+  static QImage toQImage(DicomImage* dicomImage, int frame = 0);
+
   ///
   /// \brief Returns the number of frames contained in the dicom image.
   /// \sa DicomImage::getFrameCount()
@@ -22,6 +22,7 @@
 
 // DCMTK includes
 #include <dcmtk/dcmimgle/dcmimage.h>
+#include <dcmtk/dcmimgle/dipixel.h>
 #include <dcmtk/dcmimage/diregist.h> /* Include color image support */
 
 // CTK includes
@@ -33,6 +34,8 @@
 #include "ctkDICOMModel.h"
 
 // ctkDICOMWidgets includex
+#include "ctkDICOMFrameCache.h"
+#include "ctkDICOMImage.h"
 #include "ctkDICOMItemView.h"
 
 // Qt includes
@@ -64,10 +67,27 @@ public:
   double DicomIntensityLevel;
   double DicomIntensityWindow;
   bool AutoWindowLevel;
+  ctkDICOMFrameCache* FrameCache;
+  /// Files of the series of the current image, in the model order
+  QString SequenceSeriesUID;
+  QList<ctkDICOMFrameCache::FrameId> Sequence;
 
   void init();
 
+  QString filePath(const QModelIndex& imageIndex)const;
   void setImage(const QModelIndex& imageIndex, bool defaultIntensity = true);
+  /// Prefetch the images that follow \a imageIndex in its series
+  void prefetch(const QModelIndex& imageIndex);
+
+  /// Add a decoded frame to the view. The window/level of modality values
+  /// is applied by the view, it doesn't need to decode the frame again when
+  /// it changes. Returns false if the frame is null.
+  bool addFrame(const ctkDICOMFrameCache::Frame& frame);
+
+  /// Add the modality values of a monochrome image to the view, the view
+  /// applies the window/level itself. Returns false if the values are not
+  /// 8 or 16 bit.
+  bool addModalityImage(DicomImage& dcmImage);
 
   void onPatientModelSelected(const QModelIndex& index);
   void onStudyModelSelected(const QModelIndex& index);
@@ -101,6 +121,8 @@ void ctkDICOMItemViewPrivate::init()
 
   this->AutoWindowLevel = true;
 
+  this->FrameCache = ctkDICOMFrameCache::globalInstance();
+
   /*
   this->Window->setParent(q);
   QHBoxLayout* layout = new QHBoxLayout(q);
@@ -110,6 +132,19 @@ void ctkDICOMItemViewPrivate::init()
   */
 }
 
+// -------------------------------------------------------------------------
+QString ctkDICOMItemViewPrivate::filePath(const QModelIndex &imageIndex)const{
+    const QAbstractItemModel* model = imageIndex.model();
+    QModelIndex seriesIndex = imageIndex.parent();
+    QModelIndex studyIndex = seriesIndex.parent();
+
+    QString dicomPath = this->DatabaseDirectory;
+    dicomPath.append("/dicom/").append(model->data(studyIndex ,ctkDICOMModel::UIDRole).toString());
+    dicomPath.append("/").append(model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString());
+    dicomPath.append("/").append(model->data(imageIndex ,ctkDICOMModel::UIDRole).toString());
+    return dicomPath;
+}
+
 // -------------------------------------------------------------------------
 void ctkDICOMItemViewPrivate::setImage(const QModelIndex &imageIndex, bool defaultIntensity){
     Q_Q(ctkDICOMItemView);
@@ -118,27 +153,95 @@ void ctkDICOMItemViewPrivate::setImage(const QModelIndex &imageIndex, bool defau
 
     if(model){
         QModelIndex seriesIndex = imageIndex.parent();
-        QModelIndex studyIndex = seriesIndex.parent();
-
-        QString dicomPath = this->DatabaseDirectory;
-        dicomPath.append("/dicom/").append(model->data(studyIndex ,ctkDICOMModel::UIDRole).toString());
-        dicomPath.append("/").append(model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString());
-        dicomPath.append("/").append(model->data(imageIndex ,ctkDICOMModel::UIDRole).toString());
+        QString dicomPath = this->filePath(imageIndex);
 
         if (QFile(dicomPath).exists()){
-          DicomImage dcmImage(  QDir::toNativeSeparators(dicomPath).toStdString().c_str() );
+            ctkDICOMFrameCache::Frame frame = this->FrameCache->frame(dicomPath);
 
             q->clearImages();
-            q->addImage(dcmImage, defaultIntensity);
+            // the window/level of modality values is applied by the view, the
+            // other frames are rendered with their default window
+            bool rendered = !frame.Values.isEmpty() || (this->AutoWindowLevel && defaultIntensity);
+            if (!rendered || !this->addFrame(frame)){
+                DicomImage dcmImage(  QFile::encodeName(QDir::toNativeSeparators(dicomPath)).constData() );
+                q->addImage(dcmImage, defaultIntensity);
+            }
             this->CurrentImageIndex = imageIndex;
 
             q->emitImageDisplayedSignal(imageIndex.row(), model->rowCount(seriesIndex));
+            this->prefetch(imageIndex);
         }else{
             q->clearImages();
         }
     }
 }
 
+// -------------------------------------------------------------------------
+void ctkDICOMItemViewPrivate::prefetch(const QModelIndex &imageIndex){
+    const QAbstractItemModel* model = imageIndex.model();
+    QModelIndex seriesIndex = imageIndex.parent();
+    QString seriesUID = model->data(seriesIndex, ctkDICOMModel::UIDRole).toString();
+    int imageCount = model->rowCount(seriesIndex);
+
+    if (seriesUID != this->SequenceSeriesUID || imageCount != this->Sequence.count()){
+        this->SequenceSeriesUID = seriesUID;
+        this->Sequence.clear();
+        for (int row = 0; row < imageCount; ++row){
+            this->Sequence << ctkDICOMFrameCache::FrameId(
+              this->filePath(model->index(row, 0, seriesIndex)), 0);
+        }
+    }
+    this->FrameCache->scrollTo(this->Sequence, imageIndex.row());
+}
+
+// -------------------------------------------------------------------------
+bool ctkDICOMItemViewPrivate::addFrame(const ctkDICOMFrameCache::Frame& frame)
+{
+    Q_Q(ctkDICOMItemView);
+
+    if (frame.isNull())
+    {
+      return false;
+    }
+    if (frame.Values.isEmpty())
+    {
+      q->ctkQImageView::addImage(frame.Image);
+      return true;
+    }
+    if (this->AutoWindowLevel)
+    {
+      this->DicomIntensityWindow = frame.Window;
+      this->DicomIntensityLevel = frame.Level;
+    }
+    // the values are mapped once, with the window/level they are shown with
+    q->ctkQImageView::addImage(frame.Values, frame.Width, frame.Height, frame.IsSigned,
+                               this->DicomIntensityWindow, this->DicomIntensityLevel);
+    return true;
+}
+
+// -------------------------------------------------------------------------
+bool ctkDICOMItemViewPrivate::addModalityImage(DicomImage& dcmImage)
+{
+    const DiPixel* pixels = dcmImage.getInterData();
+    if (!dcmImage.isMonochrome() || !pixels)
+    {
+      return false;
+    }
+    switch (pixels->getRepresentation())
+    {
+      case EPR_Uint8:
+      case EPR_Sint8:
+      case EPR_Uint16:
+      case EPR_Sint16:
+        break;
+      default:
+        return false;
+    }
+    // the values are read as for the cached frames
+    ctkDICOMFrameCache::Frame frame = ctkDICOMFrameCache::createFrame(dcmImage);
+    return !frame.Values.isEmpty() && this->addFrame(frame);
+}
+
 // -------------------------------------------------------------------------
 void ctkDICOMItemViewPrivate::onPatientModelSelected(const QModelIndex &index){
     Q_Q(ctkDICOMItemView);
@@ -249,6 +352,22 @@ void ctkDICOMItemView::setDatabaseDirectory(const QString &directory){
     d->DatabaseDirectory = directory;
 }
 
+// -------------------------------------------------------------------------
+void ctkDICOMItemView::setFrameCache(ctkDICOMFrameCache* frameCache){
+    Q_D(ctkDICOMItemView);
+
+    d->FrameCache = frameCache ? frameCache : ctkDICOMFrameCache::globalInstance();
+    d->SequenceSeriesUID.clear();
+    d->Sequence.clear();
+}
+
+// -------------------------------------------------------------------------
+ctkDICOMFrameCache* ctkDICOMItemView::frameCache()const{
+    Q_D(const ctkDICOMItemView);
+
+    return d->FrameCache;
+}
+
 // -------------------------------------------------------------------------
 QModelIndex ctkDICOMItemView::currentImageIndex(){
     Q_D(ctkDICOMItemView);
@@ -266,7 +385,6 @@ void ctkDICOMItemView::addImage( const QImage & image )
 void ctkDICOMItemView::addImage( DicomImage & dcmImage, bool defaultIntensity )
 {
     Q_D(ctkDICOMItemView);
-    QImage image;
     // Check whether we have a valid image
     EI_Status result = dcmImage.getStatus();
     if (result != EIS_Normal)
@@ -295,40 +413,16 @@ void ctkDICOMItemView::addImage( DicomImage & dcmImage, bool defaultIntensity )
     {
       dcmImage.setWindow(d->DicomIntensityLevel, d->DicomIntensityWindow);
     }
-    /* get image extension and prepare image header */
-    const unsigned long width = dcmImage.getWidth();
-    const unsigned long height = dcmImage.getHeight();
-    unsigned long offset = 0;
-    unsigned long length = 0;
-    QString header;
-
-    if (dcmImage.isMonochrome())
+    // the window/level of modality values is applied by the view, it
+    // doesn't need to render the image again when it changes
+    if (d->addModalityImage(dcmImage))
     {
-      // write PGM header (binary monochrome image format)
-      header = QString("P5 %1 %2 255\n").arg(width).arg(height);
-      offset = header.length();
-      length = width * height + offset;
+      return;
     }
-    else
+    QImage image = ctkDICOMImage::toQImage(&dcmImage);
+    if (image.isNull())
     {
-      // write PPM header (binary color image format)
-      header = QString("P6 %1 %2 255\n").arg(width).arg(height);
-      offset = header.length();
-      length = width * height * 3 /* RGB */ + offset;
-    }
-    /* create output buffer for DicomImage class */
-    QByteArray buffer;
-    /* copy header to output buffer and resize it for pixel data */
-    buffer.append(header);
-    buffer.resize(length);
-
-    /* render pixel data to buffer */
-    if (dcmImage.getOutputData(static_cast<void *>(buffer.data() + offset), length - offset, 8, 0))
-    {  
-      if (!image.loadFromData( buffer ))
-        {
-            logger.error("QImage couldn't created");
-        }
+      logger.error("QImage couldn't created");
     }
     this->addImage(image);
 }
@@ -377,7 +471,14 @@ void ctkDICOMItemView::mouseMoveEvent(QMouseEvent* event){
         d->DicomIntensityLevel -= (5*(nowPos.y()-d->OldMousePos.y()));
         d->AutoWindowLevel = false;
 
-        d->setImage(d->CurrentImageIndex, false);
+        if (this->isModalityImage())
+        {
+          this->setIntensityWindowLevel(d->DicomIntensityWindow, d->DicomIntensityLevel);
+        }
+        else
+        {
+          d->setImage(d->CurrentImageIndex, false);
+        }
 
         d->OldMousePos = event->pos();
     }
@@ -31,6 +31,7 @@
 #include "ctkPimpl.h"
 #include "ctkDICOMWidgetsExport.h"
 
+class ctkDICOMFrameCache;
 class ctkDICOMItemViewPrivate;
 class DicomImage;
 
@@ -56,6 +57,12 @@ public:
 
   void setDatabaseDirectory(const QString& directory);
 
+  /// Cache of the decoded images. The images that follow the displayed
+  /// image in its series are prefetched into it.
+  /// ctkDICOMFrameCache::globalInstance() by default, 0 restores it.
+  void setFrameCache(ctkDICOMFrameCache* frameCache);
+  ctkDICOMFrameCache* frameCache()const;
+
   QModelIndex currentImageIndex();
 
 Q_SIGNALS:
@@ -26,6 +26,7 @@
 #include <QMouseEvent>
 #include <QSortFilterProxyModel>
 #include <QSqlQueryModel>
+#include <QSqlRecord>
 
 //------------------------------------------------------------------------------
 class ctkDICOMTableViewPrivate : public Ui_ctkDICOMTableView
@@ -49,6 +50,11 @@ public:
 
   QString queryTableName() const;
 
+  /// The search box filters the rows in the SQL query rather than in the
+  /// proxy model when the database has a search index of all the columns shown
+  bool useSearchIndex() const;
+  QString searchIndexCondition() const;
+
   ctkDICOMDatabase* dicomDatabase;
   QSqlQueryModel dicomSQLModel;
   QSortFilterProxyModel* dicomSQLFilterModel;
@@ -57,6 +63,8 @@ public:
   QStringList currentSelection;
   //Key = QString for columns, Values = QStringList
   QHash<QString, QStringList> sqlWhereConditions;
+  /// uids of the last query, the query is updated as the search text changes
+  QStringList queryUIDs;
 
 };
 
@@ -115,9 +123,6 @@ void ctkDICOMTableViewPrivate::init()
   QObject::connect(this->tblDicomDatabaseView, SIGNAL(doubleClicked(const QModelIndex&)),
                    q, SIGNAL(doubleClicked(const QModelIndex&)));
 
-  QObject::connect(this->leSearchBox, SIGNAL(textChanged(QString)),
-                   this->dicomSQLFilterModel, SLOT(setFilterWildcard(QString)));
-
   QObject::connect(this->leSearchBox, SIGNAL(textChanged(QString)), q, SLOT(onFilterChanged()));
 }
 
@@ -142,6 +147,47 @@ QString ctkDICOMTableViewPrivate::queryTableName() const
   return this->lblTableName->text();
 }
 
+//----------------------------------------------------------------------------
+bool ctkDICOMTableViewPrivate::useSearchIndex() const
+{
+  if (this->dicomDatabase == 0
+      || !ctkDICOMDatabase::hasSearchIndex(this->dicomDatabase->database()))
+    {
+    return false;
+    }
+  // the proxy model searches all the columns, the index is only used
+  // if it has all those that are shown
+  const QStringList indexedFields = ctkDICOMDatabase::searchIndexFields(this->queryTableName());
+  const QSqlRecord record = this->dicomSQLModel.record();
+  for (int i = 0; i < record.count(); ++i)
+    {
+    if (!this->tblDicomDatabaseView->isColumnHidden(i)
+        && !indexedFields.contains(record.fieldName(i)))
+      {
+      return false;
+      }
+    }
+  return !indexedFields.isEmpty();
+}
+
+//----------------------------------------------------------------------------
+QString ctkDICOMTableViewPrivate::searchIndexCondition() const
+{
+  QString text = this->leSearchBox->text();
+  if (text.isEmpty() || !this->useSearchIndex())
+    {
+    return QString();
+    }
+  // same wildcards as the proxy model
+  text.replace('*', '%').replace('?', '_');
+  QStringList conditions;
+  foreach(const QString& field, ctkDICOMDatabase::searchIndexFields(this->queryTableName()))
+    {
+    conditions << ctkDICOMDatabase::searchCondition(field, text);
+    }
+  return " and ( " + conditions.join(" or ") + " )";
+}
+
 //----------------------------------------------------------------------------
 void ctkDICOMTableViewPrivate::showFilterActiveWarning(bool showWarning)
 {
@@ -260,6 +306,16 @@ void ctkDICOMTableView::onFilterChanged()
 {
   Q_D(ctkDICOMTableView);
 
+  if (d->useSearchIndex())
+    {
+    d->dicomSQLFilterModel->setFilterWildcard(QString());
+    this->setQuery(d->queryUIDs);
+    }
+  else
+    {
+    d->dicomSQLFilterModel->setFilterWildcard(d->leSearchBox->text());
+    }
+
   const QStringList uids = this->uidsForAllRows();
 
   d->showFilterActiveWarning( d->dicomSQLFilterModel->rowCount() == 0 &&
@@ -331,8 +387,10 @@ void ctkDICOMTableView::setQuery(const QStringList &uids)
           ++i;
         }
     }
+  d->queryUIDs = uids;
   if (d->dicomDatabase != 0)
-    d->dicomSQLModel.setQuery(query.arg(d->queryTableName()), d->dicomDatabase->database());
+    d->dicomSQLModel.setQuery(query.arg(d->queryTableName()) + d->searchIndexCondition(),
+                              d->dicomDatabase->readOnlyDatabase());
 }
 
 void ctkDICOMTableView::addSqlWhereCondition(const std::pair<QString, QStringList> &condition)
@@ -20,6 +20,7 @@
 =========================================================================*/
 
 // ctkDICOMCore includes
+#include "ctkDICOMImage.h"
 #include "ctkDICOMThumbnailGenerator.h"
 #include "ctkLogger.h"
 
@@ -75,7 +76,6 @@ ctkDICOMThumbnailGenerator::~ctkDICOMThumbnailGenerator()
 
 //------------------------------------------------------------------------------
 bool ctkDICOMThumbnailGenerator::generateThumbnail(DicomImage *dcmImage, const QString &path){
-    QImage image;
     // Check whether we have a valid image
     EI_Status result = dcmImage->getStatus();
     if (result != EIS_Normal)
@@ -96,41 +96,11 @@ bool ctkDICOMThumbnailGenerator::generateThumbnail(DicomImage *dcmImage, const Q
           dcmImage->setMinMaxWindow(OFTrue /* ignore extreme values */);
         }
     }
-    /* get image extension and prepare image header */
-    const unsigned long width = dcmImage->getWidth();
-    const unsigned long height = dcmImage->getHeight();
-    unsigned long offset = 0;
-    unsigned long length = 0;
-    QString header;
-
-    if (dcmImage->isMonochrome())
-    {
-      // write PGM header (binary monochrome image format)
-      header = QString("P5 %1 %2 255\n").arg(width).arg(height);
-      offset = header.length();
-      length = width * height + offset;
-    }
-    else
+    QImage image = ctkDICOMImage::toQImage(dcmImage);
+    if (image.isNull())
     {
-      // write PPM header (binary color image format)
-      header = QString("P6 %1 %2 255\n").arg(width).arg(height);
-      offset = header.length();
-      length = width * height * 3 /* RGB */ + offset;
-    }
-    /* create output buffer for DicomImage class */
-    QByteArray buffer;
-    /* copy header to output buffer and resize it for pixel data */
-    buffer.append(header);
-    buffer.resize(length);
-
-    /* render pixel data to buffer */
-    if (dcmImage->getOutputData(static_cast<void *>(buffer.data() + offset), length - offset, 8, 0))
-    {  
-      if (!image.loadFromData( buffer ))
-        {
-            logger.error("QImage couldn't created");
-            return false;
-        }
+      logger.error("QImage couldn't created");
+      return false;
     }
     image.scaled(128,128,Qt::KeepAspectRatio).save(path,"PNG");
     return true;
@@ -24,9 +24,11 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QGridLayout>
+#include <QHash>
 #include <QMetaType>
 #include <QPersistentModelIndex>
 #include <QPixmap>
+#include <QPointer>
 #include <QPushButton>
 #include <QResizeEvent>
 
@@ -34,7 +36,6 @@
 #include "ctkLogger.h"
 
 // ctkWidgets includes
-#include "ctkFlowLayout.h"
 #include "ctkThumbnailListWidget_p.h"
 #include "ui_ctkThumbnailListWidget.h"
 
@@ -42,6 +43,7 @@
 #include "ctkDICOMDatabase.h"
 #include "ctkDICOMFilterProxyModel.h"
 #include "ctkDICOMModel.h"
+#include "ctkDICOMThumbnailQueue.h"
 
 // ctkDICOMWidgets includes
 #include "ctkDICOMThumbnailListWidget.h"
@@ -68,6 +70,7 @@ public:
 
   QString DatabaseDirectory;
   QModelIndex CurrentSelectedModel;
+  QPointer<ctkDICOMDatabase> Database;
 
   void addThumbnailWidget(const QModelIndex &imageIndex, const QModelIndex& sourceIndex, const QString& text);
 
@@ -182,31 +185,62 @@ void ctkDICOMThumbnailListWidgetPrivate
   QModelIndex seriesIndex = imageIndex.parent();
   QModelIndex studyIndex = seriesIndex.parent();
 
-  QString thumbnailPath = this->DatabaseDirectory +
+  QString seriesInstanceUID = model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString();
+  QString sopInstanceUID = model->data(imageIndex, ctkDICOMModel::UIDRole).toString();
+  QString seriesThumbnailPath = this->DatabaseDirectory +
                           "/thumbs/" + model->data(studyIndex ,ctkDICOMModel::UIDRole).toString() + "/" +
-                          model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString() + "/" +
-                          model->data(imageIndex, ctkDICOMModel::UIDRole).toString() + ".png";
-  if(!QFileInfo(thumbnailPath).exists())
+                          seriesInstanceUID;
+  QString thumbnailPath = seriesThumbnailPath + "/" + sopInstanceUID + ".png";
+  seriesThumbnailPath += ".png";
+
+  // image entries show their own thumbnail, study and series entries the
+  // thumbnail of their series, or else the one of the image
+  const bool isImageEntry = (sourceIndex == imageIndex);
+  QString wantedThumbnailPath = isImageEntry ? thumbnailPath : seriesThumbnailPath;
+  QString availableThumbnailPath;
+  if (QFileInfo(wantedThumbnailPath).exists())
     {
-    return;
+    availableThumbnailPath = wantedThumbnailPath;
+    }
+  else if (!isImageEntry && QFileInfo(thumbnailPath).exists())
+    {
+    availableThumbnailPath = thumbnailPath;
     }
-  ctkThumbnailLabel* widget = new ctkThumbnailLabel(this->ScrollAreaContentWidget);
 
-  QString widgetLabel = text;
-  widget->setText( widgetLabel );
-  QPixmap pix(thumbnailPath);
-  logger.debug("Setting pixmap to " + thumbnailPath);
-  if(this->ThumbnailSize.isValid())
+  ctkDICOMThumbnailQueue* queue = this->Database ? this->Database->thumbnailQueue() : 0;
+  if (queue && !queue->thumbnailGenerator())
+    {
+    queue = 0;
+    }
+  if (availableThumbnailPath.isEmpty() && !queue)
+    {
+    return;
+    }
+  Thumbnail thumbnail;
+  thumbnail.Text = text;
+  if (queue)
     {
-    widget->setFixedSize(this->ThumbnailSize);
+    // what is displayed is generated first
+    queue->setSeriesPriority(seriesInstanceUID, 1);
+    }
+  if (!availableThumbnailPath.isEmpty())
+    {
+    thumbnail.FilePath = availableThumbnailPath;
+    }
+  else
+    {
+    // placeholder until the thumbnail is generated, see onThumbnailReady()
+    thumbnail.FilePath = wantedThumbnailPath;
+    this->FailedFiles.insert(wantedThumbnailPath);
+    queue->addRequest(this->Database->fileForInstance(sopInstanceUID), wantedThumbnailPath,
+                      seriesInstanceUID, isImageEntry ? sopInstanceUID : QString(), 1);
     }
-  widget->setPixmap(pix);
 
   QVariant var;
   var.setValue(QPersistentModelIndex(sourceIndex));
-  widget->setProperty("sourceIndex", var);
+  thumbnail.Properties["sourceIndex"] = var;
 
-  this->addThumbnail(widget);
+  this->addThumbnail(thumbnail);
 }
 
 //----------------------------------------------------------------------------
@@ -232,6 +266,33 @@ void ctkDICOMThumbnailListWidget::setDatabaseDirectory(const QString &directory)
   d->DatabaseDirectory = directory;
 }
 
+//----------------------------------------------------------------------------
+void ctkDICOMThumbnailListWidget::setDatabase(ctkDICOMDatabase* database)
+{
+  Q_D(ctkDICOMThumbnailListWidget);
+  if (d->Database)
+    {
+    disconnect(d->Database->thumbnailQueue(), 0, this, 0);
+    }
+  d->Database = database;
+  if (database)
+    {
+    connect(database->thumbnailQueue(), SIGNAL(thumbnailReady(QString,QString,QString)),
+            this, SLOT(onThumbnailReady(QString,QString,QString)));
+    }
+}
+
+//----------------------------------------------------------------------------
+void ctkDICOMThumbnailListWidget::onThumbnailReady(const QString& seriesInstanceUID,
+                                                   const QString& sopInstanceUID,
+                                                   const QString& thumbnailPath)
+{
+  Q_D(ctkDICOMThumbnailListWidget);
+  Q_UNUSED(seriesInstanceUID);
+  Q_UNUSED(sopInstanceUID);
+  d->reloadThumbnailFile(thumbnailPath);
+}
+
 //----------------------------------------------------------------------------
 void ctkDICOMThumbnailListWidget::selectThumbnailFromIndex(const QModelIndex &index){
   Q_D(ctkDICOMThumbnailListWidget);
@@ -249,19 +310,12 @@ void ctkDICOMThumbnailListWidget::selectThumbnailFromIndex(const QModelIndex &in
 
   if(model)
     {
-    int count = d->ScrollAreaContentWidget->layout()->count();
-
-    for(int i=0; i<count; i++)
+    for(int i=0; i<d->Thumbnails.count(); i++)
       {
-      ctkThumbnailLabel* thumbnailWidget = qobject_cast<ctkThumbnailLabel*>(d->ScrollAreaContentWidget->layout()->itemAt(i)->widget());
-      if(thumbnailWidget->property("sourceIndex").value<QPersistentModelIndex>() == index)
+      if(d->Thumbnails[i].Properties.value("sourceIndex").value<QPersistentModelIndex>() == index)
         {
-        thumbnailWidget->setSelected(true);
-        d->ScrollArea->ensureWidgetVisible(thumbnailWidget);
-        }
-      else
-        {
-        thumbnailWidget->setSelected(false);
+        this->setCurrentThumbnail(i);
+        return;
         }
       }
     }
@@ -273,6 +327,10 @@ void ctkDICOMThumbnailListWidget::addThumbnails(const QModelIndex &index)
   Q_D(ctkDICOMThumbnailListWidget);
 
   this->clearThumbnails();
+  if (d->Database)
+    {
+    d->Database->thumbnailQueue()->clearSeriesPriorities();
+    }
 
   ctkDICOMModel* model = const_cast<ctkDICOMModel*>(qobject_cast<const ctkDICOMModel*>(index.model()));
 
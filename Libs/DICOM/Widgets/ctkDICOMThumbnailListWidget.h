@@ -25,6 +25,7 @@
 #include "ctkThumbnailListWidget.h"
 
 class QModelIndex;
+class ctkDICOMDatabase;
 class ctkDICOMThumbnailListWidgetPrivate;
 class ctkThumbnailWidget;
 
@@ -39,6 +40,12 @@ public:
 
   void setDatabaseDirectory(const QString& directory);
 
+  /// If set, missing thumbnails are shown as placeholders and requested
+  /// from the database thumbnail queue, with priority over the thumbnails
+  /// of the series not displayed. Placeholders are updated as the
+  /// thumbnails are generated.
+  void setDatabase(ctkDICOMDatabase* database);
+
   void selectThumbnailFromIndex(const QModelIndex& index);
 
 private:
@@ -47,6 +54,10 @@ private:
 
 public Q_SLOTS:
   void addThumbnails(const QModelIndex& index);
+
+protected Q_SLOTS:
+  void onThumbnailReady(const QString& seriesInstanceUID, const QString& sopInstanceUID,
+                        const QString& thumbnailPath);
 };
 
 #endif
@@ -0,0 +1,172 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#include "ctkPluginFrameworkPerfInstallTestSuite_p.h"
+
+#include <ctkPlugin.h>
+#include <ctkPluginContext.h>
+#include <ctkPluginException.h>
+#include <ctkHighPrecisionTimer.h>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTest>
+#include <QUrl>
+
+//----------------------------------------------------------------------------
+ctkPluginFrameworkPerfInstallTestSuite::ctkPluginFrameworkPerfInstallTestSuite(ctkPluginContext* context)
+  : QObject(0)
+  , pc(context)
+  , nPlugins(200)
+{
+  this->setObjectName("ctkPluginFrameworkPerfInstallTestSuite");
+}
+
+//----------------------------------------------------------------------------
+void ctkPluginFrameworkPerfInstallTestSuite::initTestCase()
+{
+  QDir testPluginDir(pc->getProperty("pluginfw.testDir").toString());
+  QFileInfo libInfo;
+  QStringList libSuffixes;
+  libSuffixes << ".so" << ".dll" << ".dylib";
+  foreach(QString libSuffix, libSuffixes)
+  {
+    libInfo = QFileInfo(testPluginDir, "libpluginA_test" + libSuffix);
+    if (libInfo.exists()) break;
+  }
+  QVERIFY2(libInfo.exists(), "Test plug-in not found");
+  QFileInfo rccInfo(libInfo.absoluteFilePath() + ".rcc");
+  QVERIFY2(rccInfo.exists(), "Test plug-in resource file not found");
+
+  log() << "copying" << libInfo.fileName() << nPlugins << "times";
+
+  // Each copy keeps the file name, from which its resource path is derived
+  pluginsDir = QDir(QDir::tempPath());
+  pluginsDir.mkpath("ctkPluginFrameworkPerfInstall");
+  pluginsDir.cd("ctkPluginFrameworkPerfInstall");
+  for(int i = 0; i < nPlugins; i++)
+  {
+    QString dirName = QString("plugin%1").arg(i);
+    pluginsDir.mkpath(dirName);
+    QString pluginPath = pluginsDir.filePath(dirName + "/" + libInfo.fileName());
+    QFile::remove(pluginPath);
+    QFile::remove(pluginPath + ".rcc");
+    // copy the resource file last, it must not be older than the library
+    QVERIFY(QFile::copy(libInfo.absoluteFilePath(), pluginPath));
+    QVERIFY(QFile::copy(rccInfo.absoluteFilePath(), pluginPath + ".rcc"));
+    pluginPaths.push_back(pluginPath);
+  }
+}
+
+//----------------------------------------------------------------------------
+void ctkPluginFrameworkPerfInstallTestSuite::cleanupTestCase()
+{
+  foreach(QString pluginPath, pluginPaths)
+  {
+    QFile::remove(pluginPath);
+    QFile::remove(pluginPath + ".rcc");
+    pluginsDir.rmdir(QFileInfo(pluginPath).dir().dirName());
+  }
+  pluginPaths.clear();
+  pluginsDir.cdUp();
+  pluginsDir.rmdir("ctkPluginFrameworkPerfInstall");
+}
+
+//----------------------------------------------------------------------------
+void ctkPluginFrameworkPerfInstallTestSuite::testInstallWithResourceFile()
+{
+  QCOMPARE(installPlugins(), nPlugins);
+
+  // Check that the installation does not load the library when the
+  // resource file is used: a copy whose library is not loadable must
+  // still install, with the manifest of the resource file
+  QString pluginPath = pluginsDir.filePath("unloadable/" + QFileInfo(pluginPaths.front()).fileName());
+  pluginsDir.mkpath("unloadable");
+  QFile library(pluginPath);
+  QVERIFY(library.open(QIODevice::WriteOnly | QIODevice::Truncate));
+  library.write("not a library");
+  library.close();
+  // copy the resource file last, it must not be older than the library
+  QFile::remove(pluginPath + ".rcc");
+  QVERIFY(QFile::copy(pluginPaths.front() + ".rcc", pluginPath + ".rcc"));
+
+  QString symbolicName;
+  try
+  {
+    QSharedPointer<ctkPlugin> plugin = pc->installPlugin(QUrl::fromLocalFile(pluginPath));
+    symbolicName = plugin->getSymbolicName();
+    plugin->uninstall();
+  }
+  catch (const ctkPluginException& e)
+  {
+    qDebug() << e.printStackTrace();
+  }
+  QFile::remove(pluginPath);
+  QFile::remove(pluginPath + ".rcc");
+  pluginsDir.rmdir("unloadable");
+  QCOMPARE(symbolicName, QString("pluginA.test"));
+}
+
+//----------------------------------------------------------------------------
+void ctkPluginFrameworkPerfInstallTestSuite::testInstallByLoading()
+{
+  // without the resource files, the plug-ins are loaded to read their resources
+  foreach(QString pluginPath, pluginPaths)
+  {
+    QFile::remove(pluginPath + ".rcc");
+  }
+  QCOMPARE(installPlugins(), nPlugins);
+}
+
+//----------------------------------------------------------------------------
+int ctkPluginFrameworkPerfInstallTestSuite::installPlugins()
+{
+  // The copies share the symbolic name and version, so each one is
+  // uninstalled before the next one is installed. Only the installation
+  // is timed.
+  int installed = 0;
+  qint64 us = 0;
+  ctkHighPrecisionTimer t;
+  foreach(QString pluginPath, pluginPaths)
+  {
+    try
+    {
+      t.start();
+      QSharedPointer<ctkPlugin> plugin = pc->installPlugin(QUrl::fromLocalFile(pluginPath));
+      us += t.elapsedMicro();
+
+      // the manifest is read at installation
+      if (plugin->getSymbolicName() == "pluginA.test")
+      {
+        installed++;
+      }
+      plugin->uninstall();
+    }
+    catch (const ctkPluginException& e)
+    {
+      qDebug() << e.printStackTrace();
+    }
+  }
+  log() << "installing" << installed << "plugins took" << us / 1000 << "ms,"
+        << us / qMax(1, installed) << "us per plugin";
+  return installed;
+}
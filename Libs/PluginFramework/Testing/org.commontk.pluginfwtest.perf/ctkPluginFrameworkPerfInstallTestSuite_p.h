@@ -0,0 +1,74 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#ifndef CTKPLUGINFRAMEWORKPERFINSTALLTESTSUITE_P_H
+#define CTKPLUGINFRAMEWORKPERFINSTALLTESTSUITE_P_H
+
+#include "ctkTestSuiteInterface.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QStringList>
+
+class ctkPluginContext;
+
+/**
+ * Measures the installation of many plug-ins, as done at application
+ * startup. The plug-ins are copies of the pluginA_test plug-in.
+ */
+class ctkPluginFrameworkPerfInstallTestSuite : public QObject, public ctkTestSuiteInterface
+{
+  Q_OBJECT
+  Q_INTERFACES(ctkTestSuiteInterface)
+
+private:
+
+  ctkPluginContext* pc;
+
+  int nPlugins;
+
+  QDir pluginsDir;
+  QStringList pluginPaths;
+
+public:
+
+  ctkPluginFrameworkPerfInstallTestSuite(ctkPluginContext* context);
+
+  QDebug log()
+  {
+    return qDebug() << "install_perf:";
+  }
+
+private:
+
+  int installPlugins();
+
+private Q_SLOTS:
+
+  void initTestCase();
+  void cleanupTestCase();
+
+  void testInstallWithResourceFile();
+  void testInstallByLoading();
+};
+
+#endif // CTKPLUGINFRAMEWORKPERFINSTALLTESTSUITE_P_H
@@ -24,19 +24,56 @@
 
 #include <ctkPluginContext.h>
 #include <ctkHighPrecisionTimer.h>
+#include <ctkLDAPSearchFilter.h>
 
 #undef REGISTERED
 #include <ctkServiceEvent.h>
 
+#include <QAtomicInt>
+#include <QRunnable>
 #include <QTest>
+#include <QThreadPool>
 #include <QDebug>
 
+namespace {
+
+//----------------------------------------------------------------------------
+// Looks up a service n times, counting the failed lookups
+class LookupRunnable : public QRunnable
+{
+public:
+
+  LookupRunnable(ctkPluginContext* pc, int n, QAtomicInt& failures)
+    : pc(pc), n(n), failures(failures)
+  {}
+
+  void run()
+  {
+    for(int i = 0; i < n; i++)
+    {
+      if (!pc->getServiceReference<IPerfTestService>())
+      {
+        failures.ref();
+      }
+    }
+  }
+
+private:
+
+  ctkPluginContext* pc;
+  int n;
+  QAtomicInt& failures;
+};
+
+}
+
 //----------------------------------------------------------------------------
 ctkPluginFrameworkPerfRegistryTestSuite::ctkPluginFrameworkPerfRegistryTestSuite(ctkPluginContext* context)
   : QObject(0)
   , pc(context)
   , nListeners(100)
   , nServices(1000)
+  , nLookups(10000)
   , nRegistered(0)
   , nUnregistering(0)
   , nModified(0)
@@ -74,6 +111,64 @@ void ctkPluginFrameworkPerfRegistryTestSuite::cleanupTestCase()
   listeners.clear();
 }
 
+//----------------------------------------------------------------------------
+void ctkPluginFrameworkPerfRegistryTestSuite::testLookupScaling()
+{
+  qDebug() << "Look up services by an indexed (service.pid) and a not indexed"
+           << "property, with 100 to 100000 registered services";
+
+  QList<ctkServiceRegistration> scaleRegs;
+  QList<QObject*> scaleServices;
+  const int lookups = 1000;
+  for(int n = 100; n <= 100000; n *= 10)
+  {
+    for(int i = scaleRegs.size(); i < n; i++)
+    {
+      ctkDictionary props;
+      props.insert("service.pid", QString("scale.service.%1").arg(i));
+      props.insert("scale.service.value", QString::number(i));
+
+      QObject* service = new PerfTestService();
+      scaleServices.push_back(service);
+      scaleRegs.push_back(pc->registerService<IPerfTestService>(service, props));
+    }
+
+    ctkHighPrecisionTimer t;
+    t.start();
+    int found = lookupServices("(service.pid=scale.service.%1)", lookups, n);
+    qint64 us = t.elapsedMicro();
+    log() << n << "services: indexed lookup took" << us / lookups << "us";
+    QCOMPARE(found, lookups);
+
+    // the not indexed lookups evaluate the filter for every service
+    const int scanLookups = qMax(1, lookups * 100 / n);
+    t.start();
+    found = lookupServices("(scale.service.value=%1)", scanLookups, n);
+    us = t.elapsedMicro();
+    log() << n << "services: not indexed lookup took" << us / scanLookups << "us";
+    QCOMPARE(found, scanLookups);
+  }
+
+  for(int i = 0; i < scaleRegs.size(); i++)
+  {
+    scaleRegs[i].unregister();
+  }
+  qDeleteAll(scaleServices);
+}
+
+//----------------------------------------------------------------------------
+int ctkPluginFrameworkPerfRegistryTestSuite::lookupServices(const QString& filter, int n, int count)
+{
+  int found = 0;
+  for(int i = 0; i < n; i++)
+  {
+    // spread the lookups over the services
+    int index = static_cast<int>((static_cast<qint64>(i) * 7919) % count);
+    found += pc->getServiceReferences(filter.arg(index)).size();
+  }
+  return found;
+}
+
 //----------------------------------------------------------------------------
 void ctkPluginFrameworkPerfRegistryTestSuite::testAddListeners()
 {
@@ -136,6 +231,113 @@ void ctkPluginFrameworkPerfRegistryTestSuite::registerServices(int n)
   }
 }
 
+//----------------------------------------------------------------------------
+void ctkPluginFrameworkPerfRegistryTestSuite::testFilteredLookup()
+{
+  qDebug() << "Look up" << nLookups << "times one of the" << nServices
+           << "services with a filter, and check that exactly one service is found each time";
+
+  ctkHighPrecisionTimer t;
+  t.start();
+  int found = lookupServices(nLookups, 10);
+  int ms = t.elapsedMilli();
+  log() << "lookup with 10 different filters took" << ms << "ms";
+  QCOMPARE(found, nLookups);
+
+  // more filters than the parsed filter cache holds, every lookup parses its filter
+  t.start();
+  found = lookupServices(nLookups, nServices);
+  ms = t.elapsedMilli();
+  log() << "lookup with" << nServices << "different filters took" << ms << "ms";
+  QCOMPARE(found, nLookups);
+
+  QString filter("(&(service.pid=my.service.%1)(perf.service.value>=1))");
+  t.start();
+  for(int i = 0; i < nLookups; i++)
+  {
+    ctkLDAPSearchFilter f(filter.arg(i % nServices));
+  }
+  ms = t.elapsedMilli();
+  log() << "parsing" << nLookups << "filters took" << ms << "ms";
+}
+
+//----------------------------------------------------------------------------
+void ctkPluginFrameworkPerfRegistryTestSuite::testFilterEvaluation()
+{
+  QList<ctkServiceReference> refs = pc->getServiceReferences<IPerfTestService>();
+  QCOMPARE(refs.size(), nServices);
+
+  // filters and the number of services they match, perf.service.value
+  // is the number 1 to nServices
+  QList<QPair<QString, int> > filters;
+  filters << qMakePair(QString("(service.pid=my.service.500)"), 1)
+          << qMakePair(QString("(perf.service.value>=500)"), nServices - 499)
+          << qMakePair(QString("(perf.service.value<=9)"), 9)
+          << qMakePair(QString("(service.pid=my.service.5*)"), 111)
+          << qMakePair(QString("(service.pid~=MY.SERVICE.42)"), 1)
+          << qMakePair(QString("(|(service.pid=my.service.1)(perf.service.value<=2))"), 2);
+
+  const int rounds = 100;
+  qDebug() << "Evaluate filters" << rounds << "times against" << refs.size() << "services";
+  for(int f = 0; f < filters.size(); f++)
+  {
+    ctkLDAPSearchFilter filter(filters[f].first);
+    int matches = 0;
+    ctkHighPrecisionTimer t;
+    t.start();
+    for(int r = 0; r < rounds; r++)
+    {
+      for(int i = 0; i < refs.size(); i++)
+      {
+        if (filter.match(refs[i])) ++matches;
+      }
+    }
+    qint64 ms = qMax(qint64(1), t.elapsedMilli());
+    log() << filters[f].first << ":" << rounds * refs.size() / ms << "evaluations/ms";
+    QCOMPARE(matches / rounds, filters[f].second);
+  }
+}
+
+//----------------------------------------------------------------------------
+void ctkPluginFrameworkPerfRegistryTestSuite::testConcurrentLookup()
+{
+  const int lookupsPerThread = 20000;
+  qDebug() << "Look up a service" << lookupsPerThread << "times in each of"
+           << "1 to 32 threads, and check that every lookup finds it";
+
+  for(int nThreads = 1; nThreads <= 32; nThreads *= 2)
+  {
+    QThreadPool pool;
+    pool.setMaxThreadCount(nThreads);
+    QAtomicInt failures(0);
+
+    ctkHighPrecisionTimer t;
+    t.start();
+    for(int i = 0; i < nThreads; i++)
+    {
+      pool.start(new LookupRunnable(pc, lookupsPerThread, failures));
+    }
+    pool.waitForDone();
+    qint64 ms = qMax(qint64(1), t.elapsedMilli());
+    log() << nThreads << "threads:" << nThreads * lookupsPerThread << "lookups took"
+          << ms << "ms," << nThreads * lookupsPerThread / ms << "lookups/ms";
+    QCOMPARE(failures.fetchAndAddOrdered(0), 0);
+  }
+}
+
+//----------------------------------------------------------------------------
+int ctkPluginFrameworkPerfRegistryTestSuite::lookupServices(int n, int nFilters)
+{
+  QString filter("(&(service.pid=my.service.%1)(perf.service.value>=1))");
+
+  int found = 0;
+  for(int i = 0; i < n; i++)
+  {
+    found += pc->getServiceReferences<IPerfTestService>(filter.arg(i % nFilters)).size();
+  }
+  return found;
+}
+
 //----------------------------------------------------------------------------
 void ctkPluginFrameworkPerfRegistryTestSuite::testModifyServices()
 {
@@ -44,6 +44,7 @@ private:
 
   int nListeners;
   int nServices;
+  int nLookups;
 
   int nRegistered;
   int nUnregistering;
@@ -68,6 +69,8 @@ private:
 
   void addListeners(int n);
   void registerServices(int n);
+  int lookupServices(int n, int nFilters);
+  int lookupServices(const QString& filter, int n, int count);
   void modifyServices();
   void unregisterServices();
 
@@ -76,8 +79,13 @@ private Q_SLOTS:
   void initTestCase();
   void cleanupTestCase();
 
+  void testLookupScaling();
+
   void testAddListeners();
   void testRegisterServices();
+  void testFilteredLookup();
+  void testFilterEvaluation();
+  void testConcurrentLookup();
 
   void testModifyServices();
   void testUnregisterServices();
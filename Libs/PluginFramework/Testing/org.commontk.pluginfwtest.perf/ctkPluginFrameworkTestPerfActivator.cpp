@@ -21,6 +21,7 @@
 
 #include "ctkPluginFrameworkTestPerfActivator_p.h"
 
+#include "ctkPluginFrameworkPerfInstallTestSuite_p.h"
 #include "ctkPluginFrameworkPerfRegistryTestSuite_p.h"
 
 #include <QtPlugin>
@@ -28,7 +29,7 @@
 
 //----------------------------------------------------------------------------
 ctkPluginFrameworkTestPerfActivator::ctkPluginFrameworkTestPerfActivator()
-  : perfTestSuite(0)
+  : perfTestSuite(0), installTestSuite(0)
 {
 
 }
@@ -37,6 +38,7 @@ ctkPluginFrameworkTestPerfActivator::ctkPluginFrameworkTestPerfActivator()
 ctkPluginFrameworkTestPerfActivator::~ctkPluginFrameworkTestPerfActivator()
 {
   delete perfTestSuite;
+  delete installTestSuite;
 }
 
 //----------------------------------------------------------------------------
@@ -44,6 +46,9 @@ void ctkPluginFrameworkTestPerfActivator::start(ctkPluginContext* context)
 {
   perfTestSuite = new ctkPluginFrameworkPerfRegistryTestSuite(context);
   context->registerService<ctkTestSuiteInterface>(perfTestSuite);
+
+  installTestSuite = new ctkPluginFrameworkPerfInstallTestSuite(context);
+  context->registerService<ctkTestSuiteInterface>(installTestSuite);
 }
 
 //----------------------------------------------------------------------------
@@ -53,6 +58,8 @@ void ctkPluginFrameworkTestPerfActivator::stop(ctkPluginContext* context)
 
   delete perfTestSuite;
   perfTestSuite = 0;
+  delete installTestSuite;
+  installTestSuite = 0;
 }
 
 #if QT_VERSION < QT_VERSION_CHECK(5,0,0)
@@ -46,6 +46,7 @@ public:
 private:
 
   QObject* perfTestSuite;
+  QObject* installTestSuite;
 };
 
 #endif // CTKPLUGINFRAMEWORKTESTPERFACTIVATOR_H
@@ -26,6 +26,7 @@
 #include <ctkPluginConstants.h>
 #include <ctkPluginException.h>
 #include <ctkServiceException.h>
+#include <ctkLDAPSearchFilter.h>
 
 #include <QDir>
 #include <QTest>
@@ -539,6 +540,118 @@ void ctkPluginFrameworkTestSuite::frame070a()
   QVERIFY2(versionA1 != versionA, "framework test plug-in, update of plug-in failed, version info unchanged :FRAME070A:Fail");
 }
 
+//----------------------------------------------------------------------------
+// Check that the services found by a service.pid filter are exactly
+// the expected ones
+static bool checkPidLookup(ctkPluginContext* pc, const QString& filter,
+                           const QList<ctkServiceRegistration>& expected)
+{
+  QList<ctkServiceReference> srs = pc->getServiceReferences("QObject", filter);
+  bool found = srs.size() == expected.size();
+  foreach (ctkServiceRegistration reg, expected)
+  {
+    found = found && srs.contains(reg.getReference());
+  }
+  if (!found)
+  {
+    qDebug() << "Filter" << filter << "found" << srs.size()
+             << "services, expected" << expected.size();
+  }
+  return found;
+}
+
+//----------------------------------------------------------------------------
+// Look up services by the indexed service.pid property, with string,
+// string list and non-string values, and after changing the values
+void ctkPluginFrameworkTestSuite::frame080a()
+{
+  // Owned by the test suite, the services stay registered if a check fails
+  QObject* s1 = new QObject(this);
+  QObject* s2 = new QObject(this);
+  QObject* s3 = new QObject(this);
+  QObject* s4 = new QObject(this);
+  ctkDictionary props;
+  props[ctkPluginConstants::SERVICE_PID] = QStringList() << "frame080a.a" << "frame080a.b";
+  ctkServiceRegistration r1 = pc->registerService("QObject", s1, props);
+  props[ctkPluginConstants::SERVICE_PID] = QString("frame080a.c");
+  ctkServiceRegistration r2 = pc->registerService("QObject", s2, props);
+  props[ctkPluginConstants::SERVICE_PID] = 80;
+  ctkServiceRegistration r3 = pc->registerService("QObject", s3, props);
+  props[ctkPluginConstants::SERVICE_PID] = QVariantList() << QString("frame080a.d") << 81;
+  ctkServiceRegistration r4 = pc->registerService("QObject", s4, props);
+
+  QList<ctkServiceRegistration> none;
+  QVERIFY(checkPidLookup(pc, "(service.pid=frame080a.a)", QList<ctkServiceRegistration>() << r1));
+  QVERIFY(checkPidLookup(pc, "(service.pid=frame080a.b)", QList<ctkServiceRegistration>() << r1));
+  QVERIFY(checkPidLookup(pc, "(service.pid=frame080a.c)", QList<ctkServiceRegistration>() << r2));
+  QVERIFY(checkPidLookup(pc, "(service.pid=frame080a.d)", QList<ctkServiceRegistration>() << r4));
+  QVERIFY(checkPidLookup(pc, "(service.pid=frame080a.x)", none));
+  // Numbers are compared as numbers, they are not indexed by value
+  QVERIFY(checkPidLookup(pc, "(service.pid=080)", QList<ctkServiceRegistration>() << r3));
+  QVERIFY(checkPidLookup(pc, "(service.pid=81)", QList<ctkServiceRegistration>() << r4));
+  QVERIFY(checkPidLookup(pc, "(|(service.pid=frame080a.c)(service.pid=80))",
+                         QList<ctkServiceRegistration>() << r2 << r3));
+  QVERIFY(checkPidLookup(pc, "(&(service.pid=frame080a.a)(service.pid=frame080a.b))",
+                         QList<ctkServiceRegistration>() << r1));
+  QVERIFY(checkPidLookup(pc, "(&(service.pid=frame080a.a)(service.pid=frame080a.c))", none));
+
+  // Changing the values moves the services in the index
+  props[ctkPluginConstants::SERVICE_PID] = QString("frame080a.e");
+  r3.setProperties(props);
+  props[ctkPluginConstants::SERVICE_PID] = 82;
+  r2.setProperties(props);
+  QVERIFY(checkPidLookup(pc, "(service.pid=frame080a.e)", QList<ctkServiceRegistration>() << r3));
+  QVERIFY(checkPidLookup(pc, "(service.pid=80)", none));
+  QVERIFY(checkPidLookup(pc, "(service.pid=frame080a.c)", none));
+  QVERIFY(checkPidLookup(pc, "(service.pid=82)", QList<ctkServiceRegistration>() << r2));
+
+  r1.unregister();
+  r2.unregister();
+  r3.unregister();
+  r4.unregister();
+  QVERIFY(checkPidLookup(pc, "(service.pid=frame080a.a)", none));
+  QVERIFY(checkPidLookup(pc, "(service.pid=82)", none));
+
+  clearEvents();
+}
+
+//----------------------------------------------------------------------------
+// Match filters against list, number and string properties, with and
+// without substring patterns
+void ctkPluginFrameworkTestSuite::frame085a()
+{
+  ctkDictionary props;
+  props["strings"] = QStringList() << "alpha" << "beta";
+  props["mixed"] = QVariantList() << QString("gamma") << 42
+                                  << (QVariantList() << QString("delta") << 7);
+  props["number"] = 42;
+  props["String"] = QString("epsilon");
+
+  // The elements of lists are compared by their own type
+  QVERIFY(ctkLDAPSearchFilter("(strings=beta)").match(props));
+  QVERIFY(ctkLDAPSearchFilter("(strings=al*)").match(props));
+  QVERIFY(ctkLDAPSearchFilter("(strings=*et*)").match(props));
+  QVERIFY(!ctkLDAPSearchFilter("(strings=gam*)").match(props));
+  QVERIFY(ctkLDAPSearchFilter("(mixed=gam*)").match(props));
+  QVERIFY(ctkLDAPSearchFilter("(mixed=042)").match(props));
+  QVERIFY(ctkLDAPSearchFilter("(mixed=4*)").match(props));
+  QVERIFY(!ctkLDAPSearchFilter("(mixed=43)").match(props));
+  QVERIFY(ctkLDAPSearchFilter("(mixed=del*)").match(props));
+  QVERIFY(ctkLDAPSearchFilter("(mixed=7)").match(props));
+  QVERIFY(!ctkLDAPSearchFilter("(mixed=x*)").match(props));
+
+  // Numbers are compared as numbers, or as strings against a pattern
+  QVERIFY(ctkLDAPSearchFilter("(number=042)").match(props));
+  QVERIFY(ctkLDAPSearchFilter("(number<=100)").match(props));
+  QVERIFY(ctkLDAPSearchFilter("(number=*2)").match(props));
+  QVERIFY(!ctkLDAPSearchFilter("(number=0*)").match(props));
+
+  // The keys are not case sensitive, unless asked for
+  QVERIFY(ctkLDAPSearchFilter("(STRING=eps*)").match(props));
+  QVERIFY(ctkLDAPSearchFilter("(String=epsilon)").matchCase(props));
+  QVERIFY(!ctkLDAPSearchFilter("(string=epsilon)").matchCase(props));
+}
+
 //----------------------------------------------------------------------------
 void ctkPluginFrameworkTestSuite::frameworkListener(const ctkPluginFrameworkEvent& fwEvent)
 {
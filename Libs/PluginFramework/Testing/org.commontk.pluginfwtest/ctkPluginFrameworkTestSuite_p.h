@@ -67,6 +67,8 @@ private Q_SLOTS:
   void frame042a();
   void frame045a();
   void frame070a();
+  void frame080a();
+  void frame085a();
 
 private:
 
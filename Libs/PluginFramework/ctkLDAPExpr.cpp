@@ -23,6 +23,8 @@ limitations under the License.
 
 #include <ctkException.h>
 
+#include <QCache>
+#include <QMutex>
 #include <QSet>
 #include <QVariant>
 #include <QStringList>
@@ -99,19 +101,35 @@ class ctkLDAPExprData : public QSharedData
 public:
 
   ctkLDAPExprData( int op, QList<ctkLDAPExpr> args )
-    : m_operator(op), m_args(args)
+    : m_operator(op), m_args(args), m_matchAll(false), m_hasWildcard(false),
+    m_longLongValue(0), m_floatValue(0), m_doubleValue(0),
+    m_isLongLong(false), m_isFloat(false), m_isDouble(false),
+    m_isTrue(false), m_isFalse(false)
   {
   }
 
   ctkLDAPExprData( int op, QString attrName, QString attrValue )
-    : m_operator(op), m_attrName(attrName), m_attrValue(attrValue)
+    : m_operator(op), m_attrName(attrName), m_attrValue(attrValue),
+    m_attrNameLower(attrName.toLower()), m_matchAll(false), m_hasWildcard(false),
+    m_isTrue(attrValue.trimmed().compare("true", Qt::CaseInsensitive) == 0),
+    m_isFalse(attrValue.trimmed().compare("false", Qt::CaseInsensitive) == 0)
   {
+    QString number = attrValue.trimmed();
+    m_longLongValue = number.toLongLong(&m_isLongLong);
+    m_floatValue = number.toFloat(&m_isFloat);
+    m_doubleValue = number.toDouble(&m_isDouble);
   }
 
   ctkLDAPExprData( const ctkLDAPExprData& other )
     : QSharedData(other), m_operator(other.m_operator),
     m_args(other.m_args), m_attrName(other.m_attrName),
-    m_attrValue(other.m_attrValue)
+    m_attrValue(other.m_attrValue), m_attrNameLower(other.m_attrNameLower),
+    m_approxValue(other.m_approxValue), m_matchAll(other.m_matchAll),
+    m_hasWildcard(other.m_hasWildcard), m_longLongValue(other.m_longLongValue),
+    m_floatValue(other.m_floatValue), m_doubleValue(other.m_doubleValue),
+    m_isLongLong(other.m_isLongLong), m_isFloat(other.m_isFloat),
+    m_isDouble(other.m_isDouble), m_isTrue(other.m_isTrue),
+    m_isFalse(other.m_isFalse)
   {
   }
 
@@ -123,8 +141,51 @@ public:
   QString m_attrName;
   //!
   QString m_attrValue;
+
+  // The operand of a simple expression, converted once when parsing
+  // instead of for each evaluated property
+
+  //! m_attrName in lower case
+  QString m_attrNameLower;
+  //! m_attrValue without white space and in lower case, for APPROX
+  QString m_approxValue;
+  //! EQ with a single wildcard, matches any value
+  bool m_matchAll;
+  //!
+  bool m_hasWildcard;
+  //! m_attrValue converted to the numeric types, if it is a valid number
+  qlonglong m_longLongValue;
+  float m_floatValue;
+  double m_doubleValue;
+  bool m_isLongLong;
+  bool m_isFloat;
+  bool m_isDouble;
+  //! m_attrValue is "true" or "false", ignoring case
+  bool m_isTrue;
+  bool m_isFalse;
 };
 
+//----------------------------------------------------------------------------
+namespace {
+
+/// The most recently parsed filters. ctkLDAPExpr is implicitly shared
+/// and never modified after parsing, so the cached expressions can be
+/// evaluated by several threads.
+struct ctkLDAPExprCache
+{
+  ctkLDAPExprCache()
+    : exprs(512)
+  {
+  }
+
+  QMutex mutex;
+  QCache<QString, ctkLDAPExpr> exprs;
+};
+
+}
+
+Q_GLOBAL_STATIC(ctkLDAPExprCache, ldapExprCache)
+
 //----------------------------------------------------------------------------
 ctkLDAPExpr::ctkLDAPExpr()
 {
@@ -154,6 +215,33 @@ ctkLDAPExpr::ctkLDAPExpr( const QString &filter )
   d = expr.d;
 }
 
+//----------------------------------------------------------------------------
+ctkLDAPExpr ctkLDAPExpr::parse( const QString &filter )
+{
+  ctkLDAPExprCache* cache = ldapExprCache();
+  if (!cache)
+  {
+    // during static destruction
+    return ctkLDAPExpr(filter);
+  }
+
+  {
+    QMutexLocker lock(&cache->mutex);
+    if (ctkLDAPExpr* expr = cache->exprs.object(filter))
+    {
+      return *expr;
+    }
+  }
+
+  // Parse without holding the lock; throws for an invalid filter,
+  // which is therefore not cached
+  ctkLDAPExpr expr(filter);
+
+  QMutexLocker lock(&cache->mutex);
+  cache->exprs.insert(filter, new ctkLDAPExpr(expr));
+  return expr;
+}
+
 //----------------------------------------------------------------------------
 ctkLDAPExpr::ctkLDAPExpr( int op, const QList<ctkLDAPExpr> &args )
   : d(new ctkLDAPExprData(op, args))
@@ -164,6 +252,12 @@ ctkLDAPExpr::ctkLDAPExpr( int op, const QList<ctkLDAPExpr> &args )
 ctkLDAPExpr::ctkLDAPExpr( int op, const QString &attrName, const QString &attrValue )
   : d(new ctkLDAPExprData(op, attrName, attrValue))
 {
+  d->m_matchAll = op == EQ && attrValue == WILDCARD_QString;
+  d->m_hasWildcard = attrValue.indexOf(WILDCARD) >= 0;
+  if (op == APPROX)
+  {
+    d->m_approxValue = fixupString(attrValue);
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -186,13 +280,19 @@ ctkLDAPExpr::~ctkLDAPExpr()
 
 //----------------------------------------------------------------------------
 bool ctkLDAPExpr::getMatchedObjectClasses(QSet<QString>& objClasses) const
+{
+  return getMatchedValues(ctkPluginConstants::OBJECTCLASS, objClasses);
+}
+
+//----------------------------------------------------------------------------
+bool ctkLDAPExpr::getMatchedValues(const QString& attrName, QSet<QString>& values) const
 {
   if (d->m_operator == EQ)
   {
-    if (d->m_attrName.compare(ctkPluginConstants::OBJECTCLASS, Qt::CaseInsensitive) &&
-      d->m_attrValue.indexOf(WILDCARD) < 0) 
+    if (d->m_attrName.compare(attrName, Qt::CaseInsensitive) == 0 &&
+      !d->m_hasWildcard)
     {
-      objClasses.insert( d->m_attrValue );
+      values.insert( d->m_attrValue );
       return true;
     }
     return false;
@@ -203,19 +303,17 @@ bool ctkLDAPExpr::getMatchedObjectClasses(QSet<QString>& objClasses) const
     for (int i = 0; i < d->m_args.size( ); i++)
     {
       QSet<QString> r;
-      if(d->m_args[i].getMatchedObjectClasses(r))
+      if(d->m_args[i].getMatchedValues(attrName, r))
       {
-        result = true;
-        if (objClasses.empty())
+        // if AND op and values in several operands, each of them
+        // is possible. They are not intersected, a list property
+        // like objectclass can match all of them, so the smallest
+        // set is used.
+        if (!result || r.size() < values.size())
         {
-          objClasses = r;
-        }
-        else
-        {
-          // if AND op and classes in several operands,
-          // then only the intersection is possible.
-          objClasses.intersect(r);
+          values = r;
         }
+        result = true;
       }
     }
     return result;
@@ -225,13 +323,13 @@ bool ctkLDAPExpr::getMatchedObjectClasses(QSet<QString>& objClasses) const
     for (int i = 0; i < d->m_args.length( ); i++)
     {
       QSet<QString> r;
-      if (d->m_args[i].getMatchedObjectClasses(r))
+      if (d->m_args[i].getMatchedValues(attrName, r))
       {
-        objClasses += r;
+        values += r;
       }
       else
       {
-        objClasses.clear();
+        values.clear();
         return false;
       }
     }
@@ -253,8 +351,8 @@ bool ctkLDAPExpr::isSimple(
 
   if (d->m_operator == EQ) {
     int index;
-    if ((index = keywords.indexOf(matchCase ? d->m_attrName : d->m_attrName.toLower())) >= 0 &&
-      d->m_attrValue.indexOf(WILDCARD) < 0) {
+    if ((index = keywords.indexOf(matchCase ? d->m_attrName : d->m_attrNameLower)) >= 0 &&
+      !d->m_hasWildcard) {
         cache[index] = QStringList(d->m_attrValue);
         return true;
     }
@@ -284,10 +382,9 @@ bool ctkLDAPExpr::query( const QString &filter, const ctkDictionary &pd )
 bool ctkLDAPExpr::evaluate( const ctkServiceProperties &p, bool matchCase ) const
 {
   if ((d->m_operator & SIMPLE) != 0) {
-    // try case sensitive match first
-    int index = p.findCaseSensitive(d->m_attrName);
-    if (index < 0 && !matchCase) index = p.find(d->m_attrName);
-    return index < 0 ? false : compare(p.value(index), d->m_operator, d->m_attrValue);
+    // the keys are unique ignoring the case, and found faster in lower case
+    int index = matchCase ? p.findCaseSensitive(d->m_attrName) : p.find(d->m_attrNameLower);
+    return index < 0 ? false : compare(p.value(index));
   } else { // (d->m_operator & COMPLEX) != 0
     switch (d->m_operator) {
     case AND:
@@ -311,90 +408,106 @@ bool ctkLDAPExpr::evaluate( const ctkServiceProperties &p, bool matchCase ) cons
 }
 
 //----------------------------------------------------------------------------
-bool ctkLDAPExpr::compare( const QVariant &obj, int op, const QString &s ) const
+template<typename T>
+static bool compareNumber(T value, int op, T operand)
+{
+  switch(op) {
+  case ctkLDAPExpr::LE:
+    return value <= operand;
+  case ctkLDAPExpr::GE:
+    return value >= operand;
+  default: /*APPROX and EQ*/
+    return value == operand;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool ctkLDAPExpr::compare( const QVariant &obj ) const
 {
   if (obj.isNull())
     return false;
-  if (op == EQ && s == WILDCARD_QString )
+  if (d->m_matchAll)
     return true;
-  try {
-    if ( obj.canConvert<QString>( ) ) {
-      return compareString(obj.toString(), op, s);
-    } else if (obj.canConvert<char>( ) ) {
-      return compareString(obj.toString(), op, s);
-    } else if (obj.canConvert<bool>( ) ) {
-      if (op==LE || op==GE)
-        return false;
-      if ( obj.toBool() ) {
-        return s.compare("true", Qt::CaseInsensitive);
-      } else {
-        return s.compare("false", Qt::CaseInsensitive);
-      }
-    } 
-    else if ( obj.canConvert<Byte>( ) || obj.canConvert<int>( ) ) 
-    {
-      switch(op) {
-      case LE:
-        return obj.toInt() <= s.toInt();
-      case GE:
-        return obj.toInt() >= s.toInt();
-      default: /*APPROX and EQ*/
-        return s.toInt( ) == obj.toInt();
-      }
-    } else if ( obj.canConvert<float>( ) ) {
-      switch(op) {
-      case LE:
-        return obj.toFloat() <= s.toFloat();
-      case GE:
-        return obj.toFloat() >= s.toFloat();
-      default: /*APPROX and EQ*/
-        return s.toFloat() == obj.toFloat();
-      }
-    } else if (obj.canConvert<double>()) {
-      switch(op) {
-      case LE:
-        return obj.toDouble() <= s.toDouble();
-      case GE:
-        return obj.toDouble() >= s.toDouble();
-      default: /*APPROX and EQ*/
-        return s.toDouble( ) == obj.toDouble( );
-      }
-    } else if (obj.canConvert<qlonglong>( )) {
-      switch(op) {
-      case LE:
-        return obj.toLongLong() <= s.toLongLong( );
-      case GE:
-        return obj.toLongLong() >= s.toLongLong( );
-      default: /*APPROX and EQ*/
-        return obj.toLongLong() == s.toLongLong( );
-      }
-    } 
-    else if (obj.canConvert< QList<QVariant> >()) {
-      QList<QVariant> list = obj.toList();
-      QList<QVariant>::Iterator it;
-      for (it=list.begin(); it != list.end( ); it++)
-         if (compare(*it, op, s))
-           return true;
-    } 
-  } catch (...) {
-    // This might happen if a QString-to-datatype conversion fails
-    // Just consider it a false match and ignore the exception
+  const int op = d->m_operator;
+
+  // Lists match if one of their elements matches
+  switch (obj.userType()) {
+  case QMetaType::QStringList: {
+    const QStringList list = obj.toStringList();
+    for (QStringList::const_iterator it = list.begin(); it != list.end(); ++it)
+      if (compareString(*it))
+        return true;
+    return false;
+  }
+  case QMetaType::QVariantList: {
+    const QVariantList list = obj.toList();
+    for (QVariantList::const_iterator it = list.begin(); it != list.end(); ++it)
+      if (compare(*it))
+        return true;
+    return false;
+  }
+  default:
+    break;
+  }
+
+  // Numbers are compared as numbers, unless matched against a
+  // substring pattern
+  switch (d->m_hasWildcard ? static_cast<int>(QMetaType::QString) : obj.userType()) {
+  case QMetaType::QString:
+  case QMetaType::QChar:
+  case QMetaType::Char:
+    return compareString(obj.toString());
+  case QMetaType::Bool:
+    if (op==LE || op==GE)
+      return false;
+    return obj.toBool() ? d->m_isTrue : d->m_isFalse;
+  case QMetaType::UChar:
+  case QMetaType::Short:
+  case QMetaType::UShort:
+  case QMetaType::Int:
+  case QMetaType::UInt:
+  case QMetaType::Long:
+  case QMetaType::ULong:
+  case QMetaType::LongLong:
+  case QMetaType::ULongLong:
+    return d->m_isLongLong && compareNumber(obj.toLongLong(), op, d->m_longLongValue);
+  case QMetaType::Float:
+    return d->m_isFloat && compareNumber(obj.toFloat(), op, d->m_floatValue);
+  case QMetaType::Double:
+    return d->m_isDouble && compareNumber(obj.toDouble(), op, d->m_doubleValue);
+  default:
+    break;
+  }
+
+  // Other types are compared by their string value
+  if (obj.canConvert<QString>())
+  {
+    return compareString(obj.toString());
+  }
+  else if (obj.canConvert< QList<QVariant> >())
+  {
+    const QVariantList list = obj.toList();
+    for (QVariantList::const_iterator it = list.begin(); it != list.end(); ++it)
+      if (compare(*it))
+        return true;
   }
   return false;
 }
 
 //----------------------------------------------------------------------------
-bool ctkLDAPExpr::compareString( const QString &s1, int op, const QString &s2 )
+bool ctkLDAPExpr::compareString( const QString &s ) const
 {
-  switch(op) {
+  switch(d->m_operator) {
   case LE:
-    return s1.compare(s2) <= 0;
+    return s.compare(d->m_attrValue) <= 0;
   case GE:
-    return s1.compare(s2) >= 0;
+    return s.compare(d->m_attrValue) >= 0;
   case EQ:
-    return patSubstr(s1,s2);
+    if (!d->m_hasWildcard)
+      return !s.isNull() && s == d->m_attrValue;
+    return patSubstr(s,d->m_attrValue);
   case APPROX:
-    return fixupString(s2) == fixupString(s1);
+    return d->m_approxValue == fixupString(s);
   default:
     return false;
   }
@@ -67,6 +67,18 @@ public:
   //!
   ctkLDAPExpr(const QString &filter);
 
+  /**
+   * Returns the parsed <code>filter</code>. The most recently used filters
+   * are kept in a cache shared by all threads, so that the same filter
+   * string is parsed only once.
+   *
+   * @param filter The filter string.
+   * @return The parsed filter.
+   * @exception ctkInvalidArgumentException If <code>filter</code> is
+   *            not a valid filter. Invalid filters are not cached.
+   */
+  static ctkLDAPExpr parse(const QString &filter);
+
   //!
   ctkLDAPExpr(const ctkLDAPExpr& other);
 
@@ -84,6 +96,19 @@ public:
    */
   bool getMatchedObjectClasses(QSet<QString>& objClasses) const;
 
+  /**
+   * Get the set of values of the attribute <code>attrName</code> matched by
+   * this LDAP expression: a service can only match the expression if its
+   * <code>attrName</code> property has one of these values. This will not
+   * work with wildcards and NOT expressions.
+   *
+   * \param attrName The attribute name, compared ignoring the case.
+   * \param values The set of matched values will be added to values.
+   * \return If the set cannot be determined, <code>false</code> is returned,
+   *         <code>true</code> otherwise.
+   */
+  bool getMatchedValues(const QString& attrName, QSet<QString>& values) const;
+
   /**
    * Checks if this LDAP expression is "simple". The definition of
    * a simple filter is:
@@ -146,11 +171,11 @@ private:
   //!
   static ctkLDAPExpr parseSimple(ParseState &ps);
 
-  //!
-  bool compare(const QVariant &obj, int op, const QString &s) const;
+  //! Compare the property value \a obj with the operand of this simple expression
+  bool compare(const QVariant &obj) const;
 
   //!
-  static bool compareString(const QString &s1, int op, const QString &s2);
+  bool compareString(const QString &s) const;
 
   //!
   static QString fixupString(const QString &s);
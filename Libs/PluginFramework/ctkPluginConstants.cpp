@@ -31,6 +31,7 @@ const QString ctkPluginConstants::FRAMEWORK_STORAGE_CLEAN = "org.commontk.plugin
 const QString ctkPluginConstants::FRAMEWORK_STORAGE_CLEAN_ONFIRSTINIT = "onFirstInit";
 const QString ctkPluginConstants::FRAMEWORK_PLUGIN_LOAD_HINTS = "org.commontk.pluginfw.loadhints";
 const QString ctkPluginConstants::FRAMEWORK_PRELOAD_LIBRARIES = "org.commontk.pluginfw.preloadlibs";
+const QString ctkPluginConstants::FRAMEWORK_SERVICE_INDEX_KEYS = "org.commontk.pluginfw.serviceindexkeys";
 
 const QString ctkPluginConstants::PLUGIN_SYMBOLICNAME = "Plugin-SymbolicName";
 const QString ctkPluginConstants::PLUGIN_COPYRIGHT = "Plugin-Copyright";
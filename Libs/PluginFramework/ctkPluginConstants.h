@@ -122,6 +122,20 @@ struct CTK_PLUGINFW_EXPORT ctkPluginConstants {
    */
   static const QString FRAMEWORK_PRELOAD_LIBRARIES; // = "org.commontk.pluginfw.preloadlibs"
 
+  /**
+   * Specifies service property keys for which the framework keeps an index,
+   * in addition to the objectclass, service.pid and event.topics properties.
+   * The value of this property must be either of type QString or QStringList.
+   *
+   * Service lookups whose filter requires one of the values of an indexed
+   * property, like <code>(&(my.key=value)(service.ranking>=1))</code>,
+   * only evaluate the filter for the services having one of these values.
+   * Only string and string list property values are indexed, the services
+   * whose indexed property has another type are evaluated for every
+   * lookup using the property.
+   */
+  static const QString FRAMEWORK_SERVICE_INDEX_KEYS; // = "org.commontk.pluginfw.serviceindexkeys"
+
   /**
    * Manifest header identifying the plugin's symbolic name.
    *
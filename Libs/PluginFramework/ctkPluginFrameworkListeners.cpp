@@ -61,6 +61,7 @@ void ctkPluginFrameworkListeners::addServiceSlot(
   }
   serviceSet.insert(sse);
   checkSimple(sse);
+  snapshot.reset();
 
   connect(receiver, SIGNAL(destroyed(QObject*)), this, SLOT(serviceListenerDestroyed(QObject*)), Qt::DirectConnection);
 }
@@ -93,6 +94,7 @@ void ctkPluginFrameworkListeners::removeServiceSlot_unlocked(QSharedPointer<ctkP
       if (slot) break;
     }
   }
+  snapshot.reset();
 
   if (plugin)
   {
@@ -110,14 +112,13 @@ void ctkPluginFrameworkListeners::serviceListenerDestroyed(QObject *listener)
 QSet<ctkServiceSlotEntry> ctkPluginFrameworkListeners::getMatchingServiceSlots(
     const ctkServiceReference& sr, bool lockProps)
 {
-  QMutexLocker lock(&mutex); Q_UNUSED(lock);
+  ctkSnapshot<ctkServiceSlotsSnapshot>::Pointer slotsSnapshot = getSnapshot();
 
   QSet<ctkServiceSlotEntry> set;
-  set.reserve(serviceSet.size());
   // Check complicated or empty listener filters
   int n = 0;
   ctkLDAPExpr expr;
-  foreach (const ctkServiceSlotEntry& sse, complicatedListeners)
+  foreach (const ctkServiceSlotEntry& sse, slotsSnapshot->complicatedListeners)
   {
     ++n;
     expr = sse.getLDAPExpr();
@@ -137,25 +138,42 @@ QSet<ctkServiceSlotEntry> ctkPluginFrameworkListeners::getMatchingServiceSlots(
   QStringList c = sr.d_func()->getProperty(ctkPluginConstants::OBJECTCLASS, lockProps).toStringList();
   foreach (QString objClass, c)
   {
-    addToSet(set, OBJECTCLASS_IX, objClass);
+    addToSet(set, *slotsSnapshot, OBJECTCLASS_IX, objClass);
   }
 
   bool ok = false;
   qlonglong service_id = sr.d_func()->getProperty(ctkPluginConstants::SERVICE_ID, lockProps).toLongLong(&ok);
   if (ok)
   {
-    addToSet(set, SERVICE_ID_IX, QString::number(service_id));
+    addToSet(set, *slotsSnapshot, SERVICE_ID_IX, QString::number(service_id));
   }
 
   QStringList service_pids = sr.d_func()->getProperty(ctkPluginConstants::SERVICE_PID, lockProps).toStringList();
   foreach (QString service_pid, service_pids)
   {
-    addToSet(set, SERVICE_PID_IX, service_pid);
+    addToSet(set, *slotsSnapshot, SERVICE_PID_IX, service_pid);
   }
 
   return set;
 }
 
+//----------------------------------------------------------------------------
+ctkSnapshot<ctkServiceSlotsSnapshot>::Pointer ctkPluginFrameworkListeners::getSnapshot()
+{
+  ctkSnapshot<ctkServiceSlotsSnapshot>::Pointer s = snapshot.get();
+  if (!s)
+  {
+    QMutexLocker lock(&mutex);
+    s = snapshot.get();
+    if (!s)
+    {
+      s = new ctkServiceSlotsSnapshot(complicatedListeners, cache);
+      snapshot.publish(s.data());
+    }
+  }
+  return s;
+}
+
 //----------------------------------------------------------------------------
 void ctkPluginFrameworkListeners::frameworkError(QSharedPointer<ctkPlugin> p, const ctkException& e)
 {
@@ -209,6 +227,9 @@ void ctkPluginFrameworkListeners::serviceChanged(
       matchBefore.remove(l);
     }
 
+    // The slot may have been removed since it was matched
+    if (l.isRemoved()) continue;
+
     // TODO permission checks
     //if (l.bundle.hasPermission(new ServicePermission(sr, ServicePermission.GET))) {
     //foreach (QString clazz, classes)
@@ -303,9 +324,10 @@ void ctkPluginFrameworkListeners::checkSimple(const ctkServiceSlotEntry& sse)
 
 //----------------------------------------------------------------------------
 void ctkPluginFrameworkListeners::addToSet(QSet<ctkServiceSlotEntry>& set,
+                                           const ctkServiceSlotsSnapshot& slotsSnapshot,
                                            int cache_ix, const QString& val)
 {
-  QList<ctkServiceSlotEntry>& l = cache[cache_ix][val];
+  const QList<ctkServiceSlotEntry> l = slotsSnapshot.cache[cache_ix].value(val);
   if (!l.isEmpty())
   {
     if (pluginFw->debug.ldap)
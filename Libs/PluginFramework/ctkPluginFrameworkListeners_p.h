@@ -32,6 +32,27 @@
 #include "ctkServiceReference.h"
 #include "ctkServiceSlotEntry_p.h"
 #include "ctkServiceEvent.h"
+#include "ctkSnapshot_p.h"
+
+/**
+ * \ingroup PluginFramework
+ *
+ * The service slots, as seen by ctkPluginFrameworkListeners::getMatchingServiceSlots().
+ * See ctkPluginFrameworkListeners for the members.
+ */
+class ctkServiceSlotsSnapshot : public QSharedData
+{
+
+public:
+
+  ctkServiceSlotsSnapshot(const QList<ctkServiceSlotEntry>& complicatedListeners,
+                          const QList<QHash<QString, QList<ctkServiceSlotEntry> > >& cache)
+    : complicatedListeners(complicatedListeners), cache(cache)
+  {}
+
+  const QList<ctkServiceSlotEntry> complicatedListeners;
+  const QList<QHash<QString, QList<ctkServiceSlotEntry> > > cache;
+};
 
 /**
  * \ingroup PluginFramework
@@ -67,7 +88,8 @@ public:
                          const char* slot);
 
   /**
-   * Gets the slots interested in modifications of the service reference
+   * Gets the slots interested in modifications of the service reference.
+   * Does not lock, unless the service slots changed since the last call.
    *
    * @param sr The reference related to the event describing the service modification.
    * @param lockProps If access to the properties of the service object referenced by sr
@@ -111,6 +133,7 @@ private Q_SLOTS:
 
 private:
 
+  //! Serializes the modifications of the service slots
   QMutex mutex;
 
   QList<QString> hashedServiceKeys;
@@ -126,6 +149,9 @@ private:
 
   QSet<ctkServiceSlotEntry> serviceSet;
 
+  //! Copy of the service slots, reset when they are modified
+  ctkSnapshot<ctkServiceSlotsSnapshot> snapshot;
+
   ctkPluginFrameworkContext* pluginFw;
 
   /**
@@ -140,10 +166,17 @@ private:
    */
   void checkSimple(const ctkServiceSlotEntry& sse);
 
+  /**
+   * Get the current snapshot of the service slots, taking a new one
+   * if they changed.
+   */
+  ctkSnapshot<ctkServiceSlotsSnapshot>::Pointer getSnapshot();
+
   /**
    * Add all members of the specified list to the specified set.
    */
-  void addToSet(QSet<ctkServiceSlotEntry>& set, int cache_ix, const QString& val);
+  void addToSet(QSet<ctkServiceSlotEntry>& set, const ctkServiceSlotsSnapshot& slotsSnapshot,
+                int cache_ix, const QString& val);
 
   /**
    * The unsynchronized version of removeServiceSlot().
@@ -31,6 +31,7 @@
 #include "ctkServiceException.h"
 
 #include <QFileInfo>
+#include <QResource>
 #include <QUrl>
 
 //database table names
@@ -415,80 +416,127 @@ void ctkPluginStorageSQL::insertArchive(QSharedPointer<ctkPluginArchiveSQL> pa,
   QFileInfo fileInfo(pa->getLibLocation());
   QString libTimestamp = getStringFromQDateTime(fileInfo.lastModified());
 
-  QString resourcePrefix = fileInfo.baseName();
-  if (resourcePrefix.startsWith("lib"))
+  QString resourceDir = fileInfo.baseName();
+  if (resourceDir.startsWith("lib"))
   {
-    resourcePrefix = resourcePrefix.mid(3);
+    resourceDir = resourceDir.mid(3);
   }
-  resourcePrefix.replace("_", ".");
-  resourcePrefix = QString(":/") + resourcePrefix + "/";
+  resourceDir.replace("_", ".");
+
+  // Read the resources from the <library>.rcc file written by the build,
+  // if it is up to date. Loading the plugin instead runs its static
+  // initializers and resolves its symbols, although it might never be started.
+  QString rccFile;
+  QString rccRoot;
+  QFileInfo rccInfo(pa->getLibLocation() + ".rcc");
+  if (rccInfo.isFile() && rccInfo.lastModified() >= fileInfo.lastModified())
+  {
+    rccFile = rccInfo.absoluteFilePath();
+    rccRoot = QString("/ctkPluginStorageSQL/%1/%2").arg(pa->getPluginId()).arg(pa->getPluginGeneration());
+    if (!QResource::registerResource(rccFile, rccRoot))
+    {
+      rccRoot.clear();
+    }
+    else if (!QFile::exists(QString(":") + rccRoot + "/" + resourceDir + "/META-INF/MANIFEST.MF"))
+    {
+      QResource::unregisterResource(rccFile, rccRoot);
+      rccRoot.clear();
+    }
+  }
+
+  QString resourcePrefix = QString(":") + rccRoot + "/" + resourceDir + "/";
 
-  // Load the plugin and cache the resources
+  // Otherwise load the plugin and cache the resources
 
   QPluginLoader pluginLoader;
-  pluginLoader.setLoadHints(getPluginLoadHints());
-  pluginLoader.setFileName(pa->getLibLocation());
-  if (!pluginLoader.load())
+  if (rccRoot.isEmpty())
   {
-    ctkPluginException exc(QString("The plugin \"%1\" could not be loaded: %2").arg(pa->getLibLocation())
-                           .arg(pluginLoader.errorString()));
-    throw exc;
+    pluginLoader.setLoadHints(getPluginLoadHints());
+    pluginLoader.setFileName(pa->getLibLocation());
+    if (!pluginLoader.load())
+    {
+      ctkPluginException exc(QString("The plugin \"%1\" could not be loaded: %2").arg(pa->getLibLocation())
+                             .arg(pluginLoader.errorString()));
+      throw exc;
+    }
   }
 
-  QFile manifestResource(resourcePrefix + "META-INF/MANIFEST.MF");
-  manifestResource.open(QIODevice::ReadOnly);
-  QByteArray manifest = manifestResource.readAll();
-  manifestResource.close();
-
-  // Finally, complete the ctkPluginArchive information by reading the MANIFEST.MF resource
-  pa->readManifest(manifest);
-
-  // Assemble the data for the sql records
+  try
+  {
+    QFile manifestResource(resourcePrefix + "META-INF/MANIFEST.MF");
+    manifestResource.open(QIODevice::ReadOnly);
+    QByteArray manifest = manifestResource.readAll();
+    manifestResource.close();
+
+    // Finally, complete the ctkPluginArchive information by reading the MANIFEST.MF resource
+    pa->readManifest(manifest);
+
+    // Assemble the data for the sql records
+
+    QString version = pa->getAttribute(ctkPluginConstants::PLUGIN_VERSION);
+    if (version.isEmpty()) version = "na";
+
+    QString statement = "INSERT INTO " PLUGINS_TABLE " (ID,Generation,Location,LocalPath,SymbolicName,Version,LastModified,Timestamp,StartLevel,AutoStart) "
+                        "VALUES (?,?,?,?,?,?,?,?,?,?)";
+
+    QList<QVariant> bindValues;
+    bindValues << pa->getPluginId();
+    bindValues << pa->getPluginGeneration();
+    bindValues << pa->getPluginLocation();
+    bindValues << pa->getLibLocation();
+    bindValues << pa->getAttribute(ctkPluginConstants::PLUGIN_SYMBOLICNAME);
+    bindValues << version;
+    bindValues << "na";
+    bindValues << libTimestamp;
+    bindValues << pa->getStartLevel();
+    bindValues << pa->getAutostartSetting();
 
-  QString version = pa->getAttribute(ctkPluginConstants::PLUGIN_VERSION);
-  if (version.isEmpty()) version = "na";
+    executeQuery(query, statement, bindValues);
 
-  QString statement = "INSERT INTO " PLUGINS_TABLE " (ID,Generation,Location,LocalPath,SymbolicName,Version,LastModified,Timestamp,StartLevel,AutoStart) "
-                      "VALUES (?,?,?,?,?,?,?,?,?,?)";
+    pa->key = query->lastInsertId().toInt();
 
-  QList<QVariant> bindValues;
-  bindValues << pa->getPluginId();
-  bindValues << pa->getPluginGeneration();
-  bindValues << pa->getPluginLocation();
-  bindValues << pa->getLibLocation();
-  bindValues << pa->getAttribute(ctkPluginConstants::PLUGIN_SYMBOLICNAME);
-  bindValues << version;
-  bindValues << "na";
-  bindValues << libTimestamp;
-  bindValues << pa->getStartLevel();
-  bindValues << pa->getAutostartSetting();
+    // Write the plug-in resource data into the database
+    QDirIterator dirIter(resourcePrefix, QDirIterator::Subdirectories);
+    while (dirIter.hasNext())
+    {
+      QString resourcePath = dirIter.next();
+      if (QFileInfo(resourcePath).isDir()) continue;
 
-  executeQuery(query, statement, bindValues);
+      QFile resourceFile(resourcePath);
+      resourceFile.open(QIODevice::ReadOnly);
+      QByteArray resourceData = resourceFile.readAll();
+      resourceFile.close();
 
-  pa->key = query->lastInsertId().toInt();
+      statement = "INSERT INTO " PLUGIN_RESOURCES_TABLE " (K,ResourcePath,Resource) VALUES(?,?,?)";
+      bindValues.clear();
+      bindValues << pa->key;
+      bindValues << resourcePath.mid(resourcePrefix.size()-1);
+      bindValues << resourceData;
 
-  // Write the plug-in resource data into the database
-  QDirIterator dirIter(resourcePrefix, QDirIterator::Subdirectories);
-  while (dirIter.hasNext())
+      executeQuery(query, statement, bindValues);
+    }
+  }
+  catch (...)
   {
-    QString resourcePath = dirIter.next();
-    if (QFileInfo(resourcePath).isDir()) continue;
-
-    QFile resourceFile(resourcePath);
-    resourceFile.open(QIODevice::ReadOnly);
-    QByteArray resourceData = resourceFile.readAll();
-    resourceFile.close();
-
-    statement = "INSERT INTO " PLUGIN_RESOURCES_TABLE " (K,ResourcePath,Resource) VALUES(?,?,?)";
-    bindValues.clear();
-    bindValues << pa->key;
-    bindValues << resourcePath.mid(resourcePrefix.size()-1);
-    bindValues << resourceData;
-
-    executeQuery(query, statement, bindValues);
+    if (rccRoot.isEmpty())
+    {
+      pluginLoader.unload();
+    }
+    else
+    {
+      QResource::unregisterResource(rccFile, rccRoot);
+    }
+    throw;
   }
 
-  pluginLoader.unload();
+  if (rccRoot.isEmpty())
+  {
+    pluginLoader.unload();
+  }
+  else
+  {
+    QResource::unregisterResource(rccFile, rccRoot);
+  }
 }
 
 //----------------------------------------------------------------------------
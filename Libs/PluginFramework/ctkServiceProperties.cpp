@@ -23,18 +23,80 @@ limitations under the License.
 
 #include <ctkException.h>
 
+#include <QMutex>
+#include <QSet>
+
+//----------------------------------------------------------------------------
+namespace {
+
+struct ctkServicePropertiesKeys
+{
+  ctkServicePropertiesKeys() : pruneSize(MinPruneSize) {}
+
+  //! Size of keys below which the unused keys are not pruned
+  enum { MinPruneSize = 1024 };
+
+  QMutex mutex;
+  QSet<QString> keys;
+  int pruneSize;
+};
+
+}
+
+Q_GLOBAL_STATIC(ctkServicePropertiesKeys, internedKeys)
+
+//----------------------------------------------------------------------------
+// Returns the shared copy of the case folded key
+static QString internKey(const QString& key)
+{
+  QString foldedKey = key.toCaseFolded();
+  ctkServicePropertiesKeys* keys = internedKeys();
+  if (!keys) return foldedKey;
+
+  QMutexLocker lock(&keys->mutex);
+  QSet<QString>::const_iterator i = keys->keys.constFind(foldedKey);
+  if (i != keys->keys.constEnd())
+  {
+    return *i;
+  }
+  if (keys->keys.size() >= keys->pruneSize)
+  {
+    // Drop the keys of the properties which were all destroyed, only
+    // the set still references them. Pruning again once the set doubled
+    // keeps it below twice the number of keys in use.
+    for (QSet<QString>::iterator k = keys->keys.begin(); k != keys->keys.end();)
+    {
+      if (k->isDetached())
+      {
+        k = keys->keys.erase(k);
+      }
+      else
+      {
+        ++k;
+      }
+    }
+    keys->pruneSize = qMax(static_cast<int>(ctkServicePropertiesKeys::MinPruneSize),
+                           2 * keys->keys.size());
+  }
+  keys->keys.insert(foldedKey);
+  return foldedKey;
+}
+
 //----------------------------------------------------------------------------
 ctkServiceProperties::ctkServiceProperties(const ctkProperties& props)
 {
+  foldedKeys.reserve(props.size());
   for(ctkProperties::ConstIterator i = props.begin(), end = props.end();
       i != end; ++i)
   {
-    if (find(i.key()) != -1)
+    QString foldedKey = internKey(i.key());
+    if (foldedKeys.contains(foldedKey))
     {
       QString msg("ctkProperties object contains case variants of the key: ");
       msg += i.key();
       throw ctkInvalidArgumentException(msg);
     }
+    foldedKeys.insert(foldedKey, ks.size());
     ks.append(i.key());
     vs.append(i.value());
   }
@@ -68,21 +130,22 @@ QStringList ctkServiceProperties::keys() const
 //----------------------------------------------------------------------------
 int ctkServiceProperties::find(const QString &key) const
 {
-  for (int i = 0; i < ks.size(); ++i)
+  // A key which is found as is is case folded already,
+  // and folding it would give the same index
+  QHash<QString, int>::const_iterator i = foldedKeys.constFind(key);
+  if (i == foldedKeys.constEnd())
   {
-    if (ks[i].compare(key, Qt::CaseInsensitive) == 0)
-      return i;
+    i = foldedKeys.constFind(key.toCaseFolded());
+    if (i == foldedKeys.constEnd())
+      return -1;
   }
-  return -1;
+  return i.value();
 }
 
 //----------------------------------------------------------------------------
 int ctkServiceProperties::findCaseSensitive(const QString &key) const
 {
-  for (int i = 0; i < ks.size(); ++i)
-  {
-    if (ks[i] == key)
-      return i;
-  }
-  return -1;
+  // The keys are unique ignoring the case
+  int i = find(key);
+  return (i >= 0 && ks[i] == key) ? i : -1;
 }
@@ -22,11 +22,22 @@ limitations under the License.
 #ifndef CTKSERVICEPROPERTIES_P_H
 #define CTKSERVICEPROPERTIES_P_H
 
+#include <QHash>
 #include <QVarLengthArray>
 #include <QVariant>
 
 #include "ctkPluginFramework_global.h"
 
+/**
+ * \ingroup PluginFramework
+ *
+ * The properties of a service, with case-insensitive keys.
+ *
+ * The keys are also stored case folded in a hash, so that find() is
+ * a hash lookup. The folded keys are interned: the services share a
+ * single copy of each key. The keys which are not used anymore are
+ * pruned from the interned keys as they grow.
+ */
 class ctkServiceProperties
 {
 
@@ -35,7 +46,8 @@ private:
   QVarLengthArray<QString,10> ks;
   QVarLengthArray<QVariant,10> vs;
 
-  QMap<QString, QVariant> map;
+  //! Index in ks and vs by case folded key
+  QHash<QString, int> foldedKeys;
 
 public:
 
@@ -44,6 +56,12 @@ public:
   QVariant value(const QString& key) const;
   QVariant value(int index) const;
 
+  /**
+   * Find a key, ignoring the case. Faster if <code>key</code> is
+   * already in lower case.
+   *
+   * @return The index of the key, -1 if not found.
+   */
   int find(const QString& key) const;
   int findCaseSensitive(const QString& key) const;
 
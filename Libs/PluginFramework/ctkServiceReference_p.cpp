@@ -52,7 +52,7 @@ QObject* ctkServiceReferencePrivate::getService(QSharedPointer<ctkPlugin> plugin
   QObject* s = 0;
   {
     QMutexLocker lock(&registration->propsLock);
-    if (registration->available)
+    if (registration->isAvailable())
     {
       int count = registration->dependents.value(plugin);
       if (count == 0)
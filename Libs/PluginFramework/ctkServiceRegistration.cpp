@@ -94,7 +94,7 @@ ctkServiceReference ctkServiceRegistration::getReference() const
   Q_D(const ctkServiceRegistration);
 
   if (!d) throw ctkIllegalStateException("ctkServiceRegistration object invalid");
-  if (!d->available) throw ctkIllegalStateException("Service is unregistered");
+  if (!d->isAvailable()) throw ctkIllegalStateException("Service is unregistered");
 
   return d->reference;
 }
@@ -113,15 +113,19 @@ void ctkServiceRegistration::setProperties(const ctkDictionary& props)
     QMutexLocker lock2(&d->plugin->fwCtx->globalFwLock);
     QMutexLocker lock3(&d->propsLock);
 
-    if (d->available)
+    if (d->isAvailable())
     {
       // NYI! Optimize the MODIFIED_ENDMATCH code
       int old_rank = d->properties.value(ctkPluginConstants::SERVICE_RANKING).toInt();
       before = d->plugin->fwCtx->listeners.getMatchingServiceSlots(d->reference, false);
       QStringList classes = d->properties.value(ctkPluginConstants::OBJECTCLASS).toStringList();
       qlonglong sid = d->properties.value(ctkPluginConstants::SERVICE_ID).toLongLong();
+      ctkServiceProperties oldProperties = d->properties;
       d->properties = ctkServices::createServiceProperties(props, classes, sid);
       int new_rank = d->properties.value(ctkPluginConstants::SERVICE_RANKING).toInt();
+      // Sorting the services compares their properties, which locks propsLock
+      lock3.unlock();
+      d->plugin->fwCtx->services->updateServiceProperties(*this, oldProperties);
       if (old_rank != new_rank)
       {
         d->plugin->fwCtx->services->updateServiceRegistrationOrder(*this, classes);
@@ -153,7 +157,7 @@ void ctkServiceRegistration::unregister()
     if (d->unregistering) return;
     d->unregistering = true;
 
-    if (d->available)
+    if (d->isAvailable())
     {
       if (d->plugin)
       {
@@ -177,7 +181,7 @@ void ctkServiceRegistration::unregister()
     QMutexLocker lock(&d->eventLock);
     {
       QMutexLocker lock2(&d->propsLock);
-      d->available = false;
+      d->available.fetchAndStoreOrdered(0);
       if (d->plugin)
       {
         for (QHashIterator<QSharedPointer<ctkPlugin>, QObject*> i(d->serviceInstances); i.hasNext();)
@@ -26,7 +26,7 @@ ctkServiceRegistrationPrivate::ctkServiceRegistrationPrivate(
   ctkPluginPrivate* plugin, QObject* service,
   const ctkDictionary& props)
   : ref(1), service(service), plugin(plugin), reference(this),
-    properties(props), available(true), unregistering(false),
+    properties(props), available(1), unregistering(false),
     propsLock()
 {
 
@@ -45,6 +45,12 @@ bool ctkServiceRegistrationPrivate::isUsedByPlugin(QSharedPointer<ctkPlugin> p)
   return deps.contains(p);
 }
 
+//----------------------------------------------------------------------------
+bool ctkServiceRegistrationPrivate::isAvailable() const
+{
+  return available.fetchAndAddOrdered(0) != 0;
+}
+
 //----------------------------------------------------------------------------
 QObject* ctkServiceRegistrationPrivate::getService()
 {
@@ -25,6 +25,7 @@
 
 #include <QHash>
 #include <QMutex>
+#include <QAtomicInt>
 
 #include "ctkServiceProperties_p.h"
 #include "ctkServiceReference.h"
@@ -89,10 +90,11 @@ public:
   QHash<QSharedPointer<ctkPlugin>, QObject*> serviceInstances;
 
   /**
-   * Is service available. I.e., if <code>true</code> then holders
+   * Is service available. I.e., if not 0 then holders
    * of a ctkServiceReference for the service are allowed to get it.
+   * The service lookups read it without a lock, use isAvailable().
    */
-  volatile bool available;
+  mutable QAtomicInt available;
 
   /**
    * Avoid recursive unregistrations. I.e., if <code>true</code> then
@@ -121,6 +123,13 @@ public:
    */
   bool isUsedByPlugin(QSharedPointer<ctkPlugin> p);
 
+  /**
+   * Check if the service is available, without locking.
+   *
+   * @return true if the service is not unregistered
+   */
+  bool isAvailable() const;
+
   virtual QObject* getService();
 
 private:
@@ -80,7 +80,7 @@ ctkServiceSlotEntry::ctkServiceSlotEntry(
 {
   if (!filter.isNull())
   {
-    d->ldap = ctkLDAPExpr(filter);
+    d->ldap = ctkLDAPExpr::parse(filter);
   }
 }
 
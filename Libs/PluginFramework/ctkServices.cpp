@@ -24,6 +24,7 @@
 #include <QStringListIterator>
 #include <QMutexLocker>
 #include <QBuffer>
+#include <QSet>
 
 #include <algorithm>
 
@@ -43,6 +44,75 @@ struct ServiceRegistrationComparator
   }
 };
 
+//----------------------------------------------------------------------------
+// Get the values under which a property is indexed, see
+// ctkServicePropertyIndex. Returns false if the property is not a string
+// or a list of strings, the service is then not indexed by value.
+static bool getIndexValues(const QVariant& value, QSet<QString>& values)
+{
+  switch (value.userType())
+  {
+  case QMetaType::QString:
+    values.insert(value.toString());
+    return true;
+  case QMetaType::QStringList:
+    foreach (QString v, value.toStringList())
+    {
+      values.insert(v);
+    }
+    return true;
+  case QMetaType::QVariantList:
+    foreach (QVariant v, value.toList())
+    {
+      if (!getIndexValues(v, values))
+      {
+        return false;
+      }
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+//----------------------------------------------------------------------------
+static void insertSorted(QList<ctkServiceRegistration>& s, const ctkServiceRegistration& sr)
+{
+  s.insert(std::lower_bound(s.begin(), s.end(), sr, ServiceRegistrationComparator()), sr);
+}
+
+//----------------------------------------------------------------------------
+static QList<ctkServiceRegistration> getServicesByValue(
+    const QHash<QString, QList<ctkServiceRegistration> >& index,
+    const QSet<QString>& values,
+    const QList<ctkServiceRegistration>& unindexed = QList<ctkServiceRegistration>())
+{
+  if (values.isEmpty())
+  {
+    return unindexed;
+  }
+  if (values.size() == 1 && unindexed.isEmpty())
+  {
+    return index.value(*values.begin());
+  }
+
+  // A service may be indexed under several of the values
+  QList<ctkServiceRegistration> res = unindexed;
+  QSet<ctkServiceRegistration> added = res.toSet();
+  foreach (QString value, values)
+  {
+    foreach (ctkServiceRegistration sr, index.value(value))
+    {
+      if (!added.contains(sr))
+      {
+        added.insert(sr);
+        res.push_back(sr);
+      }
+    }
+  }
+  return res;
+}
+
 //----------------------------------------------------------------------------
 ctkDictionary ctkServices::createServiceProperties(const ctkDictionary& in,
                                                        const QStringList& classes,
@@ -65,7 +135,19 @@ ctkDictionary ctkServices::createServiceProperties(const ctkDictionary& in,
 ctkServices::ctkServices(ctkPluginFrameworkContext* fwCtx)
   : mutex(), framework(fwCtx)
 {
-
+  // "event.topics" is ctkEventConstants::EVENT_TOPIC, the event handlers
+  // of the event admin are looked up by topic
+  QStringList indexKeys;
+  indexKeys << ctkPluginConstants::SERVICE_PID << "event.topics";
+  indexKeys << fwCtx->props.value(ctkPluginConstants::FRAMEWORK_SERVICE_INDEX_KEYS).toStringList();
+  foreach (QString key, indexKeys)
+  {
+    key = key.toLower();
+    if (!key.isEmpty() && key != ctkPluginConstants::OBJECTCLASS)
+    {
+      propertyServices.insert(key, ctkServicePropertyIndex());
+    }
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -77,11 +159,36 @@ ctkServices::~ctkServices()
 //----------------------------------------------------------------------------
 void ctkServices::clear()
 {
+  QMutexLocker lock(&mutex);
   services.clear();
   classServices.clear();
+  for (QHash<QString, ctkServicePropertyIndex>::iterator i = propertyServices.begin();
+       i != propertyServices.end(); ++i)
+  {
+    i.value() = ctkServicePropertyIndex();
+  }
+  snapshot.reset();
   framework = 0;
 }
 
+//----------------------------------------------------------------------------
+ctkSnapshot<ctkServicesSnapshot>::Pointer ctkServices::getSnapshot() const
+{
+  ctkSnapshot<ctkServicesSnapshot>::Pointer s = snapshot.get();
+  if (!s)
+  {
+    // The services changed since the last snapshot
+    QMutexLocker lock(&mutex);
+    s = snapshot.get();
+    if (!s)
+    {
+      s = new ctkServicesSnapshot(services, classServices, propertyServices);
+      snapshot.publish(s.data());
+    }
+  }
+  return s;
+}
+
 //----------------------------------------------------------------------------
 ctkServiceRegistration ctkServices::registerService(ctkPluginPrivate* plugin,
                              const QStringList& classes,
@@ -126,6 +233,8 @@ ctkServiceRegistration ctkServices::registerService(ctkPluginPrivate* plugin,
           std::lower_bound(s.begin(), s.end(), res, ServiceRegistrationComparator());
       s.insert(ip, res);
     }
+    addToIndexes(res, res.d_func()->properties);
+    snapshot.reset();
   }
 
   ctkServiceReference r = res.getReference();
@@ -146,6 +255,102 @@ void ctkServices::updateServiceRegistrationOrder(const ctkServiceRegistration& s
     s.removeAll(sr);
     s.insert(std::lower_bound(s.begin(), s.end(), sr, ServiceRegistrationComparator()), sr);
   }
+  snapshot.reset();
+}
+
+//----------------------------------------------------------------------------
+void ctkServices::updateServiceProperties(const ctkServiceRegistration& sr,
+                                          const ctkServiceProperties& oldProperties)
+{
+  QMutexLocker lock(&mutex);
+  // Also re-sorts sr in the lists of the unchanged values, in case
+  // the ranking changed
+  removeFromIndexes(sr, oldProperties);
+  addToIndexes(sr, sr.d_func()->properties);
+  snapshot.reset();
+}
+
+//----------------------------------------------------------------------------
+void ctkServices::addToIndexes(const ctkServiceRegistration& sr,
+                               const ctkServiceProperties& properties)
+{
+  for (QHash<QString, ctkServicePropertyIndex>::iterator i = propertyServices.begin();
+       i != propertyServices.end(); ++i)
+  {
+    QVariant value = properties.value(i.key());
+    if (value.isNull()) continue;
+
+    QSet<QString> values;
+    if (!getIndexValues(value, values))
+    {
+      insertSorted(i.value().unindexed, sr);
+      continue;
+    }
+    foreach (QString v, values)
+    {
+      insertSorted(i.value().values[v], sr);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void ctkServices::removeFromIndexes(const ctkServiceRegistration& sr,
+                                    const ctkServiceProperties& properties)
+{
+  for (QHash<QString, ctkServicePropertyIndex>::iterator i = propertyServices.begin();
+       i != propertyServices.end(); ++i)
+  {
+    QVariant value = properties.value(i.key());
+    if (value.isNull()) continue;
+
+    QSet<QString> values;
+    if (!getIndexValues(value, values))
+    {
+      i.value().unindexed.removeAll(sr);
+      continue;
+    }
+    foreach (QString v, values)
+    {
+      QHash<QString, QList<ctkServiceRegistration> >::iterator s = i.value().values.find(v);
+      if (s == i.value().values.end()) continue;
+      s.value().removeAll(sr);
+      if (s.value().isEmpty())
+      {
+        i.value().values.erase(s);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool ctkServices::getIndexedServices(const ctkServicesSnapshot& registry,
+                                     const ctkLDAPExpr& ldap,
+                                     QList<ctkServiceRegistration>& indexed) const
+{
+  bool found = false;
+  QSet<QString> values;
+  if (ldap.getMatchedObjectClasses(values))
+  {
+    indexed = getServicesByValue(registry.classServices, values);
+    found = true;
+  }
+
+  // use the index giving the fewest services
+  for (QHash<QString, ctkServicePropertyIndex>::const_iterator i = registry.propertyServices.begin();
+       i != registry.propertyServices.end() && !(found && indexed.isEmpty()); ++i)
+  {
+    values.clear();
+    if (ldap.getMatchedValues(i.key(), values))
+    {
+      QList<ctkServiceRegistration> r = getServicesByValue(i.value().values, values, i.value().unindexed);
+      if (!found || r.size() < indexed.size())
+      {
+        indexed = r;
+        found = true;
+      }
+    }
+  }
+  return found;
 }
 
 //----------------------------------------------------------------------------
@@ -157,16 +362,14 @@ bool ctkServices::checkServiceClass(QObject* service, const QString& cls) const
 //----------------------------------------------------------------------------
 QList<ctkServiceRegistration> ctkServices::get(const QString& clazz) const
 {
-  QMutexLocker lock(&mutex);
-  return classServices.value(clazz);
+  return getSnapshot()->classServices.value(clazz);
 }
 
 //----------------------------------------------------------------------------
 ctkServiceReference ctkServices::get(ctkPluginPrivate* plugin, const QString& clazz) const
 {
-  QMutexLocker lock(&mutex);
   try {
-    QList<ctkServiceReference> srs = get_unlocked(clazz, QString(), plugin);
+    QList<ctkServiceReference> srs = get_unlocked(*getSnapshot(), clazz, QString(), plugin);
     if (framework->debug.service_reference)
     {
       qDebug() << "get service ref" << clazz << "for plugin"
@@ -186,12 +389,12 @@ ctkServiceReference ctkServices::get(ctkPluginPrivate* plugin, const QString& cl
 QList<ctkServiceReference> ctkServices::get(const QString& clazz, const QString& filter,
                                             ctkPluginPrivate* plugin) const
 {
-  QMutexLocker lock(&mutex);
-  return get_unlocked(clazz, filter, plugin);
+  return get_unlocked(*getSnapshot(), clazz, filter, plugin);
 }
 
 //----------------------------------------------------------------------------
-QList<ctkServiceReference> ctkServices::get_unlocked(const QString& clazz, const QString& filter,
+QList<ctkServiceReference> ctkServices::get_unlocked(const ctkServicesSnapshot& registry,
+                                                     const QString& clazz, const QString& filter,
                                                      ctkPluginPrivate* plugin) const
 {
   Q_UNUSED(plugin)
@@ -203,16 +406,9 @@ QList<ctkServiceReference> ctkServices::get_unlocked(const QString& clazz, const
   {
     if (!filter.isEmpty())
     {
-      ldap = ctkLDAPExpr(filter);
-      QSet<QString> matched;
-      if (ldap.getMatchedObjectClasses(matched))
+      ldap = ctkLDAPExpr::parse(filter);
+      if (getIndexedServices(registry, ldap, v))
       {
-        v.clear();
-        foreach (QString className, matched)
-        {
-          const QList<ctkServiceRegistration>& cl = classServices[className];
-          v += cl;
-        }
         if (!v.isEmpty())
         {
           s = new QListIterator<ctkServiceRegistration>(v);
@@ -224,17 +420,17 @@ QList<ctkServiceReference> ctkServices::get_unlocked(const QString& clazz, const
       }
       else
       {
-        s = new QListIterator<ctkServiceRegistration>(services.keys());
+        s = new QListIterator<ctkServiceRegistration>(registry.services.keys());
       }
     }
     else
     {
-      s = new QListIterator<ctkServiceRegistration>(services.keys());
+      s = new QListIterator<ctkServiceRegistration>(registry.services.keys());
     }
   }
   else
   {
-    QList<ctkServiceRegistration> v = classServices.value(clazz);
+    QList<ctkServiceRegistration> v = registry.classServices.value(clazz);
     if (!v.isEmpty())
     {
       s = new QListIterator<ctkServiceRegistration>(v);
@@ -245,7 +441,22 @@ QList<ctkServiceReference> ctkServices::get_unlocked(const QString& clazz, const
     }
     if (!filter.isEmpty())
     {
-      ldap = ctkLDAPExpr(filter);
+      ldap = ctkLDAPExpr::parse(filter);
+      // Use the services of a property index instead if there are fewer
+      QList<ctkServiceRegistration> indexed;
+      if (getIndexedServices(registry, ldap, indexed) && indexed.size() < v.size())
+      {
+        v.clear();
+        foreach (ctkServiceRegistration sr, indexed)
+        {
+          if (registry.services.value(sr).contains(clazz))
+          {
+            v.push_back(sr);
+          }
+        }
+        delete s;
+        s = new QListIterator<ctkServiceRegistration>(v);
+      }
     }
   }
 
@@ -253,11 +464,15 @@ QList<ctkServiceReference> ctkServices::get_unlocked(const QString& clazz, const
   while (s->hasNext())
   {
     ctkServiceRegistration sr = s->next();
-    ctkServiceReference sri = sr.getReference();
+    // The service may have been unregistered since the snapshot was taken
+    if (!sr.d_func()->isAvailable())
+    {
+      continue;
+    }
 
     if (filter.isEmpty() || ldap.evaluate(sr.d_func()->properties, false))
     {
-      res.push_back(sri);
+      res.push_back(sr.d_func()->reference);
     }
   }
 
@@ -273,6 +488,7 @@ void ctkServices::removeServiceRegistration(const ctkServiceRegistration& sr)
 
   QStringList classes = sr.d_func()->properties.value(ctkPluginConstants::OBJECTCLASS).toStringList();
   services.remove(sr);
+  removeFromIndexes(sr, sr.d_func()->properties);
   for (QStringListIterator i(classes); i.hasNext(); )
   {
     QString currClass = i.next();
@@ -286,15 +502,16 @@ void ctkServices::removeServiceRegistration(const ctkServiceRegistration& sr)
       classServices.remove(currClass);
     }
   }
+  snapshot.reset();
 }
 
 //----------------------------------------------------------------------------
 QList<ctkServiceRegistration> ctkServices::getRegisteredByPlugin(ctkPluginPrivate* p) const
 {
-  QMutexLocker lock(&mutex);
+  ctkSnapshot<ctkServicesSnapshot>::Pointer s = getSnapshot();
 
   QList<ctkServiceRegistration> res;
-  for (QHashIterator<ctkServiceRegistration, QStringList> i(services); i.hasNext(); )
+  for (QHashIterator<ctkServiceRegistration, QStringList> i(s->services); i.hasNext(); )
   {
     ctkServiceRegistration sr = i.next().key();
     if (sr.d_func()->plugin == p)
@@ -308,10 +525,10 @@ QList<ctkServiceRegistration> ctkServices::getRegisteredByPlugin(ctkPluginPrivat
 //----------------------------------------------------------------------------
 QList<ctkServiceRegistration> ctkServices::getUsedByPlugin(QSharedPointer<ctkPlugin> p) const
 {
-  QMutexLocker lock(&mutex);
+  ctkSnapshot<ctkServicesSnapshot>::Pointer s = getSnapshot();
 
   QList<ctkServiceRegistration> res;
-  for (QHashIterator<ctkServiceRegistration, QStringList> i(services); i.hasNext(); )
+  for (QHashIterator<ctkServiceRegistration, QStringList> i(s->services); i.hasNext(); )
   {
     ctkServiceRegistration sr = i.next().key();
     if (sr.d_func()->isUsedByPlugin(p))
@@ -30,7 +30,51 @@
 
 #include "ctkPlugin_p.h"
 #include "ctkServiceRegistration.h"
+#include "ctkSnapshot_p.h"
 
+class ctkLDAPExpr;
+class ctkServiceProperties;
+
+/**
+ * \ingroup PluginFramework
+ *
+ * The registered services by the value of an indexed property.
+ *
+ * Only string values are indexed: a service whose property is a string,
+ * or a list of strings, is found in <code>values</code> under each of
+ * the strings. The filters compare the other types by value,
+ * (service.pid=05) matches the number 5, so a service whose property
+ * has another type, or is a list with an element of another type, is
+ * kept in <code>unindexed</code> and is a candidate for every value.
+ * Both are ordered like ctkServices::classServices.
+ */
+struct ctkServicePropertyIndex
+{
+  QHash<QString, QList<ctkServiceRegistration> > values;
+  QList<ctkServiceRegistration> unindexed;
+};
+
+/**
+ * \ingroup PluginFramework
+ *
+ * The registered services, as seen by the service lookups.
+ * See ctkServices for the members.
+ */
+class ctkServicesSnapshot : public QSharedData
+{
+
+public:
+
+  ctkServicesSnapshot(const QHash<ctkServiceRegistration, QStringList>& services,
+                      const QHash<QString, QList<ctkServiceRegistration> >& classServices,
+                      const QHash<QString, ctkServicePropertyIndex>& propertyServices)
+    : services(services), classServices(classServices), propertyServices(propertyServices)
+  {}
+
+  const QHash<ctkServiceRegistration, QStringList> services;
+  const QHash<QString, QList<ctkServiceRegistration> > classServices;
+  const QHash<QString, ctkServicePropertyIndex> propertyServices;
+};
 
 /**
  * \ingroup PluginFramework
@@ -41,6 +85,10 @@ class ctkServices {
 
 public:
 
+  /**
+   * Serializes the modifications of the services. The lookups do not
+   * lock it, they work on a snapshot of the services.
+   */
   mutable QMutex mutex;
 
   /**
@@ -70,6 +118,15 @@ public:
    */
   QHash<QString, QList<ctkServiceRegistration> > classServices;
 
+  /**
+   * Mapping of the lower case key of an indexed property to the
+   * registered services by property value, see ctkServicePropertyIndex
+   * for the indexed values. The service.pid and event.topics properties
+   * are indexed, as well as the keys listed in the
+   * ctkPluginConstants::FRAMEWORK_SERVICE_INDEX_KEYS framework property.
+   */
+  QHash<QString, ctkServicePropertyIndex> propertyServices;
+
 
   ctkPluginFrameworkContext* framework;
 
@@ -111,6 +168,16 @@ public:
                                       const QStringList& classes);
 
 
+  /**
+   * Service properties changed, update the property indexes.
+   *
+   * @param sr The ctkServiceRegistration object, with the new properties.
+   * @param oldProperties The properties before the change.
+   */
+  void updateServiceProperties(const ctkServiceRegistration& sr,
+                               const ctkServiceProperties& oldProperties);
+
+
   /**
    * Checks that a given service object is an instance of the given
    * class name.
@@ -181,7 +248,37 @@ public:
 
 private:
 
-  QList<ctkServiceReference> get_unlocked(const QString& clazz, const QString& filter,
+  /**
+   * Copy of the services published to the lookups, reset when the
+   * services are modified.
+   */
+  mutable ctkSnapshot<ctkServicesSnapshot> snapshot;
+
+  /**
+   * Get the current snapshot of the services, without locking unless
+   * the services changed since the last snapshot.
+   */
+  ctkSnapshot<ctkServicesSnapshot>::Pointer getSnapshot() const;
+
+  void addToIndexes(const ctkServiceRegistration& sr,
+                    const ctkServiceProperties& properties);
+
+  void removeFromIndexes(const ctkServiceRegistration& sr,
+                         const ctkServiceProperties& properties);
+
+  /**
+   * Get the services which can match <code>ldap</code>, from the
+   * classServices or propertyServices index giving the fewest services.
+   *
+   * @return <code>false</code> if no index can be used for
+   *         <code>ldap</code>.
+   */
+  bool getIndexedServices(const ctkServicesSnapshot& registry,
+                          const ctkLDAPExpr& ldap,
+                          QList<ctkServiceRegistration>& indexed) const;
+
+  QList<ctkServiceReference> get_unlocked(const ctkServicesSnapshot& registry,
+                                          const QString& clazz, const QString& filter,
                                           ctkPluginPrivate* plugin) const;
 
 };
@@ -0,0 +1,108 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+#include "ctkSnapshot_p.h"
+
+//----------------------------------------------------------------------------
+template<class T>
+ctkSnapshot<T>::ctkSnapshot()
+  : current(0), readers(0), retiredCount(0)
+{
+}
+
+//----------------------------------------------------------------------------
+template<class T>
+ctkSnapshot<T>::~ctkSnapshot()
+{
+  reset();
+  // there are no readers left
+  foreach (T* snapshot, retired)
+  {
+    if (!snapshot->ref.deref()) delete snapshot;
+  }
+}
+
+//----------------------------------------------------------------------------
+template<class T>
+typename ctkSnapshot<T>::Pointer ctkSnapshot<T>::get() const
+{
+  // While readers is not 0, the snapshot loaded here can not be released
+  readers.ref();
+  Pointer snapshot(current.fetchAndAddOrdered(0));
+  if (!readers.deref() && retiredCount.fetchAndAddOrdered(0) != 0)
+  {
+    // The publish() or reset() call which retired them saw a reader
+    reclaim();
+  }
+  return snapshot;
+}
+
+//----------------------------------------------------------------------------
+template<class T>
+void ctkSnapshot<T>::publish(T* snapshot)
+{
+  if (snapshot)
+  {
+    snapshot->ref.ref();
+  }
+  T* old = current.fetchAndStoreOrdered(snapshot);
+  if (old)
+  {
+    QMutexLocker lock(&retiredLock);
+    retired.push_back(old);
+    retiredCount.fetchAndStoreOrdered(retired.size());
+  }
+  reclaim();
+}
+
+//----------------------------------------------------------------------------
+template<class T>
+void ctkSnapshot<T>::reset()
+{
+  publish(0);
+}
+
+//----------------------------------------------------------------------------
+template<class T>
+void ctkSnapshot<T>::reclaim() const
+{
+  // The retired snapshots are not current anymore, the readers entering
+  // get() after the check of readers can not load them. If the lock is
+  // held, its owner checks readers again after unlocking, so that the
+  // reader leaving get() meanwhile does not leave the snapshots retired.
+  while (retiredLock.tryLock())
+  {
+    if (readers.fetchAndAddOrdered(0) == 0)
+    {
+      foreach (T* snapshot, retired)
+      {
+        if (!snapshot->ref.deref()) delete snapshot;
+      }
+      retired.clear();
+      retiredCount.fetchAndStoreOrdered(0);
+    }
+    bool pending = !retired.isEmpty();
+    retiredLock.unlock();
+    if (!pending || readers.fetchAndAddOrdered(0) != 0) return;
+  }
+}
@@ -0,0 +1,112 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+#ifndef CTKSNAPSHOT_P_H
+#define CTKSNAPSHOT_P_H
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QExplicitlySharedDataPointer>
+#include <QList>
+#include <QMutex>
+
+/**
+ * \ingroup PluginFramework
+ *
+ * Publishes an immutable copy of some data to threads reading it
+ * without a lock.
+ *
+ * The data is a QSharedData subclass whose containers are implicitly
+ * shared with the mutable data of the writers, so that publishing a
+ * snapshot only copies the container pointers. The writers modify their
+ * own data and reset() the snapshot; the next reader then publishes a
+ * new snapshot.
+ *
+ * get() never blocks. A snapshot which is replaced is deleted once all
+ * the readers which got it have released it. Since a reader could be
+ * about to take a reference to the replaced snapshot, the reference
+ * held by this object is only dropped when no reader is in get(): by
+ * the publish() or reset() call, or else by the last reader leaving
+ * get(). The replaced snapshots are thus released as soon as the
+ * readers of this object are not all overlapping.
+ *
+ * publish() and reset() must be serialized by the caller.
+ */
+template<class T>
+class ctkSnapshot
+{
+
+public:
+
+  typedef QExplicitlySharedDataPointer<T> Pointer;
+
+  ctkSnapshot();
+
+  ~ctkSnapshot();
+
+  /**
+   * Get the current snapshot, without locking.
+   *
+   * @return The current snapshot, or a null pointer if there is none.
+   */
+  Pointer get() const;
+
+  /**
+   * Replace the current snapshot with <code>snapshot</code>, which
+   * must not be modified afterwards.
+   *
+   * @param snapshot The new snapshot, this object takes a reference to it.
+   */
+  void publish(T* snapshot);
+
+  /**
+   * Remove the current snapshot, after the data was modified.
+   */
+  void reset();
+
+private:
+
+  Q_DISABLE_COPY(ctkSnapshot)
+
+  //! Release the retired snapshots if no reader is in get()
+  void reclaim() const;
+
+  QAtomicPointer<T> current;
+
+  //! Number of threads in get()
+  mutable QAtomicInt readers;
+
+  //! Replaced snapshots not released yet, guarded by retiredLock
+  mutable QList<T*> retired;
+
+  //! Number of retired snapshots, checked by the readers without locking
+  mutable QAtomicInt retiredCount;
+
+  //! Only tried by the readers, so that get() does not block
+  mutable QMutex retiredLock;
+
+};
+
+#include "ctkSnapshot.tpp"
+
+#endif // CTKSNAPSHOT_P_H
@@ -0,0 +1,180 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QApplication>
+#include <QDir>
+#include <QEvent>
+#include <QFile>
+#include <QImage>
+#include <QTime>
+
+// CTK includes
+#include "ctkThumbnailLabel.h"
+#include "ctkThumbnailListWidget.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// Records when the first thumbnail is painted
+class PaintWatcher : public QObject
+{
+public:
+  PaintWatcher() : FirstPaint(-1) {}
+
+  virtual bool eventFilter(QObject* watched, QEvent* event)
+  {
+    if (this->FirstPaint < 0 && event->type() == QEvent::Paint
+        && qobject_cast<ctkThumbnailLabel*>(watched))
+      {
+      this->FirstPaint = this->Time.elapsed();
+      }
+    return false;
+  }
+
+  QTime Time;
+  int FirstPaint;
+};
+
+//------------------------------------------------------------------------------
+bool visibleThumbnailsLoaded(ctkThumbnailListWidget& widget)
+{
+  foreach(ctkThumbnailLabel* label, widget.findChildren<ctkThumbnailLabel*>())
+    {
+    if (label->isVisible() && !label->pixmap())
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+ctkThumbnailLabel* thumbnailLabel(ctkThumbnailListWidget& widget, int index)
+{
+  foreach(ctkThumbnailLabel* label, widget.findChildren<ctkThumbnailLabel*>())
+    {
+    if (label->isVisible() && label->property("thumbnailIndex").toInt() == index)
+      {
+      return label;
+      }
+    }
+  return 0;
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkThumbnailListWidgetTest2( int argc, char * argv [] )
+{
+  QApplication app(argc, argv);
+
+  // pass a larger count to time larger studies
+  const int thumbnailCount = argc > 1 ? QString(argv[1]).toInt() : 10000;
+  const int fileCount = 100;
+
+  QDir directory(QDir::tempPath());
+  directory.mkpath("ctkThumbnailListWidgetTest2");
+  directory.cd("ctkThumbnailListWidgetTest2");
+  QStringList files;
+  for (int i = 0; i < fileCount; ++i)
+    {
+    QImage image(256, 256, QImage::Format_RGB32);
+    image.fill(qRgb(i, 255 - i, 128));
+    QString filePath = directory.filePath(QString("thumbnail%1.png").arg(i));
+    if (!image.save(filePath))
+      {
+      std::cerr << "Could not write " << qPrintable(filePath) << std::endl;
+      return EXIT_FAILURE;
+      }
+    files << filePath;
+    }
+
+  ctkThumbnailListWidget widget;
+  widget.setThumbnailSize(QSize(96, 96));
+  widget.resize(800, 600);
+
+  PaintWatcher paintWatcher;
+  app.installEventFilter(&paintWatcher);
+  paintWatcher.Time.start();
+
+  for (int i = 0; i < thumbnailCount; ++i)
+    {
+    widget.addThumbnailFile(files[i % fileCount], QString("Image %1").arg(i));
+    }
+  const int added = paintWatcher.Time.elapsed();
+  widget.setCurrentThumbnail(0);
+  widget.show();
+  while (paintWatcher.FirstPaint < 0 && paintWatcher.Time.elapsed() < 10000)
+    {
+    app.processEvents();
+    }
+  while (!visibleThumbnailsLoaded(widget) && paintWatcher.Time.elapsed() < 10000)
+    {
+    app.processEvents();
+    }
+  const int loaded = paintWatcher.Time.elapsed();
+  app.removeEventFilter(&paintWatcher);
+
+  std::cout << thumbnailCount << " thumbnails: added in " << added << " ms, "
+            << "first paint after " << paintWatcher.FirstPaint << " ms, "
+            << "visible thumbnails loaded after " << loaded << " ms" << std::endl;
+
+  int exitCode = EXIT_SUCCESS;
+  const int labelCount = widget.findChildren<ctkThumbnailLabel*>().count();
+  if (widget.thumbnailCount() != thumbnailCount
+      || paintWatcher.FirstPaint < 0 || !visibleThumbnailsLoaded(widget))
+    {
+    std::cerr << "ctkThumbnailListWidget failed to show the thumbnails" << std::endl;
+    exitCode = EXIT_FAILURE;
+    }
+  // only the visible thumbnails have a label
+  if (labelCount >= 200)
+    {
+    std::cerr << "ctkThumbnailListWidget created " << labelCount << " labels" << std::endl;
+    exitCode = EXIT_FAILURE;
+    }
+
+  // selecting the last thumbnail scrolls to it
+  widget.setCurrentThumbnail(thumbnailCount - 1);
+  app.processEvents();
+  ctkThumbnailLabel* lastLabel = thumbnailLabel(widget, thumbnailCount - 1);
+  if (widget.currentThumbnail() != thumbnailCount - 1 || !lastLabel || !lastLabel->isSelected()
+      || widget.findChildren<ctkThumbnailLabel*>().count() > labelCount + 20)
+    {
+    std::cerr << "ctkThumbnailListWidget::setCurrentThumbnail failed" << std::endl;
+    exitCode = EXIT_FAILURE;
+    }
+
+  widget.clearThumbnails();
+  foreach(const QString& filePath, files)
+    {
+    QFile::remove(filePath);
+    }
+  directory.cdUp();
+  directory.rmdir("ctkThumbnailListWidgetTest2");
+
+  return exitCode;
+}
@@ -0,0 +1,170 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QApplication>
+#include <QVector>
+
+// CTK includes
+#include "ctkQImageView.h"
+#include "ctkWindowLevelMapper.h"
+
+// STD includes
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+bool compareImplementations(const QVector<quint16>& values, bool isSigned,
+                            double window, double level)
+{
+  QVector<uchar> expected(values.count());
+  ctkWindowLevelMapper::map(values.constData(), values.count(), isSigned,
+                            window, level, expected.data(), ctkWindowLevelMapper::Scalar);
+  ctkWindowLevelMapper::Implementation implementations[] =
+    { ctkWindowLevelMapper::SSE2, ctkWindowLevelMapper::AVX2, ctkWindowLevelMapper::Automatic };
+  for (int i = 0; i < 3; ++i)
+    {
+    if (!ctkWindowLevelMapper::isImplementationAvailable(implementations[i]))
+      {
+      continue;
+      }
+    QVector<uchar> output(values.count());
+    ctkWindowLevelMapper::map(values.constData(), values.count(), isSigned,
+                              window, level, output.data(), implementations[i]);
+    for (int j = 0; j < values.count(); ++j)
+      {
+      if (output[j] != expected[j])
+        {
+        std::cerr << "Implementation " << implementations[i] << " maps " << values[j]
+                  << (isSigned ? " (signed)" : "") << " to " << int(output[j])
+                  << " instead of " << int(expected[j]) << " with window " << window
+                  << " and level " << level << std::endl;
+        return false;
+        }
+      }
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkWindowLevelMapperTest1(int argc, char * argv [] )
+{
+  QApplication app(argc, argv);
+
+  std::cout << "Best implementation: " << ctkWindowLevelMapper::bestImplementation() << std::endl;
+  if (!ctkWindowLevelMapper::isImplementationAvailable(ctkWindowLevelMapper::Scalar))
+    {
+    std::cerr << "The scalar implementation must always be available" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // window [-1020, 1020]: 0 below, 255 above and rounded in between
+  quint16 ramp[] = { static_cast<quint16>(-2000), static_cast<quint16>(-1000),
+                     0, 1000, 3000, static_cast<quint16>(-1) };
+  uchar expectedRamp[] = { 0, 3, 128, 253, 255, 127 };
+  uchar mappedRamp[6];
+  ctkWindowLevelMapper::map(ramp, 6, true, 2040., 0., mappedRamp, ctkWindowLevelMapper::Scalar);
+  for (int i = 0; i < 6; ++i)
+    {
+    if (mappedRamp[i] != expectedRamp[i])
+      {
+      std::cerr << "Value " << static_cast<qint16>(ramp[i]) << " mapped to " << int(mappedRamp[i])
+                << " instead of " << int(expectedRamp[i]) << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // every 16-bit value, with lengths that don't fill the vector registers
+  QVector<quint16> values(65536 + 13);
+  for (int i = 0; i < values.count(); ++i)
+    {
+    values[i] = static_cast<quint16>(i * 7919);
+    }
+  const double windowLevels[][2] = { {400., 40.}, {1., 0.}, {65535., 32767.5},
+                                     {2000., -1000.}, {0.3, 100.25}, {4096., 30000.} };
+  for (int i = 0; i < 6; ++i)
+    {
+    if (!compareImplementations(values, false, windowLevels[i][0], windowLevels[i][1])
+        || !compareImplementations(values, true, windowLevels[i][0], windowLevels[i][1])
+        || !compareImplementations(values.mid(0, 7), true, windowLevels[i][0], windowLevels[i][1]))
+      {
+      return EXIT_FAILURE;
+      }
+    }
+
+  // a frame large enough to be split between threads
+  const int width = 2048;
+  const int height = ctkWindowLevelMapper::parallelThreshold() / width + 3;
+  QVector<quint16> frame(width * height);
+  for (int i = 0; i < frame.count(); ++i)
+    {
+    frame[i] = static_cast<quint16>((i % width) * 2 + i / width);
+    }
+  QImage image = ctkWindowLevelMapper::image(frame.constData(), width, height, false, 3000., 2000.);
+  QVector<uchar> expected(frame.count());
+  ctkWindowLevelMapper::map(frame.constData(), frame.count(), false, 3000., 2000.,
+                            expected.data(), ctkWindowLevelMapper::Scalar);
+  if (image.format() != QImage::Format_Indexed8 || image.size() != QSize(width, height)
+      || !image.isGrayscale())
+    {
+    std::cerr << "ctkWindowLevelMapper::image() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  for (int y = 0; y < height; ++y)
+    {
+    if (memcmp(image.constScanLine(y), expected.constData() + y * width, width) != 0)
+      {
+      std::cerr << "Row " << y << " of the image differs from the scalar mapping" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // ctkQImageView maps the modality values with its window/level
+  ctkQImageView view;
+  QVector<quint16> slice(256 * 256);
+  for (int i = 0; i < slice.count(); ++i)
+    {
+    slice[i] = static_cast<quint16>(100 + i % 1000);
+    }
+  view.addImage(slice, 256, 256);
+  if (!view.isModalityImage() || view.intensityWindow() != 999.
+      || view.intensityLevel() != 599.5)
+    {
+    std::cerr << "The window/level should cover the range of the values: "
+              << view.intensityWindow() << " " << view.intensityLevel() << std::endl;
+    return EXIT_FAILURE;
+    }
+  view.setIntensityWindowLevel(100., 50.);
+  view.addImage(QImage(16, 16, QImage::Format_RGB32));
+  view.setSliceNumber(1);
+  if (view.isModalityImage())
+    {
+    std::cerr << "A QImage slice is not a modality image" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
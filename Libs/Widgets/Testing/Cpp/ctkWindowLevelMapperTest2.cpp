@@ -0,0 +1,94 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QApplication>
+#include <QTime>
+#include <QVector>
+
+// CTK includes
+#include "ctkWindowLevelMapper.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+double megaPixelsPerSecond(int pixelCount, int iterationCount, int elapsed)
+{
+  return (pixelCount / 1000000.) * iterationCount * 1000. / qMax(1, elapsed);
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+int ctkWindowLevelMapperTest2(int argc, char * argv [] )
+{
+  QApplication app(argc, argv);
+
+  // a 16-bit mammogram, pass a larger count of iterations for stable numbers
+  const int width = 2048;
+  const int height = 2048;
+  int iterationCount = argc > 1 ? QString(argv[1]).toInt() : 10;
+  QVector<quint16> values(width * height);
+  qsrand(1);
+  for (int i = 0; i < values.count(); ++i)
+    {
+    values[i] = static_cast<quint16>(qrand() % 4096);
+    }
+  QVector<uchar> output(values.count());
+
+  const char* names[] = { "Scalar", "SSE2", "AVX2" };
+  ctkWindowLevelMapper::Implementation implementations[] =
+    { ctkWindowLevelMapper::Scalar, ctkWindowLevelMapper::SSE2, ctkWindowLevelMapper::AVX2 };
+  QTime timer;
+  for (int i = 0; i < 3; ++i)
+    {
+    if (!ctkWindowLevelMapper::isImplementationAvailable(implementations[i]))
+      {
+      std::cout << names[i] << ": not available" << std::endl;
+      continue;
+      }
+    timer.start();
+    for (int j = 0; j < iterationCount; ++j)
+      {
+      // the window moves like when dragging the mouse
+      ctkWindowLevelMapper::map(values.constData(), values.count(), false,
+                                1000. + j, 2000. - j, output.data(), implementations[i]);
+      }
+    std::cout << names[i] << ": " << megaPixelsPerSecond(values.count(), iterationCount, timer.elapsed())
+              << " Mpixels/s" << std::endl;
+    }
+
+  timer.start();
+  for (int j = 0; j < iterationCount; ++j)
+    {
+    QImage image = ctkWindowLevelMapper::image(values.constData(), width, height, false,
+                                               1000. + j, 2000. - j);
+    }
+  std::cout << "Image on the thread pool: "
+            << megaPixelsPerSecond(values.count(), iterationCount, timer.elapsed())
+            << " Mpixels/s" << std::endl;
+
+  return EXIT_SUCCESS;
+}
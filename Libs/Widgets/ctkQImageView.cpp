@@ -22,6 +22,7 @@
 
 // CTK includes
 #include "ctkQImageView.h"
+#include "ctkWindowLevelMapper.h"
 
 // Qt includes
 #include <QApplication>
@@ -74,6 +75,19 @@ public:
 
   QList< QImage > ImageList;
 
+  /// Values of the slices added as modality values, in the same order as
+  /// ImageList which holds their mapped image.
+  struct ModalityFrame
+    {
+    QVector< quint16 > Values;
+    bool IsSigned;
+    /// Window/level ImageList was mapped with
+    double MappedWindow;
+    double MappedLevel;
+    };
+  QList< ModalityFrame > ModalityFrames;
+  QVector< QRgb > IntensityPalette;
+
   QPixmap TmpImage;
   int     TmpXMin;
   int     TmpXMax;
@@ -93,6 +107,10 @@ public:
 
   double clamp( double x, double xMin, double xMax );
 
+  /// Map the modality values of a slice if the window/level changed
+  /// since it was mapped. Does nothing for slices added as a QImage.
+  void mapModalityFrame( int slice );
+
   void fitImageRectangle( double x0, double y0, double x1, double y1 );
   
 };
@@ -138,6 +156,8 @@ void ctkQImageViewPrivate::init()
   this->TransposeXY = false;
 
   this->ImageList.clear();
+  this->ModalityFrames.clear();
+  this->IntensityPalette = ctkWindowLevelMapper::grayPalette();
 
   this->TmpXMin = 0;
   this->TmpXMax = 0;
@@ -170,6 +190,27 @@ double ctkQImageViewPrivate::clamp( double x, double xMin,
   return x;
 }
 
+//--------------------------------------------------------------------------
+void ctkQImageViewPrivate::mapModalityFrame( int slice )
+{
+  if( slice < 0 || slice >= this->ModalityFrames.size() )
+    {
+    return;
+    }
+  ModalityFrame & frame = this->ModalityFrames[ slice ];
+  if( frame.Values.isEmpty() || ( frame.MappedWindow == this->IntensityWindow
+    && frame.MappedLevel == this->IntensityLevel ) )
+    {
+    return;
+    }
+  const QImage & image = this->ImageList[ slice ];
+  this->ImageList[ slice ] = ctkWindowLevelMapper::image(
+    frame.Values.constData(), image.width(), image.height(), frame.IsSigned,
+    this->IntensityWindow, this->IntensityLevel, this->IntensityPalette );
+  frame.MappedWindow = this->IntensityWindow;
+  frame.MappedLevel = this->IntensityLevel;
+}
+
 //--------------------------------------------------------------------------
 void ctkQImageViewPrivate::fitImageRectangle( double x0,
   double x1, double y0, double y1 )
@@ -219,6 +260,7 @@ void ctkQImageView::addImage( const QImage & image )
 {
   Q_D( ctkQImageView );
   d->ImageList.push_back( image );
+  d->ModalityFrames.push_back( ctkQImageViewPrivate::ModalityFrame() );
   d->TmpXMin = 0;
   d->TmpXMax = image.width();
   d->TmpYMin = 0;
@@ -234,11 +276,61 @@ void ctkQImageView::addImage( const QImage & image )
   this->setCenter( image.width()/2.0, image.height()/2.0 );
 }
 
+// -------------------------------------------------------------------------
+void ctkQImageView::addImage( const QVector<quint16> & values, int imageWidth,
+  int imageHeight, bool isSigned, double window, double level )
+{
+  Q_D( ctkQImageView );
+  if( imageWidth <= 0 || imageHeight <= 0 || values.size() < imageWidth * imageHeight )
+    {
+    return;
+    }
+  double minimum = 0;
+  double maximum = 0;
+  for( int i = 0; i < imageWidth * imageHeight; ++i )
+    {
+    double value = isSigned ? static_cast<qint16>( values[i] ) : values[i];
+    if( i == 0 || value < minimum )
+      {
+      minimum = value;
+      }
+    if( i == 0 || value > maximum )
+      {
+      maximum = value;
+      }
+    }
+  if( window <= 0 )
+    {
+    // like 8-bit images, the window covers the intensity range
+    window = qMax( maximum - minimum, 1. );
+    level = ( maximum + minimum ) / 2;
+    }
+
+  ctkQImageViewPrivate::ModalityFrame frame;
+  frame.Values = values;
+  frame.IsSigned = isSigned;
+  frame.MappedWindow = window;
+  frame.MappedLevel = level;
+  d->ModalityFrames.push_back( frame );
+  d->ImageList.push_back( ctkWindowLevelMapper::image( values.constData(),
+    imageWidth, imageHeight, isSigned, window, level, d->IntensityPalette ) );
+  d->TmpXMin = 0;
+  d->TmpXMax = imageWidth;
+  d->TmpYMin = 0;
+  d->TmpYMax = imageHeight;
+  d->IntensityMin = minimum;
+  d->IntensityMax = maximum;
+  this->setIntensityWindowLevel( window, level );
+  this->update( true, false );
+  this->setCenter( imageWidth/2.0, imageHeight/2.0 );
+}
+
 // -------------------------------------------------------------------------
 void ctkQImageView::clearImages( void )
 {
   Q_D( ctkQImageView );
   d->ImageList.clear();
+  d->ModalityFrames.clear();
   this->update( true, true );
 }
 
@@ -309,6 +401,17 @@ double ctkQImageView::positionValue( void )
   Q_D( ctkQImageView );
   if( d->SliceNumber >= 0 && d->SliceNumber < d->ImageList.size() )
     {
+    const ctkQImageViewPrivate::ModalityFrame & frame =
+      d->ModalityFrames[ d->SliceNumber ];
+    int x = static_cast<int>( d->PositionX );
+    int y = static_cast<int>( d->PositionY );
+    int imageWidth = d->ImageList[ d->SliceNumber ].width();
+    if( !frame.Values.isEmpty() && x >= 0 && y >= 0 && x < imageWidth
+      && y < d->ImageList[ d->SliceNumber ].height() )
+      {
+      quint16 value = frame.Values[ y * imageWidth + x ];
+      return frame.IsSigned ? static_cast<qint16>( value ) : value;
+      }
     QColor vc( d->ImageList[ d->SliceNumber ].pixel( d->PositionX,
       d->PositionY ) );
     return vc.value();
@@ -377,6 +480,38 @@ void ctkQImageView::setIntensityWindowLevel( double iwWindow,
     }
 }
 
+// -------------------------------------------------------------------------
+void ctkQImageView::setIntensityPalette( const QVector<QRgb> & palette )
+{
+  Q_D( ctkQImageView );
+  d->IntensityPalette = palette.size() == 256 ? palette
+    : ctkWindowLevelMapper::grayPalette();
+  // only the color tables change, the values don't need to be mapped again
+  for( int i = 0; i < d->ModalityFrames.size(); ++i )
+    {
+    if( !d->ModalityFrames[ i ].Values.isEmpty() )
+      {
+      d->ImageList[ i ].setColorTable( d->IntensityPalette );
+      }
+    }
+  this->update( false, false );
+}
+
+// -------------------------------------------------------------------------
+QVector<QRgb> ctkQImageView::intensityPalette( void ) const
+{
+  Q_D( const ctkQImageView );
+  return d->IntensityPalette;
+}
+
+// -------------------------------------------------------------------------
+bool ctkQImageView::isModalityImage( void ) const
+{
+  Q_D( const ctkQImageView );
+  return d->SliceNumber >= 0 && d->SliceNumber < d->ModalityFrames.size()
+    && !d->ModalityFrames[ d->SliceNumber ].Values.isEmpty();
+}
+
 // -------------------------------------------------------------------------
 double ctkQImageView::intensityLevel( void ) const
 {
@@ -894,6 +1029,7 @@ void ctkQImageView::update( bool zoomChanged,
   Q_D( ctkQImageView );
   if( d->SliceNumber >= 0 && d->SliceNumber < d->ImageList.size() )
     {
+    d->mapModalityFrame( d->SliceNumber );
     const QImage * img = & ( d->ImageList[ d->SliceNumber ] );
     if( zoomChanged || sizeChanged )
       {
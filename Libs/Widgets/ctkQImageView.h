@@ -24,6 +24,7 @@
 /// Qt includes
 #include <QWidget>
 #include <QImage>
+#include <QVector>
 
 /// CTK includes
 #include "ctkPimpl.h"
@@ -69,6 +70,13 @@ public:
   double intensityWindow( void ) const;
   double intensityLevel( void ) const;
 
+  /// Color table of the images added as modality values,
+  /// gray levels by default.
+  QVector<QRgb> intensityPalette( void ) const;
+
+  /// Returns true if the current slice was added as modality values.
+  bool isModalityImage( void ) const;
+
   bool invertImage( void ) const;
 
   bool flipXAxis( void ) const;
@@ -80,11 +88,21 @@ public:
 public Q_SLOTS:
 
   void addImage( const QImage & image );
+  /// Add a slice of 16-bit modality values, e.g. CT Hounsfield units.
+  /// The displayed image is mapped from the values with the intensity
+  /// window/level (see ctkWindowLevelMapper) and kept until the
+  /// window/level changes.
+  /// The intensity window/level is set to \a window and \a level if
+  /// \a window is positive, e.g. the window of the DICOM file, else to
+  /// the range of the values. Passing it here maps the slice only once.
+  void addImage( const QVector<quint16> & values, int imageWidth, int imageHeight,
+    bool isSigned = false, double window = 0, double level = 0 );
   void clearImages( void );
 
   void setSliceNumber( int slicenum );
 
   void setIntensityWindowLevel( double iwWindow, double iwLevel );
+  void setIntensityPalette( const QVector<QRgb> & palette );
 
   void setInvertImage( bool invert );
   void setFlipXAxis( bool flip );
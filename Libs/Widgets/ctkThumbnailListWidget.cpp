@@ -24,19 +24,19 @@
 #include <QEvent>
 #include <QFile>
 #include <QFileInfo>
-#include <QGridLayout>
+#include <QImage>
+#include <QMutexLocker>
 #include <QPixmap>
+#include <QPixmapCache>
 #include <QPushButton>
 #include <QResizeEvent>
+#include <QRunnable>
 #include <QScrollBar>
 #include <QTimer>
 
 // ctk includes
 #include "ctkLogger.h"
 
-// ctkWidgets includes
-#include "ctkFlowLayout.h"
-
 // ctkDICOMWidgets includes
 #include "ctkThumbnailLabel.h"
 #include "ctkThumbnailListWidget.h"
@@ -47,6 +47,28 @@
 
 static ctkLogger logger("org.commontk.Widgets.ctkThumbnailListWidget");
 
+namespace
+{
+// Size of the thumbnails when thumbnailSize is not set
+const int DefaultThumbnailLength = 128;
+}
+
+//----------------------------------------------------------------------------
+class ctkThumbnailListWidgetLoader : public QRunnable
+{
+public:
+  ctkThumbnailListWidgetLoader(ctkThumbnailListWidgetPrivate* list)
+    : List(list)
+  {
+  }
+  virtual void run()
+  {
+    this->List->loadThumbnailFiles();
+  }
+private:
+  ctkThumbnailListWidgetPrivate* List;
+};
+
 //----------------------------------------------------------------------------
 // ctkThumbnailListWidgetPrivate methods
 
@@ -56,7 +78,17 @@ ctkThumbnailListWidgetPrivate
   : q_ptr(parent)
   , CurrentThumbnail(-1)
   , ThumbnailSize(-1, -1)
+  , Flow(Qt::Horizontal)
+  , Spacing(4)
+  , LineLength(1)
   , RequestRelayout(false)
+  , LoaderRunning(false)
+{
+  this->LoaderPool.setMaxThreadCount(1);
+}
+
+//----------------------------------------------------------------------------
+ctkThumbnailListWidgetPrivate::~ctkThumbnailListWidgetPrivate()
 {
 }
 
@@ -66,12 +98,11 @@ void ctkThumbnailListWidgetPrivate::init()
   Q_Q(ctkThumbnailListWidget);
 
   this->setupUi(q);
-  ctkFlowLayout* flowLayout = new ctkFlowLayout;
-  //flowLayout->setOrientation(Qt::Vertical);
-  //flowLayout->setPreferredExpandingDirections(Qt::Horizontal);
-  flowLayout->setHorizontalSpacing(4);
-  this->ScrollAreaContentWidget->setLayout(flowLayout);
-  this->ScrollArea->installEventFilter(q);
+  this->ScrollArea->viewport()->installEventFilter(q);
+  QObject::connect(this->ScrollArea->horizontalScrollBar(), SIGNAL(valueChanged(int)),
+                   q, SLOT(updateVisibleThumbnails()));
+  QObject::connect(this->ScrollArea->verticalScrollBar(), SIGNAL(valueChanged(int)),
+                   q, SLOT(updateVisibleThumbnails()));
 }
 
 //----------------------------------------------------------------------------
@@ -79,36 +110,90 @@ void ctkThumbnailListWidgetPrivate::clearAllThumbnails()
 {
   Q_Q(ctkThumbnailListWidget);
 
-  // Remove previous displayed thumbnails
-  QLayoutItem* item;
-  while((item = this->ScrollAreaContentWidget->layout()->takeAt(0)))
+  // Labels are hidden but not deleted, the thumbnails may be cleared from
+  // a slot connected to a label signal.
+  foreach(ctkThumbnailLabel* label, this->VisibleLabels)
+    {
+    label->hide();
+    this->FreeLabels << label;
+    }
+  this->VisibleLabels.clear();
+  this->Thumbnails.clear();
+  this->FailedFiles.clear();
+  this->CurrentThumbnail = -1;
+  {
+  QMutexLocker locker(&this->LoaderMutex);
+  this->PendingFiles.clear();
+  }
+  this->updateScrollAreaContentWidgetSize(q->size());
+}
+
+//----------------------------------------------------------------------------
+void ctkThumbnailListWidgetPrivate::addThumbnail(const Thumbnail& thumbnail)
+{
+  Q_Q(ctkThumbnailListWidget);
+
+  this->Thumbnails.append(thumbnail);
+  // a single relayout for the thumbnails added together
+  if (!this->RequestRelayout)
+    {
+    this->RequestRelayout = true;
+    QTimer::singleShot(0, q, SLOT(updateLayout()));
+    }
+}
+
+//----------------------------------------------------------------------------
+void ctkThumbnailListWidgetPrivate::reloadThumbnailFile(const QString& filePath)
+{
+  this->FailedFiles.remove(filePath);
+  QPixmapCache::remove(this->pixmapCacheKey(filePath));
+  foreach(ctkThumbnailLabel* label, this->VisibleLabels)
     {
-    ctkThumbnailLabel* thumbnailWidget = qobject_cast<ctkThumbnailLabel*>(item->widget());
-    if(thumbnailWidget)
+    int index = this->labelIndex(label);
+    if (index >= 0 && this->Thumbnails[index].FilePath == filePath)
       {
-      q->disconnect(thumbnailWidget, SIGNAL(selected(ctkThumbnailLabel)), q, SLOT(onThumbnailSelected(ctkThumbnailLabel)));
-      q->disconnect(thumbnailWidget, SIGNAL(selected(ctkThumbnailLabel)), q, SIGNAL(selected(ctkThumbnailLabel)));
-      q->disconnect(thumbnailWidget, SIGNAL(doubleClicked(ctkThumbnailLabel)), q, SIGNAL(doubleClicked(ctkThumbnailLabel)));
+      label->setPixmap(QPixmap());
       }
-    item->widget()->deleteLater();
     }
+  this->updateVisibleThumbnails();
 }
 
 //----------------------------------------------------------------------------
-void ctkThumbnailListWidgetPrivate::addThumbnail(ctkThumbnailLabel* thumbnail)
+QString ctkThumbnailListWidgetPrivate::pixmapCacheKey(const QString& filePath)const
 {
-  Q_Q(ctkThumbnailListWidget);
+  QSize size = this->cellSize();
+  return QString("ctkThumbnailListWidget:%1x%2:%3")
+    .arg(size.width()).arg(size.height()).arg(filePath);
+}
+
+//----------------------------------------------------------------------------
+QSize ctkThumbnailListWidgetPrivate::cellSize()const
+{
+  return this->ThumbnailSize.isValid() ?
+    this->ThumbnailSize : QSize(DefaultThumbnailLength, DefaultThumbnailLength);
+}
 
-  this->ScrollAreaContentWidget->layout()->addWidget(thumbnail);
-  thumbnail->installEventFilter(q);
-  this->RequestRelayout = true;
+//----------------------------------------------------------------------------
+int ctkThumbnailListWidgetPrivate::lineLength(int viewportLength)const
+{
+  QSize cell = this->cellSize();
+  int cellLength = this->Flow == Qt::Horizontal ? cell.width() : cell.height();
+  return qMax(1, (viewportLength + this->Spacing) / (cellLength + this->Spacing));
+}
 
-  q->connect(thumbnail, SIGNAL(selected(ctkThumbnailLabel)),
-    q, SLOT(onThumbnailSelected(ctkThumbnailLabel)));
-  q->connect(thumbnail, SIGNAL(selected(ctkThumbnailLabel)),
-    q, SIGNAL(selected(ctkThumbnailLabel)));
-  q->connect(thumbnail, SIGNAL(doubleClicked(ctkThumbnailLabel)),
-    q, SIGNAL(doubleClicked(ctkThumbnailLabel)));
+//----------------------------------------------------------------------------
+QRect ctkThumbnailListWidgetPrivate::thumbnailRect(int index)const
+{
+  QSize cell = this->cellSize();
+  int line = index / this->LineLength;
+  int position = index % this->LineLength;
+  if (this->Flow == Qt::Horizontal)
+    {
+    return QRect(QPoint(position * (cell.width() + this->Spacing),
+                        line * (cell.height() + this->Spacing)), cell);
+    }
+  return QRect(QPoint(line * (cell.width() + this->Spacing),
+                      position * (cell.height() + this->Spacing)), cell);
 }
 
 //----------------------------------------------------------------------------
@@ -116,35 +201,213 @@ void ctkThumbnailListWidgetPrivate::updateScrollAreaContentWidgetSize(QSize size
 {
   QSize newViewportSize = size - QSize(2 * this->ScrollArea->lineWidth(),
                                        2 * this->ScrollArea->lineWidth());
-
-  ctkFlowLayout* flowLayout = qobject_cast<ctkFlowLayout*>(
-    this->ScrollAreaContentWidget->layout());
-  newViewportSize = newViewportSize.expandedTo(flowLayout->minimumSize());
-  if (flowLayout->hasHeightForWidth())
+  QSize cell = this->cellSize();
+  const int count = this->Thumbnails.count();
+  if (this->Flow == Qt::Horizontal)
     {
     int newViewPortHeight = newViewportSize.height();
-    newViewportSize.rheight() = flowLayout->heightForWidth( newViewportSize.width() );
+    this->LineLength = this->lineLength(newViewportSize.width());
+    int lineCount = (count + this->LineLength - 1) / this->LineLength;
+    newViewportSize.rheight() = qMax(0, lineCount * (cell.height() + this->Spacing) - this->Spacing);
     if (newViewportSize.height() > newViewPortHeight)
       {
       // The new width is too narrow, to fit everything, a vertical scrollbar
       // is needed. Recompute with the scrollbar width.
       newViewportSize.rwidth() -= this->ScrollArea->verticalScrollBar()->sizeHint().width();
-      newViewportSize.rheight() = flowLayout->heightForWidth( newViewportSize.width() );
+      this->LineLength = this->lineLength(newViewportSize.width());
+      lineCount = (count + this->LineLength - 1) / this->LineLength;
+      newViewportSize.rheight() = lineCount * (cell.height() + this->Spacing) - this->Spacing;
       }
+    newViewportSize.rheight() = qMax(newViewportSize.height(), newViewPortHeight);
     }
-  else if (flowLayout->hasWidthForHeight())
+  else
     {
     int newViewPortWidth = newViewportSize.width();
-    newViewportSize.rwidth() = flowLayout->widthForHeight( newViewportSize.height() );
+    this->LineLength = this->lineLength(newViewportSize.height());
+    int lineCount = (count + this->LineLength - 1) / this->LineLength;
+    newViewportSize.rwidth() = qMax(0, lineCount * (cell.width() + this->Spacing) - this->Spacing);
     if (newViewportSize.width() > newViewPortWidth)
       {
       // The new height is too narrow, to fit everything, an horizontal scrollbar
       // is needed. Recompute with the scrollbar height.
       newViewportSize.rheight() -= this->ScrollArea->horizontalScrollBar()->sizeHint().height();
-      newViewportSize.rwidth() = flowLayout->widthForHeight( newViewportSize.height() );
+      this->LineLength = this->lineLength(newViewportSize.height());
+      lineCount = (count + this->LineLength - 1) / this->LineLength;
+      newViewportSize.rwidth() = lineCount * (cell.width() + this->Spacing) - this->Spacing;
       }
+    newViewportSize.rwidth() = qMax(newViewportSize.width(), newViewPortWidth);
     }
   this->ScrollAreaContentWidget->resize(newViewportSize);
+  // the thumbnails move when the number of thumbnails per line changes
+  this->updateVisibleThumbnails();
+}
+
+//----------------------------------------------------------------------------
+void ctkThumbnailListWidgetPrivate::updateVisibleThumbnails()
+{
+  const int count = this->Thumbnails.count();
+  QSize cell = this->cellSize();
+  QRect visibleRect(this->ScrollArea->horizontalScrollBar()->value(),
+                    this->ScrollArea->verticalScrollBar()->value(),
+                    this->ScrollArea->viewport()->width(),
+                    this->ScrollArea->viewport()->height());
+  int firstLine = 0;
+  int lastLine = -1;
+  if (this->Flow == Qt::Horizontal)
+    {
+    firstLine = visibleRect.top() / (cell.height() + this->Spacing);
+    lastLine = visibleRect.bottom() / (cell.height() + this->Spacing);
+    }
+  else
+    {
+    firstLine = visibleRect.left() / (cell.width() + this->Spacing);
+    lastLine = visibleRect.right() / (cell.width() + this->Spacing);
+    }
+  const int first = qMin(count, firstLine * this->LineLength);
+  const int end = qMin(count, (lastLine + 1) * this->LineLength);
+
+  // the labels scrolled out of view are reused
+  QHash<int, ctkThumbnailLabel*>::iterator it = this->VisibleLabels.begin();
+  while (it != this->VisibleLabels.end())
+    {
+    if (it.key() < first || it.key() >= end)
+      {
+      it.value()->hide();
+      this->FreeLabels << it.value();
+      it = this->VisibleLabels.erase(it);
+      }
+    else
+      {
+      ++it;
+      }
+    }
+
+  QStringList filesToLoad;
+  for (int index = first; index < end; ++index)
+    {
+    ctkThumbnailLabel* label = this->VisibleLabels.value(index);
+    if (!label)
+      {
+      label = this->takeLabel();
+      this->bindLabel(label, index);
+      this->VisibleLabels[index] = label;
+      }
+    label->setFixedSize(cell);
+    label->move(this->thumbnailRect(index).topLeft());
+    label->show();
+
+    const QString& filePath = this->Thumbnails[index].FilePath;
+    if (!filePath.isEmpty() && !label->pixmap()
+        && !this->FailedFiles.contains(filePath) && !filesToLoad.contains(filePath))
+      {
+      filesToLoad << filePath;
+      }
+    }
+
+  // only the files of the visible thumbnails are loaded
+  QMutexLocker locker(&this->LoaderMutex);
+  this->PendingFiles.clear();
+  foreach(const QString& filePath, filesToLoad)
+    {
+    if (!this->LoadingFiles.contains(filePath))
+      {
+      this->PendingFiles << filePath;
+      }
+    }
+  this->LoadSize = cell;
+  if (!this->PendingFiles.isEmpty() && !this->LoaderRunning)
+    {
+    this->LoaderRunning = true;
+    this->LoaderPool.start(new ctkThumbnailListWidgetLoader(this));
+    }
+}
+
+//----------------------------------------------------------------------------
+void ctkThumbnailListWidgetPrivate::bindLabel(ctkThumbnailLabel* label, int index)
+{
+  const Thumbnail& thumbnail = this->Thumbnails[index];
+  foreach(const QByteArray& name, label->dynamicPropertyNames())
+    {
+    label->setProperty(name.constData(), QVariant());
+    }
+  QHash<QByteArray, QVariant>::const_iterator it;
+  for (it = thumbnail.Properties.constBegin(); it != thumbnail.Properties.constEnd(); ++it)
+    {
+    label->setProperty(it.key().constData(), it.value());
+    }
+  label->setProperty("thumbnailIndex", index);
+  label->setText(thumbnail.Text);
+  label->setSelected(index == this->CurrentThumbnail);
+
+  QPixmap pixmap = thumbnail.Pixmap;
+  if (!thumbnail.FilePath.isEmpty())
+    {
+    QPixmapCache::find(this->pixmapCacheKey(thumbnail.FilePath), &pixmap);
+    }
+  label->setPixmap(pixmap);
+}
+
+//----------------------------------------------------------------------------
+ctkThumbnailLabel* ctkThumbnailListWidgetPrivate::takeLabel()
+{
+  Q_Q(ctkThumbnailListWidget);
+
+  if (!this->FreeLabels.isEmpty())
+    {
+    return this->FreeLabels.takeLast();
+    }
+  ctkThumbnailLabel* label = new ctkThumbnailLabel(this->ScrollAreaContentWidget);
+  q->connect(label, SIGNAL(selected(ctkThumbnailLabel)),
+    q, SLOT(onThumbnailSelected(ctkThumbnailLabel)));
+  q->connect(label, SIGNAL(selected(ctkThumbnailLabel)),
+    q, SIGNAL(selected(ctkThumbnailLabel)));
+  q->connect(label, SIGNAL(doubleClicked(ctkThumbnailLabel)),
+    q, SIGNAL(doubleClicked(ctkThumbnailLabel)));
+  return label;
+}
+
+//----------------------------------------------------------------------------
+int ctkThumbnailListWidgetPrivate::labelIndex(const ctkThumbnailLabel* label)const
+{
+  QVariant index = label->property("thumbnailIndex");
+  if (!index.isValid() || this->VisibleLabels.value(index.toInt()) != label)
+    {
+    return -1;
+    }
+  return index.toInt();
+}
+
+//----------------------------------------------------------------------------
+void ctkThumbnailListWidgetPrivate::loadThumbnailFiles()
+{
+  while (true)
+    {
+    QString filePath;
+    QSize size;
+    {
+    QMutexLocker locker(&this->LoaderMutex);
+    if (this->PendingFiles.isEmpty())
+      {
+      this->LoaderRunning = false;
+      return;
+      }
+    filePath = this->PendingFiles.takeFirst();
+    size = this->LoadSize;
+    this->LoadingFiles.insert(filePath);
+    }
+    // QPixmap can only be used in the GUI thread
+    QImage image(filePath);
+    if (image.width() > size.width() || image.height() > size.height())
+      {
+      image = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+      }
+    QMetaObject::invokeMethod(this->q_ptr, "onThumbnailFileLoaded", Qt::QueuedConnection,
+                              Q_ARG(QString, filePath), Q_ARG(QImage, image));
+    {
+    QMutexLocker locker(&this->LoaderMutex);
+    this->LoadingFiles.remove(filePath);
+    }
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -176,7 +439,13 @@ ctkThumbnailListWidget::~ctkThumbnailListWidget()
 {
   Q_D(ctkThumbnailListWidget);
 
-  d->clearAllThumbnails();
+  // the loader posts the decoded files to this object
+  {
+  QMutexLocker locker(&d->LoaderMutex);
+  d->PendingFiles.clear();
+  }
+  d->LoaderPool.waitForDone();
+  delete d_ptr;
 }
 
 //----------------------------------------------------------------------------
@@ -192,14 +461,27 @@ void ctkThumbnailListWidget::addThumbnails(const QList<QPixmap>& thumbnails)
 void ctkThumbnailListWidget::addThumbnail(const QPixmap& pixmap, const QString& label)
 {
   Q_D(ctkThumbnailListWidget);
-  ctkThumbnailLabel* widget = new ctkThumbnailLabel(d->ScrollAreaContentWidget);
-  widget->setText(label);
-  if(d->ThumbnailSize.isValid())
-    {
-    widget->setFixedSize(d->ThumbnailSize);
-    }
-  widget->setPixmap(pixmap);
-  d->addThumbnail(widget);
+  ctkThumbnailListWidgetPrivate::Thumbnail thumbnail;
+  thumbnail.Text = label;
+  thumbnail.Pixmap = pixmap;
+  d->addThumbnail(thumbnail);
+}
+
+//----------------------------------------------------------------------------
+void ctkThumbnailListWidget::addThumbnailFile(const QString& filePath, const QString& label)
+{
+  Q_D(ctkThumbnailListWidget);
+  ctkThumbnailListWidgetPrivate::Thumbnail thumbnail;
+  thumbnail.Text = label;
+  thumbnail.FilePath = filePath;
+  d->addThumbnail(thumbnail);
+}
+
+//----------------------------------------------------------------------------
+int ctkThumbnailListWidget::thumbnailCount()const
+{
+  Q_D(const ctkThumbnailListWidget);
+  return d->Thumbnails.count();
 }
 
 //----------------------------------------------------------------------------
@@ -207,27 +489,28 @@ void ctkThumbnailListWidget::setCurrentThumbnail(int index)
 {
   Q_D(ctkThumbnailListWidget);
 
-  int count = d->ScrollAreaContentWidget->layout()->count();
+  int count = d->Thumbnails.count();
 
   logger.debug("Select thumbnail " + QVariant(index).toString() + " of " + QVariant(count).toString());
 
   if(index >= count)return;
 
-  for(int i=0; i<count; i++)
+  if (d->RequestRelayout)
     {
-    ctkThumbnailLabel* thumbnailWidget = qobject_cast<ctkThumbnailLabel*>(d->ScrollAreaContentWidget->layout()->itemAt(i)->widget());
-    if(i == index)
-      {
-      thumbnailWidget->setSelected(true);
-      d->ScrollArea->ensureWidgetVisible(thumbnailWidget);
-      }
-    else
-      {
-      thumbnailWidget->setSelected(false);
-      }
+    this->updateLayout();
     }
-
   d->CurrentThumbnail = index;
+  QHash<int, ctkThumbnailLabel*>::const_iterator it;
+  for (it = d->VisibleLabels.constBegin(); it != d->VisibleLabels.constEnd(); ++it)
+    {
+    it.value()->setSelected(it.key() == index);
+    }
+  if (index >= 0)
+    {
+    QRect rect = d->thumbnailRect(index);
+    d->ScrollArea->ensureVisible(rect.center().x(), rect.center().y(),
+                                 rect.width() / 2, rect.height() / 2);
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -242,47 +525,59 @@ int ctkThumbnailListWidget::currentThumbnail()
 void ctkThumbnailListWidget::onThumbnailSelected(const ctkThumbnailLabel &widget)
 {
   Q_D(ctkThumbnailListWidget);
-  for(int i=0; i<d->ScrollAreaContentWidget->layout()->count(); i++)
+  d->CurrentThumbnail = d->labelIndex(&widget);
+  foreach(ctkThumbnailLabel* thumbnailWidget, d->VisibleLabels)
     {
-    ctkThumbnailLabel* thumbnailWidget = qobject_cast<ctkThumbnailLabel*>(d->ScrollAreaContentWidget->layout()->itemAt(i)->widget());
-    if(thumbnailWidget && (&widget != thumbnailWidget))
+    if(&widget != thumbnailWidget)
       {
       thumbnailWidget->setSelected(false);
       }
     }
 }
 
+//----------------------------------------------------------------------------
+void ctkThumbnailListWidget::onThumbnailFileLoaded(const QString& filePath, const QImage& image)
+{
+  Q_D(ctkThumbnailListWidget);
+  if (image.isNull())
+    {
+    logger.warn("Could not read thumbnail " + filePath);
+    d->FailedFiles.insert(filePath);
+    return;
+    }
+  QPixmap pixmap = QPixmap::fromImage(image);
+  QPixmapCache::insert(d->pixmapCacheKey(filePath), pixmap);
+  QHash<int, ctkThumbnailLabel*>::const_iterator it;
+  for (it = d->VisibleLabels.constBegin(); it != d->VisibleLabels.constEnd(); ++it)
+    {
+    if (d->Thumbnails[it.key()].FilePath == filePath)
+      {
+      it.value()->setPixmap(pixmap);
+      }
+    }
+}
+
 //----------------------------------------------------------------------------
 void ctkThumbnailListWidget::setFlow(Qt::Orientation flow)
 {
   Q_D(ctkThumbnailListWidget);
-  ctkFlowLayout* flowLayout = qobject_cast<ctkFlowLayout*>(
-    d->ScrollAreaContentWidget->layout());
-  flowLayout->setOrientation(flow);
+  d->Flow = flow;
+  this->updateLayout();
 }
 
 //----------------------------------------------------------------------------
 Qt::Orientation ctkThumbnailListWidget::flow()const
 {
   Q_D(const ctkThumbnailListWidget);
-  ctkFlowLayout* flowLayout = qobject_cast<ctkFlowLayout*>(
-    d->ScrollAreaContentWidget->layout());
-  return flowLayout->orientation();
+  return d->Flow;
 }
 
 //----------------------------------------------------------------------------
 void ctkThumbnailListWidget::setThumbnailSize(QSize size)
 {
   Q_D(ctkThumbnailListWidget);
-  if (size.isValid())
-    {
-    foreach( ctkThumbnailLabel* thumbnail,
-             this->findChildren<ctkThumbnailLabel*>())
-      {
-      thumbnail->setFixedSize(size);
-      }
-    }
   d->ThumbnailSize = size;
+  this->updateLayout();
 }
 
 //----------------------------------------------------------------------------
@@ -310,13 +605,10 @@ void ctkThumbnailListWidget::resizeEvent(QResizeEvent* event)
 bool ctkThumbnailListWidget::eventFilter(QObject* watched, QEvent* event)
 {
   Q_D(ctkThumbnailListWidget);
-  if (d->RequestRelayout &&
-      qobject_cast<ctkThumbnailLabel*>(watched) &&
-      event->type() == QEvent::Show)
+  if (watched == d->ScrollArea->viewport() &&
+      event->type() == QEvent::Resize)
     {
-    d->RequestRelayout = false;
-    watched->removeEventFilter(this);
-    QTimer::singleShot(0, this, SLOT(updateLayout()));
+    d->updateVisibleThumbnails();
     }
   return this->Superclass::eventFilter(watched, event);
 }
@@ -325,5 +617,13 @@ bool ctkThumbnailListWidget::eventFilter(QObject* watched, QEvent* event)
 void ctkThumbnailListWidget::updateLayout()
 {
   Q_D(ctkThumbnailListWidget);
+  d->RequestRelayout = false;
   d->updateScrollAreaContentWidgetSize(this->size());
 }
+
+//----------------------------------------------------------------------------
+void ctkThumbnailListWidget::updateVisibleThumbnails()
+{
+  Q_D(ctkThumbnailListWidget);
+  d->updateVisibleThumbnails();
+}
@@ -23,6 +23,7 @@
 
 // Qt includes
 #include <QWidget>
+class QImage;
 class QResizeEvent;
 
 // CTK includes
@@ -31,6 +32,11 @@ class ctkThumbnailListWidgetPrivate;
 class ctkThumbnailLabel;
 
 /// \ingroup Widgets
+/// ctkThumbnailListWidget shows thumbnails in a scrollable grid.
+/// Only the visible thumbnails are shown by a ctkThumbnailLabel, the labels
+/// are reused as the list is scrolled: the widget passed with selected()
+/// and doubleClicked() has a "thumbnailIndex" property with the index of
+/// the thumbnail. All the thumbnails have the size thumbnailSize.
 class CTK_WIDGETS_EXPORT ctkThumbnailListWidget : public QWidget
 {
   Q_OBJECT
@@ -48,6 +54,13 @@ public:
   /// Add multiple thumbnails to the widget
   void addThumbnails(const QList<QPixmap>& thumbnails);
 
+  /// Add a thumbnail read from an image file. The file is read in the
+  /// background when the thumbnail becomes visible.
+  void addThumbnailFile(const QString& filePath, const QString& label = QString());
+
+  /// Number of thumbnails
+  int thumbnailCount()const;
+
   /// Set current thumbnail
   void setCurrentThumbnail(int index);
 
@@ -63,7 +76,7 @@ public:
   void setFlow(Qt::Orientation orientation);
   Qt::Orientation flow()const;
 
-  /// Get thumbnail width
+  /// Get thumbnail size. 128x128 is used if the size is invalid (default).
   QSize thumbnailSize()const;
 
   virtual bool eventFilter(QObject* watched, QEvent* event);
@@ -79,6 +92,8 @@ Q_SIGNALS:
 protected Q_SLOTS:
   void onThumbnailSelected(const ctkThumbnailLabel& widget);
   void updateLayout();
+  void updateVisibleThumbnails();
+  void onThumbnailFileLoaded(const QString& filePath, const QImage& image);
 
 protected:
   explicit ctkThumbnailListWidget(ctkThumbnailListWidgetPrivate* ptr, QWidget* parent=0);
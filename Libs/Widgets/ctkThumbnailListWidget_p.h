@@ -21,6 +21,16 @@
 #ifndef __ctkThumbnailListWidget_p_h
 #define __ctkThumbnailListWidget_p_h
 
+// Qt includes
+#include <QHash>
+#include <QMutex>
+#include <QPixmap>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVariant>
+#include <QVector>
+
 #include "ctkWidgetsExport.h"
 #include "ui_ctkThumbnailListWidget.h"
 
@@ -29,27 +39,81 @@ class ctkThumbnailListWidget;
 
 //----------------------------------------------------------------------------
 /// \ingroup Widgets
+/// Only the visible thumbnails have a ctkThumbnailLabel. The labels of the
+/// thumbnails scrolled out of view are reused for the ones scrolled in.
 class CTK_WIDGETS_EXPORT ctkThumbnailListWidgetPrivate
   : public Ui_ctkThumbnailListWidget
 {
   Q_DECLARE_PUBLIC(ctkThumbnailListWidget);
 public:
   ctkThumbnailListWidgetPrivate(ctkThumbnailListWidget* parent);
+  virtual ~ctkThumbnailListWidgetPrivate();
+
+  struct Thumbnail
+  {
+    QString Text;
+    /// Pixmap of the thumbnails added from memory
+    QPixmap Pixmap;
+    /// File of the thumbnails loaded when visible. The decoded pixmaps are
+    /// kept in QPixmapCache.
+    QString FilePath;
+    /// Set as dynamic properties of the label showing the thumbnail
+    QHash<QByteArray, QVariant> Properties;
+  };
 
   /// Initialize
   void init();
 
   void clearAllThumbnails();
-  void addThumbnail(ctkThumbnailLabel* thumbnail);
+  void addThumbnail(const Thumbnail& thumbnail);
+  /// Load again the thumbnails of \a filePath when they are visible,
+  /// for files that didn't exist yet or that changed.
+  void reloadThumbnailFile(const QString& filePath);
+  QString pixmapCacheKey(const QString& filePath)const;
   void updateScrollAreaContentWidgetSize(QSize size);
 
+  /// Size of the thumbnails and number of rows (Qt::Vertical flow) or
+  /// columns (Qt::Horizontal flow)
+  QSize cellSize()const;
+  int lineLength(int viewportLength)const;
+  QRect thumbnailRect(int index)const;
+
+  /// Bind a label to each visible thumbnail and load their pixmaps
+  void updateVisibleThumbnails();
+  void bindLabel(ctkThumbnailLabel* label, int index);
+  ctkThumbnailLabel* takeLabel();
+  /// Returns the index of the thumbnail shown by the label, -1 if none
+  int labelIndex(const ctkThumbnailLabel* label)const;
+
+  /// Decode the pending files, runs on the loader thread
+  void loadThumbnailFiles();
+
 protected:
   ctkThumbnailListWidget* const q_ptr;
 
   int CurrentThumbnail;
   QSize ThumbnailSize;
+  Qt::Orientation Flow;
+  int Spacing;
+  /// Number of thumbnails per row or column of the current layout
+  int LineLength;
   bool RequestRelayout;
 
+  QVector<Thumbnail> Thumbnails;
+  QHash<int, ctkThumbnailLabel*> VisibleLabels;
+  QList<ctkThumbnailLabel*> FreeLabels;
+  /// Files that couldn't be read, they are not tried again until
+  /// reloadThumbnailFile() is called
+  QSet<QString> FailedFiles;
+
+  QThreadPool LoaderPool;
+  /// Protects the members below
+  QMutex LoaderMutex;
+  QStringList PendingFiles;
+  QSet<QString> LoadingFiles;
+  QSize LoadSize;
+  bool LoaderRunning;
+
 private:
   Q_DISABLE_COPY( ctkThumbnailListWidgetPrivate );
 };
@@ -0,0 +1,346 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+// CTK includes
+#include "ctkWindowLevelMapper.h"
+#include "ctkWindowLevelMapper_p.h"
+
+#ifdef CTK_WINDOWLEVEL_HAVE_SSE2
+# include <emmintrin.h>
+#endif
+#if defined(CTK_WINDOWLEVEL_HAVE_AVX2) && defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
+namespace
+{
+
+// 1024 x 1024 values, below that the threads cost more than they save
+const int ParallelThreshold = 1024 * 1024;
+
+//------------------------------------------------------------------------------
+bool cpuSupportsAVX2()
+{
+#if defined(CTK_WINDOWLEVEL_HAVE_AVX2)
+# if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    {
+    return false;
+    }
+  __cpuid(info, 1);
+  const bool osUsesXSave = (info[2] & (1 << 27)) != 0;
+  const bool cpuHasAVX = (info[2] & (1 << 28)) != 0;
+  if (!osUsesXSave || !cpuHasAVX)
+    {
+    return false;
+    }
+  // the OS saves the YMM registers
+  if ((_xgetbv(0) & 0x6) != 0x6)
+    {
+    return false;
+    }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+# else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+# endif
+#else
+  return false;
+#endif
+}
+
+//------------------------------------------------------------------------------
+struct MapParameters
+{
+  const quint16* Values;
+  int Width;
+  uchar* Output;
+  int BytesPerLine;
+  bool IsSigned;
+  float Lower;
+  float Scale;
+  ctkWindowLevelMapper::Implementation Implementation;
+};
+
+//------------------------------------------------------------------------------
+void mapValues(const MapParameters& parameters, const quint16* values, int count, uchar* output)
+{
+  switch (parameters.Implementation)
+    {
+#ifdef CTK_WINDOWLEVEL_HAVE_AVX2
+    case ctkWindowLevelMapper::AVX2:
+      ctkWindowLevelMapAVX2(values, count, parameters.IsSigned,
+                            parameters.Lower, parameters.Scale, output);
+      break;
+#endif
+#ifdef CTK_WINDOWLEVEL_HAVE_SSE2
+    case ctkWindowLevelMapper::SSE2:
+      ctkWindowLevelMapSSE2(values, count, parameters.IsSigned,
+                            parameters.Lower, parameters.Scale, output);
+      break;
+#endif
+    default:
+      ctkWindowLevelMapScalar(values, count, parameters.IsSigned,
+                              parameters.Lower, parameters.Scale, output);
+      break;
+    }
+}
+
+//------------------------------------------------------------------------------
+void mapRows(const MapParameters& parameters, int firstRow, int endRow)
+{
+  for (int y = firstRow; y < endRow; ++y)
+    {
+    mapValues(parameters, parameters.Values + y * parameters.Width, parameters.Width,
+              parameters.Output + y * parameters.BytesPerLine);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Maps a band of rows on a thread of the pool
+class MapRowsTask : public QRunnable
+{
+public:
+  MapRowsTask(const MapParameters& parameters, int firstRow, int endRow, QSemaphore& done)
+    : Parameters(parameters)
+    , FirstRow(firstRow)
+    , EndRow(endRow)
+    , Done(done)
+  {
+  }
+
+  virtual void run()
+  {
+    mapRows(this->Parameters, this->FirstRow, this->EndRow);
+    this->Done.release();
+  }
+
+protected:
+  const MapParameters& Parameters;
+  int FirstRow;
+  int EndRow;
+  QSemaphore& Done;
+};
+
+//------------------------------------------------------------------------------
+MapParameters mapParameters(const quint16* values, bool isSigned, double window, double level,
+                            ctkWindowLevelMapper::Implementation implementation)
+{
+  window = qMax(window, 1.);
+  MapParameters parameters;
+  parameters.Values = values;
+  parameters.Width = 0;
+  parameters.Output = 0;
+  parameters.BytesPerLine = 0;
+  parameters.IsSigned = isSigned;
+  parameters.Lower = static_cast<float>(level - window / 2.);
+  parameters.Scale = static_cast<float>(255. / window);
+  if (implementation == ctkWindowLevelMapper::Automatic
+      || !ctkWindowLevelMapper::isImplementationAvailable(implementation))
+    {
+    implementation = ctkWindowLevelMapper::bestImplementation();
+    }
+  parameters.Implementation = implementation;
+  return parameters;
+}
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+void ctkWindowLevelMapScalar(const unsigned short* values, int count, bool isSigned,
+                             float lower, float scale, unsigned char* output)
+{
+  if (isSigned)
+    {
+    const short* signedValues = reinterpret_cast<const short*>(values);
+    for (int i = 0; i < count; ++i)
+      {
+      output[i] = ctkWindowLevelMapValue(static_cast<float>(signedValues[i]), lower, scale);
+      }
+    }
+  else
+    {
+    for (int i = 0; i < count; ++i)
+      {
+      output[i] = ctkWindowLevelMapValue(static_cast<float>(values[i]), lower, scale);
+      }
+    }
+}
+
+#ifdef CTK_WINDOWLEVEL_HAVE_SSE2
+//------------------------------------------------------------------------------
+void ctkWindowLevelMapSSE2(const unsigned short* values, int count, bool isSigned,
+                           float lower, float scale, unsigned char* output)
+{
+  const __m128 lowerValue = _mm_set1_ps(lower);
+  const __m128 scaleValue = _mm_set1_ps(scale);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 maximum = _mm_set1_ps(255.f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128i zeroInteger = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 8 <= count; i += 8)
+    {
+    __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+    __m128i low;
+    __m128i high;
+    if (isSigned)
+      {
+      // sign extend by shifting the value from the high half
+      low = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+      high = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+      }
+    else
+      {
+      low = _mm_unpacklo_epi16(packed, zeroInteger);
+      high = _mm_unpackhi_epi16(packed, zeroInteger);
+      }
+    __m128 lowMapped = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(low), lowerValue), scaleValue);
+    __m128 highMapped = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(high), lowerValue), scaleValue);
+    lowMapped = _mm_min_ps(_mm_max_ps(lowMapped, zero), maximum);
+    highMapped = _mm_min_ps(_mm_max_ps(highMapped, zero), maximum);
+    low = _mm_cvttps_epi32(_mm_add_ps(lowMapped, half));
+    high = _mm_cvttps_epi32(_mm_add_ps(highMapped, half));
+    __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(low, high), zeroInteger);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(output + i), bytes);
+    }
+  ctkWindowLevelMapScalar(values + i, count - i, isSigned, lower, scale, output + i);
+}
+#endif
+
+//------------------------------------------------------------------------------
+bool ctkWindowLevelMapper::isImplementationAvailable(Implementation implementation)
+{
+  switch (implementation)
+    {
+    case Automatic:
+    case Scalar:
+      return true;
+    case SSE2:
+#ifdef CTK_WINDOWLEVEL_HAVE_SSE2
+      return true;
+#else
+      return false;
+#endif
+    case AVX2:
+      {
+      static const bool supportsAVX2 = cpuSupportsAVX2();
+      return supportsAVX2;
+      }
+    }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+ctkWindowLevelMapper::Implementation ctkWindowLevelMapper::bestImplementation()
+{
+  if (ctkWindowLevelMapper::isImplementationAvailable(AVX2))
+    {
+    return AVX2;
+    }
+  if (ctkWindowLevelMapper::isImplementationAvailable(SSE2))
+    {
+    return SSE2;
+    }
+  return Scalar;
+}
+
+//------------------------------------------------------------------------------
+void ctkWindowLevelMapper::map(const quint16* values, int count, bool isSigned,
+                               double window, double level, uchar* output,
+                               Implementation implementation)
+{
+  MapParameters parameters = mapParameters(values, isSigned, window, level, implementation);
+  mapValues(parameters, values, count, output);
+}
+
+//------------------------------------------------------------------------------
+QImage ctkWindowLevelMapper::image(const quint16* values, int width, int height, bool isSigned,
+                                   double window, double level,
+                                   const QVector<QRgb>& palette,
+                                   Implementation implementation)
+{
+  QImage image(width, height, QImage::Format_Indexed8);
+  if (image.isNull())
+    {
+    return image;
+    }
+  image.setColorTable(palette.count() == 256 ? palette : ctkWindowLevelMapper::grayPalette());
+  MapParameters parameters = mapParameters(values, isSigned, window, level, implementation);
+  parameters.Width = width;
+  parameters.Output = image.bits();
+  parameters.BytesPerLine = image.bytesPerLine();
+
+  QThreadPool* pool = QThreadPool::globalInstance();
+  const int bandCount = qMin(pool->maxThreadCount(), height);
+  if (width * height < ParallelThreshold || bandCount < 2)
+    {
+    mapRows(parameters, 0, height);
+    return image;
+    }
+  // the bands the pool has no thread for are mapped on this thread,
+  // which also maps the last one
+  QSemaphore done;
+  int startedCount = 0;
+  const int bandHeight = (height + bandCount - 1) / bandCount;
+  int firstRow = 0;
+  for (; firstRow + bandHeight < height; firstRow += bandHeight)
+    {
+    MapRowsTask* task = new MapRowsTask(parameters, firstRow, firstRow + bandHeight, done);
+    if (pool->tryStart(task))
+      {
+      ++startedCount;
+      }
+    else
+      {
+      task->run();
+      delete task;
+      done.acquire();
+      }
+    }
+  mapRows(parameters, firstRow, height);
+  done.acquire(startedCount);
+  return image;
+}
+
+//------------------------------------------------------------------------------
+QVector<QRgb> ctkWindowLevelMapper::grayPalette()
+{
+  QVector<QRgb> palette(256);
+  for (int i = 0; i < 256; ++i)
+    {
+    palette[i] = qRgb(i, i, i);
+    }
+  return palette;
+}
+
+//------------------------------------------------------------------------------
+int ctkWindowLevelMapper::parallelThreshold()
+{
+  return ParallelThreshold;
+}
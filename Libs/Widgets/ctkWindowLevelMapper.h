@@ -0,0 +1,82 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkWindowLevelMapper_h
+#define __ctkWindowLevelMapper_h
+
+// Qt includes
+#include <QImage>
+#include <QVector>
+
+#include "ctkWidgetsExport.h"
+
+/// \ingroup Widgets
+///
+/// Maps 16-bit modality values (e.g. CT Hounsfield units) to 8-bit display
+/// values with an intensity window/level.
+///
+/// Values below level - window / 2 are mapped to 0, values above
+/// level + window / 2 to 255 and the values in between linearly.
+/// The mapping is vectorized with SSE2 or AVX2 when the build and the CPU
+/// support them; every implementation gives the same output as Scalar.
+/// image() maps large frames on QThreadPool::globalInstance().
+class CTK_WIDGETS_EXPORT ctkWindowLevelMapper
+{
+public:
+  enum Implementation
+  {
+    /// Fastest available implementation
+    Automatic = 0,
+    Scalar,
+    SSE2,
+    AVX2
+  };
+
+  /// Returns true if \a implementation is built and supported by the CPU.
+  static bool isImplementationAvailable(Implementation implementation);
+  /// Implementation used by Automatic.
+  static Implementation bestImplementation();
+
+  /// Map \a count values into \a output.
+  /// \a isSigned tells if the values are signed (int16) or unsigned (uint16).
+  /// An unavailable \a implementation falls back to Scalar.
+  static void map(const quint16* values, int count, bool isSigned,
+                  double window, double level, uchar* output,
+                  Implementation implementation = Automatic);
+
+  /// Map a \a width x \a height frame into a Format_Indexed8 image that
+  /// has \a palette as color table, grayPalette() if it is empty.
+  /// Changing the palette of the returned image doesn't require mapping
+  /// the values again, see QImage::setColorTable().
+  /// Frames of more than parallelThreshold() values are split between the
+  /// threads of QThreadPool::globalInstance().
+  static QImage image(const quint16* values, int width, int height, bool isSigned,
+                      double window, double level,
+                      const QVector<QRgb>& palette = QVector<QRgb>(),
+                      Implementation implementation = Automatic);
+
+  /// 256 gray levels from black to white.
+  static QVector<QRgb> grayPalette();
+
+  /// Number of values above which image() uses the thread pool.
+  static int parallelThreshold();
+};
+
+#endif
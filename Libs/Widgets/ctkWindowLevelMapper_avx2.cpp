@@ -0,0 +1,70 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// This file is built with AVX2 enabled, see ctkWindowLevelMapper_p.h before
+// adding includes.
+
+// CTK includes
+#include "ctkWindowLevelMapper_p.h"
+
+#include <immintrin.h>
+
+//------------------------------------------------------------------------------
+void ctkWindowLevelMapAVX2(const unsigned short* values, int count, bool isSigned,
+                           float lower, float scale, unsigned char* output)
+{
+  const __m256 lowerValue = _mm256_set1_ps(lower);
+  const __m256 scaleValue = _mm256_set1_ps(scale);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 maximum = _mm256_set1_ps(255.f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  int i = 0;
+  for (; i + 16 <= count; i += 16)
+    {
+    __m128i lowPacked = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+    __m128i highPacked = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 8));
+    __m256i low;
+    __m256i high;
+    if (isSigned)
+      {
+      low = _mm256_cvtepi16_epi32(lowPacked);
+      high = _mm256_cvtepi16_epi32(highPacked);
+      }
+    else
+      {
+      low = _mm256_cvtepu16_epi32(lowPacked);
+      high = _mm256_cvtepu16_epi32(highPacked);
+      }
+    __m256 lowMapped = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(low), lowerValue), scaleValue);
+    __m256 highMapped = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(high), lowerValue), scaleValue);
+    lowMapped = _mm256_min_ps(_mm256_max_ps(lowMapped, zero), maximum);
+    highMapped = _mm256_min_ps(_mm256_max_ps(highMapped, zero), maximum);
+    low = _mm256_cvttps_epi32(_mm256_add_ps(lowMapped, half));
+    high = _mm256_cvttps_epi32(_mm256_add_ps(highMapped, half));
+    // the 256-bit packs work within each 128-bit lane, put the 64-bit
+    // blocks back in order before the last pack
+    __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+    __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words),
+                                     _mm256_extracti128_si256(words, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), bytes);
+    }
+  _mm256_zeroupper();
+  ctkWindowLevelMapScalar(values + i, count - i, isSigned, lower, scale, output + i);
+}
@@ -0,0 +1,66 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkWindowLevelMapper_p_h
+#define __ctkWindowLevelMapper_p_h
+
+// Kernels of ctkWindowLevelMapper.
+// This header is included by ctkWindowLevelMapper_avx2.cpp, which is built
+// with AVX2 enabled: it must not include Qt or STD headers, otherwise inline
+// functions compiled with AVX2 instructions could be picked by the linker
+// and run on CPUs without AVX2.
+
+// SSE2 is part of the x86-64 instruction set, the kernel is built when the
+// compiler targets it. The AVX2 kernel is only built when CMake found the
+// compiler flag (see CMakeLists.txt), it is selected at runtime.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define CTK_WINDOWLEVEL_HAVE_SSE2
+#endif
+
+//------------------------------------------------------------------------------
+/// \internal
+/// Reference mapping of a single value, the vectorized kernels do the same
+/// single precision operations in the same order so that the results are
+/// bit-exact.
+static inline unsigned char ctkWindowLevelMapValue(float value, float lower, float scale)
+{
+  float mapped = (value - lower) * scale;
+  mapped = mapped < 0.f ? 0.f : mapped;
+  mapped = mapped > 255.f ? 255.f : mapped;
+  return static_cast<unsigned char>(static_cast<int>(mapped + 0.5f));
+}
+
+//------------------------------------------------------------------------------
+/// \internal
+/// \a lower is level - window / 2 and \a scale is 255 / window
+void ctkWindowLevelMapScalar(const unsigned short* values, int count, bool isSigned,
+                             float lower, float scale, unsigned char* output);
+
+#ifdef CTK_WINDOWLEVEL_HAVE_SSE2
+void ctkWindowLevelMapSSE2(const unsigned short* values, int count, bool isSigned,
+                           float lower, float scale, unsigned char* output);
+#endif
+
+#ifdef CTK_WINDOWLEVEL_HAVE_AVX2
+void ctkWindowLevelMapAVX2(const unsigned short* values, int count, bool isSigned,
+                           float lower, float scale, unsigned char* output);
+#endif
+
+#endif